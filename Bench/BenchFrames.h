@@ -0,0 +1,160 @@
+#ifndef BenchFrames_H
+#define BenchFrames_H
+
+/* Generated by Host/build/benchframes, do not edit. One pairing session
+ * with PAC 0x2182: pair request, key, then 32 control frames and one
+ * with the e-brake on.
+ */
+
+#define BENCH_TEAM_ADC 85
+#define BENCH_NUM_CONTROL 32
+#define BENCH_CONTROL_SIZE 14
+
+static const uint8_t BenchPairFrame[11] = {
+    0x7E, 0x00, 0x07, 0x81, 0x21, 0x82, 0x28, 0x00, 0x00, 0x00, 0xB3,
+};
+
+static const uint8_t BenchKeyFrame[42] = {
+    0x7E, 0x00, 0x26, 0x81, 0x21, 0x82, 0x28, 0x00, 0x01, 0x70, 0x42, 0xB7,
+    0x98, 0x88, 0xFE, 0x3A, 0x85, 0x37, 0x49, 0xD8, 0xF0, 0x58, 0x9D, 0xB0,
+    0x9A, 0x29, 0xE3, 0x27, 0x53, 0x7E, 0xBF, 0x06, 0x7C, 0x0F, 0x06, 0xA3,
+    0x7A, 0xD4, 0xAA, 0xFD, 0x24, 0xCF,
+};
+
+static const uint8_t BenchControlFrames[BENCH_NUM_CONTROL][BENCH_CONTROL_SIZE] = {
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x72, 0xC2, 0x17, 0x98,
+        0xAA, 0x26,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xFC, 0xB2, 0x23, 0x37,
+        0x79, 0x32,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xDA, 0x60, 0xF4, 0x9D,
+        0x8E, 0x5A,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x98, 0xB1, 0x51, 0x27,
+        0x1F, 0xD3,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x7C, 0x1F, 0xBE, 0x7C,
+        0x55, 0x89,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x04, 0x0B, 0xC4, 0xD4,
+        0xC2, 0x4A,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xFF, 0x94, 0xB4, 0x42,
+        0xC1, 0x69,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x9A, 0x30, 0x34, 0x3A,
+        0x01, 0x7A,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x35, 0x89, 0x08, 0xF0,
+        0xCA, 0x33,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x9F, 0x78, 0x4C, 0x29,
+        0x43, 0xE4,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x25, 0x83, 0xA2, 0xBF,
+        0xA8, 0x02,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x7E, 0xD7, 0xE4, 0xA3,
+        0xC6, 0x11,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xD6, 0x4A, 0x15, 0x24,
+        0xBA, 0xA0,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x40, 0x5F, 0x76, 0x88,
+        0x26, 0xF0,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x38, 0x75, 0xC3, 0x49,
+        0x3E, 0xBC,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xF2, 0xA0, 0x67, 0xB0,
+        0x6E, 0x9C,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x2B, 0xE3, 0x27, 0x53,
+        0x7C, 0xAF,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xBD, 0x0E, 0x7A, 0x0F,
+        0x16, 0x49,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xA1, 0x6A, 0xD8, 0xAA,
+        0xE3, 0x43,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x26, 0x68, 0x50, 0xB7,
+        0xB4, 0x6A,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x8A, 0xDE, 0x22, 0x85,
+        0x0D, 0x97,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x4B, 0xF0, 0xEE, 0x58,
+        0xD5, 0x5D,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xB2, 0xAA, 0x0D, 0xE3,
+        0x71, 0xF6,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x51, 0x46, 0x95, 0x06,
+        0x18, 0x69,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x0D, 0x46, 0x93, 0x7A,
+        0xA6, 0xAD,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xA8, 0xB5, 0x12, 0x70,
+        0xC2, 0x12,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xB5, 0xC8, 0xB4, 0xFE,
+        0xB4, 0xD0,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x87, 0x6F, 0x0B, 0xD8,
+        0x6C, 0x6E,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x5A, 0xFD, 0xF8, 0x9A,
+        0x83, 0x47,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0xE1, 0x4F, 0x1D, 0x7E,
+        0x07, 0xE1,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x04, 0x0C, 0x5B, 0x06,
+        0x65, 0xDD,
+    },
+    {
+        0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x78, 0xAC, 0xF0, 0xFD,
+        0xF0, 0xB2,
+    },
+};
+
+static const uint8_t BenchBrakeFrame[BENCH_CONTROL_SIZE] = {
+    0x7E, 0x00, 0x0A, 0x81, 0x21, 0x82, 0x28, 0x00, 0x72, 0x02, 0xB7, 0x99,
+    0xCB, 0x24,
+};
+
+#endif /* BenchFrames_H */
@@ -0,0 +1,342 @@
+/****************************************************************************
+ Module
+   BenchMain.c
+
+ Description
+   Cycle-count benchmark firmware. Replaces the framework's main: it starts
+   the services, then drives the canned frames in BenchFrames.h through the
+   real CommService, PairingSM and MotorControl run functions, timing each
+   hot path in instruction cycles with Timer1, and prints the results over
+   the EUSART.
+
+ Notes
+   Build it with XC8 in place of the project's main module. Interrupts are
+   off while measuring, so the framework tick and the receive ISR are not in
+   the numbers; bytes go straight to RunCommService, as the receive ISR's
+   post would deliver them.
+
+   Every hot path is timed on its own, once per frame, BENCH_ROUNDS times
+   over the 32 control frames. Each result line reads
+       BENCH <name> n=<samples> min=<cycles> mean=<cycles> max=<cycles>
+   with the cost of starting and stopping Timer1 already taken off. Host
+   tools (Host/build/benchreport) compare them against a baseline.
+
+   Then the e-brake goes through the path the receive interrupt takes:
+   the braking frame is posted byte by byte through PostCommService, the
+   last byte (which runs FastBrake) timed as rx_isr_brake, and a drive
+   command and lift fan request queued before it are run afterwards the
+   way the main loop would. BENCH_BRAKE held=1 says the fan and both
+   drives were stopped by the post alone and stayed stopped.
+
+   BenchMarker is written with the number of the path about to be timed and
+   BenchDone once the report has gone out, so a simulator can log or break
+   on them (see bench.stc).
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <xc.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "PIC16F1788.h"
+#include "CommService.h"
+#include "PairingSM.h"
+#include "MotorControl.h"
+#include "FlightRecorder.h"
+#include "AdcSequencer.h"
+#include "BenchFrames.h"
+#ifdef BENCH_SMOKE_TEST
+#include <stdio.h>
+#include "HostRegs.h"
+#endif
+
+/*----------------------------- Module Defines ----------------------------*/
+#define BENCH_ROUNDS 4
+#define OVERHEAD_SAMPLES 8
+#define CTRL_PACKET_SIZE 5 // key bytes used per control frame
+#define KEY_INDEX_MASK 0x1f
+
+// the hot paths, in report order
+enum { BENCH_RX_BYTE, BENCH_COMM_FRAME, BENCH_DECRYPT_MIX, BENCH_MC_UPDATE,
+       BENCH_SEND_PACKET, BENCH_FR_RECORD, BENCH_ISR_BRAKE, NUM_BENCHES };
+
+/*---------------------------- Module Types ---------------------------*/
+typedef struct {
+    uint16_t Min;
+    uint16_t Max;
+    uint32_t Total;
+    uint16_t Count;
+} BenchStat_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void InitTimer1(void);
+static void StartTiming(uint8_t Which);
+static uint16_t StopTiming(void);
+static void Record(uint8_t Which, uint16_t Cycles);
+static uint16_t FeedByte(uint8_t Byte);
+static void FeedFrame(const uint8_t *pFrame, uint8_t Length);
+static void Pair(void);
+static bool CheckBrake(void);
+static void PrintText(const char *pText);
+static void PrintNumber(uint32_t Number);
+static void PrintChar(char Char);
+#ifdef BENCH_SMOKE_TEST
+static void SmokeTx(uint8_t Byte);
+#endif
+
+/*---------------------------- Module Variables ---------------------------*/
+static const char * const BenchNames[NUM_BENCHES] = {
+    "rx_byte", "comm_frame", "pairing_decrypt_mix", "mc_update", "send_packet",
+    "fr_record_post", "rx_isr_brake"
+};
+
+static BenchStat_t Stats[NUM_BENCHES];
+static uint16_t Overhead;
+static uint16_t NumOutOfSync;
+
+volatile uint8_t BenchMarker;
+volatile uint8_t BenchDone;
+
+/*------------------------------ Module Code ------------------------------*/
+int main(void)
+{
+    ES_Event ThisEvent;
+    uint8_t ExpectedCounter;
+    bool isHeld;
+
+    ES_Initialize();
+    // the services turn interrupts on during init, the bench wants them off
+    GIE = 0;
+    InitTimer1();
+    // cost of timing nothing
+    Overhead = 0xFFFF;
+    for (uint8_t i=0; i<OVERHEAD_SAMPLES; i++){
+        uint16_t Cycles;
+        StartTiming(NUM_BENCHES);
+        Cycles = StopTiming();
+        if (Cycles < Overhead){
+            Overhead = Cycles;
+        }
+    }
+    for (uint8_t i=0; i<NUM_BENCHES; i++){
+        Stats[i].Min = 0xFFFF;
+    }
+
+    Pair();
+    ExpectedCounter = getDecryptCounter();
+    for (uint8_t Round=0; Round<BENCH_ROUNDS; Round++){
+        for (uint8_t i=0; i<BENCH_NUM_CONTROL; i++){
+            uint16_t FrameCycles = 0;
+            // receive: every byte on its own, the frame as their sum
+            for (uint8_t j=0; j<BENCH_CONTROL_SIZE; j++){
+                uint16_t Cycles = FeedByte(BenchControlFrames[i][j]);
+                Record(BENCH_RX_BYTE, Cycles);
+                FrameCycles += Cycles;
+            }
+            Record(BENCH_COMM_FRAME, FrameCycles);
+            // decrypt, check and mix the frame now in the receive buffer
+            ThisEvent.EventType = ES_NEW_PACKET;
+            ThisEvent.EventParam = RF_SIZE(ControlFrame_t);
+            StartTiming(BENCH_DECRYPT_MIX);
+            RunPairingSM(ThisEvent);
+            Record(BENCH_DECRYPT_MIX, StopTiming());
+            ExpectedCounter = (ExpectedCounter + CTRL_PACKET_SIZE) & KEY_INDEX_MASK;
+            if (getDecryptCounter() != ExpectedCounter){
+                NumOutOfSync++;
+                ExpectedCounter = getDecryptCounter();
+            }
+            // drive and turn bytes to duty cycle registers
+            ThisEvent.EventType = ES_DRIVE_COMMAND;
+            ThisEvent.EventParam = 0x01;
+            StartTiming(BENCH_MC_UPDATE);
+            RunMC(ThisEvent);
+            Record(BENCH_MC_UPDATE, StopTiming());
+            // the status reply, including waiting on the UART
+            ThisEvent.EventType = ES_STATUS1;
+            StartTiming(BENCH_SEND_PACKET);
+            RunCommService(ThisEvent);
+            Record(BENCH_SEND_PACKET, StopTiming());
+            // one flight recorder entry, which every post now pays for
+            StartTiming(BENCH_FR_RECORD);
+            FR_RecordPost(FR_NO_SERVICE, &ThisEvent, true);
+            Record(BENCH_FR_RECORD, StopTiming());
+        }
+    }
+
+    isHeld = CheckBrake();
+
+#ifdef BENCH_SMOKE_TEST
+    // on the host shim only the report goes to stdout, not the status frames
+    HostRegs_SetCallbacks(SmokeTx, NULL);
+#endif
+    for (uint8_t i=0; i<NUM_BENCHES; i++){
+        PrintText("BENCH ");
+        PrintText(BenchNames[i]);
+        PrintText(" n=");
+        PrintNumber(Stats[i].Count);
+        PrintText(" min=");
+        PrintNumber(Stats[i].Min);
+        PrintText(" mean=");
+        PrintNumber(Stats[i].Total/Stats[i].Count);
+        PrintText(" max=");
+        PrintNumber(Stats[i].Max);
+        PrintText("\r\n");
+    }
+    // every frame must have decrypted, or the numbers are for the wrong path
+    PrintText("BENCH_SYNC out_of_sync=");
+    PrintNumber(NumOutOfSync);
+    PrintText("\r\n");
+    PrintText("BENCH_BRAKE held=");
+    PrintNumber(isHeld);
+    PrintText("\r\n");
+    BenchDone = 1;
+#ifndef BENCH_SMOKE_TEST
+    for (;;){
+    }
+#endif
+    return 0;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// InitTimer1: count instruction cycles (Fosc/4, no prescaler, no gate)
+static void InitTimer1(void){
+    TMR1ON = 0;
+    TMR1CS1 = 0;
+    TMR1CS0 = 0;
+    T1CKPS1 = 0;
+    T1CKPS0 = 0;
+    TMR1GE = 0;
+}
+
+static void StartTiming(uint8_t Which){
+    BenchMarker = Which;
+    TMR1H = 0;
+    TMR1L = 0;
+    TMR1ON = 1;
+}
+
+// StopTiming: stop the timer first so the two halves read consistently
+static uint16_t StopTiming(void){
+    TMR1ON = 0;
+    return ((uint16_t)TMR1H << 8) | TMR1L;
+}
+
+static void Record(uint8_t Which, uint16_t Cycles){
+    BenchStat_t *pStat = &Stats[Which];
+    if (Which != BENCH_COMM_FRAME){
+        // a frame is a sum of bytes that already had it taken off
+        Cycles = (Cycles > Overhead) ? Cycles - Overhead : 0;
+    }
+    if (Cycles < pStat->Min){
+        pStat->Min = Cycles;
+    }
+    if (Cycles > pStat->Max){
+        pStat->Max = Cycles;
+    }
+    pStat->Total += Cycles;
+    pStat->Count++;
+}
+
+// FeedByte: one received byte through CommService; returns its cost
+static uint16_t FeedByte(uint8_t Byte){
+    ES_Event ThisEvent;
+    uint16_t Cycles;
+    ThisEvent.EventType = ES_ReceivedByte;
+    ThisEvent.EventParam = Byte;
+    StartTiming(BENCH_RX_BYTE);
+    RunCommService(ThisEvent);
+    Cycles = StopTiming();
+    return (Cycles > Overhead) ? Cycles - Overhead : 0;
+}
+
+static void FeedFrame(const uint8_t *pFrame, uint8_t Length){
+    for (uint8_t i=0; i<Length; i++){
+        FeedByte(pFrame[i]);
+    }
+}
+
+/* Pair: walk PairingSM into Waiting4Control with the canned key. The run
+ * functions are called directly; what they post is left in the queues.
+ */
+static void Pair(void){
+    ES_Event ThisEvent;
+    ThisEvent.EventType = ES_INIT;
+    RunCommService(ThisEvent);
+    RunPairingSM(ThisEvent);
+    // no ADC interrupts to read the team resistor, so stand in for them
+    ADC_Publish(ADC_CH_TEAM, BENCH_TEAM_ADC);
+    ThisEvent.EventType = ES_TIMEOUT;
+    ThisEvent.EventParam = ADC_TIMER;
+    RunPairingSM(ThisEvent);
+    FeedFrame(BenchPairFrame, sizeof(BenchPairFrame));
+    ThisEvent.EventType = ES_NEW_PACKET;
+    ThisEvent.EventParam = RF_SIZE(PairRequestFrame_t);
+    RunPairingSM(ThisEvent);
+    FeedFrame(BenchKeyFrame, sizeof(BenchKeyFrame));
+    ThisEvent.EventParam = RF_SIZE(KeyFrame_t);
+    RunPairingSM(ThisEvent);
+}
+
+/* CheckBrake: with the craft driving, post the braking frame as the
+ * receive interrupt does, then run what MotorControl had queued from
+ * before it: the drive command and lift fan request for the last frame.
+ * returns true if the post alone stopped the fan and both drives, and
+ * they stayed stopped
+ */
+static bool CheckBrake(void){
+    ES_Event ThisEvent;
+    uint8_t Brakes = getMCBrakes();
+    uint16_t Cycles = 0;
+    bool isStopped;
+    ThisEvent.EventType = ES_LiftFan;
+    ThisEvent.EventParam = MC_FAN_ON(Brakes);
+    RunMC(ThisEvent);
+    ThisEvent.EventType = ES_DRIVE_COMMAND;
+    RunMC(ThisEvent);
+    if ((LATA0 == 0) || (CCPR2L == 0) || (CCPR3L == 0)){
+        return false; // not driving, nothing to check
+    }
+    ThisEvent.EventType = ES_ReceivedByte;
+    for (uint8_t i=0; i<BENCH_CONTROL_SIZE; i++){
+        ThisEvent.EventParam = BenchBrakeFrame[i];
+        StartTiming(BENCH_ISR_BRAKE);
+        PostCommService(ThisEvent);
+        Cycles = StopTiming();
+    }
+    Record(BENCH_ISR_BRAKE, Cycles);
+    isStopped = (LATA0 == 0) && (CCPR2L == 0) && (CCPR3L == 0);
+    ThisEvent.EventType = ES_DRIVE_COMMAND;
+    RunMC(ThisEvent);
+    ThisEvent.EventType = ES_LiftFan;
+    ThisEvent.EventParam = MC_FAN_ON(Brakes);
+    RunMC(ThisEvent);
+    return isStopped && (LATA0 == 0) && (CCPR2L == 0) && (CCPR3L == 0);
+}
+
+static void PrintText(const char *pText){
+    while (*pText != '\0'){
+        PrintChar(*pText++);
+    }
+}
+
+static void PrintNumber(uint32_t Number){
+    char Digits[10];
+    uint8_t NumDigits = 0;
+    do {
+        Digits[NumDigits++] = '0' + (Number % 10);
+        Number /= 10;
+    } while (Number > 0);
+    while (NumDigits > 0){
+        PrintChar(Digits[--NumDigits]);
+    }
+}
+
+static void PrintChar(char Char){
+    TX1REG = Char;
+    while (TRMT == 0);
+}
+
+#ifdef BENCH_SMOKE_TEST
+static void SmokeTx(uint8_t Byte){
+    putchar(Byte);
+}
+#endif
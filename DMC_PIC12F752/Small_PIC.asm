@@ -10,16 +10,39 @@
 ; Define bit numbers of port A
 LED1		 	equ 0x00 ; 0th bit (red team LED)
 LED2		 	equ 0x01 ; 1st bit (blue team LED)
-INPUT1			equ 0x02 ; 2nd bit
-INPUT2			equ 0x03 ; 3rd bit
+LINK_DATA		equ 0x02 ; 2nd bit (link data, from the main PIC's RA6)
+LINK_CLK		equ 0x03 ; 3rd bit (link clock, from the main PIC's RA7)
 SERVO		 	equ 0x04 ; 4th bit
 DEBUG			equ 0x05 ; 5th bit
 
 ; RAM locations
-LastTime		equ 0x70 ; holds last high-time of servo PWM
-PS_Cntr			equ 0x71 ; holds value of HLTMR postcale counter
-HighTime		equ 0x72 ; holds current deired high-time for servo PWM
+Pos				equ 0x70 ; holds current servo pulse width, in TMR2 counts (16 us)
+Start			equ 0x71 ; holds pulse width the current move started from
+Span			equ 0x72 ; holds distance of the current move, see Flags DOWN
 Rdy2Raise		equ 0x73 ; holds software flag for guarding physical flag-raising action
+LinkState		equ 0x74 ; holds where the link receiver is in a frame, LS_x
+Flags			equ 0x75 ; holds software flags shared by Main and the ISR
+ParkCntr		equ 0x76 ; holds servo periods left before the PWM is stopped
+Index			equ 0x77 ; holds current step of the motion profile
+StepLen			equ 0x78 ; holds servo periods per profile step
+StepCntr		equ 0x79 ; holds servo periods left in this step
+Phase			equ 0x7A ; holds TMR2 slices left in this servo period
+Frac			equ 0x7B ; holds profile table value being scaled (and scratch)
+ProdH			equ 0x7C ; holds Span*Frac/256
+
+; bank 0 RAM locations, for the link and the commands it carries
+RxBuf			equ 0x40 ; holds the frame being received, RX_SIZE bytes
+RxByte			equ 0x44 ; holds the byte being shifted in
+BitCntr			equ 0x45 ; holds bits left in RxByte
+RxCount			equ 0x46 ; holds bytes of the frame received so far
+FrameLen		equ 0x47 ; holds bytes in the frame, from its command byte
+RxSum			equ 0x48 ; holds the sum of the bytes received so far
+LinkFlags		equ 0x49 ; holds link receiver flags
+Edges			equ 0x4A ; holds the IOC flags being handled
+Pins			equ 0x4B ; holds PORTA as the IOC ISR found it
+LedPattern		equ 0x4C ; holds the LED pattern last commanded
+BlinkCntr		equ 0x4D ; holds servo periods until the LEDs toggle
+WaveCntr		equ 0x4E ; holds moves left in the celebration
 
 ; ISR PUSH/POP RAM locations
 WREG_TEMP		equ 0x7D
@@ -27,6 +50,86 @@ STATUS_TEMP 	equ 0x7E
 PCLATH_TEMP		equ 0x7F 
 
 ; Other constants
+LINK_MASK		equ b'00001100' ; LINK_DATA and LINK_CLK
+PARK_PERIODS	equ d'50'	 ; servo periods to hold the lowered flag before stopping the PWM
+
+; bits of Flags
+FRAME			equ 0x00 ; RxBuf holds a command for Main
+MOVING			equ 0x01 ; a motion profile is running
+DOWN			equ 0x02 ; the move goes to Start - Span, not Start + Span
+TRAPEZOID		equ 0x03 ; the move follows TrapTable, not EaseTable
+DESCEND_NEXT	equ 0x04 ; when this move ends, start the slow descent
+WAVING			equ 0x05 ; a celebration is running, see WaveCntr
+
+; bits of LinkFlags
+DISCARD			equ 0x00 ; do not keep this frame (Main is busy, or it is too long)
+FRAME_OK		equ 0x01 ; the frame is complete and adds up, ack it
+
+; link receiver states, see IOC_ISR and the notes at the end
+LS_IDLE			equ 0x00 ; waiting for a start
+LS_RECEIVE		equ 0x01 ; shifting in bits on rising clock edges
+LS_ACK			equ 0x02 ; all bytes in, the next rising clock edge is the ack
+LS_ACKING		equ 0x03 ; driving the ack until the clock falls
+LS_WAIT_STOP	equ 0x04 ; waiting for the stop
+
+; frames: command in the high nibble of the first byte, payload length in
+; the low one, the payload, then a checksum; all of it adds up to 0xFF
+RX_SIZE			equ d'4'	 ; longest frame: command, two bytes, checksum
+LINK_LEN_MASK	equ b'00001111'
+CMD_TEAM		equ 0x01	 ; team: TEAM_x
+CMD_SERVO		equ 0x02	 ; pulse width in TMR2 counts, servo periods per step
+CMD_LEDS		equ 0x03	 ; pattern: LED1/LED2 bits, LED_BLINK
+CMD_CELEBRATE	equ 0x04	 ; none
+TEAM_NONE		equ 0x00
+TEAM_RED		equ 0x01
+TEAM_BLUE		equ 0x02
+
+; LED patterns: the LED bits of LATA, and LED_BLINK to flash them. Blinking
+; is timed by the servo PWM, so a parked servo holds the LEDs where they are.
+LED_MASK		equ (1 << LED1) | (1 << LED2)
+LED_BLINK		equ 0x07
+BLINK_PERIODS	equ d'16'	 ; 320 ms on, 320 ms off
+
+; Servo timing. TMR2 always runs at Fosc/4/16, one count every 16 us. A
+; servo period is SLICE_COUNTS*(LOW_SLICES+1) counts, 20 ms: the pulse
+; (Pos counts), the rest of the first slice, then LOW_SLICES full slices.
+T2_CONFIG		equ b'00000110' ; postscaler 1, TMR2 on, prescaler 16
+SLICE_COUNTS	equ d'250'	 ; 4 ms
+LOW_SLICES		equ d'4'
+PERIOD_MS		equ d'20'
+
+; Flag positions, as pulse widths in TMR2 counts
+FLAG_UP			equ d'125'	 ; 2.0 ms
+FLAG_DOWN		equ d'44'	 ; 0.7 ms
+FLAG_WAVE		equ d'85'	 ; 1.36 ms, the bottom of a celebration wave
+
+; Motion profiles: every move takes PROFILE_STEPS steps of StepLen periods
+PROFILE_STEPS	equ d'32'	 ; entries in EaseTable and TrapTable
+RAISE_TIME_MS	equ d'1280'	 ; pair: raise the flag, eased
+DESCENT_TIME_MS	equ d'58000' ; paired: the flag sinks back down, trapezoid
+LOWER_TIME_MS	equ d'640'	 ; unpair: lower the flag, eased
+WAVE_TIME_MS	equ d'640'	 ; celebrate: each move of a wave, eased
+CELEBRATE_WAVES	equ d'3'
+RAISE_STEP		equ RAISE_TIME_MS / (PROFILE_STEPS * PERIOD_MS)
+DESCENT_STEP	equ DESCENT_TIME_MS / (PROFILE_STEPS * PERIOD_MS)
+LOWER_STEP		equ LOWER_TIME_MS / (PROFILE_STEPS * PERIOD_MS)
+WAVE_STEP		equ WAVE_TIME_MS / (PROFILE_STEPS * PERIOD_MS)
+	if (RAISE_STEP == 0) || (LOWER_STEP == 0) || (DESCENT_STEP == 0) || (WAVE_STEP == 0)
+	error "a move must take at least PROFILE_STEPS servo periods"
+	endif
+	if (RAISE_STEP > d'255') || (LOWER_STEP > d'255') || (DESCENT_STEP > d'255') || (WAVE_STEP > d'255')
+	error "StepLen is one byte: make that move shorter"
+	endif
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; macros
+ScaleBit	macro Bit
+			; one bit of ProdH = W*Frac/256: add W if this bit of Frac is
+			; set, then shift the sum (and the carry) down a place
+			bcf STATUS, C
+			btfsc Frac, Bit
+			addwf ProdH, F
+			rrf ProdH, F
+			endm
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; program memory organization
 
@@ -37,6 +140,23 @@ PCLATH_TEMP		equ 0x7F
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; Define tables
 			; list any tables of contants here
+			; Motion profiles: with W = step (0 to PROFILE_STEPS-1), return
+			; how far along the move the flag should be, out of 256. Both
+			; tables sit in the first 256 words, so PCLATH stays 0.
+EaseTable:
+			; smoothstep, 3t^2 - 2t^3: starts and stops gently
+			addwf PCL, F
+			dt d'0', d'1', d'3', d'6', d'11', d'17', d'24', d'31'
+			dt d'40', d'49', d'59', d'70', d'81', d'92', d'104', d'116'
+			dt d'128', d'140', d'152', d'164', d'175', d'186', d'197', d'207'
+			dt d'216', d'225', d'232', d'239', d'245', d'250', d'253', d'255'
+TrapTable:
+			; trapezoidal speed: accelerate for 1/4, cruise, decelerate for 1/4
+			addwf PCL, F
+			dt d'0', d'1', d'3', d'6', d'11', d'17', d'24', d'33'
+			dt d'43', d'53', d'64', d'75', d'85', d'96', d'107', d'117'
+			dt d'128', d'139', d'149', d'160', d'171', d'181', d'192', d'203'
+			dt d'213', d'223', d'232', d'239', d'245', d'250', d'253', d'255'
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; Debug routine
 Debug:
@@ -64,39 +184,31 @@ InitFunc:
 			goto Main
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; Main
 Main: 
-			; check states of input pins, respond accordingly
-			; 	if INPUT1 is low: (case1)
-			;		if INPUT 2 is low: (case1A)
-			;			- Unpaired
-			; 		else: (case1B)
-			;			- Blue Team
-			; 	else: (case2)
-			; 		if INPUT 2 is low: (case2A)
-			;			- Red Team
-			;		else: (case2B)
-			;			- *UNIMPLEMENTED* 
+			; carry out a command once the ISR has a whole frame of it (see
+			; IOC_ISR); with nothing to do, sleep until the next edge
+			btfss Flags, FRAME
+			goto Idle
+			call DoCommand
+			; RxBuf is free for the next frame
+			bcf Flags, FRAME
+			goto Main
 
-			banksel PORTA
-			btfsc PORTA, INPUT1
-			goto case2
-
-case1:
-				btfsc PORTA, INPUT2
-				goto case1B
-case1A				call Unpaired
-					goto Done
-case1B				call BlueTeam
-					goto Done
-
-case2:
-				banksel PORTA
-				btfsc PORTA, INPUT2
-				goto case2B
-case2A				call RedTeam
-					goto Done
-case2B				goto Done
-
-Done:
+Idle:
+			; TMR2 (servo PWM) stops in sleep, so only sleep with the servo
+			; parked. The link needs no clock, each edge wakes us. Interrupts
+			; are off while checking, so an edge after the check makes SLEEP
+			; a NOP instead of being slept through; the ISR runs once GIE is
+			; back on.
+			bcf INTCON, GIE
+			btfsc Flags, FRAME
+			goto Awake
+			banksel T2CON
+			btfsc T2CON, TMR2ON
+			goto Awake
+			sleep
+			nop
+Awake:
+			bsf INTCON, GIE
 			goto Main
 
 
@@ -118,6 +230,19 @@ InitPins:
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; InitInts
 InitInts:
+			; no pull-ups, the main PIC drives both link lines
+			banksel OPTION_REG
+			movlw b'10000000'
+			movwf OPTION_REG
+			; interrupt on both edges of both link lines
+			banksel IOCAP
+			movlw LINK_MASK
+			movwf IOCAP
+			banksel IOCAN
+			movwf IOCAN
+			banksel IOCAF
+			clrf IOCAF
+			bsf INTCON, IOCIE
 			; enable peripheral interrupts
 			bsf INTCON, PEIE
 			; enable global interrupts
@@ -129,35 +254,124 @@ InitInts:
 		;return
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; InitVars
 InitVars:
-			; init PS_Cntr to zero
-			movlw 0x00
-			movwf PS_Cntr
+			; the flag starts down, the servo PWM off
+			movlw FLAG_DOWN
+			movwf Pos
+			clrf Phase
 			; init Rdy2Raise to zero
 			movlw 0x00
 			movwf Rdy2Raise
+			clrf Flags
+			; link idle, LEDs off, until the main PIC says otherwise
+			clrf LinkState
+			banksel LinkFlags
+			clrf LinkFlags
+			clrf LedPattern
+			clrf WaveCntr
 		return
 
 ;______________________________________________________________________ Other Subroutines
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; DoCommand
+DoCommand:
+			; carry out the frame in RxBuf: the command is the high nibble
+			; of its first byte
+			banksel RxBuf
+			swapf RxBuf, W
+			andlw LINK_LEN_MASK
+			xorlw CMD_TEAM
+			btfsc STATUS, Z
+			goto DoTeam
+			xorlw CMD_TEAM ^ CMD_SERVO
+			btfsc STATUS, Z
+			goto DoServo
+			xorlw CMD_SERVO ^ CMD_LEDS
+			btfsc STATUS, Z
+			goto DoLeds
+			xorlw CMD_LEDS ^ CMD_CELEBRATE
+			btfsc STATUS, Z
+			goto Celebration
+			; a command this code does not know: ignore it
+		return
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; DoTeam
+DoTeam:
+			; payload: TEAM_x; anything else counts as unpaired
+			movf RxBuf+1, W
+			xorlw TEAM_RED
+			btfsc STATUS, Z
+			goto RedTeam
+			xorlw TEAM_RED ^ TEAM_BLUE
+			btfsc STATUS, Z
+			goto BlueTeam
+			goto Unpaired
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; DoServo
+DoServo:
+			; payload: pulse width, servo periods per step (0 taken as 1).
+			; Eased, from wherever the flag is, and never past its travel.
+			movf RxBuf+2, W
+			btfsc STATUS, Z
+			movlw d'1'
+			bcf INTCON, GIE
+			movwf StepLen
+			bcf Flags, TRAPEZOID
+			bcf Flags, DESCEND_NEXT
+			bcf Flags, WAVING
+			banksel RxBuf
+			movf RxBuf+1, W
+			movwf Frac
+			movlw FLAG_DOWN
+			subwf Frac, W		; C clear if the target is below FLAG_DOWN
+			movlw FLAG_DOWN
+			btfss STATUS, C
+			movwf Frac
+			movf Frac, W
+			sublw FLAG_UP		; C clear if the target is above FLAG_UP
+			movlw FLAG_UP
+			btfss STATUS, C
+			movwf Frac
+			movf Frac, W
+			call StartMove
+			; park the PWM afterwards, if we are unpaired (see EndPulse)
+			movlw PARK_PERIODS
+			movwf ParkCntr
+			bsf INTCON, GIE
+		return
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; DoLeds
+DoLeds:
+			; payload: the LED pattern
+			movf RxBuf+1, W
+			goto SetLeds
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; SetLeds
+SetLeds:
+			; W = LED pattern. Interrupts are off so the blink in EndPulse
+			; sees the pattern and the LEDs change together.
+			bcf INTCON, GIE
+			banksel LedPattern
+			movwf LedPattern
+			movlw BLINK_PERIODS
+			movwf BlinkCntr
+			movf LedPattern, W
+			andlw LED_MASK
+			; set the LED bits of LATA to W, leaving the others alone
+			banksel LATA
+			xorwf LATA, W
+			andlw LED_MASK
+			xorwf LATA, F
+			bsf INTCON, GIE
+		return
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; RedTeam
 RedTeam:
-			; turn off blue LED
-			banksel LATA
-			bcf LATA, LED2
-			; turn on red LED
-			;banksel LATA
-			bsf LATA, LED1
+			; red LED on, blue LED off
+			movlw 1 << LED1
+			call SetLeds
 			; raise the pairing flag
 			btfss Rdy2Raise, 0x01
 			call RaiseFlag
 		return
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; BlueTeam
 BlueTeam:			
-			; turn off red LED
-			banksel LATA
-			bcf LATA, LED1
-			; turn on blue LED
-			;banksel LATA
-			bsf LATA, LED2
+			; blue LED on, red LED off
+			movlw 1 << LED2
+			call SetLeds
 			; raise the pairing flag
 			btfss Rdy2Raise, 0x01
 			call RaiseFlag
@@ -165,86 +379,106 @@ BlueTeam:
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; Unpaired
 Unpaired:
 			; turn off both LEDS
-			banksel LATA
-			bcf LATA, LED1
-			bcf LATA, LED2
+			movlw 0x00
+			call SetLeds
 			; lower flag
 			call LowerFlag
 		return
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; Celebration
 Celebration:
-			; unimplemented 
+			; wave the flag CELEBRATE_WAVES times, down to FLAG_WAVE and
+			; back up, then carry on as before (see EndMove)
+			banksel WaveCntr
+			movlw CELEBRATE_WAVES * 2
+			movwf WaveCntr
+			bcf INTCON, GIE
+			bcf Flags, TRAPEZOID
+			bcf Flags, DESCEND_NEXT
+			bsf Flags, WAVING
+			movlw WAVE_STEP
+			movwf StepLen
+			movlw FLAG_UP
+			call StartMove
+			bsf INTCON, GIE
 		return
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; RaiseFlag
 RaiseFlag:
 			; raise software flag
 			bsf Rdy2Raise, 0x01
+			; ease the flag up, then let it sink slowly while we are paired
+			bcf INTCON, GIE
+			bcf Flags, TRAPEZOID
+			bcf Flags, WAVING
+			bsf Flags, DESCEND_NEXT
+			movlw RAISE_STEP
+			movwf StepLen
+			movlw FLAG_UP
+			call StartMove
+			bsf INTCON, GIE
+		return
 
-			; set servo line high to begin PWM
-			banksel LATA
-			bsf LATA, SERVO
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; LowerFlag
+LowerFlag:			
+			; ease the flag down from wherever it is
+			bcf INTCON, GIE
+			bcf Flags, TRAPEZOID
+			bcf Flags, DESCEND_NEXT
+			bcf Flags, WAVING
+			movlw LOWER_STEP
+			movwf StepLen
+			movlw FLAG_DOWN
+			call StartMove
+			; stop the PWM once the flag has been down a while (see EndPulse)
+			movlw PARK_PERIODS
+			movwf ParkCntr
+			bsf INTCON, GIE
+			; lower software flag
+			bcf Rdy2Raise, 0x01
+		return
 
-			; set TMR2 to interrupt after 2 ms
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; StartMove
+StartMove:
+			; move the flag from Pos to the pulse width in W: PROFILE_STEPS
+			; steps of StepLen servo periods, along TrapTable if Flags
+			; TRAPEZOID is set, else EaseTable. Call with interrupts off,
+			; or from the ISR.
+			movwf Frac
+			movf Pos, W
+			movwf Start
+			; Span = |target - Start|, and DOWN if the target is below Start
+			bcf Flags, DOWN
+			subwf Frac, W		; W = target - Start, C clear on a borrow
+			btfsc STATUS, C
+			goto SpanSet
+			bsf Flags, DOWN
+			movf Frac, W
+			subwf Start, W		; W = Start - target
+SpanSet:
+			movwf Span
+			clrf Index
+			movf StepLen, W
+			movwf StepCntr
+			bsf Flags, MOVING
+			; start the servo PWM if it is parked
+			banksel T2CON
+			btfss T2CON, TMR2ON
+			goto StartPWM
+		return
+StartPWM:
+			; the first match, one slice from now, starts a pulse
+			clrf Phase
+			banksel TMR2
+			clrf TMR2
 			banksel PR2
-			movlw 0xff
+			movlw SLICE_COUNTS - 1
 			movwf PR2
-			banksel T2CON
-			movlw b'00111100' 
-			movwf T2CON
-			; clear TMR2 int flags
 			banksel PIR1
-			bcf PIR1,TMR2IF
-			; enable TMR2 interrupts
+			bcf PIR1, TMR2IF
 			banksel PIE1
 			bsf PIE1, TMR2IE
-
-			; set HLTMR to count to 0.0655 s (then postscale to get 4.5 sec)
-			banksel HLTPR
-			movlw 0x7f 
-			movwf HLTPR
-			; set HLTMR to ignore hardware edge resets
-			banksel HLTCON1
-			bcf HLTCON1, HLTREREN
-			bcf HLTCON1, HLTFEREN
-			; clear interrupt flag for HLTMR
-			banksel PIR1
-			bcf PIR1, HLTIF
-			; enable interrupt for HLTMR
-			banksel PIE1
-			bsf PIE1, HLTIE
-			; clear HLTMR
-			banksel HLTTMR
-			clrf HLTTMR
-			; turn on HLTMR
-			banksel HLTCON0
-			movlw b'01111111'
-			movwf HLTCON0
-
-			; set LastTime variable to 20 (represents 2 ms)
-			movlw d'20'
-			movwf LastTime
-			; set HighTime variable to 200
-			movlw d'200'
-			movwf HighTime
-			; set PS_Cntr to 68
-			movlw d'68'
-			movwf PS_Cntr
-
-		return
-
-;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;; LowerFlag
-LowerFlag:			
-			; disable HLTMR
-			banksel HLTCON0
-			bcf HLTCON0, HLTON
-			; set HighTime to 10
-			movlw d'70'
-			movwf HighTime
-			; set LastTime to 1
-			movlw d'7'
-			movwf LastTime
-			; lower software flag
-			bcf Rdy2Raise, 0x01
+			banksel T2CON
+			movlw T2_CONFIG
+			movwf T2CON
 		return
 
 ;______________________________________________________________________ ISRs
@@ -261,14 +495,14 @@ PUSH:
 
 ISR_BODY:
 			; branch to sub-ISRs
-			; if this interrupt came from TMR2, go to TMR2 ISR
+			; if this interrupt came from TMR2, go to TMR2 ISR (first, so
+			; the servo edges always follow the TMR2 match by the same time)
 			banksel PIR1
 			btfsc PIR1, TMR2IF
 			goto TMR2_ISR
-			; else if this interrupt came from HLTMR, go to HLT ISR
-			banksel PIR1
-			btfsc PIR1, HLTIF
-			goto HLT_ISR
+			; else if a link line changed, go to IOC ISR
+			btfsc INTCON, IOCIF
+			goto IOC_ISR
 			; else, go to POP
 			goto POP
 
@@ -276,50 +510,301 @@ TMR2_ISR:
 			; first, clear TMR2 flag
 			banksel PIR1
 			bcf PIR1, TMR2IF
-			; toggle servo line
-			banksel PORTA
-			btfss PORTA, SERVO
-			goto SetServo
-ClrServo:
-			banksel LATA
-			bcf LATA, SERVO
-			; set TMR2 to interrupt after (200-LastTime)/10 ms
+			; TMR2 never changes prescaler or postscaler, only PR2: each
+			; match ends a slice of the servo period, and Phase counts the
+			; slices left (0: start a pulse, LOW_SLICES+1: end it)
+			movf Phase, F
+			btfsc STATUS, Z
+			goto StartPulse
+			movlw LOW_SLICES + 1
+			xorwf Phase, W
+			btfsc STATUS, Z
+			goto EndPulse
+			; another full slice with the servo line low
+			decf Phase, F
 			banksel PR2
-			movf LastTime, W
-			sublw d'200'
+			movlw SLICE_COUNTS - 1
 			movwf PR2
-			banksel T2CON
-			movlw b'00101111' ; postscaler = 6, prescaler = 16
-			movwf T2CON
 			goto POP
-SetServo:
+StartPulse:
 			banksel LATA
 			bsf LATA, SERVO
-			; set TMR2 to interrupt after (HighTime/100) ms
+			; set TMR2 to interrupt after Pos counts
 			banksel PR2
-			movf HighTime, W
+			decf Pos, W
 			movwf PR2
+			movlw LOW_SLICES + 1
+			movwf Phase
+			goto POP
+EndPulse:
+			banksel LATA
+			bcf LATA, SERVO
+			; the rest of the first slice, so every period is 20 ms
+			banksel PR2
+			movf Pos, W
+			sublw SLICE_COUNTS - 1
+			movwf PR2
+			decf Phase, F
+			; flash the LEDs, if the pattern says to
+			banksel LedPattern
+			btfss LedPattern, LED_BLINK
+			goto BlinkDone
+			decfsz BlinkCntr, F
+			goto BlinkDone
+			movlw BLINK_PERIODS
+			movwf BlinkCntr
+			movf LedPattern, W
+			andlw LED_MASK
+			banksel LATA
+			xorwf LATA, F
+BlinkDone:
+			; work out the next pulse width now, there is time to spare
+			btfsc Flags, MOVING
+			goto StepMotion
+			; with the flag lowered and still, count down to parking the servo
+			btfsc Rdy2Raise, 0x01
+			goto POP
+			decfsz ParkCntr
+			goto POP
+			; flag is down: stop the PWM so Main can sleep
 			banksel T2CON
-			movlw b'01001100' ; postscaler = 10
-			movwf T2CON
+			bcf T2CON, TMR2ON
+			banksel PIE1
+			bcf PIE1, TMR2IE
 			goto POP
-			
-HLT_ISR:
-			; clear HLTMR interrupt flag
-			banksel PIR1
-			bcf PIR1, HLTIF
-			; decrement PS_Cntr, if zero:
-			;		-  reset PS_Cntr to 68 
-			;		-  subtract 10 from HighTime
-			;		-  subtract 1 from LastTime
-			decfsz PS_Cntr
+
+StepMotion:
+			; every StepLen periods, the next step of the profile
+			decfsz StepCntr
 			goto POP
-			movlw d'68'
-			movwf PS_Cntr
-			movlw d'10'
-			subwf HighTime
-			movlw d'1'
-			subwf LastTime
+			movf StepLen, W
+			movwf StepCntr
+			incf Index, F
+			movf Index, W
+			xorlw PROFILE_STEPS
+			btfsc STATUS, Z
+			goto EndMove
+			movf Index, W
+			btfsc Flags, TRAPEZOID
+			goto StepTrap
+			call EaseTable
+			goto StepScale
+StepTrap:
+			call TrapTable
+StepScale:
+			; Pos = Start +/- Span*table/256
+			movwf Frac
+			clrf ProdH
+			movf Span, W
+			ScaleBit 0
+			ScaleBit 1
+			ScaleBit 2
+			ScaleBit 3
+			ScaleBit 4
+			ScaleBit 5
+			ScaleBit 6
+			ScaleBit 7
+			movf ProdH, W
+			btfsc Flags, DOWN
+			goto StepDown
+			addwf Start, W
+			movwf Pos
+			goto POP
+StepDown:
+			subwf Start, W		; W = Start - ProdH
+			movwf Pos
+			goto POP
+
+EndMove:
+			; land exactly on the target
+			bcf Flags, MOVING
+			movf Span, W
+			btfsc Flags, DOWN
+			goto EndDown
+			addwf Start, W
+			goto EndSet
+EndDown:
+			subwf Start, W
+EndSet:
+			movwf Pos
+			btfsc Flags, WAVING
+			goto NextWave
+			; once the flag is up, it starts sinking back down
+			btfss Flags, DESCEND_NEXT
+			goto POP
+StartDescent:
+			bcf Flags, DESCEND_NEXT
+			bsf Flags, TRAPEZOID
+			movlw DESCENT_STEP
+			movwf StepLen
+			movlw FLAG_DOWN
+			call StartMove
+			goto POP
+
+NextWave:
+			banksel WaveCntr
+			decfsz WaveCntr, F
+			goto WaveAgain
+			; waved enough: sink back down if paired, else lower the flag
+			bcf Flags, WAVING
+			btfsc Rdy2Raise, 0x01
+			goto StartDescent
+			movlw LOWER_STEP
+			movwf StepLen
+			movlw FLAG_DOWN
+			call StartMove
+			movlw PARK_PERIODS
+			movwf ParkCntr
+			goto POP
+WaveAgain:
+			; odd counts go down to FLAG_WAVE, even ones back up
+			movlw FLAG_WAVE
+			btfss WaveCntr, 0
+			movlw FLAG_UP
+			call StartMove
+			goto POP
+
+IOC_ISR:
+			; take the change flags that are set, leaving any edge that
+			; comes in meanwhile for the next interrupt
+			banksel IOCAF
+			movlw 0xff
+			xorwf IOCAF, W
+			andwf IOCAF, F
+			xorlw 0xff
+			banksel Edges
+			movwf Edges
+			banksel PORTA
+			movf PORTA, W
+			banksel Pins
+			movwf Pins
+			; a clock edge; data changing along with it is only bit set-up
+			btfsc Edges, LINK_CLK
+			goto ClockEdge
+			; data changing while the clock is high is a start or a stop,
+			; unless it is our own ack
+			btfss Pins, LINK_CLK
+			goto POP
+			movf LinkState, W
+			xorlw LS_ACK
+			btfsc STATUS, Z
+			goto POP
+			movf LinkState, W
+			xorlw LS_ACKING
+			btfsc STATUS, Z
+			goto POP
+			btfsc Pins, LINK_DATA
+			goto LinkStop
+LinkStart:
+			; data fell: a new frame, kept only if Main is done with the last
+			clrf RxCount
+			clrf RxSum
+			clrf LinkFlags
+			movlw d'8'
+			movwf BitCntr
+			btfsc Flags, FRAME
+			bsf LinkFlags, DISCARD
+			movlw LS_RECEIVE
+			movwf LinkState
+			goto POP
+LinkStop:
+			; data rose: a frame we acked is Main's to carry out
+			movf LinkState, W
+			xorlw LS_WAIT_STOP
+			btfss STATUS, Z
+			goto LinkIdle
+			btfsc LinkFlags, FRAME_OK
+			bsf Flags, FRAME
+LinkIdle:
+			clrf LinkState
+			goto POP
+
+ClockEdge:
+			btfss Pins, LINK_CLK
+			goto ClockFell
+			movf LinkState, W
+			xorlw LS_RECEIVE
+			btfsc STATUS, Z
+			goto ShiftBit
+			movf LinkState, W
+			xorlw LS_ACK
+			btfss STATUS, Z
+			goto POP
+			; the ack clock: drive data low if we took the frame, high if not
+			btfsc LinkFlags, FRAME_OK
+			goto AckLow
+			banksel LATA
+			bsf LATA, LINK_DATA
+			goto AckDrive
+AckLow:
+			banksel LATA
+			bcf LATA, LINK_DATA
+AckDrive:
+			banksel TRISA
+			bcf TRISA, LINK_DATA
+			movlw LS_ACKING
+			movwf LinkState
+			goto POP
+ClockFell:
+			; the end of the ack clock: let go of data
+			movf LinkState, W
+			xorlw LS_ACKING
+			btfss STATUS, Z
+			goto POP
+			banksel TRISA
+			bsf TRISA, LINK_DATA
+			movlw LS_WAIT_STOP
+			movwf LinkState
+			goto POP
+
+ShiftBit:
+			; clock rose: shift in the data bit, MSB first
+			bcf STATUS, C
+			btfsc Pins, LINK_DATA
+			bsf STATUS, C
+			rlf RxByte, F
+			decfsz BitCntr, F
+			goto POP
+			; a whole byte
+			movlw d'8'
+			movwf BitCntr
+			movf RxByte, W
+			addwf RxSum, F
+			; the low nibble of the first byte is the payload length
+			movf RxCount, F
+			btfss STATUS, Z
+			goto StoreByte
+			andlw LINK_LEN_MASK
+			addlw d'2'
+			movwf FrameLen
+			sublw RX_SIZE		; C clear if the frame is longer than RxBuf
+			btfss STATUS, C
+			bsf LinkFlags, DISCARD
+StoreByte:
+			; RxBuf[RxCount] = RxByte. Only the ISR uses FSR, so it is not
+			; saved.
+			btfsc LinkFlags, DISCARD
+			goto ByteDone
+			movf RxCount, W
+			addlw RxBuf
+			movwf FSR
+			movf RxByte, W
+			movwf INDF
+ByteDone:
+			incf RxCount, F
+			movf RxCount, W
+			xorwf FrameLen, W
+			btfss STATUS, Z
+			goto POP
+			; that was the checksum: a good frame adds up to 0xFF
+			incf RxSum, W
+			btfss STATUS, Z
+			goto AckNext
+			btfss LinkFlags, DISCARD
+			bsf LinkFlags, FRAME_OK
+AckNext:
+			movlw LS_ACK
+			movwf LinkState
 			goto POP
 
 POP: 
@@ -342,11 +827,26 @@ POP:
 ;*********************************************************************;
 ;************************      NOTES      ****************************; 
 ;
-; Communication bits from BIG PIC:
+; Command link from the BIG PIC (see SmallLink.h there):
+;
+;	LINK_CLK (RA3) and LINK_DATA (RA2) idle high, both driven by the BIG PIC
+;		start	LINK_DATA falls while LINK_CLK is high
+;		bits	8 per byte, MSB first: LINK_DATA changes while LINK_CLK is
+;				low, and is sampled as LINK_CLK rises
+;		ack		after the last byte the BIG PIC lets go of LINK_DATA for one
+;				clock; we drive it low to take the frame, high to turn it
+;				down, from the rising edge to the falling one
+;		stop	LINK_DATA rises while LINK_CLK is high
+;
+;	Frame bytes:	[command << 4 | payload length] [payload] [checksum]
+;					all of them add up to 0xFF
+;
+;		command			payload
+;		CMD_TEAM		TEAM_NONE, TEAM_RED or TEAM_BLUE
+;		CMD_SERVO		pulse width (16 us counts), servo periods per step
+;		CMD_LEDS		LED pattern
+;		CMD_CELEBRATE	none
 ;
-;					____INPUT1__|___INPUT2___
-;		Unpaired 	|	Low		|	Low		|
-;		Red Team	|	High	|	Low		|
-;		Blue Team	|	Low		|	High	|
-;		Unused		|	High	|	High	|
+;	A frame that arrives while Main is still busy with the last one is
+;	turned down, and the BIG PIC sends it again.
 ;
@@ -0,0 +1,60 @@
+#ifndef AdcSequencer_H
+#define AdcSequencer_H
+
+#include "ES_Types.h"     /* gets bool type for returns */
+#include "CraftContext.h"
+
+/* AdcSequencer scans the analog inputs round robin from the ADC and Timer6
+ * interrupts, and keeps the latest filtered reading of each for whoever
+ * wants it. Nothing is posted per conversion: readers call getADCValue
+ * when they need a value.
+ *
+ * Each channel gets its own acquisition time (Timer6 runs it out before
+ * the conversion starts) and its own filter, a first order IIR that moves
+ * 1/2^Shift of the way to each new reading. Readings are 8 bits, ADRESH.
+ *
+ * The scan list is the const table in AdcSequencer.c, in ADC_CH_x order.
+ */
+
+// scan list entries
+#define ADC_CH_TEAM     0 // team select resistor
+#define ADC_CH_BATTERY  1 // battery, through the divider below
+#define ADC_CH_CURRENT  2 // drive motor current sense
+#define ADC_NUM_CHANNELS 3
+
+// board wiring: the analog input (CHS) each entry reads
+#define ADC_AN_TEAM     9  // RB3
+#define ADC_AN_BATTERY  10 // RB1
+#define ADC_AN_CURRENT  8  // RB2
+
+// the battery divider (10k over 4.7k) takes 11.1 V, 3 cells nominal, to 182
+// counts of VDD; a reading below ADC_BATTERY_ABSENT means bench power
+#define ADC_BATTERY_NOMINAL 182
+#define ADC_BATTERY_ABSENT  64
+
+// time between the end of one scan and the start of the next
+#define ADC_SCAN_REST_US 2000
+
+// everything AdcSequencer keeps, see CraftContext.h; the ISR writes it
+typedef struct {
+    uint16_t Filter[ADC_NUM_CHANNELS];         // reading << Shift
+    volatile uint8_t Value[ADC_NUM_CHANNELS];  // Filter >> Shift
+    volatile uint8_t ValidMask;                // channels read at least once
+    uint8_t Current;                           // entry being acquired or converted
+    volatile uint16_t Scans;
+} ADCContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL ADCContext_t *pADCContext;
+#endif
+
+// Public Function Prototypes
+void InitADCSequencer(void);
+void ADC_ISR(void);
+void ADC_Publish(uint8_t Channel, uint8_t Reading);
+
+uint8_t getADCValue(uint8_t Channel);
+bool getADCValid(uint8_t Channel);
+uint16_t getADCScans(void);
+
+#endif /* AdcSequencer_H */
@@ -4,24 +4,56 @@
 // Event Definitions
 #include "ES_Configure.h" /* gets us event definitions */
 #include "ES_Types.h"     /* gets bool type for returns */
+#include "XBeeFrames.h"
+#include "CraftContext.h"
+
+// telemetry frames carry TELEMETRY_TYPE, then the battery, motor current
+// and team resistor readings (see AdcSequencer.h)
+#define TELEMETRY_TYPE 0x06
+#define TELEMETRY_LENGTH 4
 
 // typedefs for the states
 // State definitions for use with the query function
 typedef enum { InitComm, WaitFor7E, WaitForMSB, WaitForLSB, 
                SuckUpPacket } CommServiceState_t ;
 
+// everything CommService keeps between events, see CraftContext.h
+typedef struct {
+    CommServiceState_t CurrentState;
+    uint8_t MyPriority;
+    uint8_t ReceiveLength;   // length of array that we are receiving
+    uint8_t ReceiveCounter;  // index of array that we are currently writing
+    RecvFrame_t RecvFrame;   // holds the frame data of the received packet
+    uint8_t ReceiveCheckSum; // keeps running total of data bytes received
+    uint8_t RecvDataLength;  // length of RF data portion of packet
+    uint8_t PACAddressLSB;
+    uint8_t PACAddressMSB;
+    uint8_t RxQueued;        // received bytes posted but not yet handled
+    // the same frames again, followed as the bytes are posted, see TrackByte
+    BrakeFrame_t FastFrame;
+    uint8_t FastCount;       // bytes of the frame posted so far, 7E included
+    uint8_t FastLength;      // its length field
+    uint8_t FastSum;         // running total of the bytes after the length
+} CommContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL CommContext_t *pCommContext;
+#endif
 
 // Public Function Prototypes
 bool InitCommService ( uint8_t Priority );
 bool PostCommService( ES_Event ThisEvent );
 ES_Event RunCommService( ES_Event ThisEvent );
+#ifdef SM_DUMP
+bool DumpCommService(void);
+#endif
 
-uint8_t* getRecvArray(void);
+const RecvFrame_t* getRecvFrame(void);
 uint8_t getPACAddressLSB(void);
 uint8_t getPACAddressMSB(void);
+bool getCommIdle(void);
 
-//void BuildPacket(uint8_t WhichData);
-//void SendPacket(uint8_t WhichData);
+//void SendPacket(uint8_t WhichData, const uint8_t *pVars);
 
 #endif /* CommService_H */
         
@@ -0,0 +1,66 @@
+#ifndef ConfigStore_H
+#define ConfigStore_H
+
+#include "ES_Types.h"     /* gets bool type for returns */
+#include "CraftContext.h"
+
+// bump this whenever the layout of Config_t changes; a record with any other
+// version is discarded and replaced with the defaults
+#define CONFIG_VERSION 0x02
+
+// number of teams with an ADC threshold band
+#define CONFIG_NUM_TEAMS 4
+
+/* Layout of the record as it sits in data EEPROM. The offsets are part of the
+ * radio update protocol (see UpdateConfig), so only ever append fields and
+ * bump CONFIG_VERSION. Every 16-bit field is 2-byte aligned so the struct has
+ * no padding on either the PIC or a host compiler.
+ */
+typedef struct {
+    uint8_t  Version;                       // 0:  CONFIG_VERSION
+    uint8_t  Length;                        // 1:  sizeof(Config_t)
+    uint16_t PairTimeout;                   // 2:  ms before a pairing times out
+    uint16_t XmitTimeout;                   // 4:  ms without a packet before we unpair
+    uint16_t PwmFreq;                       // 6:  drive motor PWM frequency in Hz
+    uint8_t  TeamNumber;                    // 8:  last team number read from the ADC
+    uint8_t  LastPairMSB;                   // 9:  address of the last PAC we paired with
+    uint8_t  LastPairLSB;                   // 10
+    uint8_t  TeamThresholds[2*CONFIG_NUM_TEAMS]; // 11: (low, high) raw ADC band per team
+    uint8_t  ResumeWindow;                  // 19: grace window after a link dropout, in 10 ms units
+    uint8_t  MaxResumeSkip;                 // 20: control packets we may have missed and still resume
+    uint8_t  CRC;                           // 21: CRC-8 over every byte above
+} Config_t;
+
+// everything ConfigStore keeps, see CraftContext.h
+typedef struct {
+    Config_t Config;
+    bool isLoaded;
+    bool isWritePending;
+    uint8_t WriteIndex; // next byte of the record to compare against EEPROM
+} ConfigStoreContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL ConfigStoreContext_t *pConfigStoreContext;
+#endif
+
+// Public Function Prototypes
+void InitConfigStore(void);
+bool UpdateConfig(uint8_t Offset, const uint8_t *pData, uint8_t Length);
+bool CheckConfigWrite(void);
+
+uint16_t getConfigPairTimeout(void);
+uint16_t getConfigXmitTimeout(void);
+uint16_t getConfigPwmFreq(void);
+uint8_t getConfigTeamNumber(void);
+uint8_t getConfigLastPairMSB(void);
+uint8_t getConfigLastPairLSB(void);
+uint8_t getConfigTeamLow(uint8_t Team);
+uint8_t getConfigTeamHigh(uint8_t Team);
+uint8_t getConfigResumeWindow(void);
+uint8_t getConfigMaxResumeSkip(void);
+bool getConfigWritePending(void);
+
+void setConfigTeamNumber(uint8_t Team);
+void setConfigLastPair(uint8_t PairMSB, uint8_t PairLSB);
+
+#endif /* ConfigStore_H */
@@ -0,0 +1,21 @@
+#ifndef CraftContext_H
+#define CraftContext_H
+
+/* Every service keeps the state it carries between events in one context
+ * struct (CommContext_t, PairingContext_t, ...) instead of loose statics.
+ *
+ * On the target there is only one craft, so each module has a single static
+ * instance of its context and the members still sit at fixed addresses.
+ * Host builds with MULTI_CRAFT defined run many craft in one process: each
+ * module reaches its state through a pointer instead, which the host points
+ * at the active craft's context before running it (see Host/include/Craft.h).
+ * The pointers are thread local, so different threads can run different
+ * craft at the same time.
+ */
+#ifdef MULTI_CRAFT
+#define CRAFT_LOCAL _Thread_local
+#else
+#define CRAFT_LOCAL
+#endif
+
+#endif /* CraftContext_H */
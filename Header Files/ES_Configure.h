@@ -20,6 +20,33 @@
 #ifndef CONFIGURE_H
 #define CONFIGURE_H
 
+/****************************************************************************/
+// Build profiles, picked with -DBUILD_PROFILE=PROFILE_x in the project's
+// build configuration:
+//   PROFILE_DEBUG       the Blink and ButtonDebounce services and their
+//                       events, the DEBUG1/DEBUG2 frames in place of STATUS1
+//                       and STATUS4 (DEBUG1 carries a key byte), the debug
+//                       getters and the RA3 checksum error pin
+//   PROFILE_PROFILE     production, plus the RA3 pin and the state table
+//                       row counts (SM_COVERAGE), for timing and path checks
+//   PROFILE_PRODUCTION  the spec status frames and nothing else; the default
+// Every profile keeps the production events in the same order and numbers,
+// with the debug ones after them, so a debug recorder decoder reads them all.
+#define PROFILE_DEBUG 0
+#define PROFILE_PROFILE 1
+#define PROFILE_PRODUCTION 2
+
+#ifndef BUILD_PROFILE
+#define BUILD_PROFILE PROFILE_PRODUCTION
+#endif
+
+#define DEBUG_SERVICES (BUILD_PROFILE == PROFILE_DEBUG)
+#define DEBUG_PIN (BUILD_PROFILE != PROFILE_PRODUCTION)
+
+#if (BUILD_PROFILE == PROFILE_PROFILE) && !defined(SM_COVERAGE)
+#define SM_COVERAGE
+#endif
+
 /****************************************************************************/
 // The maximum number of services sets an upper bound on the number of 
 // services that the framework will handle. Reasonable values are 8 and 16
@@ -29,13 +56,19 @@
 /****************************************************************************/
 // This macro determines that nuber of services that are *actually* used in
 // a particular application. It will vary in value from 1 to MAX_NUM_SERVICES
+// Without the two debugging services the others move down, keeping their order.
+#if DEBUG_SERVICES
 #define NUM_SERVICES 5
+#else
+#define NUM_SERVICES 3
+#endif
 
 /****************************************************************************/
 // These are the definitions for Service 0, the lowest priority service.
 // Every Events and Services application must have a Service 0. Further 
 // services are added in numeric sequence (1,2,3,...) with increasing 
 // priorities
+#if DEBUG_SERVICES
 // the header file with the public function prototypes
 #define SERV_0_HEADER "Blink.h" // this is a debugging service
 // the name of the Init function
@@ -44,6 +77,15 @@
 #define SERV_0_RUN RunBlink
 // How big should this services Queue be?
 #define SERV_0_QUEUE_SIZE 2
+// and its urgent lane, for the events ES_IS_URGENT picks out (at least 1)
+#define SERV_0_URGENT_QUEUE_SIZE 1
+#else
+#define SERV_0_HEADER "CommService.h"
+#define SERV_0_INIT InitCommService
+#define SERV_0_RUN RunCommService
+#define SERV_0_QUEUE_SIZE 5
+#define SERV_0_URGENT_QUEUE_SIZE 1
+#endif
 
 /****************************************************************************/
 // The following sections are used to define the parameters for each of the
@@ -52,6 +94,7 @@
 /****************************************************************************/
 // These are the definitions for Service 1
 #if NUM_SERVICES > 1
+#if DEBUG_SERVICES
 // the header file with the public function prototypes
 #define SERV_1_HEADER "CommService.h"
 // the name of the Init function
@@ -60,11 +103,20 @@
 #define SERV_1_RUN RunCommService
 // How big should this services Queue be?
 #define SERV_1_QUEUE_SIZE 5
+#define SERV_1_URGENT_QUEUE_SIZE 1
+#else
+#define SERV_1_HEADER "MotorControl.h"
+#define SERV_1_INIT InitMC
+#define SERV_1_RUN RunMC
+#define SERV_1_QUEUE_SIZE 5
+#define SERV_1_URGENT_QUEUE_SIZE 1
+#endif
 #endif
 
 /****************************************************************************/
 // These are the definitions for Service 2
 #if NUM_SERVICES > 2
+#if DEBUG_SERVICES
 // the header file with the public function prototypes
 #define SERV_2_HEADER "ButtonDebounce.h" // this is a debugging-aid service
 // the name of the Init function
@@ -73,6 +125,15 @@
 #define SERV_2_RUN RunButtonDB
 // How big should this services Queue be?
 #define SERV_2_QUEUE_SIZE 5
+#define SERV_2_URGENT_QUEUE_SIZE 1
+#else
+#define SERV_2_HEADER "PairingSM.h"
+#define SERV_2_INIT InitPairingSM
+#define SERV_2_RUN RunPairingSM
+#define SERV_2_QUEUE_SIZE 5
+// an unpair and the timeouts can all be pending at once
+#define SERV_2_URGENT_QUEUE_SIZE 3
+#endif
 #endif
 
 /****************************************************************************/
@@ -86,6 +147,7 @@
 #define SERV_3_RUN RunMC
 // How big should this services Queue be?
 #define SERV_3_QUEUE_SIZE 5
+#define SERV_3_URGENT_QUEUE_SIZE 1
 #endif
 
 /****************************************************************************/
@@ -99,6 +161,8 @@
 #define SERV_4_RUN RunPairingSM
 // How big should this services Queue be?
 #define SERV_4_QUEUE_SIZE 5
+// an unpair and the timeouts can all be pending at once
+#define SERV_4_URGENT_QUEUE_SIZE 3
 #endif
 
 /****************************************************************************/
@@ -112,6 +176,7 @@
 #define SERV_5_RUN RunService5
 // How big should this services Queue be?
 #define SERV_5_QUEUE_SIZE 5
+#define SERV_5_URGENT_QUEUE_SIZE 1
 #endif
 
 /****************************************************************************/
@@ -125,6 +190,7 @@
 #define SERV_6_RUN RunService6
 // How big should this services Queue be?
 #define SERV_6_QUEUE_SIZE 3
+#define SERV_6_URGENT_QUEUE_SIZE 1
 #endif
 
 /****************************************************************************/
@@ -138,6 +204,7 @@
 #define SERV_7_RUN RunService7
 // How big should this services Queue be?
 #define SERV_7_QUEUE_SIZE 3
+#define SERV_7_URGENT_QUEUE_SIZE 1
 #endif
 
 /****************************************************************************/
@@ -152,8 +219,6 @@ typedef enum {  ES_NO_EVENT = 0,
                 ES_ENTRY_HISTORY,
                 ES_EXIT,
                 /* User-defined events start here */
-                ES_DEBUG1, 
-                ES_DEBUG2, 
                 ES_DECRYPT_ERROR, 
                 ES_MANUAL_UNPAIR, 
                 ES_DRIVE_COMMAND, 
@@ -164,6 +229,14 @@ typedef enum {  ES_NO_EVENT = 0,
                 ES_NEW_PACKET, 
                 ES_Transmit, /* command comm to transmit */
                 ES_ReceivedByte, /* received a byte */
+                ES_LiftFan,  //Events for checkpoint 1
+                ES_TELEMETRY, // CommService sends battery and motor current to the PAC
+                ES_DUMP_RECORDER, // CommService sends flight recorder dump frame EventParam
+                ES_DRIVE_BATCH, // MotorControl takes EventParam commands from getDriveBatch
+#if DEBUG_SERVICES
+                /* debug profile only, see the build profiles above */
+                ES_DEBUG1, 
+                ES_DEBUG2, 
 				ES_LOCK,
 				ES_UNLOCK,
 				ES_BUTTON_DOWN,
@@ -171,10 +244,27 @@ typedef enum {  ES_NO_EVENT = 0,
                 ES_Fan1,    //Events for checkpoint 1
                 ES_Fan2,    //Events for checkpoint 1
                 ES_LED,     //Events for checkpoint 1
-                ES_LiftFan,  //Events for checkpoint 1
-                ES_ADCNewRead //Posted from ISR to PairingSM after a new ADC conversion is done
+#endif
+                ES_NUM_EVENTS /* keep last: sizes the state table indexes */
                 } ES_EventTyp_t ;
 
+/****************************************************************************/
+// Events that go in the urgent lane of the service they are posted to. The
+// run loop takes every urgent event, highest priority service first, before
+// any normal one, and each lane keeps the order of its posts. Keep this to
+// what ends or suspends a session: the unpairs, and the pairing, transmit
+// and resume timeouts. Routine traffic (received bytes, ADC timeouts, drive
+// commands) stays in the normal queues.
+// Only the host framework (Host/src/ES_Framework.c) has the urgent lanes so
+// far. The target framework ignores ES_IS_URGENT and the
+// SERV_n_URGENT_QUEUE_SIZE settings and queues every event in order until
+// its queues and run loop are ported; Host/scenarios/lanes.txt shows what
+// the port has to do.
+#define ES_IS_URGENT(Event) \
+    (((Event).EventType == ES_DECRYPT_ERROR) || ((Event).EventType == ES_MANUAL_UNPAIR) \
+     || (((Event).EventType == ES_TIMEOUT) && (((Event).EventParam == PAIR_TIMER) \
+         || ((Event).EventParam == XMIT_TIMER) || ((Event).EventParam == RESUME_TIMER))))
+
 /****************************************************************************/
 // These are the definitions for the Distribution lists. Each definition
 // should be a comma separated list of post functions to indicate which
@@ -207,11 +297,15 @@ typedef enum {  ES_NO_EVENT = 0,
 
 /****************************************************************************/
 // This are the name of the Event checking funcion header file. 
-#define EVENT_CHECK_HEADER "ButtonDebounce.h"
+#define EVENT_CHECK_HEADER "EventCheckers.h"
 
 /****************************************************************************/
 // This is the list of event checking functions 
-#define EVENT_CHECK_LIST CheckButtonEvents
+#if DEBUG_SERVICES
+#define EVENT_CHECK_LIST CheckButtonEvents, CheckConfigWrite, CheckSmallLink, CheckPowerState
+#else
+#define EVENT_CHECK_LIST CheckConfigWrite, CheckSmallLink, CheckPowerState
+#endif
 
 /****************************************************************************/
 // These are the definitions for the post functions to be executed when the
@@ -220,14 +314,20 @@ typedef enum {  ES_NO_EVENT = 0,
 // Unlike services, any combination of timers may be used and there is no
 // priority in servicing them
 #define TIMER_UNUSED ((pPostFunc)0)
+#if DEBUG_SERVICES
 #define TIMER0_RESP_FUNC PostBlink
 #define TIMER1_RESP_FUNC PostCommService
 #define TIMER2_RESP_FUNC PostButton
+#else
+#define TIMER0_RESP_FUNC TIMER_UNUSED
+#define TIMER1_RESP_FUNC PostCommService
+#define TIMER2_RESP_FUNC TIMER_UNUSED
+#endif
 #define TIMER3_RESP_FUNC PostMC
 #define TIMER4_RESP_FUNC PostPairingSM
 #define TIMER5_RESP_FUNC PostPairingSM
 #define TIMER6_RESP_FUNC PostPairingSM
-#define TIMER7_RESP_FUNC TIMER_UNUSED
+#define TIMER7_RESP_FUNC PostPairingSM
 
 /****************************************************************************/
 // Give the timer numbers symbolc names to make it easier to move them
@@ -243,5 +343,6 @@ typedef enum {  ES_NO_EVENT = 0,
 #define PAIR_TIMER 4
 #define XMIT_TIMER 5
 #define ADC_TIMER 6
+#define RESUME_TIMER 7
 
 #endif /* CONFIGURE_H */
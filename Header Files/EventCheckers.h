@@ -0,0 +1,14 @@
+#ifndef EventCheckers_H
+#define EventCheckers_H
+
+// The framework only takes a single EVENT_CHECK_HEADER, so this pulls in the
+// headers of every module that contributes a function to EVENT_CHECK_LIST.
+#include "ES_Configure.h"
+#if DEBUG_SERVICES
+#include "ButtonDebounce.h"
+#endif
+#include "ConfigStore.h"
+#include "SmallLink.h"
+#include "PowerManager.h"
+
+#endif /* EventCheckers_H */
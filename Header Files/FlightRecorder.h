@@ -0,0 +1,94 @@
+#ifndef FlightRecorder_H
+#define FlightRecorder_H
+
+#include "ES_Configure.h" /* gets us event definitions */
+#include "ES_Types.h"     /* gets bool type for returns */
+#include "ES_Events.h"
+#include "CraftContext.h"
+
+/* The flight recorder keeps the last FR_NUM_ENTRIES framework events in a
+ * RAM ring buffer, so that after an unpair we can see what led up to it.
+ *
+ * Every entry is four bytes: a head byte whose top two bits give the kind
+ * of entry, two data bytes, and the low byte of the framework's ms clock.
+ *   FR_POST    head bits 5-3 source service, bits 2-0 destination service,
+ *              A = event type, B = low byte of the event parameter
+ *   FR_STATE   head bits 2-0 service, A = old state, B = new state
+ *   FR_TIME    A = high byte of the ms clock from this entry on, B = 0.
+ *              Written ahead of any entry whose clock high byte differs
+ *              from the entry before it.
+ *   FR_FREEZE  A = FR_Cause_t, B = 0
+ * The source of a post is the service whose run function posted it, or
+ * FR_NO_SERVICE for posts from interrupts and service inits.
+ *
+ * The first fault (decrypt error, unpair, full queue) freezes the buffer,
+ * and nothing more is recorded until a dump request re-arms it. Dumps go
+ * out over the XBee as FR_DUMP_TYPE frames, see CommService, and
+ * Host/src/RecorderDecode.c turns them back into a timeline.
+ */
+
+#define FR_NUM_ENTRIES 32 // must be a power of two
+#define FR_NO_SERVICE 7   // source of posts made outside any run function
+
+// a dump goes out as frames of RF data: FR_DUMP_TYPE, frame number, number
+// of frames, FR_Cause_t, clock high byte of the oldest entry (getFRBaseMSB),
+// then up to FR_ENTRIES_PER_DUMP entries, oldest first
+#define FR_DUMP_TYPE 0x05
+#define FR_DUMP_OVERHEAD 5
+#define FR_ENTRIES_PER_DUMP 8
+
+#define FR_KIND_SHIFT 6
+#define FR_SOURCE_SHIFT 3
+#define FR_SERVICE_MASK 0x07
+
+typedef enum { FR_POST = 0, FR_STATE, FR_TIME, FR_FREEZE } FR_Kind_t;
+
+typedef enum { FR_RECORDING = 0, // not frozen
+               FR_DECRYPT_ERROR, // ES_DECRYPT_ERROR was posted
+               FR_UNPAIR,        // PairingSM tore down a session
+               FR_QUEUE_FULL,    // a post failed
+               FR_DUMP_REQUEST   // frozen so a dump reads a steady buffer
+             } FR_Cause_t;
+
+typedef struct {
+    uint8_t Head;
+    uint8_t A;
+    uint8_t B;
+    uint8_t TimeLSB;
+} FR_Entry_t;
+
+// everything the recorder keeps, see CraftContext.h
+typedef struct {
+    FR_Entry_t Entries[FR_NUM_ENTRIES];
+    uint8_t Next;       // entry the next record goes in
+    uint8_t Count;      // entries in use, up to FR_NUM_ENTRIES
+    uint8_t TimeMSB;    // clock high byte of the newest entry
+    uint8_t BaseMSB;    // clock high byte of the oldest entry
+    uint8_t Running;    // service whose run function is executing
+    uint8_t Cause;      // FR_Cause_t, FR_RECORDING unless frozen
+    bool isRearmPending; // start recording again once the dump is out
+    uint8_t DumpMSB;    // who asked for the dump
+    uint8_t DumpLSB;
+} FlightRecorderContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL FlightRecorderContext_t *pFlightRecorderContext;
+#endif
+
+// Public Function Prototypes
+void InitFlightRecorder(void);
+void FR_SetRunning(uint8_t Service);
+void FR_RecordPost(uint8_t Dest, const ES_Event *pEvent, bool isPosted);
+void FR_RecordState(uint8_t Service, uint8_t OldState, uint8_t NewState);
+void FR_Freeze(uint8_t Cause);
+void FR_RequestDump(uint8_t RequesterMSB, uint8_t RequesterLSB, bool isRearm);
+void FR_DumpDone(void);
+
+uint8_t getFRCount(void);
+const FR_Entry_t* getFREntry(uint8_t Index);
+uint8_t getFRCause(void);
+uint8_t getFRBaseMSB(void);
+uint8_t getFRDumpMSB(void);
+uint8_t getFRDumpLSB(void);
+
+#endif /* FlightRecorder_H */
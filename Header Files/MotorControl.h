@@ -6,11 +6,46 @@
 #include <xc.h>
 #include "ES_Events.h"
 #include "ES_Types.h"
+#include "CraftContext.h"
+#include "XBeeFrames.h"
+
+// drive motor PWM frequency, unless ConfigStore says otherwise; above
+// hearing, and still 400 duty steps at 8 MHz (see MotorControl.c)
+#define PWM_FREQ 20000
+
+// ES_LiftFan parameter: off, or on as asked for when getMCBrakes was Brakes
+#define MC_FAN_OFF 0x0000
+#define MC_FAN_ON(Brakes) (0x0100 | (uint8_t)(Brakes))
+
+// everything MotorControl keeps between events, see CraftContext.h
+typedef struct {
+    uint8_t MyPriority;
+    uint8_t PR2Value;    // PWM period, worked out from the configured frequency
+    uint8_t Prescale;    // Timer2 prescaler that goes with it
+    uint16_t DutySteps;  // full duty in CCPRxL:DCxB counts, 4*(PR2Value+1)
+    BatchCommand_t Schedule[CTRL_BATCH_MAX]; // the batch being carried out
+    uint8_t NumScheduled;
+    uint8_t NextScheduled;
+    uint8_t ScheduleAt;  // At of the command MC_TIMER is running for
+    // the brake latch: e-brakes forced from the receive interrupt, and how
+    // many of them the main loop has let go of; braked while they differ
+    volatile uint8_t Brakes;
+    uint8_t BrakesReleased;
+} MCContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL MCContext_t *pMCContext;
+#endif
 
 // Public Function Prototypes
 bool InitMC ( uint8_t Priority );
 bool PostMC( ES_Event ThisEvent );
 ES_Event RunMC( ES_Event CurrentEvent );
+void MC_EmergencyStop(void);
+bool MC_CanPlanPWM(uint16_t Freq);
+
+uint16_t getMCDutySteps(void);
+uint8_t getMCBrakes(void);
 
 #endif	/* MC_H */
 
@@ -4,18 +4,68 @@
 // Event Definitions
 #include "ES_Configure.h" /* gets us event definitions */
 #include "ES_Types.h"     /* gets bool type for returns */
+#include "ES_Events.h"
+#include "XBeeFrames.h"
+#include "CraftContext.h"
 
 // typedefs for the states
 // State definitions for use with the query function
 typedef enum { Waiting2Pair,
                Waiting4Encrypt,
-               Waiting4Control } PairingState_t ;
+               Waiting4Control,
+               Suspended } PairingState_t ;
 
+// everything PairingSM keeps between events, see CraftContext.h
+typedef struct {
+    ES_Event ThatEvent;
+    PairingState_t CurrentState;
+    uint8_t MyPriority;
+
+    uint8_t DataLength;
+    uint16_t PairAddressMSB;
+    uint8_t PairAddressLSB;
+    uint8_t LastPairMSB;
+    uint8_t LastPairLSB;
+
+    uint8_t currTeam;         // SL_TEAM_x, for the small PIC
+    bool isBrakeHeld;         // the last control packet had the e-brake on
+    bool isCelebrateHeld;     // the last control packet asked to celebrate
+
+    int8_t DriveByte;
+    int8_t TurnByte;
+    uint8_t SpecialByte;
+    BatchCommand_t Batch[CTRL_BATCH_MAX]; // the last batch, decrypted
+    bool isVarLength;         // the PAC has sent a batch or config write this session
+
+    int8_t DriveLeft;
+    int8_t DriveRight;
+
+    uint8_t EncryptionKey[KEY_LENGTH];
+    uint8_t DecryptCounter;
+    uint8_t ControlSum;
+    uint8_t EncryptedCHKSM;
+
+    bool isLiftFanOn;
+    uint8_t FanBrakes;        // getMCBrakes when the lift fan was last asked on
+
+    uint8_t RawADCValue;
+    uint8_t TeamNumber;
+
+    const RecvFrame_t *pFrame; // view of the frame CommService last received
+} PairingContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL PairingContext_t *pPairingContext;
+#endif
 
 // Public Function Prototypes
 bool InitPairingSM ( uint8_t Priority );
 bool PostPairingSM( ES_Event ThisEvent );
 ES_Event RunPairingSM( ES_Event ThisEvent );
+#ifdef SM_DUMP
+bool DumpPairingSM(void);
+#endif
+bool FastBrake(const BrakeFrame_t *pFrame, uint8_t Length);
 
 uint8_t getEncryptedCHKSM(void);
 int8_t getTurnByte(void);
@@ -25,8 +75,13 @@ uint8_t getPairAddressMSB(void);
 int8_t getDriveByte(void);
 uint8_t getDecryptCounter(void);
 uint8_t getSpecialByte(void);
+const BatchCommand_t *getDriveBatch(void);
 uint8_t getTeamNumber(void);
+PairingState_t getPairingState(void);
+#if DEBUG_SERVICES
 uint8_t* getEncryptionKey(void);
 uint8_t getCtrlCheckSum(void);
+uint8_t getCtrlCheckSum2(void);
+#endif
 
 #endif /* PairingSM_H */
@@ -0,0 +1,59 @@
+#ifndef PowerManager_H
+#define PowerManager_H
+
+#include "ES_Types.h"     /* gets bool type for returns */
+#include "CraftContext.h"
+
+/* PowerManager puts the PIC to sleep between events while the craft is
+ * unpaired, and counts how long it spends awake and asleep.
+ *
+ * CheckPowerState is the last entry of EVENT_CHECK_LIST. The framework only
+ * calls the event checkers once every queue is empty, so when it gets that
+ * far with nothing left to do it sleeps. The wake-up sources are
+ *   - the EUSART receive line (WUE): the start bit of the first byte of a
+ *     frame wakes the chip, and that byte is lost (it reads back as 0x00)
+ *   - the watchdog, every PM_WDT_PERIOD_MS, standing in for ADC_TIMER so
+ *     the team resistor is still re-read while we wait for a PAC. The ADC
+ *     scan stood still as well, so the stand-in waits until it has been
+ *     round every input again, PM_WAKE_SCANS scans, a little over 4 ms
+ *
+ * Sleep stops the system clock, so the PWM, the framework tick and any
+ * conversion in progress stop with it. That is why the craft only sleeps
+ * in Waiting2Pair, with the lift fan off and nothing half done, and stays
+ * awake for PM_WAKE_HOLD_MS after power-up and after a radio wake: the
+ * frame that woke us is lost, and the PAC's next try must find us awake.
+ */
+
+// WDT period while asleep: WDTPS 1:16384 of the 31 kHz LFINTOSC, 512 ms
+#define PM_WDTPS 0x09
+#define PM_WDT_PERIOD_MS (1u << PM_WDTPS)
+// longer than the PAC's 500 ms between pair requests
+#define PM_WAKE_HOLD_MS 1000
+// the scan can have stopped just after the team resistor
+#define PM_WAKE_SCANS 2
+
+// everything PowerManager keeps, see CraftContext.h
+typedef struct {
+    bool isAsleep;         // SLEEP was executed, the next check is the wake-up
+    uint16_t LastTime;     // framework clock at the previous check
+    uint16_t HoldStart;    // framework clock at the last radio wake
+    bool isScanPending;    // watchdog wake, waiting on the ADC before reading the team
+    uint16_t WakeScans;    // getADCScans at that wake
+    uint32_t AwakeMs;      // ms the framework tick has run
+    uint16_t WatchdogWakes;
+    uint16_t RadioWakes;   // wakes on the receive line
+} PowerManagerContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL PowerManagerContext_t *pPowerManagerContext;
+#endif
+
+// Public Function Prototypes
+bool CheckPowerState(void);
+
+uint32_t getPMAwakeMs(void);
+uint32_t getPMSleepMs(void);
+uint16_t getPMWatchdogWakes(void);
+uint16_t getPMRadioWakes(void);
+
+#endif /* PowerManager_H */
@@ -0,0 +1,92 @@
+#ifndef SmallLink_H
+#define SmallLink_H
+
+#include "ES_Types.h"     /* gets bool type for returns */
+#include "CraftContext.h"
+
+/* SmallLink sends commands to the PIC12F752 that runs the flag servo and
+ * the team LEDs, over the two wires that used to carry a 2-bit status:
+ * RA6 is data, RA7 is clock (the small PIC's RA2 and RA3).
+ *
+ * The link is clocked, so neither side needs an accurate bit time and the
+ * small PIC can take each edge in its interrupt-on-change ISR:
+ *   - idle, both lines are high
+ *   - start: data falls while the clock is high
+ *   - bits, MSB first: data changes while the clock is low, the small PIC
+ *     samples it on the rising edge
+ *   - ack: after the last byte we let go of data for one clock, and the
+ *     small PIC drives it, low for a frame it took, high for one it did not
+ *     (bad checksum, or still busy with the last one)
+ *   - stop: data rises while the clock is high
+ *
+ * A frame is a command byte (command in the high nibble, number of payload
+ * bytes in the low one), the payload, and a checksum that makes the bytes
+ * of the frame add up to 0xFF, like an XBee frame.
+ *
+ * Sending never blocks: the SL_Send functions queue a frame and the
+ * CheckSmallLink event checker moves it out one line change per
+ * SL_STEP_US. A frame the small PIC turns down is sent again, up to
+ * SL_MAX_TRIES times in all.
+ */
+
+// commands, and their payloads
+#define SL_CMD_TEAM      0x01 // team: SL_TEAM_x, sets the LEDs and raises or lowers the flag
+#define SL_CMD_SERVO     0x02 // pulse width in 16 us counts, servo periods (20 ms) per profile step
+#define SL_CMD_LEDS      0x03 // pattern: SL_LED_x bits
+#define SL_CMD_CELEBRATE 0x04 // none: wave the flag
+
+#define SL_TEAM_NONE 0x00
+#define SL_TEAM_RED  0x01
+#define SL_TEAM_BLUE 0x02
+
+#define SL_LED_RED   0x01
+#define SL_LED_BLUE  0x02
+#define SL_LED_BLINK 0x80 // toggle the LEDs above every 320 ms; needs the servo running
+
+#define SL_MAX_PAYLOAD 2
+#define SL_MAX_FRAME (SL_MAX_PAYLOAD + 2) // command, payload, checksum
+#define SL_QUEUE_SIZE 4
+#define SL_MAX_TRIES 3
+// time between line changes; the small PIC must take an edge within this,
+// and its servo ISR can hold it off for up to ~100 us
+#define SL_STEP_US 200
+
+// everything SmallLink keeps, see CraftContext.h
+typedef struct {
+    uint8_t Bytes[SL_MAX_FRAME];
+    uint8_t Length;
+} SL_Frame_t;
+
+typedef struct {
+    SL_Frame_t Queue[SL_QUEUE_SIZE];
+    uint8_t Head;       // frame on the wire, or next to go
+    uint8_t Count;      // frames queued, including the one on the wire
+    uint8_t Step;       // where the frame on the wire has got to
+    uint8_t ByteIndex;
+    uint8_t BitMask;
+    uint8_t Tries;      // times the frame on the wire has been sent
+    bool isAcked;
+    uint16_t Frames;    // frames the small PIC took
+    uint16_t Nacks;     // times it turned one down
+    uint16_t Dropped;   // frames given up on, or refused because the queue was full
+} SmallLinkContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL SmallLinkContext_t *pSmallLinkContext;
+#endif
+
+// Public Function Prototypes
+void InitSmallLink(void);
+bool CheckSmallLink(void);
+
+bool SL_SendTeam(uint8_t Team);
+bool SL_SendServo(uint8_t PulseWidth, uint8_t StepPeriods);
+bool SL_SendLeds(uint8_t Pattern);
+bool SL_SendCelebrate(void);
+
+bool getSLIdle(void);
+uint16_t getSLFrames(void);
+uint16_t getSLNacks(void);
+uint16_t getSLDropped(void);
+
+#endif /* SmallLink_H */
@@ -0,0 +1,62 @@
+#ifndef StateTable_H
+#define StateTable_H
+
+#include "ES_Configure.h" /* gets us event definitions */
+#include "ES_Types.h"     /* gets bool type for returns */
+#include "ES_Events.h"
+#include <stddef.h>       /* gets NULL */
+
+/* A state machine is a const table of transitions plus a const index from
+ * (state, event) to the first transition for that pair, both kept in flash.
+ * Transitions that share a (state, event) pair sit next to each other and
+ * are tried in order until one's guard passes, so dispatch costs one index
+ * lookup plus the guards of that pair only.
+ *
+ * One extra block of the index, SM_ANY_STATE(NumStates), holds transitions
+ * that apply in every state. It is only consulted when no state-specific
+ * transition fired.
+ */
+
+// Guard: return true to take the transition
+typedef bool (*pGuardFunc)(const ES_Event *pEvent);
+// Action: run when the transition is taken, before the state changes
+typedef void (*pActionFunc)(const ES_Event *pEvent);
+
+#define SM_SAME_STATE 0xFF // NextState value that leaves the state alone
+#define SM_NO_ROW 0        // index value for (state, event) pairs with no transition
+
+// block of the index that holds transitions valid in every state
+#define SM_ANY_STATE(NumStates) (NumStates)
+// slot in the index for a (state, event) pair
+#define SM_INDEX(State, Event) ((State)*ES_NUM_EVENTS + (Event))
+// number of index slots for a machine with NumStates states
+#define SM_INDEX_SIZE(NumStates) (((NumStates)+1)*ES_NUM_EVENTS)
+
+typedef struct {
+    uint8_t State;        // state this transition leaves, or SM_ANY_STATE
+    uint8_t Event;        // ES_EventTyp_t that triggers it
+    pGuardFunc Guard;     // NULL for an unconditional transition
+    pActionFunc Action;   // NULL if there is nothing to do
+    uint8_t NextState;    // or SM_SAME_STATE
+} SM_Transition_t;
+
+typedef struct {
+    const SM_Transition_t *Rows;
+    const uint8_t *Index;  // SM_INDEX -> row number + 1, or SM_NO_ROW
+    uint8_t NumRows;
+    uint8_t NumStates;
+#ifdef SM_COVERAGE
+    uint16_t *Hits;        // NumRows counters, one per transition taken
+#endif
+#ifdef SM_DUMP
+    const char *Name;
+#endif
+} SM_Table_t;
+
+// Public Function Prototypes
+bool SM_Dispatch(const SM_Table_t *pTable, uint8_t *pState, const ES_Event *pEvent);
+#ifdef SM_DUMP
+bool SM_Dump(const SM_Table_t *pTable);
+#endif
+
+#endif /* StateTable_H */
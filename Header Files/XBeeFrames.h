@@ -0,0 +1,165 @@
+#ifndef XBeeFrames_H
+#define XBeeFrames_H
+
+#include "ES_Types.h"
+#include <stddef.h>       /* gets offsetof */
+
+/* Overlay views of the frames CommService receives from the XBee. The frame
+ * data (everything between the length bytes and the checksum) sits in a
+ * single buffer, and each view names the fields of one kind of frame so
+ * consumers read them in place instead of at magic offsets.
+ *
+ * CommService only accepts frames that fit the buffer, so every field of
+ * every view is always inside it. Consumers still have to check that the RF
+ * data was long enough for the kind of frame they expect, once, before they
+ * read it (see RF_SIZE).
+ */
+
+#define RECV_BUFFER_SIZE 50 // bytes of frame data we can hold
+#define RX16_API_ID 0x81    // "RX packet, 16-bit address" API identifier
+#define KEY_LENGTH 32
+
+// RF data header bytes (the control header is encrypted)
+#define PAIR_REQUEST_HEADER 0x00
+#define KEY_HEADER 0x01
+#define CONTROL_HEADER 0x02
+#define CONTROL_BATCH_HEADER 0x03
+#define CONFIG_WRITE_HEADER 0x04
+#define RECORDER_DUMP_HEADER 0x05
+
+// ControlBatchFrame_t: commands a frame carries, and the unit of their At
+#define CTRL_BATCH_MAX 8
+#define BATCH_TICK_MS 10
+
+// ConfigFrame_t: most record bytes one write carries, all of the key
+#define CONFIG_DATA_MAX (KEY_LENGTH - 4)
+
+// DumpRequestFrame_t flags
+#define DUMP_REARM 0x01     // clear the flight recorder and record again after the dump
+
+// header of every RX packet, 16-bit address frame
+typedef struct {
+    uint8_t ApiId;       // RX16_API_ID
+    uint8_t SourceMSB;
+    uint8_t SourceLSB;
+    uint8_t RSSI;
+    uint8_t Options;
+} RX16Header_t;
+
+typedef struct {
+    RX16Header_t Rx;
+    uint8_t Header;      // PAIR_REQUEST_HEADER
+    uint8_t Team;        // bit 7: blue team, bits 6-0: team number
+} PairRequestFrame_t;
+
+typedef struct {
+    RX16Header_t Rx;
+    uint8_t Header;      // KEY_HEADER
+    uint8_t Key[KEY_LENGTH];
+} KeyFrame_t;
+
+// every byte from Header on is encrypted with the next byte of the key
+typedef struct {
+    RX16Header_t Rx;
+    uint8_t Header;      // CONTROL_HEADER
+    uint8_t Drive;
+    uint8_t Turn;
+    uint8_t Special;
+    uint8_t Checksum;    // sum of the four decrypted bytes above
+} ControlFrame_t;
+
+typedef struct {
+    uint8_t Drive;
+    uint8_t Turn;
+    uint8_t At;          // BATCH_TICK_MS ticks after the frame arrives
+} BatchCommand_t;
+
+/* Several drive commands for the price of one frame's XBee overhead, plus
+ * the special byte. Encrypted like ControlFrame_t, from Header through the
+ * checksum, which follows the last command (BATCH_RF_SIZE says where) and
+ * is the sum of the decrypted bytes before it. Commands are in At order.
+ */
+typedef struct {
+    RX16Header_t Rx;
+    uint8_t Header;      // CONTROL_BATCH_HEADER
+    uint8_t Special;     // as in ControlFrame_t, acted on when the frame arrives
+    uint8_t Count;       // 1 to CTRL_BATCH_MAX
+    BatchCommand_t Commands[CTRL_BATCH_MAX];
+    uint8_t Checksum;    // only here when Count is CTRL_BATCH_MAX
+} ControlBatchFrame_t;
+
+/* New config record bytes from the PAC we are paired with. Encrypted like
+ * ControlBatchFrame_t, from Header through the checksum, which follows the
+ * last data byte (CONFIG_RF_SIZE says where) and is the sum of the
+ * decrypted bytes before it.
+ */
+typedef struct {
+    RX16Header_t Rx;
+    uint8_t Header;      // CONFIG_WRITE_HEADER
+    uint8_t Offset;      // first byte of the config record to write
+    uint8_t Length;      // 1 to CONFIG_DATA_MAX
+    uint8_t Data[CONFIG_DATA_MAX];
+    uint8_t Checksum;    // only here when Length is CONFIG_DATA_MAX
+} ConfigFrame_t;
+
+typedef struct {
+    RX16Header_t Rx;
+    uint8_t Header;      // RECORDER_DUMP_HEADER
+    uint8_t Flags;       // DUMP_*
+} DumpRequestFrame_t;
+
+typedef union {
+    uint8_t Bytes[RECV_BUFFER_SIZE];
+    RX16Header_t Rx;
+    PairRequestFrame_t Pair;
+    KeyFrame_t Key;
+    ControlFrame_t Control;
+    ControlBatchFrame_t Batch;
+    ConfigFrame_t Config;
+    DumpRequestFrame_t Dump;
+} RecvFrame_t;
+
+// the frames that can carry the e-brake, as the receive interrupt keeps them
+// for FastBrake; longer frames are not kept
+typedef union {
+    uint8_t Bytes[sizeof(ControlBatchFrame_t)];
+    RX16Header_t Rx;
+    ControlFrame_t Control;
+    ControlBatchFrame_t Batch;
+} BrakeFrame_t;
+
+// bytes of RF data a frame of the given kind needs
+#define RF_SIZE(FrameType) (sizeof(FrameType) - sizeof(RX16Header_t))
+// RF bytes of a batch of Count commands: header, special, count, checksum
+#define BATCH_RF_SIZE(Count) (4 + (Count)*sizeof(BatchCommand_t))
+// RF bytes of a config write of Length bytes: header, offset, length, checksum
+#define CONFIG_RF_SIZE(Length) (4 + (Length))
+// smallest frame data length that carries any RF data
+#define MIN_RX16_LENGTH (sizeof(RX16Header_t) + 1)
+
+/* Compile-time checks that the views match the XBee and PAC frame formats
+ * and fit in the receive buffer. A failing check is a negative array size.
+ */
+#define FRAME_ASSERT(Cond, Name) typedef char FrameAssert_##Name[(Cond) ? 1 : -1]
+
+FRAME_ASSERT(sizeof(RX16Header_t) == 5, RX16HeaderSize);
+FRAME_ASSERT(offsetof(PairRequestFrame_t, Header) == 5, PairHeaderOffset);
+FRAME_ASSERT(offsetof(PairRequestFrame_t, Team) == 6, PairTeamOffset);
+FRAME_ASSERT(offsetof(KeyFrame_t, Key) == 6, KeyOffset);
+FRAME_ASSERT(offsetof(ControlFrame_t, Header) == 5, ControlHeaderOffset);
+FRAME_ASSERT(offsetof(ControlFrame_t, Checksum) == 9, ControlChecksumOffset);
+FRAME_ASSERT(offsetof(ControlBatchFrame_t, Commands) == 8, BatchCommandsOffset);
+FRAME_ASSERT(sizeof(BatchCommand_t) == 3, BatchCommandSize);
+FRAME_ASSERT(RF_SIZE(ControlBatchFrame_t) == BATCH_RF_SIZE(CTRL_BATCH_MAX), BatchSize);
+// no key byte is used twice in one frame
+FRAME_ASSERT(BATCH_RF_SIZE(CTRL_BATCH_MAX) <= KEY_LENGTH, BatchKeyBytes);
+FRAME_ASSERT(offsetof(ConfigFrame_t, Data) == 8, ConfigDataOffset);
+FRAME_ASSERT(RF_SIZE(ConfigFrame_t) == CONFIG_RF_SIZE(CONFIG_DATA_MAX), ConfigSize);
+FRAME_ASSERT(CONFIG_RF_SIZE(CONFIG_DATA_MAX) <= KEY_LENGTH, ConfigKeyBytes);
+FRAME_ASSERT(offsetof(DumpRequestFrame_t, Flags) == 6, DumpFlagsOffset);
+FRAME_ASSERT(sizeof(KeyFrame_t) <= RECV_BUFFER_SIZE, KeyFrameFits);
+FRAME_ASSERT(sizeof(ControlBatchFrame_t) <= RECV_BUFFER_SIZE, BatchFrameFits);
+FRAME_ASSERT(sizeof(ConfigFrame_t) <= RECV_BUFFER_SIZE, ConfigFrameFits);
+FRAME_ASSERT(sizeof(RecvFrame_t) == RECV_BUFFER_SIZE, RecvFrameSize);
+
+#endif /* XBeeFrames_H */
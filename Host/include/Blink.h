@@ -0,0 +1,11 @@
+#ifndef Blink_H
+#define Blink_H
+
+/* Host build only: stand-in for the debugging blink service. */
+#include "ES_Events.h"
+
+bool InitBlink(uint8_t Priority);
+bool PostBlink(ES_Event ThisEvent);
+ES_Event RunBlink(ES_Event ThisEvent);
+
+#endif /* Blink_H */
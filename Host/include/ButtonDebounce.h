@@ -0,0 +1,12 @@
+#ifndef ButtonDebounce_H
+#define ButtonDebounce_H
+
+/* Host build only: stand-in for the debugging button debounce service. */
+#include "ES_Events.h"
+
+bool InitButtonDB(uint8_t Priority);
+bool PostButton(ES_Event ThisEvent);
+ES_Event RunButtonDB(ES_Event ThisEvent);
+bool CheckButtonEvents(void);
+
+#endif /* ButtonDebounce_H */
@@ -0,0 +1,38 @@
+#ifndef Craft_H
+#define Craft_H
+
+/* Host build only, with MULTI_CRAFT: one complete craft, i.e. its register
+ * file, framework queues and timers, and the context of every firmware
+ * module. Any number of them can live in one process; Craft_Select points
+ * the firmware at one before it runs, on the calling thread only.
+ */
+#include "HostRegs.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "CommService.h"
+#include "PairingSM.h"
+#include "MotorControl.h"
+#include "ConfigStore.h"
+#include "FlightRecorder.h"
+#include "PowerManager.h"
+#include "SmallLink.h"
+#include "AdcSequencer.h"
+
+typedef struct {
+    HostRegs_t Regs;
+    ES_FrameworkContext_t Framework;
+    ES_TimerContext_t Timers;
+    CommContext_t Comm;
+    PairingContext_t Pairing;
+    MCContext_t MC;
+    ConfigStoreContext_t Store;
+    FlightRecorderContext_t Recorder;
+    PowerManagerContext_t PM;
+    SmallLinkContext_t Link;
+    ADCContext_t Scan;
+} Craft_t;
+
+void Craft_Select(Craft_t *pCraft);
+bool Craft_PowerUp(Craft_t *pCraft, uint8_t TeamAdc);
+
+#endif /* Craft_H */
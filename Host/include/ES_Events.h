@@ -0,0 +1,13 @@
+#ifndef ES_EVENTS_H
+#define ES_EVENTS_H
+
+/* Host build only: the framework event type. */
+#include "ES_Types.h"
+#include "ES_Configure.h"
+
+typedef struct ES_Event_t {
+    ES_EventTyp_t EventType; // what kind of event?
+    uint16_t EventParam;     // parameter value for use w/ this event
+} ES_Event;
+
+#endif /* ES_EVENTS_H */
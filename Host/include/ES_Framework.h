@@ -0,0 +1,83 @@
+#ifndef ES_FRAMEWORK_H
+#define ES_FRAMEWORK_H
+
+/* Host build only: a minimal Events and Services framework with the same
+ * posting interface as the target framework, plus the hooks the host
+ * runner and benchmarks need to drive it one step at a time.
+ */
+#include "ES_Types.h"
+#include "ES_Configure.h"
+#include "ES_Events.h"
+#include "CraftContext.h"
+
+typedef bool (*pPostFunc)(ES_Event);
+
+typedef struct {
+    uint8_t Head;
+    uint8_t Count;
+    uint8_t UrgentHead;
+    uint8_t UrgentCount;
+    uint8_t HighWater;  // most events queued at once, both lanes, since ES_Initialize
+} ES_QueueState_t;
+
+// the framework's queues, normal and urgent lane for each service, one set
+// per craft (see CraftContext.h)
+typedef struct {
+    ES_Event Queue0[SERV_0_QUEUE_SIZE];
+    ES_Event Urgent0[SERV_0_URGENT_QUEUE_SIZE];
+#if NUM_SERVICES > 1
+    ES_Event Queue1[SERV_1_QUEUE_SIZE];
+    ES_Event Urgent1[SERV_1_URGENT_QUEUE_SIZE];
+#endif
+#if NUM_SERVICES > 2
+    ES_Event Queue2[SERV_2_QUEUE_SIZE];
+    ES_Event Urgent2[SERV_2_URGENT_QUEUE_SIZE];
+#endif
+#if NUM_SERVICES > 3
+    ES_Event Queue3[SERV_3_QUEUE_SIZE];
+    ES_Event Urgent3[SERV_3_URGENT_QUEUE_SIZE];
+#endif
+#if NUM_SERVICES > 4
+    ES_Event Queue4[SERV_4_QUEUE_SIZE];
+    ES_Event Urgent4[SERV_4_URGENT_QUEUE_SIZE];
+#endif
+#if NUM_SERVICES > 5
+    ES_Event Queue5[SERV_5_QUEUE_SIZE];
+    ES_Event Urgent5[SERV_5_URGENT_QUEUE_SIZE];
+#endif
+#if NUM_SERVICES > 6
+    ES_Event Queue6[SERV_6_QUEUE_SIZE];
+    ES_Event Urgent6[SERV_6_URGENT_QUEUE_SIZE];
+#endif
+#if NUM_SERVICES > 7
+    ES_Event Queue7[SERV_7_QUEUE_SIZE];
+    ES_Event Urgent7[SERV_7_URGENT_QUEUE_SIZE];
+#endif
+    ES_QueueState_t Queues[NUM_SERVICES];
+    uint16_t PostFailures;
+} ES_FrameworkContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL ES_FrameworkContext_t *pES_FrameworkContext;
+#endif
+
+typedef enum { Success = 0, FailedPost = 1, FailedRun, FailedPointer,
+               FailedIndex, FailedInit } ES_Return_t;
+
+ES_Return_t ES_Initialize(void);
+bool ES_PostToService(uint8_t WhichService, ES_Event TheEvent);
+bool ES_PostAll(ES_Event ThisEvent);
+
+// host only
+typedef void ES_RunHook_t(uint8_t WhichService, const ES_Event *pEvent, bool isUrgent);
+
+bool ES_RunOnce(void);
+void ES_RunUntilIdle(void);
+void ES_RunFor(uint32_t Milliseconds);
+void ES_FlushQueues(void);
+uint16_t ES_GetPostFailures(void);
+uint8_t ES_GetQueueHighWater(uint8_t WhichService);
+const char *ES_GetServiceName(uint8_t WhichService);
+void ES_SetRunHook(ES_RunHook_t *pHook);
+
+#endif /* ES_FRAMEWORK_H */
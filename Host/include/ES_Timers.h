@@ -0,0 +1,47 @@
+#ifndef ES_TIMERS_H
+#define ES_TIMERS_H
+
+/* Host build only: framework timers on a virtual millisecond clock. The
+ * run loop either ticks them 1 ms at a time or skips straight to the next
+ * expiry, see ES_RunFor. While the chip sleeps the tick stands still but
+ * time goes on, so ES_Timer_GetTime (the tick count, as on the target)
+ * falls behind ES_Timer_GetTime32 (time since power-up).
+ */
+#include "ES_Types.h"
+#include "CraftContext.h"
+
+#define ES_NUM_TIMERS 8
+
+// the timers and clock, one set per craft (see CraftContext.h)
+typedef struct {
+    uint16_t TimerArray[ES_NUM_TIMERS];
+    uint8_t ActiveFlags;
+    uint32_t Time;   // ms since power-up
+    uint32_t Ticks;  // ms the tick has run
+} ES_TimerContext_t;
+
+#ifdef MULTI_CRAFT
+extern CRAFT_LOCAL ES_TimerContext_t *pES_TimerContext;
+#endif
+
+typedef enum { ES_Timer_ERR = -1, ES_Timer_NOT_ACTIVE = 0,
+               ES_Timer_OK = 1, ES_Timer_ACTIVE = 1 } ES_TimerReturn_t;
+
+ES_TimerReturn_t ES_Timer_InitTimer(uint8_t Num, uint16_t NewTime);
+ES_TimerReturn_t ES_Timer_SetTimer(uint8_t Num, uint16_t NewTime);
+ES_TimerReturn_t ES_Timer_StartTimer(uint8_t Num);
+ES_TimerReturn_t ES_Timer_StopTimer(uint8_t Num);
+uint16_t ES_Timer_GetTime(void);
+
+// host only
+void ES_Timer_Reset(void);
+void ES_Timer_Tick(void);
+uint32_t ES_Timer_GetTime32(void);
+uint32_t ES_Timer_NextExpiry(void);
+void ES_Timer_Skip(uint32_t Milliseconds);
+void ES_Timer_Sleep(uint32_t Milliseconds);
+
+// ES_Timer_NextExpiry when no timer is running
+#define ES_TIMER_NEVER UINT32_MAX
+
+#endif /* ES_TIMERS_H */
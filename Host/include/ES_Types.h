@@ -0,0 +1,10 @@
+#ifndef ES_TYPES_H
+#define ES_TYPES_H
+
+/* Host build only: fixed width and bool types, as the target framework's
+ * ES_Types.h provides them.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+#endif /* ES_TYPES_H */
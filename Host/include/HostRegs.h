@@ -0,0 +1,116 @@
+#ifndef HostRegs_H
+#define HostRegs_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "CraftContext.h"
+#include "SmallPicModel.h"
+
+/* Host stand-in for the PIC16F1788 special function registers. Each
+ * register (or bit) the firmware touches is a byte in HostRegs_t, and
+ * PIC16F1788.h maps the XC8 names onto the fields of the active register
+ * file, so the firmware sources build unmodified.
+ *
+ * Registers with side effects are emulated lazily. The framework calls
+ * HostRegs_Poll after every service run and event check, which finishes
+ * ADC conversions, runs Timer4 and Timer6, takes the ADC and Timer6
+ * interrupts, completes EEPROM writes, hands the link pins to the small
+ * PIC model and reports changes on the watched outputs. Reads that must
+ * see a side effect straight away (EEDATL after RD, TRMT after a TX1REG
+ * write) go through accessor functions.
+ *
+ * SLEEP halts the firmware until HostRegs_Receive or the watchdog (see
+ * HostRegs_SleepFor) wakes it; the framework runs nothing meanwhile.
+ */
+
+#define HOST_REGISTERS \
+    X(TX1REG) X(TRMT) X(SPEN) X(TXEN) X(TXSEL) X(RXSEL) X(RCIE) X(CREN) \
+    X(BRGH) X(BRG16) X(SYNC) X(SP1BRGL) X(GIE) X(PEIE) \
+    X(LATA0) X(LATA1) X(LATA3) X(LATA6) X(LATA7) X(LATC2) X(LATC5) \
+    X(ANSB1) X(ANSB2) X(ANSB3) X(ANSB6) X(ANSB7) \
+    X(TRISB1) X(TRISB2) X(TRISB3) X(TRISB6) X(TRISB7) X(WPUB3) \
+    X(TRISC1) X(TRISC2) X(TRISC5) X(TRISC6) X(RC4) X(RC5) X(RC7) \
+    X(CHS0) X(CHS1) X(CHS2) X(CHS3) X(CHS4) \
+    X(CHSN0) X(CHSN1) X(CHSN2) X(CHSN3) X(ADPREF0) X(ADPREF1) X(ADNREF) \
+    X(ADCS0) X(ADCS1) X(ADCS2) X(ADIF) X(ADIE) X(ADFM) X(ADRMD) X(ADON) \
+    X(GO_nDONE) X(ADRESH) \
+    X(PR2) X(TMR2IF) X(T2CKPS0) X(T2CKPS1) X(TMR2ON) \
+    X(CCPR2L) X(CCPR3L) X(CCP2CON) X(CCP3CON) \
+    X(CCP2M0) X(CCP2M1) X(CCP2M2) X(CCP2M3) \
+    X(CCP3M0) X(CCP3M1) X(CCP3M2) X(CCP3M3) \
+    X(DC2B0) X(DC2B1) X(DC3B0) X(DC3B1) \
+    X(EEADRL) X(EEDATL) X(EECON2) X(RD) X(WR) X(WREN) X(CFGS) X(EEPGD) \
+    X(TMR1ON) X(TMR1CS0) X(TMR1CS1) X(T1CKPS0) X(T1CKPS1) X(TMR1GE) X(TMR1H) X(TMR1L) \
+    X(WUE) X(WDTCON) X(SWDTEN) X(nTO) \
+    X(TRISA6) X(TRISA7) X(RA6) X(PR4) X(T4CKPS0) X(T4CKPS1) X(TMR4ON) X(TMR4IF) \
+    X(TMR6) X(PR6) X(T6CKPS0) X(T6CKPS1) X(TMR6ON) X(TMR6IF) X(TMR6IE)
+
+// what the emulated PIC12F752 on the far end of RA6/RA7 is showing, see
+// SmallPicModel.h
+#define HOST_SMALL_PIC \
+    X(SP_TEAM) X(SP_LEDS) X(SP_SERVO) X(SP_WAVES)
+
+// outputs whose changes are reported to the output callback
+#define HOST_WATCHED \
+    X(LATA0) X(LATA1) X(LATA3) X(LATC2) X(LATC5) \
+    X(SP_TEAM) X(SP_LEDS) X(SP_SERVO) X(SP_WAVES) \
+    X(PR2) X(CCPR2L) X(CCPR3L) X(CCP2CON) X(CCP3CON)
+
+#define HOST_EEPROM_SIZE 256
+#define HOST_ADC_INPUTS 32 // one per CHS value
+#define HOST_WDT_NEVER UINT32_MAX
+
+// index of each watched output, as passed to the output callback
+enum {
+#define X(Name) HOST_OUT_##Name,
+    HOST_WATCHED
+#undef X
+    NUM_HOST_WATCHED
+};
+
+typedef struct {
+#define X(Name) volatile uint8_t Name;
+    HOST_REGISTERS
+    HOST_SMALL_PIC
+#undef X
+    // emulated peripherals behind the registers
+    SmallPicModel_t SmallPic;
+    uint8_t Eeprom[HOST_EEPROM_SIZE];
+    uint8_t AdcInput[HOST_ADC_INPUTS]; // what a conversion of each input reads
+    bool isAsleep;           // SLEEP executed, not woken yet
+    uint32_t WdtLeft;        // ms until the watchdog wakes it, while asleep
+    struct {
+#define X(Name) uint8_t Name;
+        HOST_WATCHED
+#undef X
+    } Shadow;                // last reported value of each watched output
+} HostRegs_t;
+
+// called with every byte the firmware transmits
+typedef void (*pHostTxFunc)(uint8_t Byte);
+// called when a watched output changes
+typedef void (*pHostOutputFunc)(uint8_t Index, uint8_t Old, uint8_t New);
+
+// names of the watched outputs, by index
+extern const char * const HostRegs_WatchedNames[NUM_HOST_WATCHED];
+
+// register file the firmware is currently running against
+extern CRAFT_LOCAL HostRegs_t *pHostRegs;
+
+void HostRegs_Reset(HostRegs_t *pRegs);
+void HostRegs_Select(HostRegs_t *pRegs);
+void HostRegs_SetCallbacks(pHostTxFunc TxFunc, pHostOutputFunc OutputFunc);
+void HostRegs_Poll(void);
+void HostRegs_Receive(uint8_t Byte);
+bool HostRegs_IsAsleep(void);
+void HostRegs_Elapse(uint32_t Milliseconds);
+uint32_t HostRegs_SleepFor(uint32_t Milliseconds);
+
+// instructions
+void HostRegs_Sleep(void);
+
+// side-effecting reads
+volatile uint8_t *HostReg_TRMT(void);
+volatile uint8_t *HostReg_EEDATL(void);
+
+#endif /* HostRegs_H */
@@ -0,0 +1,131 @@
+#ifndef PIC16F1788_H
+#define PIC16F1788_H
+
+/* Host build only: maps the PIC16F1788 register and bit names used by the
+ * firmware onto the emulated register file in HostRegs.h.
+ */
+#include "HostRegs.h"
+
+#define TX1REG     (pHostRegs->TX1REG)
+#define TRMT       (*HostReg_TRMT())
+#define SPEN       (pHostRegs->SPEN)
+#define TXEN       (pHostRegs->TXEN)
+#define TXSEL      (pHostRegs->TXSEL)
+#define RXSEL      (pHostRegs->RXSEL)
+#define RCIE       (pHostRegs->RCIE)
+#define CREN       (pHostRegs->CREN)
+#define BRGH       (pHostRegs->BRGH)
+#define BRG16      (pHostRegs->BRG16)
+#define SYNC       (pHostRegs->SYNC)
+#define SP1BRGL    (pHostRegs->SP1BRGL)
+#define GIE        (pHostRegs->GIE)
+#define PEIE       (pHostRegs->PEIE)
+#define LATA0      (pHostRegs->LATA0)
+#define LATA1      (pHostRegs->LATA1)
+#define LATA3      (pHostRegs->LATA3)
+#define LATA6      (pHostRegs->LATA6)
+#define LATA7      (pHostRegs->LATA7)
+#define LATC2      (pHostRegs->LATC2)
+#define LATC5      (pHostRegs->LATC5)
+#define ANSB1      (pHostRegs->ANSB1)
+#define ANSB2      (pHostRegs->ANSB2)
+#define ANSB3      (pHostRegs->ANSB3)
+#define ANSB6      (pHostRegs->ANSB6)
+#define ANSB7      (pHostRegs->ANSB7)
+#define TRISB1     (pHostRegs->TRISB1)
+#define TRISB2     (pHostRegs->TRISB2)
+#define TRISB3     (pHostRegs->TRISB3)
+#define TRISB6     (pHostRegs->TRISB6)
+#define TRISB7     (pHostRegs->TRISB7)
+#define WPUB3      (pHostRegs->WPUB3)
+#define TRISC1     (pHostRegs->TRISC1)
+#define TRISC2     (pHostRegs->TRISC2)
+#define TRISC5     (pHostRegs->TRISC5)
+#define TRISC6     (pHostRegs->TRISC6)
+#define RC4        (pHostRegs->RC4)
+#define RC5        (pHostRegs->RC5)
+#define RC7        (pHostRegs->RC7)
+#define CHS0       (pHostRegs->CHS0)
+#define CHS1       (pHostRegs->CHS1)
+#define CHS2       (pHostRegs->CHS2)
+#define CHS3       (pHostRegs->CHS3)
+#define CHS4       (pHostRegs->CHS4)
+#define CHSN0      (pHostRegs->CHSN0)
+#define CHSN1      (pHostRegs->CHSN1)
+#define CHSN2      (pHostRegs->CHSN2)
+#define CHSN3      (pHostRegs->CHSN3)
+#define ADPREF0    (pHostRegs->ADPREF0)
+#define ADPREF1    (pHostRegs->ADPREF1)
+#define ADNREF     (pHostRegs->ADNREF)
+#define ADCS0      (pHostRegs->ADCS0)
+#define ADCS1      (pHostRegs->ADCS1)
+#define ADCS2      (pHostRegs->ADCS2)
+#define ADIF       (pHostRegs->ADIF)
+#define ADIE       (pHostRegs->ADIE)
+#define ADFM       (pHostRegs->ADFM)
+#define ADRMD      (pHostRegs->ADRMD)
+#define ADON       (pHostRegs->ADON)
+#define GO_nDONE   (pHostRegs->GO_nDONE)
+#define ADRESH     (pHostRegs->ADRESH)
+#define PR2        (pHostRegs->PR2)
+#define TMR2IF     (pHostRegs->TMR2IF)
+#define T2CKPS0    (pHostRegs->T2CKPS0)
+#define T2CKPS1    (pHostRegs->T2CKPS1)
+#define TMR2ON     (pHostRegs->TMR2ON)
+#define CCPR2L     (pHostRegs->CCPR2L)
+#define CCPR3L     (pHostRegs->CCPR3L)
+#define CCP2CON    (pHostRegs->CCP2CON)
+#define CCP3CON    (pHostRegs->CCP3CON)
+#define CCP2M0     (pHostRegs->CCP2M0)
+#define CCP2M1     (pHostRegs->CCP2M1)
+#define CCP2M2     (pHostRegs->CCP2M2)
+#define CCP2M3     (pHostRegs->CCP2M3)
+#define CCP3M0     (pHostRegs->CCP3M0)
+#define CCP3M1     (pHostRegs->CCP3M1)
+#define CCP3M2     (pHostRegs->CCP3M2)
+#define CCP3M3     (pHostRegs->CCP3M3)
+#define DC2B0      (pHostRegs->DC2B0)
+#define DC2B1      (pHostRegs->DC2B1)
+#define DC3B0      (pHostRegs->DC3B0)
+#define DC3B1      (pHostRegs->DC3B1)
+#define EEADRL     (pHostRegs->EEADRL)
+#define EEDATL     (*HostReg_EEDATL())
+#define EECON2     (pHostRegs->EECON2)
+#define RD         (pHostRegs->RD)
+#define WR         (pHostRegs->WR)
+#define WREN       (pHostRegs->WREN)
+#define CFGS       (pHostRegs->CFGS)
+#define EEPGD      (pHostRegs->EEPGD)
+#define TMR1ON     (pHostRegs->TMR1ON)
+#define TMR1CS0    (pHostRegs->TMR1CS0)
+#define TMR1CS1    (pHostRegs->TMR1CS1)
+#define T1CKPS0    (pHostRegs->T1CKPS0)
+#define T1CKPS1    (pHostRegs->T1CKPS1)
+#define TMR1GE     (pHostRegs->TMR1GE)
+#define TMR1H      (pHostRegs->TMR1H)
+#define TMR1L      (pHostRegs->TMR1L)
+#define WUE        (pHostRegs->WUE)
+#define WDTCON     (pHostRegs->WDTCON)
+#define SWDTEN     (pHostRegs->SWDTEN)
+#define nTO        (pHostRegs->nTO)
+#define TRISA6     (pHostRegs->TRISA6)
+#define TRISA7     (pHostRegs->TRISA7)
+#define RA6        (pHostRegs->RA6)
+#define PR4        (pHostRegs->PR4)
+#define T4CKPS0    (pHostRegs->T4CKPS0)
+#define T4CKPS1    (pHostRegs->T4CKPS1)
+#define TMR4ON     (pHostRegs->TMR4ON)
+#define TMR4IF     (pHostRegs->TMR4IF)
+#define TMR6       (pHostRegs->TMR6)
+#define PR6        (pHostRegs->PR6)
+#define T6CKPS0    (pHostRegs->T6CKPS0)
+#define T6CKPS1    (pHostRegs->T6CKPS1)
+#define TMR6ON     (pHostRegs->TMR6ON)
+#define TMR6IF     (pHostRegs->TMR6IF)
+#define TMR6IE     (pHostRegs->TMR6IE)
+
+#define SLEEP()    HostRegs_Sleep()
+#define CLRWDT()   ((void)(nTO = 1))
+#define NOP()      ((void)0)
+
+#endif /* PIC16F1788_H */
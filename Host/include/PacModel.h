@@ -0,0 +1,62 @@
+#ifndef PacModel_H
+#define PacModel_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "XBeeFrames.h"
+
+/* Host build only: a model of the PAC (hand-held controller) side of the
+ * protocol. It builds complete XBee API frames, start delimiter to checksum,
+ * exactly as the craft's radio would hand them to the UART, and decodes the
+ * status frames the craft sends back.
+ */
+
+// longest frame the craft accepts, plus delimiter, length and checksum
+#define PAC_MAX_FRAME (RECV_BUFFER_SIZE + 4)
+
+typedef struct {
+    uint8_t AddressMSB;
+    uint8_t AddressLSB;
+    uint8_t RSSI;
+    uint8_t Key[KEY_LENGTH];
+    uint8_t Counter;        // next key byte to encrypt with
+    uint32_t Seed;          // key generator state
+} PacModel_t;
+
+// a status frame from the craft, decoded
+typedef struct {
+    uint8_t DestMSB;
+    uint8_t DestLSB;
+    uint8_t Type;
+    uint8_t Code;
+    uint8_t NumVars;
+    uint8_t Vars[4];
+} PacStatus_t;
+
+// reassembles API frames from a byte stream
+typedef struct {
+    uint8_t Buffer[PAC_MAX_FRAME + 1];
+    uint8_t Count;
+    uint8_t Expected;
+} PacDecoder_t;
+
+void Pac_Init(PacModel_t *pPac, uint8_t AddressMSB, uint8_t AddressLSB, uint32_t Seed);
+uint8_t Pac_PairRequest(PacModel_t *pPac, uint8_t Team, bool isBlue, uint8_t *pFrame);
+uint8_t Pac_KeyFrame(PacModel_t *pPac, uint8_t *pFrame);
+uint8_t Pac_ControlFrame(PacModel_t *pPac, int8_t Drive, int8_t Turn,
+                         uint8_t Special, uint8_t *pFrame);
+uint8_t Pac_ControlBatch(PacModel_t *pPac, const BatchCommand_t *pCommands, uint8_t Count,
+                         uint8_t Special, uint8_t *pFrame);
+uint8_t Pac_ConfigFrame(PacModel_t *pPac, uint8_t Offset, const uint8_t *pData,
+                        uint8_t Length, uint8_t *pFrame);
+uint8_t Pac_DumpRequest(PacModel_t *pPac, bool isRearm, uint8_t *pFrame);
+void Pac_Skip(PacModel_t *pPac, uint8_t NumPackets);
+
+uint8_t Pac_WrapRX16(const PacModel_t *pPac, const uint8_t *pRF, uint8_t RFLength,
+                     uint8_t *pFrame);
+
+void Pac_ResetDecoder(PacDecoder_t *pDecoder);
+uint8_t Pac_FeedDecoder(PacDecoder_t *pDecoder, uint8_t Byte);
+bool Pac_ParseStatus(const uint8_t *pFrame, uint8_t Length, PacStatus_t *pStatus);
+
+#endif /* PacModel_H */
@@ -0,0 +1,47 @@
+#ifndef SmallPicModel_H
+#define SmallPicModel_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Host build only: the receiving end of SmallLink, i.e. what
+ * DMC_PIC12F752/Small_PIC.asm does with the edges on its RA2 (data) and RA3
+ * (clock), decoded to the commands it carries out. The host has no flag or
+ * LEDs to move, so the model only keeps what they were last told to do.
+ *
+ * HostRegs_Poll hands it the link lines after every firmware step, which
+ * is one line change at most (see CheckSmallLink), so no edge is missed.
+ */
+
+// as in Small_PIC.asm
+#define SP_RX_SIZE 4
+#define SP_FLAG_UP 125
+#define SP_FLAG_DOWN 44
+
+typedef struct {
+    uint8_t Clock;          // line levels at the last update
+    uint8_t Data;
+    uint8_t State;          // SP_State_t in SmallPicModel.c
+    uint8_t RxByte;
+    uint8_t BitCount;
+    uint8_t Count;          // bytes of this frame so far
+    uint8_t Length;         // bytes in this frame, from its command byte
+    uint8_t Sum;
+    uint8_t Buf[SP_RX_SIZE];
+    bool isFrameOk;         // what the ack said
+    bool isRaised;          // Rdy2Raise
+    // what the small PIC is showing
+    uint8_t Team;
+    uint8_t Leds;           // SL_LED_x pattern
+    uint8_t Servo;          // target of the last move it was told to make
+    uint8_t Waves;          // celebrations
+    uint16_t Frames;
+    uint16_t BadFrames;
+} SmallPicModel_t;
+
+// Update: the link lines now. With isDataDriven false the craft has let go
+// of data. Returns the level the data line is at, for the craft's RA6.
+uint8_t SmallPic_Update(SmallPicModel_t *pModel, uint8_t Clock, uint8_t Data,
+                        bool isDataDriven);
+
+#endif /* SmallPicModel_H */
@@ -0,0 +1,80 @@
+#ifndef Trace_H
+#define Trace_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Host build only: binary trace of the craft's UART traffic and outputs.
+ *
+ * File layout, all multi-byte values little endian:
+ *   "XBTR", version, flags (TRACE_HAS_*), name count, then per name a
+ *   length byte and the characters: the outputs, by index, that OUTPUT
+ *   records refer to.
+ *   Records until end of file:
+ *     time since the previous record in us (unsigned LEB128 varint),
+ *     type (TRACE_RX, TRACE_TX, TRACE_OUTPUT), length, length data bytes.
+ *   RX/TX records hold a burst of bytes that went over the wire back to
+ *   back, stamped with the time of the first one. OUTPUT records hold an
+ *   output index and its new value.
+ *
+ * OUTPUT records whose name starts with TRACE_QUEUE_PREFIX, followed by a
+ * service's run function, are not outputs: they give the most events that
+ * service's queue held, as of the record's time (runner -r writes them at
+ * the end of the run).
+ *
+ * A byte of UART traffic costs a little over one byte of trace, and both
+ * the writer and the reader work a record at a time, so traces of any
+ * length stream through in constant memory. The reader also takes a trace
+ * already in memory (Trace_OpenBuffer), e.g. a mapped file, and reads it in
+ * place without going through stdio.
+ */
+
+#define TRACE_VERSION 1
+
+// header flags: what the capture contains, so a replay knows what to diff
+#define TRACE_HAS_RX      0x01
+#define TRACE_HAS_TX      0x02
+#define TRACE_HAS_OUTPUTS 0x04
+
+// bytes further apart than this start a new burst
+#define TRACE_BURST_GAP_US 2000
+
+#define TRACE_MAX_NAMES 32
+#define TRACE_MAX_NAME 15
+
+#define TRACE_QUEUE_PREFIX "Q"
+
+typedef enum { TRACE_RX = 0, TRACE_TX = 1, TRACE_OUTPUT = 2, NUM_TRACE_TYPES } TraceType_t;
+
+typedef struct {
+    uint64_t Time;       // us since the start of the trace
+    uint8_t Type;
+    uint8_t Length;
+    uint8_t Data[255];
+} TraceRecord_t;
+
+typedef struct {
+    FILE *pFile;         // NULL when reading from a buffer
+    const uint8_t *pData; // reader: the buffer, and how far into it
+    size_t Size;
+    size_t Offset;
+    uint8_t Flags;
+    uint8_t NumNames;
+    char Names[TRACE_MAX_NAMES][TRACE_MAX_NAME + 1];
+    uint64_t Time;       // of the last record read or written
+    TraceRecord_t Burst; // writer: burst still being collected
+    uint64_t BurstEnd;   // writer: latest time written so far
+} Trace_t;
+
+bool Trace_Create(Trace_t *pTrace, const char *Path, uint8_t Flags,
+                  const char * const *pNames, uint8_t NumNames);
+void Trace_WriteByte(Trace_t *pTrace, uint8_t Type, uint64_t Time, uint8_t Byte);
+void Trace_WriteOutput(Trace_t *pTrace, uint64_t Time, uint8_t Index, uint8_t Value);
+bool Trace_Close(Trace_t *pTrace);
+
+bool Trace_Open(Trace_t *pTrace, const char *Path);
+bool Trace_OpenBuffer(Trace_t *pTrace, const uint8_t *pData, size_t Size);
+int Trace_Read(Trace_t *pTrace, TraceRecord_t *pRecord);
+
+#endif /* Trace_H */
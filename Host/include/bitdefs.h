@@ -0,0 +1,23 @@
+#ifndef BITDEFS_H
+#define BITDEFS_H
+
+/* Host build only: the bit masks from the target framework's bitdefs.h. */
+#define BIT0HI 0x01
+#define BIT1HI 0x02
+#define BIT2HI 0x04
+#define BIT3HI 0x08
+#define BIT4HI 0x10
+#define BIT5HI 0x20
+#define BIT6HI 0x40
+#define BIT7HI 0x80
+
+#define BIT0LO 0xfe
+#define BIT1LO 0xfd
+#define BIT2LO 0xfb
+#define BIT3LO 0xf7
+#define BIT4LO 0xef
+#define BIT5LO 0xdf
+#define BIT6LO 0xbf
+#define BIT7LO 0x7f
+
+#endif /* BITDEFS_H */
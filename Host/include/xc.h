@@ -0,0 +1,9 @@
+#ifndef XC_H
+#define XC_H
+
+/* Host build only: the firmware includes <xc.h> for the device registers,
+ * which on the host come from PIC16F1788.h.
+ */
+#include "PIC16F1788.h"
+
+#endif /* XC_H */
@@ -0,0 +1,742 @@
+/****************************************************************************
+ Module
+   Arena.c
+
+ Description
+   Runs many craft and many PACs in one process on a simulated shared
+   radio channel: a whole arena, with contention for the air, collisions,
+   XBee address filtering and the cross-talk that comes with them.
+
+ Notes
+   Usage: arena [options]
+     -n CRAFT     craft in the arena (default 4)
+     -m PACS      PACs (default one per craft); PAC j drives craft j mod n
+     -d SECONDS   match time to simulate (default 60)
+     -j THREADS   threads running the craft (default 1)
+     -r HZ        control packet rate of every PAC (default 5)
+     -l LOSS      fraction of frames lost to fading, on top of collisions
+     -b           PACs broadcast their pair requests, so every craft of the
+                  team hears them, instead of addressing their own craft
+     -C           no carrier sense: radios transmit without waiting for a
+                  clear channel
+     -s SEED      seed for the radio and PAC timing (default 1)
+     -v           print every pairing and unpairing
+
+   Each craft is the real firmware in a MULTI_CRAFT build (see Craft.h)
+   with its own XBee address, CRAFT_ADDRESS_BASE + index, and team
+   resistor; team = index mod 4. The PACs follow the same script as the
+   PAC emulator: pair request until acknowledged, key, then control
+   packets, and pair again from a fresh address after an unpair.
+
+   The channel is one 802.15.4 channel at 250 kbit/s. Every radio does
+   unslotted CSMA-CA before it transmits, and a unicast frame that is not
+   acknowledged is retried by the MAC. Two frames that overlap on the air
+   are both lost, there is no capture. A radio passes a frame up only if
+   it is addressed to it or broadcast. Frames cross the 9600 baud UART
+   between the PIC and its XBee at their real length, PACs talk to their
+   radio directly.
+
+   Time steps in 1 ms epochs. Within an epoch the craft run in parallel,
+   split over the threads, and everything on the channel is done on the
+   main thread in a fixed order, so a run gives the same result whatever
+   the thread count.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "Craft.h"
+#include "PacModel.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define NUM_TEAMS 4
+#define CRAFT_ADDRESS_BASE 0xF000
+#define BROADCAST 0xFFFF
+#define NO_OWNER (-1)
+#define PAC_ADDRESS_MSBS 0xEF  // PAC addresses stay below the craft's
+#define PAIR_RETRY_MS 500
+#define KEY_RETRY_MS 1000
+#define STATUS_TYPE 0x03
+#define PAIRED 0x01            // status codes, see CommService
+#define UNPAIRED 0x00
+#define UNPAIRED_DEC_ERROR 0x02
+
+// 802.15.4 at 250 kbit/s, XBee defaults
+#define US_PER_BYTE 32
+#define AIR_OVERHEAD 17        // preamble, SFD, length, MAC header and FCS bytes
+#define API_OVERHEAD 9         // delimiter, length, API header and checksum bytes
+#define TURNAROUND_US 192      // clear channel to transmitting
+#define BACKOFF_UNIT_US 320
+#define MIN_BE 3
+#define MAX_BE 5
+#define MAX_CSMA_BACKOFFS 4
+#define MAC_RETRIES 3
+#define ACK_WAIT_US 864
+#define UART_US_PER_BYTE 1042  // 9600 baud, 10 bits per byte
+
+#define MAX_RX_PENDING 8
+#define MAX_TX_PENDING 8
+
+/*---------------------------- Module Types ---------------------------*/
+// a frame on its way through the air, from one API frame to another
+typedef struct {
+    uint64_t Cca;         // us, the sending radio's next clear channel assessment
+    uint64_t Start;       // us, on the air from Start to End
+    uint64_t End;
+    int32_t Sender;       // craft index, or -1 - PAC index
+    uint16_t Dest;
+    uint8_t BE;           // backoff exponent
+    uint8_t NumBackoffs;
+    uint8_t Retries;
+    bool isCorrupt;
+    uint8_t Length;
+    uint8_t Bytes[PAC_MAX_FRAME];
+} AirFrame_t;
+
+typedef struct {
+    AirFrame_t *pFrames;
+    size_t Count;
+    size_t Size;
+} FrameList_t;
+
+// a frame on its way over the UART from the XBee to the PIC
+typedef struct {
+    uint64_t Due;         // us, when its last byte has arrived
+    uint8_t Length;
+    uint8_t Bytes[PAC_MAX_FRAME];
+} RxFrame_t;
+
+typedef struct {
+    Craft_t Craft;
+    uint16_t Address;
+    uint8_t Team;
+    PacDecoder_t Decoder;
+    RxFrame_t Rx[MAX_RX_PENDING];
+    uint8_t RxHead;
+    uint8_t RxCount;
+    AirFrame_t Tx[MAX_TX_PENDING]; // sent to the XBee during this epoch
+    uint8_t NumTx;
+    // statistics
+    unsigned long NumRx;
+    unsigned long NumRxOverflows;
+    unsigned long NumStatus;
+    unsigned long NumUnpairs;
+} ArenaCraft_t;
+
+typedef enum { PacPairing, PacKeying, PacDriving } PacState_t;
+
+typedef struct {
+    PacModel_t Model;
+    PacState_t State;
+    uint16_t Home;        // address of the craft this PAC is meant to drive
+    uint16_t Target;      // address of the craft that accepted it
+    uint8_t Team;
+    bool isBlue;
+    uint32_t NextSend;    // ms
+    // statistics
+    unsigned long NumControls;
+    unsigned long NumAcks;
+    unsigned long NumPairs;
+    unsigned long NumForeignPairs;
+    unsigned long NumUnpairs;
+    unsigned long NumDecryptErrors;
+    unsigned long NumCrossTalk;
+} ArenaPac_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void *Worker(void *pArg);
+static void RunShare(unsigned Share);
+static void StepCraft(ArenaCraft_t *pCraft);
+static void OnTxByte(uint8_t Byte);
+static void RunPacs(void);
+static void NewPacAddress(ArenaPac_t *pPac);
+static void PacReceive(ArenaPac_t *pPac, const AirFrame_t *pFrame, uint16_t Source);
+static void Queue(int32_t Sender, uint16_t Dest, uint64_t Ready,
+                  const uint8_t *pBytes, uint8_t Length);
+static void StartAccess(AirFrame_t *pFrame, uint64_t Ready);
+static void Collect(void);
+static void Arbitrate(uint64_t EpochEnd);
+static bool IsBusy(uint64_t Time);
+static void Deliver(uint64_t Now);
+static void Receive(const AirFrame_t *pFrame);
+static uint16_t SenderAddress(int32_t Sender);
+static void Append(FrameList_t *pList, const AirFrame_t *pFrame);
+static int CompareReady(const void *pA, const void *pB);
+static int CompareDone(const void *pA, const void *pB);
+static uint32_t Random(uint32_t Range);
+static double Now(void);
+static void Report(double WallSeconds);
+
+/*---------------------------- Module Variables ---------------------------*/
+static const uint8_t TeamAdc[NUM_TEAMS] = { 85, 120, 151, 176 };
+
+static ArenaCraft_t *Crafts;
+static ArenaPac_t *Pacs;
+static int32_t *AddressOwner;  // PAC index by address, or NO_OWNER
+static unsigned NumCrafts = 4;
+static unsigned NumPacs;
+static unsigned NumThreads = 1;
+static uint32_t Duration = 60000;
+static uint32_t Period = 200;
+static double Loss = 0;
+static bool isBroadcastPairing = false;
+static bool isCarrierSense = true;
+static bool isVerbose = false;
+static uint32_t RandomState = 1;
+static unsigned NextPacAddress;
+
+static FrameList_t Outbox;    // waiting for the radio to get the channel
+static FrameList_t Air;       // on the air, or just off it
+static FrameList_t Due;
+static uint32_t Time;         // ms, start of the current epoch
+
+static pthread_barrier_t StepStart;
+static pthread_barrier_t StepEnd;
+static volatile bool isDone = false;
+
+// the craft the calling thread is running, for OnTxByte
+static CRAFT_LOCAL ArenaCraft_t *pCurrent;
+
+// channel statistics
+static unsigned long NumSent;
+static unsigned long NumCollided;
+static unsigned long NumFaded;
+static unsigned long NumRetries;
+static unsigned long NumLost;
+static unsigned long NumAccessFailures;
+static unsigned long NumUnheard;
+static uint64_t AirTime;
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    pthread_t *Threads;
+    double Start;
+    int Option;
+
+    NumPacs = 0;
+    while ((Option = getopt(argc, argv, "n:m:d:j:r:l:bCs:v")) != -1){
+        switch (Option){
+            case 'n': NumCrafts = (unsigned)atoi(optarg); break;
+            case 'm': NumPacs = (unsigned)atoi(optarg); break;
+            case 'd': Duration = (uint32_t)(atof(optarg)*1e3); break;
+            case 'j': NumThreads = (unsigned)atoi(optarg); break;
+            case 'r': Period = (uint32_t)(1e3/atof(optarg)); break;
+            case 'l': Loss = atof(optarg); break;
+            case 'b': isBroadcastPairing = true; break;
+            case 'C': isCarrierSense = false; break;
+            case 's': RandomState = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'v': isVerbose = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n CRAFT] [-m PACS] [-d SECONDS] [-j THREADS]"
+                        " [-r HZ] [-l LOSS] [-b] [-C] [-s SEED] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (NumPacs == 0){
+        NumPacs = NumCrafts;
+    }
+    if ((NumCrafts == 0) || (NumCrafts > BROADCAST - CRAFT_ADDRESS_BASE)
+            || (NumThreads == 0) || (Period == 0) || (RandomState == 0)){
+        fprintf(stderr, "craft, threads, rate and seed must be nonzero\n");
+        return 1;
+    }
+    if (NumThreads > NumCrafts){
+        NumThreads = NumCrafts;
+    }
+
+    // every craft is powered up here, on the main thread
+    Crafts = calloc(NumCrafts, sizeof(ArenaCraft_t));
+    Pacs = calloc(NumPacs, sizeof(ArenaPac_t));
+    AddressOwner = malloc(0x10000*sizeof(int32_t));
+    if ((Crafts == NULL) || (Pacs == NULL) || (AddressOwner == NULL)){
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    HostRegs_SetCallbacks(OnTxByte, NULL);
+    for (unsigned i=0; i<NumCrafts; i++){
+        ArenaCraft_t *pCraft = &Crafts[i];
+        pCurrent = pCraft;
+        pCraft->Address = CRAFT_ADDRESS_BASE + i;
+        pCraft->Team = i % NUM_TEAMS;
+        Pac_ResetDecoder(&pCraft->Decoder);
+        if (!Craft_PowerUp(&pCraft->Craft, TeamAdc[pCraft->Team])){
+            fprintf(stderr, "craft %u failed to initialize\n", i);
+            return 1;
+        }
+    }
+    for (unsigned i=0; i<0x10000; i++){
+        AddressOwner[i] = NO_OWNER;
+    }
+    for (unsigned i=0; i<NumPacs; i++){
+        ArenaPac_t *pPac = &Pacs[i];
+        Pac_Init(&pPac->Model, 0, 0, RandomState + i);
+        NewPacAddress(pPac);
+        pPac->Home = Crafts[i % NumCrafts].Address;
+        pPac->Team = Crafts[i % NumCrafts].Team;
+        pPac->isBlue = (i & 1);
+        pPac->State = PacPairing;
+        // PACs are switched on over the first second, not all at once
+        pPac->NextSend = Random(1000);
+    }
+
+    Threads = malloc(NumThreads*sizeof(pthread_t));
+    if (NumThreads > 1){
+        pthread_barrier_init(&StepStart, NULL, NumThreads);
+        pthread_barrier_init(&StepEnd, NULL, NumThreads);
+        for (unsigned i=1; i<NumThreads; i++){
+            pthread_create(&Threads[i], NULL, Worker, (void *)(uintptr_t)i);
+        }
+    }
+
+    Start = Now();
+    for (Time=0; Time<Duration; Time++){
+        Deliver((uint64_t)Time*1000);
+        RunPacs();
+        if (NumThreads > 1){
+            pthread_barrier_wait(&StepStart);
+            RunShare(0);
+            pthread_barrier_wait(&StepEnd);
+        } else {
+            RunShare(0);
+        }
+        Collect();
+        Arbitrate((uint64_t)(Time + 1)*1000);
+    }
+    if (NumThreads > 1){
+        isDone = true;
+        pthread_barrier_wait(&StepStart);
+        for (unsigned i=1; i<NumThreads; i++){
+            pthread_join(Threads[i], NULL);
+        }
+    }
+    Report(Now() - Start);
+    return 0;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static void *Worker(void *pArg)
+{
+    unsigned Share = (unsigned)(uintptr_t)pArg;
+    for (;;){
+        pthread_barrier_wait(&StepStart);
+        if (isDone){
+            return NULL;
+        }
+        RunShare(Share);
+        pthread_barrier_wait(&StepEnd);
+    }
+}
+
+// RunShare: one epoch of every craft that belongs to this thread
+static void RunShare(unsigned Share)
+{
+    for (unsigned i=Share; i<NumCrafts; i+=NumThreads){
+        StepCraft(&Crafts[i]);
+    }
+}
+
+/* StepCraft: hand the craft the frames its UART has finished receiving,
+ * the way the receive interrupt does, then let a millisecond pass
+ */
+static void StepCraft(ArenaCraft_t *pCraft)
+{
+    pCurrent = pCraft;
+    Craft_Select(&pCraft->Craft);
+    while ((pCraft->RxCount > 0) && (pCraft->Rx[pCraft->RxHead].Due <= (uint64_t)Time*1000)){
+        RxFrame_t *pRx = &pCraft->Rx[pCraft->RxHead];
+        for (uint8_t i=0; i<pRx->Length; i++){
+            HostRegs_Receive(pRx->Bytes[i]);
+            ES_RunUntilIdle();
+        }
+        pCraft->RxHead = (pCraft->RxHead + 1) % MAX_RX_PENDING;
+        pCraft->RxCount--;
+    }
+    ES_RunFor(1);
+}
+
+// OnTxByte: a byte from the running craft's UART to its XBee
+static void OnTxByte(uint8_t Byte)
+{
+    ArenaCraft_t *pCraft = pCurrent;
+    uint8_t Length = Pac_FeedDecoder(&pCraft->Decoder, Byte);
+    AirFrame_t *pFrame;
+    if ((Length == 0) || (pCraft->NumTx >= MAX_TX_PENDING)){
+        return;
+    }
+    // TX16: API id, frame id, then the destination
+    pFrame = &pCraft->Tx[pCraft->NumTx++];
+    pFrame->Dest = (pCraft->Decoder.Buffer[5] << 8) | pCraft->Decoder.Buffer[6];
+    // the XBee has the frame once the last byte is through the UART
+    pFrame->Cca = (uint64_t)ES_Timer_GetTime32()*1000 + Length*UART_US_PER_BYTE;
+    pFrame->Length = Length;
+    memcpy(pFrame->Bytes, pCraft->Decoder.Buffer, Length);
+}
+
+static void RunPacs(void)
+{
+    for (unsigned i=0; i<NumPacs; i++){
+        ArenaPac_t *pPac = &Pacs[i];
+        uint8_t Frame[PAC_MAX_FRAME];
+        uint8_t Length;
+        uint16_t Dest = pPac->Target;
+        if (Time < pPac->NextSend){
+            continue;
+        }
+        if (pPac->State == PacPairing){
+            Length = Pac_PairRequest(&pPac->Model, pPac->Team, pPac->isBlue, Frame);
+            Dest = isBroadcastPairing ? BROADCAST : pPac->Home;
+            pPac->NextSend = Time + PAIR_RETRY_MS;
+        } else if (pPac->State == PacKeying){
+            Length = Pac_KeyFrame(&pPac->Model, Frame);
+            pPac->NextSend = Time + KEY_RETRY_MS;
+        } else {
+            // sweep the sticks so every packet is different
+            Length = Pac_ControlFrame(&pPac->Model, (int8_t)(pPac->NumControls*3),
+                                      (int8_t)(pPac->NumControls*5), 0, Frame);
+            pPac->NumControls++;
+            pPac->NextSend += Period;
+        }
+        // the PAC's clock is not in step with ours
+        Queue(-1 - (int32_t)i, Dest, (uint64_t)Time*1000 + Random(1000), Frame, Length);
+    }
+}
+
+/* NewPacAddress: PACs start over from a fresh address after an unpair,
+ * since a craft turns away the PAC it was last paired with. Addresses are
+ * handed out so that both bytes differ between neighbours and none has a
+ * zero byte.
+ */
+static void NewPacAddress(ArenaPac_t *pPac)
+{
+    unsigned n = NextPacAddress++;
+    uint16_t Old = (pPac->Model.AddressMSB << 8) | pPac->Model.AddressLSB;
+    if (AddressOwner[Old] == pPac - Pacs){
+        AddressOwner[Old] = NO_OWNER;
+    }
+    pPac->Model.AddressMSB = 1 + n % PAC_ADDRESS_MSBS;
+    pPac->Model.AddressLSB = 1 + (n + n/PAC_ADDRESS_MSBS) % 0xFF;
+    AddressOwner[(pPac->Model.AddressMSB << 8) | pPac->Model.AddressLSB] = pPac - Pacs;
+}
+
+// PacReceive: a status frame from a craft reached this PAC's radio
+static void PacReceive(ArenaPac_t *pPac, const AirFrame_t *pFrame, uint16_t Source)
+{
+    PacStatus_t Status;
+    unsigned Index = pPac - Pacs;
+    if (!Pac_ParseStatus(pFrame->Bytes, pFrame->Length, &Status) || (Status.Type != STATUS_TYPE)){
+        return;
+    }
+    if ((pPac->State != PacPairing) && (Source != pPac->Target)){
+        // another craft took our broadcast pair request
+        pPac->NumCrossTalk++;
+        return;
+    }
+    if ((Status.Code == UNPAIRED) || (Status.Code == UNPAIRED_DEC_ERROR)){
+        if (pPac->State == PacPairing){
+            return;
+        }
+        pPac->NumUnpairs++;
+        pPac->NumDecryptErrors += (Status.Code == UNPAIRED_DEC_ERROR);
+        if (isVerbose){
+            printf("[%7lu] PAC %u (%02X%02X) unpaired by craft %04X%s\n", (unsigned long)Time,
+                   Index, pPac->Model.AddressMSB, pPac->Model.AddressLSB, Source,
+                   (Status.Code == UNPAIRED_DEC_ERROR) ? ", decrypt error" : "");
+        }
+        NewPacAddress(pPac);
+        pPac->State = PacPairing;
+        pPac->NextSend = Time;
+    } else if (pPac->State == PacPairing){
+        pPac->Target = Source;
+        pPac->State = PacKeying;
+        pPac->NextSend = Time;
+        pPac->NumPairs++;
+        pPac->NumForeignPairs += (Source != pPac->Home);
+        if (isVerbose){
+            printf("[%7lu] PAC %u (%02X%02X) paired with craft %04X\n", (unsigned long)Time,
+                   Index, pPac->Model.AddressMSB, pPac->Model.AddressLSB, Source);
+        }
+    } else if (pPac->State == PacKeying){
+        pPac->State = PacDriving;
+        pPac->NextSend = Time;
+    } else {
+        pPac->NumAcks++;
+    }
+}
+
+// Queue: a frame is in its sender's radio from Ready on
+static void Queue(int32_t Sender, uint16_t Dest, uint64_t Ready,
+                  const uint8_t *pBytes, uint8_t Length)
+{
+    AirFrame_t Frame;
+    if (Length == 0){
+        return;
+    }
+    memset(&Frame, 0, sizeof(Frame));
+    Frame.Sender = Sender;
+    Frame.Dest = Dest;
+    Frame.Length = Length;
+    memcpy(Frame.Bytes, pBytes, Length);
+    StartAccess(&Frame, Ready);
+    Append(&Outbox, &Frame);
+    NumSent++;
+}
+
+// StartAccess: unslotted CSMA-CA starts with a random backoff
+static void StartAccess(AirFrame_t *pFrame, uint64_t Ready)
+{
+    pFrame->BE = MIN_BE;
+    pFrame->NumBackoffs = 0;
+    pFrame->Cca = Ready;
+    if (isCarrierSense){
+        pFrame->Cca += (uint64_t)Random(1 << MIN_BE)*BACKOFF_UNIT_US;
+    }
+}
+
+// Collect: what the craft sent their XBees this epoch, in craft order
+static void Collect(void)
+{
+    for (unsigned i=0; i<NumCrafts; i++){
+        ArenaCraft_t *pCraft = &Crafts[i];
+        for (uint8_t j=0; j<pCraft->NumTx; j++){
+            AirFrame_t *pFrame = &pCraft->Tx[j];
+            pCraft->NumStatus++;
+            // a status frame that unpairs a PAC: type, code in the RF data
+            if ((pFrame->Length > 10) && ((pFrame->Bytes[9] == UNPAIRED)
+                    || (pFrame->Bytes[9] == UNPAIRED_DEC_ERROR))){
+                pCraft->NumUnpairs++;
+            }
+            Queue(i, pFrame->Dest, pFrame->Cca + Random(1000), pFrame->Bytes, pFrame->Length);
+        }
+        pCraft->NumTx = 0;
+    }
+}
+
+/* Arbitrate: run every clear channel assessment due before EpochEnd, in
+ * time order. A radio that finds the channel busy backs off for longer
+ * and tries again, up to MAX_CSMA_BACKOFFS times; one that finds it clear
+ * transmits after the turnaround time, so two radios that sense within
+ * that time of each other both go ahead and collide.
+ */
+static void Arbitrate(uint64_t EpochEnd)
+{
+    for (;;){
+        AirFrame_t *pFrame = NULL;
+        uint64_t AirLength;
+        for (size_t i=0; i<Outbox.Count; i++){
+            AirFrame_t *pOther = &Outbox.pFrames[i];
+            if ((pOther->Cca < EpochEnd) && ((pFrame == NULL) || (CompareReady(pOther, pFrame) < 0))){
+                pFrame = pOther;
+            }
+        }
+        if (pFrame == NULL){
+            return;
+        }
+        if (isCarrierSense && IsBusy(pFrame->Cca)){
+            if (++pFrame->NumBackoffs <= MAX_CSMA_BACKOFFS){
+                pFrame->BE = (pFrame->BE < MAX_BE) ? pFrame->BE + 1 : MAX_BE;
+                pFrame->Cca += (uint64_t)Random(1 << pFrame->BE)*BACKOFF_UNIT_US;
+                continue;
+            }
+            NumAccessFailures++;
+        } else {
+            AirLength = (uint64_t)(pFrame->Length - API_OVERHEAD + AIR_OVERHEAD)*US_PER_BYTE;
+            pFrame->Start = pFrame->Cca + (isCarrierSense ? TURNAROUND_US : 0);
+            pFrame->End = pFrame->Start + AirLength;
+            pFrame->isCorrupt = false;
+            for (size_t j=0; j<Air.Count; j++){
+                AirFrame_t *pOther = &Air.pFrames[j];
+                if ((pFrame->Start < pOther->End) && (pOther->Start < pFrame->End)){
+                    pFrame->isCorrupt = true;
+                    pOther->isCorrupt = true;
+                }
+            }
+            AirTime += AirLength;
+            Append(&Air, pFrame);
+        }
+        // done with it, the outbox is unordered
+        *pFrame = Outbox.pFrames[--Outbox.Count];
+    }
+}
+
+// IsBusy: what a clear channel assessment at Time sees
+static bool IsBusy(uint64_t Time)
+{
+    for (size_t i=0; i<Air.Count; i++){
+        if ((Air.pFrames[i].Start <= Time) && (Time < Air.pFrames[i].End)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Deliver: hand out every frame that has finished by Now, in air order
+static void Deliver(uint64_t Now)
+{
+    size_t Kept = 0;
+    Due.Count = 0;
+    for (size_t i=0; i<Air.Count; i++){
+        if (Air.pFrames[i].End <= Now){
+            Append(&Due, &Air.pFrames[i]);
+        } else {
+            Air.pFrames[Kept++] = Air.pFrames[i];
+        }
+    }
+    Air.Count = Kept;
+    qsort(Due.pFrames, Due.Count, sizeof(AirFrame_t), CompareDone);
+    for (size_t i=0; i<Due.Count; i++){
+        AirFrame_t *pFrame = &Due.pFrames[i];
+        bool isFaded = (Loss > 0) && (Random(1000000) < Loss*1e6);
+        if (pFrame->isCorrupt || isFaded){
+            NumCollided += pFrame->isCorrupt;
+            NumFaded += !pFrame->isCorrupt;
+            // no acknowledgement: the MAC tries again, broadcasts are not acknowledged
+            if ((pFrame->Dest != BROADCAST) && (pFrame->Retries < MAC_RETRIES)){
+                pFrame->Retries++;
+                StartAccess(pFrame, pFrame->End + ACK_WAIT_US);
+                Append(&Outbox, pFrame);
+                NumRetries++;
+            } else {
+                NumLost++;
+            }
+            continue;
+        }
+        Receive(pFrame);
+    }
+}
+
+// Receive: the radios the frame is addressed to pass it up
+static void Receive(const AirFrame_t *pFrame)
+{
+    if (pFrame->Sender >= 0){
+        int32_t Owner = AddressOwner[pFrame->Dest];
+        if (Owner == NO_OWNER){
+            NumUnheard++;
+            return;
+        }
+        PacReceive(&Pacs[Owner], pFrame, SenderAddress(pFrame->Sender));
+        return;
+    }
+    bool isHeard = false;
+    for (unsigned i=0; i<NumCrafts; i++){
+        ArenaCraft_t *pCraft = &Crafts[i];
+        RxFrame_t *pRx;
+        if ((pFrame->Dest != BROADCAST) && (pFrame->Dest != pCraft->Address)){
+            continue;
+        }
+        isHeard = true;
+        pCraft->NumRx++;
+        if (pCraft->RxCount >= MAX_RX_PENDING){
+            pCraft->NumRxOverflows++;
+            continue;
+        }
+        pRx = &pCraft->Rx[(pCraft->RxHead + pCraft->RxCount++) % MAX_RX_PENDING];
+        pRx->Due = pFrame->End + pFrame->Length*UART_US_PER_BYTE;
+        pRx->Length = pFrame->Length;
+        memcpy(pRx->Bytes, pFrame->Bytes, pFrame->Length);
+    }
+    NumUnheard += !isHeard;
+}
+
+static uint16_t SenderAddress(int32_t Sender)
+{
+    if (Sender >= 0){
+        return Crafts[Sender].Address;
+    }
+    return (Pacs[-1 - Sender].Model.AddressMSB << 8) | Pacs[-1 - Sender].Model.AddressLSB;
+}
+
+static void Append(FrameList_t *pList, const AirFrame_t *pFrame)
+{
+    if (pList->Count == pList->Size){
+        pList->Size = (pList->Size == 0) ? 64 : 2*pList->Size;
+        pList->pFrames = realloc(pList->pFrames, pList->Size*sizeof(AirFrame_t));
+        if (pList->pFrames == NULL){
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    pList->pFrames[pList->Count++] = *pFrame;
+}
+
+/* CompareReady, CompareDone: frames in the order of their next clear
+ * channel assessment, or in the order they came off the air; ties go by sender so that the
+ * order is always the same
+ */
+static int CompareReady(const void *pA, const void *pB)
+{
+    const AirFrame_t *pFrameA = pA;
+    const AirFrame_t *pFrameB = pB;
+    if (pFrameA->Cca != pFrameB->Cca){
+        return (pFrameA->Cca < pFrameB->Cca) ? -1 : 1;
+    }
+    return (pFrameA->Sender > pFrameB->Sender) - (pFrameA->Sender < pFrameB->Sender);
+}
+
+static int CompareDone(const void *pA, const void *pB)
+{
+    const AirFrame_t *pFrameA = pA;
+    const AirFrame_t *pFrameB = pB;
+    if (pFrameA->End != pFrameB->End){
+        return (pFrameA->End < pFrameB->End) ? -1 : 1;
+    }
+    return (pFrameA->Sender > pFrameB->Sender) - (pFrameA->Sender < pFrameB->Sender);
+}
+
+// Random: xorshift32, uniform in [0, Range)
+static uint32_t Random(uint32_t Range)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return (uint32_t)(((uint64_t)RandomState*Range) >> 32);
+}
+
+static double Now(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec + Time.tv_nsec*1e-9;
+}
+
+static void Report(double WallSeconds)
+{
+    unsigned long NumControls = 0, NumAcks = 0, NumPairs = 0, NumForeignPairs = 0;
+    unsigned long NumUnpairs = 0, NumDecryptErrors = 0, NumCrossTalk = 0;
+    unsigned NumDriving = 0;
+    for (unsigned i=0; i<NumPacs; i++){
+        NumControls += Pacs[i].NumControls;
+        NumAcks += Pacs[i].NumAcks;
+        NumPairs += Pacs[i].NumPairs;
+        NumForeignPairs += Pacs[i].NumForeignPairs;
+        NumUnpairs += Pacs[i].NumUnpairs;
+        NumDecryptErrors += Pacs[i].NumDecryptErrors;
+        NumCrossTalk += Pacs[i].NumCrossTalk;
+        NumDriving += (Pacs[i].State == PacDriving);
+    }
+    printf("arena: %u craft, %u PACs, %.1f s, %u thread%s\n", NumCrafts, NumPacs,
+           Duration*1e-3, NumThreads, (NumThreads > 1) ? "s" : "");
+    printf("channel: %lu frames, %lu collided, %lu faded, %lu retries, %lu lost,"
+           " %lu no clear channel, %lu unheard, %.1f%% airtime\n",
+           NumSent, NumCollided, NumFaded, NumRetries, NumLost, NumAccessFailures,
+           NumUnheard, 100.0*AirTime/(Duration*1e3));
+    printf("PACs: %lu pairs (%lu with another craft), %lu unpairs (%lu decrypt errors),"
+           " %u driving at the end\n", NumPairs, NumForeignPairs, NumUnpairs,
+           NumDecryptErrors, NumDriving);
+    printf("control: %lu sent, %lu acknowledged (%.1f%%), %lu replies from other craft\n",
+           NumControls, NumAcks, (NumControls > 0) ? 100.0*NumAcks/NumControls : 0.0,
+           NumCrossTalk);
+    printf("%-6s %-4s %4s %8s %8s %8s %8s\n", "craft", "addr", "team", "rx", "dropped",
+           "status", "unpairs");
+    for (unsigned i=0; i<NumCrafts; i++){
+        ArenaCraft_t *pCraft = &Crafts[i];
+        printf("%-6u %04X %4u %8lu %8lu %8lu %8lu\n", i, pCraft->Address, pCraft->Team,
+               pCraft->NumRx, pCraft->NumRxOverflows, pCraft->NumStatus, pCraft->NumUnpairs);
+    }
+    printf("wall: %.2f s, %.1fx real time\n", WallSeconds,
+           (WallSeconds > 0) ? Duration*1e-3/WallSeconds : 0.0);
+}
@@ -0,0 +1,86 @@
+/****************************************************************************
+ Module
+   BenchFrames.c
+
+ Description
+   Writes Bench/BenchFrames.h: the canned XBee frames the cycle benchmark
+   firmware feeds through CommService and PairingSM.
+
+ Notes
+   Usage: benchframes > ../Bench/BenchFrames.h
+
+   The frames are one pairing session from the PAC model: a pair request,
+   a key, then one full turn of the key counter's worth of control frames,
+   so the benchmark can replay them in a loop and stay in sync. After them
+   comes one more, with the e-brake on, for wherever the loop stops.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include "PacModel.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define NUM_CONTROL_FRAMES KEY_LENGTH
+#define CONTROL_FRAME_SIZE (sizeof(ControlFrame_t) + 4)
+#define BENCH_SEED 0x5EED
+#define BENCH_TEAM 0
+#define BENCH_TEAM_ADC 85 // inside team 0's default band
+#define BENCH_EBRAKE 0x01 // special byte of the braking frame
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void PrintBytes(const uint8_t *pBytes, uint8_t Length, const char *Indent);
+
+/*------------------------------ Module Code ------------------------------*/
+int main(void)
+{
+    PacModel_t Pac;
+    uint8_t Frame[PAC_MAX_FRAME];
+    uint8_t Length;
+
+    Pac_Init(&Pac, 0x21, 0x82, BENCH_SEED);
+    printf("#ifndef BenchFrames_H\n#define BenchFrames_H\n\n");
+    printf("/* Generated by Host/build/benchframes, do not edit. One pairing session\n"
+           " * with PAC 0x2182: pair request, key, then %u control frames and one\n"
+           " * with the e-brake on.\n */\n\n",
+           NUM_CONTROL_FRAMES);
+    printf("#define BENCH_TEAM_ADC %u\n", BENCH_TEAM_ADC);
+    printf("#define BENCH_NUM_CONTROL %u\n", NUM_CONTROL_FRAMES);
+    printf("#define BENCH_CONTROL_SIZE %u\n\n", (unsigned)CONTROL_FRAME_SIZE);
+
+    Length = Pac_PairRequest(&Pac, BENCH_TEAM, false, Frame);
+    printf("static const uint8_t BenchPairFrame[%u] = {\n", Length);
+    PrintBytes(Frame, Length, "    ");
+    printf("};\n\n");
+
+    Length = Pac_KeyFrame(&Pac, Frame);
+    printf("static const uint8_t BenchKeyFrame[%u] = {\n", Length);
+    PrintBytes(Frame, Length, "    ");
+    printf("};\n\n");
+
+    printf("static const uint8_t BenchControlFrames[BENCH_NUM_CONTROL][BENCH_CONTROL_SIZE] = {\n");
+    for (unsigned i=0; i<NUM_CONTROL_FRAMES; i++){
+        // sweep drive and turn so every branch of the mixer gets exercised
+        Length = Pac_ControlFrame(&Pac, (int8_t)(i*8 - 128), (int8_t)(i*6 - 96), 0, Frame);
+        printf("    {\n");
+        PrintBytes(Frame, Length, "        ");
+        printf("    },\n");
+    }
+    printf("};\n\n");
+
+    Length = Pac_ControlFrame(&Pac, 64, 0, BENCH_EBRAKE, Frame);
+    printf("static const uint8_t BenchBrakeFrame[BENCH_CONTROL_SIZE] = {\n");
+    PrintBytes(Frame, Length, "    ");
+    printf("};\n\n#endif /* BenchFrames_H */\n");
+    return 0;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static void PrintBytes(const uint8_t *pBytes, uint8_t Length, const char *Indent)
+{
+    for (uint8_t i=0; i<Length; i++){
+        printf("%s0x%02X,", (i % 12 == 0) ? Indent : " ", pBytes[i]);
+        if ((i % 12 == 11) || (i == Length - 1)){
+            printf("\n");
+        }
+    }
+}
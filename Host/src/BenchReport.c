@@ -0,0 +1,242 @@
+/****************************************************************************
+ Module
+   BenchReport.c
+
+ Description
+   Compares a run of the cycle benchmark firmware (Bench/BenchMain.c) with
+   a baseline and flags the hot paths that got slower.
+
+ Notes
+   Usage: benchreport [-g] [-t PCT] [-o NEWBASE] RESULTS [BASELINE]
+
+   RESULTS holds the firmware's report: the BENCH lines it prints over the
+   EUSART, as captured by a terminal. With -g it is a gpsim log instead
+   (see Bench/bench.stc), and the report is rebuilt from the logged writes
+   to TX1REG. A baseline is just a saved report; -o writes the results out
+   as one.
+
+   Each path is compared on its mean cycle count. A path more than PCT
+   percent (default 2) slower than the baseline is a regression. Exits 0
+   when nothing regressed, 1 on a regression, when the firmware lost key
+   sync or when the e-brake it posted did not hold, 2 on bad arguments or
+   unreadable files.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*----------------------------- Module Defines ----------------------------*/
+#define MAX_PATHS 16
+#define MAX_NAME 32
+#define MAX_LINE 256
+#define DEFAULT_THRESHOLD 2.0
+
+/*---------------------------- Module Types ---------------------------*/
+typedef struct {
+    char Name[MAX_NAME];
+    unsigned long Count;
+    unsigned long Min;
+    unsigned long Mean;
+    unsigned long Max;
+} BenchResult_t;
+
+typedef struct {
+    BenchResult_t Paths[MAX_PATHS];
+    int NumPaths;
+    long OutOfSync; // -1 if the report had no BENCH_SYNC line
+    long Held;      // -1 if the report had no BENCH_BRAKE line
+} BenchReport_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static int ReadReport(const char *Path, int isGpsimLog, BenchReport_t *pReport);
+static void ParseLine(const char *Line, BenchReport_t *pReport);
+static const BenchResult_t *FindPath(const BenchReport_t *pReport, const char *Name);
+static int WriteReport(const char *Path, const BenchReport_t *pReport);
+static void Usage(void);
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    BenchReport_t Results, Baseline;
+    const char *NewBase = NULL;
+    double Threshold = DEFAULT_THRESHOLD;
+    int isGpsimLog = 0;
+    int NumRegressions = 0;
+    int Opt;
+
+    while ((Opt = getopt(argc, argv, "gt:o:")) != -1){
+        switch (Opt){
+            case 'g':
+                isGpsimLog = 1;
+                break;
+            case 't':
+                Threshold = atof(optarg);
+                break;
+            case 'o':
+                NewBase = optarg;
+                break;
+            default:
+                Usage();
+                return 2;
+        }
+    }
+    if ((argc - optind < 1) || (argc - optind > 2)){
+        Usage();
+        return 2;
+    }
+    if (!ReadReport(argv[optind], isGpsimLog, &Results)){
+        return 2;
+    }
+    if (Results.NumPaths == 0){
+        fprintf(stderr, "%s: no BENCH lines\n", argv[optind]);
+        return 2;
+    }
+    if ((NewBase != NULL) && !WriteReport(NewBase, &Results)){
+        return 2;
+    }
+
+    if (argc - optind == 2){
+        if (!ReadReport(argv[optind + 1], 0, &Baseline)){
+            return 2;
+        }
+        printf("%-20s %8s %8s %8s %8s\n", "path", "base", "mean", "delta", "%");
+        for (int i=0; i<Results.NumPaths; i++){
+            const BenchResult_t *pNew = &Results.Paths[i];
+            const BenchResult_t *pOld = FindPath(&Baseline, pNew->Name);
+            if (pOld == NULL){
+                printf("%-20s %8s %8lu %8s %8s  new\n", pNew->Name, "-", pNew->Mean, "-", "-");
+                continue;
+            }
+            long Delta = (long)pNew->Mean - (long)pOld->Mean;
+            double Percent = (pOld->Mean > 0) ? 100.0*Delta/pOld->Mean : 0.0;
+            int isRegression = (Percent > Threshold);
+            printf("%-20s %8lu %8lu %+8ld %+7.1f%%%s\n", pNew->Name, pOld->Mean,
+                   pNew->Mean, Delta, Percent, isRegression ? "  REGRESSION" : "");
+            NumRegressions += isRegression;
+        }
+    } else {
+        printf("%-20s %8s %8s %8s %8s\n", "path", "n", "min", "mean", "max");
+        for (int i=0; i<Results.NumPaths; i++){
+            const BenchResult_t *pPath = &Results.Paths[i];
+            printf("%-20s %8lu %8lu %8lu %8lu\n", pPath->Name, pPath->Count,
+                   pPath->Min, pPath->Mean, pPath->Max);
+        }
+    }
+
+    if (Results.OutOfSync != 0){
+        // the control frames took the decrypt error path, so the numbers lie
+        printf("key sync lost (out_of_sync=%ld)\n", Results.OutOfSync);
+        return 1;
+    }
+    if (Results.Held == 0){
+        printf("e-brake not held\n");
+        return 1;
+    }
+    return (NumRegressions > 0) ? 1 : 0;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+/* ReadReport: a gpsim log is turned back into the text the firmware sent,
+ * one logged TX1REG write per character, then parsed like a capture.
+ */
+static int ReadReport(const char *Path, int isGpsimLog, BenchReport_t *pReport)
+{
+    FILE *pFile = fopen(Path, "r");
+    char Line[MAX_LINE];
+    char Text[MAX_LINE];
+    size_t TextLength = 0;
+
+    if (pFile == NULL){
+        perror(Path);
+        return 0;
+    }
+    pReport->NumPaths = 0;
+    pReport->OutOfSync = -1;
+    pReport->Held = -1;
+    while (fgets(Line, sizeof(Line), pFile) != NULL){
+        if (!isGpsimLog){
+            ParseLine(Line, pReport);
+            continue;
+        }
+        // e.g. "  0x00001A2B  p16f1788  0x0123  wrote: 0x42 to TX1REG(0x019A)"
+        const char *pWrote = strstr(Line, "rote");
+        if ((pWrote == NULL) || (strstr(Line, "TX1REG") == NULL)){
+            continue;
+        }
+        const char *pValue = strstr(pWrote, "0x");
+        if (pValue == NULL){
+            continue;
+        }
+        char Char = (char)strtoul(pValue, NULL, 16);
+        if (Char == '\n'){
+            Text[TextLength] = '\0';
+            ParseLine(Text, pReport);
+            TextLength = 0;
+        } else if ((Char != '\r') && (TextLength < sizeof(Text) - 1)){
+            Text[TextLength++] = Char;
+        }
+    }
+    fclose(pFile);
+    return 1;
+}
+
+static void ParseLine(const char *Line, BenchReport_t *pReport)
+{
+    BenchResult_t Result;
+    long OutOfSync;
+    long Held;
+    if (sscanf(Line, "BENCH_SYNC out_of_sync=%ld", &OutOfSync) == 1){
+        pReport->OutOfSync = OutOfSync;
+        return;
+    }
+    if (sscanf(Line, "BENCH_BRAKE held=%ld", &Held) == 1){
+        pReport->Held = Held;
+        return;
+    }
+    if (sscanf(Line, "BENCH %31s n=%lu min=%lu mean=%lu max=%lu", Result.Name,
+               &Result.Count, &Result.Min, &Result.Mean, &Result.Max) != 5){
+        return;
+    }
+    if (pReport->NumPaths < MAX_PATHS){
+        pReport->Paths[pReport->NumPaths++] = Result;
+    }
+}
+
+static const BenchResult_t *FindPath(const BenchReport_t *pReport, const char *Name)
+{
+    for (int i=0; i<pReport->NumPaths; i++){
+        if (strcmp(pReport->Paths[i].Name, Name) == 0){
+            return &pReport->Paths[i];
+        }
+    }
+    return NULL;
+}
+
+// WriteReport: in the firmware's own format, so it reads back as a baseline
+static int WriteReport(const char *Path, const BenchReport_t *pReport)
+{
+    FILE *pFile = fopen(Path, "w");
+    if (pFile == NULL){
+        perror(Path);
+        return 0;
+    }
+    for (int i=0; i<pReport->NumPaths; i++){
+        const BenchResult_t *pPath = &pReport->Paths[i];
+        fprintf(pFile, "BENCH %s n=%lu min=%lu mean=%lu max=%lu\n", pPath->Name,
+                pPath->Count, pPath->Min, pPath->Mean, pPath->Max);
+    }
+    fprintf(pFile, "BENCH_SYNC out_of_sync=%ld\n", pReport->OutOfSync);
+    if (pReport->Held >= 0){
+        fprintf(pFile, "BENCH_BRAKE held=%ld\n", pReport->Held);
+    }
+    fclose(pFile);
+    return 1;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: benchreport [-g] [-t PCT] [-o NEWBASE] RESULTS [BASELINE]\n");
+}
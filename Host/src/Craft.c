@@ -0,0 +1,49 @@
+/****************************************************************************
+ Module
+   Craft.c
+
+ Description
+   Switches the firmware between the craft of a MULTI_CRAFT host build.
+
+ Notes
+   Selecting a craft only moves pointers, so it costs the same however
+   much state the craft has, and the pointers are thread local, so each
+   thread can run its own craft.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <string.h>
+#include "Craft.h"
+
+/*------------------------------ Module Code ------------------------------*/
+void Craft_Select(Craft_t *pCraft)
+{
+    HostRegs_Select(&pCraft->Regs);
+    pES_FrameworkContext = &pCraft->Framework;
+    pES_TimerContext = &pCraft->Timers;
+    pCommContext = &pCraft->Comm;
+    pPairingContext = &pCraft->Pairing;
+    pMCContext = &pCraft->MC;
+    pConfigStoreContext = &pCraft->Store;
+    pFlightRecorderContext = &pCraft->Recorder;
+    pPowerManagerContext = &pCraft->PM;
+    pSmallLinkContext = &pCraft->Link;
+    pADCContext = &pCraft->Scan;
+}
+
+/* Craft_PowerUp: blank EEPROM, power-on registers, and every service
+ * started; leaves the craft selected
+ */
+bool Craft_PowerUp(Craft_t *pCraft, uint8_t TeamAdc)
+{
+    memset(pCraft, 0, sizeof(*pCraft));
+    HostRegs_Reset(&pCraft->Regs);
+    pCraft->Regs.AdcInput[ADC_AN_TEAM] = TeamAdc;
+    Craft_Select(pCraft);
+    ES_Timer_Reset();
+    if (ES_Initialize() != Success){
+        return false;
+    }
+    ES_RunUntilIdle();
+    return true;
+}
@@ -0,0 +1,56 @@
+/****************************************************************************
+ Module
+   DebugServices.c
+
+ Description
+   Host build only: do-nothing stand-ins for the Blink and ButtonDebounce
+   debugging services, whose sources are not part of this project but which
+   still occupy slots in the service table.
+
+****************************************************************************/
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "Blink.h"
+#include "ButtonDebounce.h"
+
+static uint8_t BlinkPriority;
+static uint8_t ButtonPriority;
+
+bool InitBlink(uint8_t Priority)
+{
+    BlinkPriority = Priority;
+    return true;
+}
+
+bool PostBlink(ES_Event ThisEvent)
+{
+    return ES_PostToService(BlinkPriority, ThisEvent);
+}
+
+ES_Event RunBlink(ES_Event ThisEvent)
+{
+    ThisEvent.EventType = ES_NO_EVENT;
+    return ThisEvent;
+}
+
+bool InitButtonDB(uint8_t Priority)
+{
+    ButtonPriority = Priority;
+    return true;
+}
+
+bool PostButton(ES_Event ThisEvent)
+{
+    return ES_PostToService(ButtonPriority, ThisEvent);
+}
+
+ES_Event RunButtonDB(ES_Event ThisEvent)
+{
+    ThisEvent.EventType = ES_NO_EVENT;
+    return ThisEvent;
+}
+
+bool CheckButtonEvents(void)
+{
+    return false;
+}
@@ -0,0 +1,338 @@
+/****************************************************************************
+ Module
+   ES_Framework.c
+
+ Description
+   Host build of the Events and Services framework: two FIFO queues per
+   service, a normal one and an urgent lane, sized from ES_Configure.h, and
+   a run step that runs the highest priority service with an event waiting,
+   or the event checkers if there is none.
+
+ Notes
+   The target framework runs forever from ES_Run. On the host the runner
+   owns the loop, so it calls ES_RunOnce or ES_RunUntilIdle between
+   injected inputs instead, and ES_RunFor to let time pass.
+
+   Time is virtual. Between inputs nothing can happen except a timer
+   expiring, so ES_RunFor jumps the clock straight to the next expiry rather
+   than stepping through every millisecond; a 10 minute match costs a few
+   thousand service runs, and the same script always gives the same run.
+   A sleeping chip (see PowerManager) runs nothing, and its timers stand
+   still, until the watchdog or a received byte wakes it.
+
+   ES_PostToService puts the events ES_IS_URGENT picks out in the urgent
+   lane, the rest in the normal queue, so posting stays a single store.
+   ES_RunOnce looks through the urgent lanes, highest priority first,
+   before any normal queue: an unpair or a session timeout never waits
+   behind received bytes or drive commands, whichever service they are
+   queued for. Within a lane events run in the order they were posted. A
+   full lane drops the post, as a full queue does; it does not spill into
+   the other.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stddef.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "ES_ServiceHeaders.h"
+#include "HostRegs.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+// every service needs room for at least one urgent event
+typedef char ES_AssertUrgent0[(SERV_0_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#if NUM_SERVICES > 1
+typedef char ES_AssertUrgent1[(SERV_1_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#endif
+#if NUM_SERVICES > 2
+typedef char ES_AssertUrgent2[(SERV_2_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#endif
+#if NUM_SERVICES > 3
+typedef char ES_AssertUrgent3[(SERV_3_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#endif
+#if NUM_SERVICES > 4
+typedef char ES_AssertUrgent4[(SERV_4_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#endif
+#if NUM_SERVICES > 5
+typedef char ES_AssertUrgent5[(SERV_5_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#endif
+#if NUM_SERVICES > 6
+typedef char ES_AssertUrgent6[(SERV_6_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#endif
+#if NUM_SERVICES > 7
+typedef char ES_AssertUrgent7[(SERV_7_URGENT_QUEUE_SIZE >= 1) ? 1 : -1];
+#endif
+
+/*---------------------------- Module Types ---------------------------*/
+typedef bool InitFunc_t(uint8_t Priority);
+typedef ES_Event RunFunc_t(ES_Event ThisEvent);
+typedef bool CheckFunc(void);
+
+typedef struct {
+    InitFunc_t *InitFunc;
+    RunFunc_t *RunFunc;
+    size_t QueueOffset;
+    uint8_t QueueSize;
+    size_t UrgentOffset;
+    uint8_t UrgentSize;
+    const char *Name;   // of the run function
+} ServDesc_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static ES_Event *GetQueue(uint8_t WhichService);
+static ES_Event *GetUrgent(uint8_t WhichService);
+static ES_Event TakeEvent(uint8_t WhichService, bool isUrgent);
+static void RunService(uint8_t WhichService, bool isUrgent);
+
+/*---------------------------- Module Variables ---------------------------*/
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL ES_FrameworkContext_t *pES_FrameworkContext;
+#define Framework (*pES_FrameworkContext)
+#else
+static ES_FrameworkContext_t Framework;
+#endif
+// the runner's view of which service runs what, see ES_SetRunHook
+static ES_RunHook_t *pRunHook = NULL;
+
+// each service's queue and urgent lane, as offsets into the framework context
+static const ServDesc_t ServDescList[] = {
+    { SERV_0_INIT, SERV_0_RUN, offsetof(ES_FrameworkContext_t, Queue0), SERV_0_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent0), SERV_0_URGENT_QUEUE_SIZE, XSTR(SERV_0_RUN) },
+#if NUM_SERVICES > 1
+    { SERV_1_INIT, SERV_1_RUN, offsetof(ES_FrameworkContext_t, Queue1), SERV_1_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent1), SERV_1_URGENT_QUEUE_SIZE, XSTR(SERV_1_RUN) },
+#endif
+#if NUM_SERVICES > 2
+    { SERV_2_INIT, SERV_2_RUN, offsetof(ES_FrameworkContext_t, Queue2), SERV_2_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent2), SERV_2_URGENT_QUEUE_SIZE, XSTR(SERV_2_RUN) },
+#endif
+#if NUM_SERVICES > 3
+    { SERV_3_INIT, SERV_3_RUN, offsetof(ES_FrameworkContext_t, Queue3), SERV_3_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent3), SERV_3_URGENT_QUEUE_SIZE, XSTR(SERV_3_RUN) },
+#endif
+#if NUM_SERVICES > 4
+    { SERV_4_INIT, SERV_4_RUN, offsetof(ES_FrameworkContext_t, Queue4), SERV_4_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent4), SERV_4_URGENT_QUEUE_SIZE, XSTR(SERV_4_RUN) },
+#endif
+#if NUM_SERVICES > 5
+    { SERV_5_INIT, SERV_5_RUN, offsetof(ES_FrameworkContext_t, Queue5), SERV_5_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent5), SERV_5_URGENT_QUEUE_SIZE, XSTR(SERV_5_RUN) },
+#endif
+#if NUM_SERVICES > 6
+    { SERV_6_INIT, SERV_6_RUN, offsetof(ES_FrameworkContext_t, Queue6), SERV_6_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent6), SERV_6_URGENT_QUEUE_SIZE, XSTR(SERV_6_RUN) },
+#endif
+#if NUM_SERVICES > 7
+    { SERV_7_INIT, SERV_7_RUN, offsetof(ES_FrameworkContext_t, Queue7), SERV_7_QUEUE_SIZE,
+      offsetof(ES_FrameworkContext_t, Urgent7), SERV_7_URGENT_QUEUE_SIZE, XSTR(SERV_7_RUN) },
+#endif
+};
+
+static CheckFunc * const ES_EventList[] = { EVENT_CHECK_LIST };
+
+/*------------------------------ Module Code ------------------------------*/
+/* ES_Initialize: empty the queues and run every service's init function in
+ * priority order
+ */
+ES_Return_t ES_Initialize(void)
+{
+    ES_FlushQueues();
+    Framework.PostFailures = 0;
+    for (uint8_t i=0; i<NUM_SERVICES; i++){
+        Framework.Queues[i].HighWater = 0;
+    }
+    for (uint8_t i=0; i<NUM_SERVICES; i++){
+        if (!ServDescList[i].InitFunc(i)){
+            return FailedInit;
+        }
+        HostRegs_Poll();
+    }
+    return Success;
+}
+
+// ES_PostToService: queue an event in the lane ES_IS_URGENT says it goes in
+bool ES_PostToService(uint8_t WhichService, ES_Event TheEvent)
+{
+    ES_QueueState_t *pQueue;
+    const ServDesc_t *pDesc;
+    if (WhichService >= NUM_SERVICES){
+        return false;
+    }
+    pQueue = &Framework.Queues[WhichService];
+    pDesc = &ServDescList[WhichService];
+    if (ES_IS_URGENT(TheEvent)){
+        if (pQueue->UrgentCount >= pDesc->UrgentSize){
+            Framework.PostFailures++;
+            return false;
+        }
+        GetUrgent(WhichService)[(pQueue->UrgentHead + pQueue->UrgentCount)
+                % pDesc->UrgentSize] = TheEvent;
+        pQueue->UrgentCount++;
+    } else {
+        if (pQueue->Count >= pDesc->QueueSize){
+            Framework.PostFailures++;
+            return false;
+        }
+        GetQueue(WhichService)[(pQueue->Head + pQueue->Count)
+                % pDesc->QueueSize] = TheEvent;
+        pQueue->Count++;
+    }
+    if (pQueue->Count + pQueue->UrgentCount > pQueue->HighWater){
+        pQueue->HighWater = pQueue->Count + pQueue->UrgentCount;
+    }
+    return true;
+}
+
+bool ES_PostAll(ES_Event ThisEvent)
+{
+    bool isOK = true;
+    for (uint8_t i=0; i<NUM_SERVICES; i++){
+        isOK &= ES_PostToService(i, ThisEvent);
+    }
+    return isOK;
+}
+
+/* ES_RunOnce: one pass of the target's run loop: let the highest priority
+ * service with an urgent event handle it, failing that the highest priority
+ * service with a normal one or, if every queue is empty, call the event
+ * checkers until one reports an event.
+ * returns true if a service ran or a checker found an event
+ */
+bool ES_RunOnce(void)
+{
+    if (HostRegs_IsAsleep()){
+        return false;
+    }
+    for (int8_t i=NUM_SERVICES-1; i>=0; i--){
+        if (Framework.Queues[i].UrgentCount > 0){
+            RunService(i, true);
+            return true;
+        }
+    }
+    for (int8_t i=NUM_SERVICES-1; i>=0; i--){
+        if (Framework.Queues[i].Count > 0){
+            RunService(i, false);
+            return true;
+        }
+    }
+    for (uint8_t i=0; i<sizeof(ES_EventList)/sizeof(ES_EventList[0]); i++){
+        bool isEvent = ES_EventList[i]();
+        HostRegs_Poll();
+        if (isEvent){
+            return true;
+        }
+    }
+    return false;
+}
+
+void ES_RunUntilIdle(void)
+{
+    while (ES_RunOnce()){
+    }
+}
+
+/* ES_RunFor: let Milliseconds of virtual time pass, running every service
+ * that a timer expiry wakes up on the way
+ */
+void ES_RunFor(uint32_t Milliseconds)
+{
+    ES_RunUntilIdle();
+    while (Milliseconds > 0){
+        uint32_t Next;
+        if (HostRegs_IsAsleep()){
+            uint32_t Slept = HostRegs_SleepFor(Milliseconds);
+            ES_Timer_Sleep(Slept);
+            Milliseconds -= Slept;
+            ES_RunUntilIdle();
+            continue;
+        }
+        Next = ES_Timer_NextExpiry();
+        if (Next > Milliseconds){
+            ES_Timer_Skip(Milliseconds);
+            HostRegs_Elapse(Milliseconds);
+            return;
+        }
+        ES_Timer_Skip(Next - 1);
+        HostRegs_Elapse(Next);
+        ES_Timer_Tick();
+        Milliseconds -= Next;
+        ES_RunUntilIdle();
+    }
+}
+
+void ES_FlushQueues(void)
+{
+    for (uint8_t i=0; i<NUM_SERVICES; i++){
+        Framework.Queues[i].Head = 0;
+        Framework.Queues[i].Count = 0;
+        Framework.Queues[i].UrgentHead = 0;
+        Framework.Queues[i].UrgentCount = 0;
+    }
+}
+
+// ES_GetQueueHighWater: the most events a service's queue has held
+uint8_t ES_GetQueueHighWater(uint8_t WhichService)
+{
+    return (WhichService < NUM_SERVICES) ? Framework.Queues[WhichService].HighWater : 0;
+}
+
+// ES_GetServiceName: the name of a service's run function
+const char *ES_GetServiceName(uint8_t WhichService)
+{
+    return (WhichService < NUM_SERVICES) ? ServDescList[WhichService].Name : NULL;
+}
+
+// ES_SetRunHook: have pHook see every event just before a service runs it,
+// NULL to stop
+void ES_SetRunHook(ES_RunHook_t *pHook)
+{
+    pRunHook = pHook;
+}
+
+// ES_GetPostFailures: posts dropped because a queue was full
+uint16_t ES_GetPostFailures(void)
+{
+    return Framework.PostFailures;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static ES_Event *GetQueue(uint8_t WhichService)
+{
+    return (ES_Event *)((char *)&Framework + ServDescList[WhichService].QueueOffset);
+}
+
+static ES_Event *GetUrgent(uint8_t WhichService)
+{
+    return (ES_Event *)((char *)&Framework + ServDescList[WhichService].UrgentOffset);
+}
+
+// TakeEvent: the oldest event in one of a service's lanes, which must not be empty
+static ES_Event TakeEvent(uint8_t WhichService, bool isUrgent)
+{
+    ES_QueueState_t *pQueue = &Framework.Queues[WhichService];
+    ES_Event ThisEvent;
+    if (isUrgent){
+        ThisEvent = GetUrgent(WhichService)[pQueue->UrgentHead];
+        pQueue->UrgentHead = (pQueue->UrgentHead + 1) % ServDescList[WhichService].UrgentSize;
+        pQueue->UrgentCount--;
+    } else {
+        ThisEvent = GetQueue(WhichService)[pQueue->Head];
+        pQueue->Head = (pQueue->Head + 1) % ServDescList[WhichService].QueueSize;
+        pQueue->Count--;
+    }
+    return ThisEvent;
+}
+
+// RunService: hand the next event in one of a service's lanes to it
+static void RunService(uint8_t WhichService, bool isUrgent)
+{
+    ES_Event ThisEvent = TakeEvent(WhichService, isUrgent);
+    if (pRunHook != NULL){
+        pRunHook(WhichService, &ThisEvent, isUrgent);
+    }
+    ServDescList[WhichService].RunFunc(ThisEvent);
+    HostRegs_Poll();
+}
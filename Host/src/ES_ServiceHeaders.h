@@ -0,0 +1,34 @@
+#ifndef ES_SERVICE_HEADERS_H
+#define ES_SERVICE_HEADERS_H
+
+/* Host build only: pulls in the header of every service listed in
+ * ES_Configure.h, for the framework tables.
+ */
+#include "ES_Configure.h"
+
+#include SERV_0_HEADER
+#if NUM_SERVICES > 1
+#include SERV_1_HEADER
+#endif
+#if NUM_SERVICES > 2
+#include SERV_2_HEADER
+#endif
+#if NUM_SERVICES > 3
+#include SERV_3_HEADER
+#endif
+#if NUM_SERVICES > 4
+#include SERV_4_HEADER
+#endif
+#if NUM_SERVICES > 5
+#include SERV_5_HEADER
+#endif
+#if NUM_SERVICES > 6
+#include SERV_6_HEADER
+#endif
+#if NUM_SERVICES > 7
+#include SERV_7_HEADER
+#endif
+
+#include EVENT_CHECK_HEADER
+
+#endif /* ES_SERVICE_HEADERS_H */
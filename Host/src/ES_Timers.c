@@ -0,0 +1,132 @@
+/****************************************************************************
+ Module
+   ES_Timers.c
+
+ Description
+   Host build of the framework timers. Each tick is one millisecond; an
+   expiring timer posts ES_TIMEOUT, with the timer number as the parameter,
+   to the response function named in ES_Configure.h.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stddef.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "ES_ServiceHeaders.h"
+
+/*---------------------------- Module Variables ---------------------------*/
+static const pPostFunc Timer2PostFunc[ES_NUM_TIMERS] = {
+    TIMER0_RESP_FUNC, TIMER1_RESP_FUNC, TIMER2_RESP_FUNC, TIMER3_RESP_FUNC,
+    TIMER4_RESP_FUNC, TIMER5_RESP_FUNC, TIMER6_RESP_FUNC, TIMER7_RESP_FUNC
+};
+
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL ES_TimerContext_t *pES_TimerContext;
+#define Timers (*pES_TimerContext)
+#else
+static ES_TimerContext_t Timers;
+#endif
+
+/*------------------------------ Module Code ------------------------------*/
+void ES_Timer_Reset(void)
+{
+    Timers.ActiveFlags = 0;
+    Timers.Time = 0;
+    Timers.Ticks = 0;
+}
+
+ES_TimerReturn_t ES_Timer_InitTimer(uint8_t Num, uint16_t NewTime)
+{
+    if ((Num >= ES_NUM_TIMERS) || (NewTime == 0) || (Timer2PostFunc[Num] == TIMER_UNUSED)){
+        return ES_Timer_ERR;
+    }
+    Timers.TimerArray[Num] = NewTime;
+    Timers.ActiveFlags |= (1 << Num);
+    return ES_Timer_OK;
+}
+
+ES_TimerReturn_t ES_Timer_SetTimer(uint8_t Num, uint16_t NewTime)
+{
+    if ((Num >= ES_NUM_TIMERS) || (NewTime == 0) || (Timer2PostFunc[Num] == TIMER_UNUSED)){
+        return ES_Timer_ERR;
+    }
+    Timers.TimerArray[Num] = NewTime;
+    return ES_Timer_OK;
+}
+
+ES_TimerReturn_t ES_Timer_StartTimer(uint8_t Num)
+{
+    if ((Num >= ES_NUM_TIMERS) || (Timer2PostFunc[Num] == TIMER_UNUSED)){
+        return ES_Timer_ERR;
+    }
+    Timers.ActiveFlags |= (1 << Num);
+    return ES_Timer_OK;
+}
+
+ES_TimerReturn_t ES_Timer_StopTimer(uint8_t Num)
+{
+    if ((Num >= ES_NUM_TIMERS) || (Timer2PostFunc[Num] == TIMER_UNUSED)){
+        return ES_Timer_ERR;
+    }
+    Timers.ActiveFlags &= ~(1 << Num);
+    return ES_Timer_OK;
+}
+
+uint16_t ES_Timer_GetTime(void)
+{
+    return (uint16_t)Timers.Ticks;
+}
+
+uint32_t ES_Timer_GetTime32(void)
+{
+    return Timers.Time;
+}
+
+// ES_Timer_NextExpiry: ms until the next timer expires
+uint32_t ES_Timer_NextExpiry(void)
+{
+    uint32_t Next = ES_TIMER_NEVER;
+    for (uint8_t Num=0; Num<ES_NUM_TIMERS; Num++){
+        if ((Timers.ActiveFlags & (1 << Num)) && (Timers.TimerArray[Num] < Next)){
+            Next = Timers.TimerArray[Num];
+        }
+    }
+    return Next;
+}
+
+/* ES_Timer_Skip: advance time without any timer expiring. Milliseconds must
+ * be less than ES_Timer_NextExpiry()
+ */
+void ES_Timer_Skip(uint32_t Milliseconds)
+{
+    Timers.Time += Milliseconds;
+    Timers.Ticks += Milliseconds;
+    for (uint8_t Num=0; Num<ES_NUM_TIMERS; Num++){
+        if (Timers.ActiveFlags & (1 << Num)){
+            Timers.TimerArray[Num] -= Milliseconds;
+        }
+    }
+}
+
+// ES_Timer_Tick: advance time by 1 ms, posting a timeout for each expiry
+void ES_Timer_Tick(void)
+{
+    Timers.Time++;
+    Timers.Ticks++;
+    for (uint8_t Num=0; Num<ES_NUM_TIMERS; Num++){
+        if ((Timers.ActiveFlags & (1 << Num)) && (--Timers.TimerArray[Num] == 0)){
+            ES_Event ThisEvent;
+            Timers.ActiveFlags &= ~(1 << Num);
+            ThisEvent.EventType = ES_TIMEOUT;
+            ThisEvent.EventParam = Num;
+            Timer2PostFunc[Num](ThisEvent);
+        }
+    }
+}
+
+// ES_Timer_Sleep: time passes with the chip asleep, so the tick is stopped
+void ES_Timer_Sleep(uint32_t Milliseconds)
+{
+    Timers.Time += Milliseconds;
+}
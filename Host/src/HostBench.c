@@ -0,0 +1,175 @@
+/****************************************************************************
+ Module
+   HostBench.c
+
+ Description
+   Microbenchmarks for the firmware hot paths, built for the host: the
+   receive state machine, control packet and batch decryption and the
+   drive mixer.
+
+ Notes
+   Usage: bench [iterations]
+
+   Each benchmark calls the service run function directly, then throws away
+   whatever it posted, so the numbers are for the code under test and not the
+   framework. Host numbers only rank changes against each other; they say
+   nothing absolute about cycles on the PIC.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "HostRegs.h"
+#include "PacModel.h"
+#include "CommService.h"
+#include "PairingSM.h"
+#include "MotorControl.h"
+#include "AdcSequencer.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define DEFAULT_ITERATIONS 1000000UL
+#define NUM_FRAMES KEY_LENGTH // control frames before the key counter repeats
+#define TEAM_ADC_READING 85   // inside team 0's band
+
+/*---------------------------- Module Types ---------------------------*/
+typedef struct {
+    uint8_t Bytes[PAC_MAX_FRAME];
+    uint8_t Length;
+} Frame_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void Pair(void);
+static void Feed(const Frame_t *pFrame);
+static double Now(void);
+static void Report(const char *Name, double Start, unsigned long Iterations);
+
+/*---------------------------- Module Variables ---------------------------*/
+static HostRegs_t Regs;
+static PacModel_t Pac;
+static Frame_t Frames[NUM_FRAMES];
+static Frame_t Batches[NUM_FRAMES];
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    unsigned long Iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : DEFAULT_ITERATIONS;
+    RecvFrame_t *pRecv = (RecvFrame_t *)getRecvFrame();
+    ES_Event ThisEvent;
+    double Start;
+
+    HostRegs_Reset(&Regs);
+    HostRegs_Select(&Regs);
+    Regs.AdcInput[ADC_AN_TEAM] = TEAM_ADC_READING;
+    Pac_Init(&Pac, 0x21, 0x82, 1);
+    ES_Timer_Reset();
+    ES_Initialize();
+    ES_RunUntilIdle();
+    Pair();
+    // one full turn of the key counter, so the frames can be replayed in a loop
+    for (uint8_t i=0; i<NUM_FRAMES; i++){
+        Frames[i].Length = Pac_ControlFrame(&Pac, (int8_t)(i*8 - 128), (int8_t)(64 - i*4),
+                                            0, Frames[i].Bytes);
+    }
+    // and of full batches, which take the counter back to the same place
+    for (uint8_t i=0; i<NUM_FRAMES; i++){
+        BatchCommand_t Commands[CTRL_BATCH_MAX];
+        for (uint8_t j=0; j<CTRL_BATCH_MAX; j++){
+            Commands[j].Drive = (uint8_t)(i*8 + j);
+            Commands[j].Turn = (uint8_t)(64 - j*4);
+            Commands[j].At = j*2;
+        }
+        Batches[i].Length = Pac_ControlBatch(&Pac, Commands, CTRL_BATCH_MAX, 0, Batches[i].Bytes);
+    }
+
+    // receive state machine: every byte of a control frame, checksum included
+    Start = Now();
+    for (unsigned long n=0; n<Iterations; n++){
+        const Frame_t *pFrame = &Frames[n % NUM_FRAMES];
+        ThisEvent.EventType = ES_ReceivedByte;
+        for (uint8_t i=0; i<pFrame->Length; i++){
+            ThisEvent.EventParam = pFrame->Bytes[i];
+            RunCommService(ThisEvent);
+        }
+        ES_FlushQueues();
+    }
+    Report("frame parser (per frame)", Start, Iterations);
+
+    // decrypt and check a control frame already in the receive buffer
+    ThisEvent.EventType = ES_NEW_PACKET;
+    ThisEvent.EventParam = RF_SIZE(ControlFrame_t);
+    Start = Now();
+    for (unsigned long n=0; n<Iterations; n++){
+        const Frame_t *pFrame = &Frames[n % NUM_FRAMES];
+        memcpy(pRecv->Bytes, &pFrame->Bytes[3], pFrame->Length - 4);
+        RunPairingSM(ThisEvent);
+        ES_FlushQueues();
+    }
+    Report("decrypt + dispatch (per frame)", Start, Iterations);
+
+    // the same for a batch, per command it carries
+    ThisEvent.EventParam = BATCH_RF_SIZE(CTRL_BATCH_MAX);
+    Start = Now();
+    for (unsigned long n=0; n<Iterations; n++){
+        const Frame_t *pFrame = &Batches[n % NUM_FRAMES];
+        memcpy(pRecv->Bytes, &pFrame->Bytes[3], pFrame->Length - 4);
+        RunPairingSM(ThisEvent);
+        ES_FlushQueues();
+    }
+    Report("batch decrypt (per command)", Start, Iterations*CTRL_BATCH_MAX);
+
+    // mixer: drive and turn bytes to duty cycles and direction pins
+    ThisEvent.EventType = ES_DRIVE_COMMAND;
+    ThisEvent.EventParam = 0x01;
+    Start = Now();
+    for (unsigned long n=0; n<Iterations; n++){
+        RunMC(ThisEvent);
+    }
+    Report("drive mixer (per command)", Start, Iterations);
+
+    if (ES_GetPostFailures() != 0){
+        printf("warning: %u posts failed during setup\n", ES_GetPostFailures());
+    }
+    return 0;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// Pair: read the team resistor and walk PairingSM into Waiting4Control
+static void Pair(void)
+{
+    Frame_t Frame;
+    for (uint16_t i=0; i<10; i++){
+        ES_Timer_Tick();
+        ES_RunUntilIdle();
+    }
+    Frame.Length = Pac_PairRequest(&Pac, 0, false, Frame.Bytes);
+    Feed(&Frame);
+    Frame.Length = Pac_KeyFrame(&Pac, Frame.Bytes);
+    Feed(&Frame);
+}
+
+static void Feed(const Frame_t *pFrame)
+{
+    for (uint8_t i=0; i<pFrame->Length; i++){
+        HostRegs_Receive(pFrame->Bytes[i]);
+        ES_RunUntilIdle();
+    }
+}
+
+static double Now(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec + Time.tv_nsec*1e-9;
+}
+
+static void Report(const char *Name, double Start, unsigned long Iterations)
+{
+    double Elapsed = Now() - Start;
+    printf("%-32s %8.1f ns/op  (%lu ops, %.3f s)\n", Name,
+           Elapsed*1e9/Iterations, Iterations, Elapsed);
+}
@@ -0,0 +1,219 @@
+/****************************************************************************
+ Module
+   HostRegs.c
+
+ Description
+   Emulated PIC16F1788 register file for the host build.
+
+ Notes
+   Only the peripherals the firmware depends on are modelled: the EUSART
+   transmitter (every TX1REG byte goes to the TX callback), the ADC (a
+   conversion started with GO_nDONE completes on the next poll, reading
+   AdcInput[CHS]), the data EEPROM, SLEEP with its two wake-up sources,
+   the receive line (WUE) and the software watchdog (SWDTEN, WDTCON's
+   WDTPS), and Timer4 and Timer6, whose periods are always up by the next
+   poll. The ADC and Timer6 interrupts go to ADC_ISR, as the target's
+   interrupt routine sends them, so the scan moves on one entry a poll, and
+   HostRegs_Elapse keeps it going while the framework is idle. The
+   PIC12F752 on the other end of RA6/RA7 is SmallPicModel.
+
+   After a reset every input reads 0 but the battery, which reads
+   ADC_BATTERY_NOMINAL, so thrust compensation leaves duty cycles alone.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <string.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "HostRegs.h"
+#include "CommService.h"
+#include "AdcSequencer.h"
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void ServiceAdc(HostRegs_t *pRegs);
+
+/*---------------------------- Module Variables ---------------------------*/
+static HostRegs_t DefaultRegs;
+CRAFT_LOCAL HostRegs_t *pHostRegs = &DefaultRegs;
+
+const char * const HostRegs_WatchedNames[NUM_HOST_WATCHED] = {
+#define X(Name) #Name,
+    HOST_WATCHED
+#undef X
+};
+
+static pHostTxFunc TxFunc;
+static pHostOutputFunc OutputFunc;
+
+/*------------------------------ Module Code ------------------------------*/
+// HostRegs_Reset: power-on state, with a blank (erased) EEPROM
+void HostRegs_Reset(HostRegs_t *pRegs)
+{
+    memset(pRegs, 0, sizeof(*pRegs));
+    memset(pRegs->Eeprom, 0xFF, sizeof(pRegs->Eeprom));
+    pRegs->TRMT = 1;
+    pRegs->nTO = 1;
+    pRegs->AdcInput[ADC_AN_BATTERY] = ADC_BATTERY_NOMINAL;
+}
+
+// HostRegs_Select: point the register names at another register file
+void HostRegs_Select(HostRegs_t *pRegs)
+{
+    pHostRegs = pRegs;
+}
+
+void HostRegs_SetCallbacks(pHostTxFunc NewTxFunc, pHostOutputFunc NewOutputFunc)
+{
+    TxFunc = NewTxFunc;
+    OutputFunc = NewOutputFunc;
+}
+
+/* HostRegs_Poll: run the side effects of the register writes made since the
+ * last poll
+ */
+void HostRegs_Poll(void)
+{
+    HostRegs_t *pRegs = pHostRegs;
+    // Timer6: like Timer4
+    if (pRegs->TMR6ON){
+        pRegs->TMR6IF = 1;
+    }
+    // the interrupt routine hands both Timer6 and the ADC to the sequencer;
+    // a conversion takes microseconds, so one started here is done here and
+    // no firmware step ever finds GO_nDONE set
+    ServiceAdc(pRegs);
+    if (pRegs->GO_nDONE && pRegs->ADON){
+        uint8_t Input = pRegs->CHS0 | (pRegs->CHS1 << 1) | (pRegs->CHS2 << 2)
+                      | (pRegs->CHS3 << 3) | (pRegs->CHS4 << 4);
+        pRegs->GO_nDONE = 0;
+        pRegs->ADRESH = pRegs->AdcInput[Input];
+        pRegs->ADIF = 1;
+    }
+    ServiceAdc(pRegs);
+    // EEPROM: a started write completes
+    if (pRegs->WR){
+        pRegs->Eeprom[pRegs->EEADRL] = pRegs->EEDATL;
+        pRegs->WR = 0;
+    }
+    // Timer4: the firmware never runs a whole period between polls
+    if (pRegs->TMR4ON){
+        pRegs->TMR4IF = 1;
+    }
+    // the small PIC sees the link lines, and may be driving data
+    pRegs->RA6 = SmallPic_Update(&pRegs->SmallPic, pRegs->LATA7, pRegs->LATA6,
+                                 pRegs->TRISA6 == 0);
+    pRegs->SP_TEAM = pRegs->SmallPic.Team;
+    pRegs->SP_LEDS = pRegs->SmallPic.Leds;
+    pRegs->SP_SERVO = pRegs->SmallPic.Servo;
+    pRegs->SP_WAVES = pRegs->SmallPic.Waves;
+    // watched outputs
+    if (OutputFunc != NULL){
+#define X(Name) \
+        if (pRegs->Name != pRegs->Shadow.Name){ \
+            OutputFunc(HOST_OUT_##Name, pRegs->Shadow.Name, pRegs->Name); \
+            pRegs->Shadow.Name = pRegs->Name; \
+        }
+        HOST_WATCHED
+#undef X
+    }
+}
+
+/* HostRegs_Receive: a byte arrives on the UART and the receive interrupt
+ * posts it to CommService. A sleeping chip misses it, unless WUE is set:
+ * then the start bit wakes it and the EUSART hands over 0x00 in its place.
+ */
+void HostRegs_Receive(uint8_t Byte)
+{
+    ES_Event ThisEvent;
+    if (pHostRegs->isAsleep){
+        if (!pHostRegs->WUE){
+            return;
+        }
+        pHostRegs->isAsleep = false;
+        pHostRegs->WUE = 0;
+        Byte = 0x00;
+    }
+    ThisEvent.EventType = ES_ReceivedByte;
+    ThisEvent.EventParam = Byte;
+    PostCommService(ThisEvent);
+}
+
+bool HostRegs_IsAsleep(void)
+{
+    return pHostRegs->isAsleep;
+}
+
+/* HostRegs_Elapse: Milliseconds pass awake with nothing for the firmware
+ * to do. Nothing polls then, but the ADC interrupts carry on, a scan every
+ * 2 ms or so: run the sequencer through one, so the readings are as fresh
+ * as the target's however many steps the firmware took before.
+ */
+void HostRegs_Elapse(uint32_t Milliseconds)
+{
+    if ((Milliseconds == 0) || pHostRegs->isAsleep){
+        return;
+    }
+    for (uint8_t i=0; i<ADC_NUM_CHANNELS; i++){
+        HostRegs_Poll();
+    }
+}
+
+/* HostRegs_SleepFor: up to Milliseconds pass with the chip asleep. Returns
+ * how many did before the watchdog woke it (clearing nTO), or Milliseconds
+ * if it slept throughout.
+ */
+uint32_t HostRegs_SleepFor(uint32_t Milliseconds)
+{
+    uint32_t Slept;
+    if (pHostRegs->WdtLeft > Milliseconds){
+        if (pHostRegs->WdtLeft != HOST_WDT_NEVER){
+            pHostRegs->WdtLeft -= Milliseconds;
+        }
+        return Milliseconds;
+    }
+    Slept = pHostRegs->WdtLeft;
+    pHostRegs->isAsleep = false;
+    pHostRegs->nTO = 0;
+    return Slept;
+}
+
+// HostRegs_Sleep: SLEEP. The watchdog period is 1 ms << WDTPS
+void HostRegs_Sleep(void)
+{
+    pHostRegs->nTO = 1;
+    pHostRegs->isAsleep = true;
+    pHostRegs->WdtLeft = pHostRegs->SWDTEN ? (1ul << ((pHostRegs->WDTCON >> 1) & 0x1f))
+                                           : HOST_WDT_NEVER;
+}
+
+/* HostReg_TRMT: the firmware polls TRMT after every TX1REG write, so this is
+ * where a transmitted byte leaves the chip. The shift register is always
+ * reported empty.
+ */
+volatile uint8_t *HostReg_TRMT(void)
+{
+    if (TxFunc != NULL){
+        TxFunc(pHostRegs->TX1REG);
+    }
+    pHostRegs->TRMT = 1;
+    return &pHostRegs->TRMT;
+}
+
+// HostReg_EEDATL: a read started with RD completes immediately
+volatile uint8_t *HostReg_EEDATL(void)
+{
+    if (pHostRegs->RD){
+        pHostRegs->EEDATL = pHostRegs->Eeprom[pHostRegs->EEADRL];
+        pHostRegs->RD = 0;
+    }
+    return &pHostRegs->EEDATL;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// ServiceAdc: what the interrupt routine does with Timer6 and the ADC
+static void ServiceAdc(HostRegs_t *pRegs){
+    if (pRegs->GIE && pRegs->PEIE && ((pRegs->ADIF && pRegs->ADIE)
+                                      || (pRegs->TMR6IF && pRegs->TMR6IE))){
+        ADC_ISR();
+    }
+}
@@ -0,0 +1,339 @@
+/****************************************************************************
+ Module
+   HostReplay.c
+
+ Description
+   Feeds a recorded UART trace into the host build of the firmware and
+   diffs what the craft does now against what it did when the trace was
+   captured.
+
+ Notes
+   Usage: replay [-v] [-x FACTOR] [-w WINDOW_MS] [-a ADC] trace
+     -v   print every frame and output change of the replay
+     -x   pace the replay in wall-clock time, FACTOR times faster than
+          the capture (1 = original timing); by default it runs on the
+          virtual clock as fast as it can
+     -w   how far apart in time a captured and a replayed event may be and
+          still count as the same event (default 50 ms)
+     -a   team resistor reading for the ADC (default 85, team 1)
+
+   The RX bytes of the trace drive the firmware. The TX frames, and the
+   outputs if the trace has them, are what the replay is diffed against:
+   "-" lines are in the capture but not the replay, "+" lines the other
+   way round. Captured outputs the host does not watch, such as queue
+   high-water marks, are left out of the diff. The trace is read one record at a time and only events
+   within the diff window are held, so a multi-hour trace replays in
+   constant memory.
+
+   Exit status: 0 if the replay matched, 1 if it differed, 2 on errors.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "HostRegs.h"
+#include "PacModel.h"
+#include "Trace.h"
+#include "CommService.h"
+#include "AdcSequencer.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define QUEUE_SIZE 128
+#define MAX_TEXT (3*PAC_MAX_FRAME + 16)
+#define DEFAULT_WINDOW_MS 50
+#define DEFAULT_ADC 85
+
+/*---------------------------- Module Types ---------------------------*/
+// one frame or output change, as text so captured and replayed ones compare
+typedef struct {
+    uint64_t Time;
+    char Text[MAX_TEXT];
+} DiffItem_t;
+
+typedef struct {
+    DiffItem_t Items[QUEUE_SIZE];
+    unsigned Head;
+    unsigned Count;
+} DiffQueue_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void RunUntil(uint64_t Time);
+static void OnTxByte(uint8_t Byte);
+static void OnOutput(uint8_t Index, uint8_t Old, uint8_t New);
+static void FormatFrame(char *pText, const uint8_t *pFrame, uint8_t Length);
+static void Push(DiffQueue_t *pQueue, uint64_t Time, const char *pText, char Side);
+static DiffItem_t *At(DiffQueue_t *pQueue, unsigned i);
+static void Pop(DiffQueue_t *pQueue, unsigned NumItems, char Side);
+static void Resolve(uint64_t Now, bool isFinal);
+static double WallNow(void);
+
+/*---------------------------- Module Variables ---------------------------*/
+static HostRegs_t Regs;
+static PacDecoder_t ReplayDecoder;
+static PacDecoder_t CaptureDecoder;
+static DiffQueue_t Captured;
+static DiffQueue_t Replayed;
+static Trace_t Trace;
+
+static bool isVerbose = false;
+static double Speed = 0;
+static uint64_t Window = DEFAULT_WINDOW_MS*1000ULL;
+static bool isDiffingTx;
+static bool isDiffingOutputs;
+static bool isWatched[TRACE_MAX_NAMES]; // by the trace's output index
+
+static unsigned long NumMatched;
+static unsigned long NumDiffs;
+static unsigned long NumLate;
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    TraceRecord_t Record;
+    int Option;
+    int Result;
+    double WallStart;
+    uint8_t AdcInput = DEFAULT_ADC;
+
+    while ((Option = getopt(argc, argv, "vx:w:a:")) != -1){
+        if (Option == 'v'){
+            isVerbose = true;
+        } else if (Option == 'x'){
+            Speed = atof(optarg);
+        } else if (Option == 'w'){
+            Window = strtoull(optarg, NULL, 0)*1000ULL;
+        } else if (Option == 'a'){
+            AdcInput = (uint8_t)strtoul(optarg, NULL, 0);
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 1){
+        fprintf(stderr, "usage: %s [-v] [-x FACTOR] [-w WINDOW_MS] [-a ADC] trace\n", argv[0]);
+        return 2;
+    }
+    if (!Trace_Open(&Trace, argv[optind])){
+        fprintf(stderr, "%s: not a trace\n", argv[optind]);
+        return 2;
+    }
+    isDiffingTx = (Trace.Flags & TRACE_HAS_TX) != 0;
+    isDiffingOutputs = (Trace.Flags & TRACE_HAS_OUTPUTS) != 0;
+    for (uint8_t i=0; i<Trace.NumNames; i++){
+        for (uint8_t j=0; j<NUM_HOST_WATCHED; j++){
+            isWatched[i] |= (strcmp(Trace.Names[i], HostRegs_WatchedNames[j]) == 0);
+        }
+    }
+
+    HostRegs_Reset(&Regs);
+    Regs.AdcInput[ADC_AN_TEAM] = AdcInput;
+    HostRegs_Select(&Regs);
+    HostRegs_SetCallbacks(OnTxByte, OnOutput);
+    Pac_ResetDecoder(&ReplayDecoder);
+    Pac_ResetDecoder(&CaptureDecoder);
+    ES_Timer_Reset();
+    ES_Initialize();
+    ES_RunUntilIdle();
+
+    WallStart = WallNow();
+    while ((Result = Trace_Read(&Trace, &Record)) == 1){
+        if (Speed > 0){
+            double Wait = WallStart + Record.Time*1e-6/Speed - WallNow();
+            if (Wait > 0){
+                struct timespec Delay = { (time_t)Wait, (long)((Wait - (time_t)Wait)*1e9) };
+                nanosleep(&Delay, NULL);
+            }
+        }
+        RunUntil(Record.Time);
+        if (Record.Type == TRACE_RX){
+            for (uint8_t i=0; i<Record.Length; i++){
+                HostRegs_Receive(Record.Data[i]);
+                ES_RunUntilIdle();
+            }
+        } else if ((Record.Type == TRACE_TX) && isDiffingTx){
+            for (uint8_t i=0; i<Record.Length; i++){
+                uint8_t Length = Pac_FeedDecoder(&CaptureDecoder, Record.Data[i]);
+                if (Length > 0){
+                    char Text[MAX_TEXT];
+                    FormatFrame(Text, CaptureDecoder.Buffer, Length);
+                    Push(&Captured, Record.Time, Text, '-');
+                }
+            }
+        } else if ((Record.Type == TRACE_OUTPUT) && isDiffingOutputs
+                   && isWatched[Record.Data[0]]){
+            char Text[MAX_TEXT];
+            snprintf(Text, sizeof(Text), "%s=%u", Trace.Names[Record.Data[0]], Record.Data[1]);
+            Push(&Captured, Record.Time, Text, '-');
+        }
+        Resolve(ES_Timer_GetTime32()*1000ULL, false);
+    }
+    // let anything the last input started play out
+    RunUntil(ES_Timer_GetTime32()*1000ULL + Window);
+    Resolve(ES_Timer_GetTime32()*1000ULL, true);
+    Trace_Close(&Trace);
+
+    printf("replayed %lu ms: %lu matched, %lu late, %lu differences\n",
+           (unsigned long)ES_Timer_GetTime32(), NumMatched, NumLate, NumDiffs);
+    if (Result < 0){
+        fprintf(stderr, "trace is corrupt after %lu ms\n", (unsigned long)ES_Timer_GetTime32());
+        return 2;
+    }
+    return (NumDiffs == 0) ? 0 : 1;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// RunUntil: bring the firmware's clock up to a trace time
+static void RunUntil(uint64_t Time)
+{
+    uint64_t Milliseconds = Time/1000;
+    if (Milliseconds > ES_Timer_GetTime32()){
+        ES_RunFor((uint32_t)(Milliseconds - ES_Timer_GetTime32()));
+    }
+}
+
+static void OnTxByte(uint8_t Byte)
+{
+    uint8_t Length = Pac_FeedDecoder(&ReplayDecoder, Byte);
+    char Text[MAX_TEXT];
+    if (Length == 0){
+        return;
+    }
+    FormatFrame(Text, ReplayDecoder.Buffer, Length);
+    if (isVerbose){
+        printf("[%7lu] %s\n", (unsigned long)ES_Timer_GetTime32(), Text);
+    }
+    if (isDiffingTx){
+        Push(&Replayed, ES_Timer_GetTime32()*1000ULL, Text, '+');
+    }
+}
+
+static void OnOutput(uint8_t Index, uint8_t Old, uint8_t New)
+{
+    char Text[MAX_TEXT];
+    snprintf(Text, sizeof(Text), "%s=%u", HostRegs_WatchedNames[Index], New);
+    if (isVerbose){
+        printf("[%7lu] %s\n", (unsigned long)ES_Timer_GetTime32(), Text);
+    }
+    if (isDiffingOutputs){
+        Push(&Replayed, ES_Timer_GetTime32()*1000ULL, Text, '+');
+    }
+}
+
+static void FormatFrame(char *pText, const uint8_t *pFrame, uint8_t Length)
+{
+    pText += sprintf(pText, "TX");
+    for (uint8_t i=0; i<Length; i++){
+        pText += sprintf(pText, " %02X", pFrame[i]);
+    }
+}
+
+// Push: a full queue means the other side has gone quiet; report the oldest
+static void Push(DiffQueue_t *pQueue, uint64_t Time, const char *pText, char Side)
+{
+    DiffItem_t *pItem;
+    if (pQueue->Count == QUEUE_SIZE){
+        Pop(pQueue, 1, Side);
+    }
+    pItem = At(pQueue, pQueue->Count);
+    pItem->Time = Time;
+    snprintf(pItem->Text, sizeof(pItem->Text), "%s", pText);
+    pQueue->Count++;
+}
+
+static DiffItem_t *At(DiffQueue_t *pQueue, unsigned i)
+{
+    return &pQueue->Items[(pQueue->Head + i) % QUEUE_SIZE];
+}
+
+// Pop: drop items that have no counterpart on the other side, reporting each
+static void Pop(DiffQueue_t *pQueue, unsigned NumItems, char Side)
+{
+    for (unsigned i=0; i<NumItems; i++){
+        DiffItem_t *pItem = At(pQueue, 0);
+        printf("%c [%7lu] %s\n", Side, (unsigned long)(pItem->Time/1000), pItem->Text);
+        NumDiffs++;
+        pQueue->Head = (pQueue->Head + 1) % QUEUE_SIZE;
+        pQueue->Count--;
+    }
+}
+
+/* Resolve: pair up captured and replayed events in order. An unmatched
+ * event is only reported once the window has passed without its
+ * counterpart showing up, or at the end of the trace.
+ */
+static void Resolve(uint64_t Now, bool isFinal)
+{
+    while ((Captured.Count > 0) || (Replayed.Count > 0)){
+        uint64_t Oldest;
+        if ((Captured.Count > 0) && (Replayed.Count > 0)
+                && (strcmp(At(&Captured, 0)->Text, At(&Replayed, 0)->Text) == 0)){
+            uint64_t CapturedTime = At(&Captured, 0)->Time;
+            uint64_t ReplayedTime = At(&Replayed, 0)->Time;
+            if (((CapturedTime > ReplayedTime) ? CapturedTime - ReplayedTime
+                    : ReplayedTime - CapturedTime) > Window){
+                printf("~ [%7lu -> %lu] %s\n", (unsigned long)(CapturedTime/1000),
+                       (unsigned long)(ReplayedTime/1000), At(&Captured, 0)->Text);
+                NumLate++;
+            }
+            Captured.Head = (Captured.Head + 1) % QUEUE_SIZE;
+            Captured.Count--;
+            Replayed.Head = (Replayed.Head + 1) % QUEUE_SIZE;
+            Replayed.Count--;
+            NumMatched++;
+            continue;
+        }
+        if (Captured.Count == 0){
+            Oldest = At(&Replayed, 0)->Time;
+        } else if (Replayed.Count == 0){
+            Oldest = At(&Captured, 0)->Time;
+        } else {
+            Oldest = At(&Captured, 0)->Time < At(&Replayed, 0)->Time
+                    ? At(&Captured, 0)->Time : At(&Replayed, 0)->Time;
+        }
+        if (!isFinal && (Now < Oldest + Window)){
+            return;
+        }
+        if (Captured.Count == 0){
+            Pop(&Replayed, 1, '+');
+        } else if (Replayed.Count == 0){
+            Pop(&Captured, 1, '-');
+        } else {
+            // look for the captured head further on in the replay, and the
+            // other way round, to tell an extra event from a missing one
+            unsigned Found = 0;
+            for (unsigned i=1; (i<Replayed.Count) && (Found == 0); i++){
+                if (strcmp(At(&Captured, 0)->Text, At(&Replayed, i)->Text) == 0){
+                    Found = i;
+                }
+            }
+            if (Found > 0){
+                Pop(&Replayed, Found, '+');
+                continue;
+            }
+            for (unsigned i=1; (i<Captured.Count) && (Found == 0); i++){
+                if (strcmp(At(&Replayed, 0)->Text, At(&Captured, i)->Text) == 0){
+                    Found = i;
+                }
+            }
+            if (Found > 0){
+                Pop(&Captured, Found, '-');
+                continue;
+            }
+            Pop(&Captured, 1, '-');
+            Pop(&Replayed, 1, '+');
+        }
+    }
+}
+
+static double WallNow(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec + Time.tv_nsec*1e-9;
+}
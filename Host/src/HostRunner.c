@@ -0,0 +1,820 @@
+/****************************************************************************
+ Module
+   HostRunner.c
+
+ Description
+   Runs the craft firmware on the host against a script of radio traffic
+   and pin inputs, printing every frame the craft transmits and every change
+   on its outputs.
+
+ Notes
+   Usage: runner [-q] [-r TRACE] [-s NAME=VALUE]... [-w NAME=FROM:TO:STEP] [script]
+          runner [-q] [-r TRACE] [-s NAME=VALUE]... [-a ADC] -t TTY
+     -q   print only the end-of-run summary
+     -r   record the UART traffic and outputs to a trace file (see Trace.h),
+          and at the end each service's queue high-water mark
+     -s   override a config value (see ConfigFields) before the script runs
+     -w   sweep: run the script once per value, each in a fresh process,
+          printing one summary line per run
+     -t   no script: the UART is the serial device TTY, typically the pty
+          of the PAC emulator, and the firmware runs in real time until
+          the other end hangs up
+     -a   team resistor reading for -t mode (default 85, team 1)
+   The script is read from stdin when no file is given.
+
+   Script time is virtual (see ES_RunFor), so runs are fast and repeatable.
+
+   Script commands, one per line, '#' starts a comment:
+     wait MS                  let MS milliseconds of firmware time pass
+     @TIME COMMAND...         wait until TIME ms after power-up, then run it
+     every MS COUNT CMD...    run CMD COUNT times, MS apart
+     adc VALUE                what the team resistor reads from now on
+     battery VALUE            what the battery divider reads (182 is 11.1 V)
+     current VALUE            what the motor current sense reads
+     pac MSB LSB [SEED]       address (hex) and key seed of the PAC model
+     pair TEAM [blue]         PAC sends a pair request
+     key                      PAC picks a new key and sends it
+     control DRIVE TURN SPEC  PAC sends an encrypted control frame
+     batch SPEC MS DRIVE TURN...
+                              PAC sends up to 8 DRIVE TURN commands in one
+                              batch, MS apart (a multiple of 10)
+     skip N                   PAC sends N control frames that get lost
+     config OFFSET HEX...     PAC sends an encrypted config write
+     recorder [rearm]         PAC asks for the flight recorder dump
+     rx HEX...                raw bytes arrive on the UART
+     replay N                 the Nth last frame the PAC sent (1 is the last,
+                              up to 8) arrives again, as someone listening
+                              in would play it back
+     stall CMD...             run CMD with the services held off, as when
+                              the higher priority queues are backed up:
+                              its bytes are posted but nothing runs until
+                              the next command
+     expect NAME VALUE        stop with an error unless an output matches
+     post SERVICE EVENT [PARAM]
+                              queue an event for a service (by priority)
+                              without running anything; EVENT and PARAM
+                              by number or by name (see EventNames)
+     runs RUN...              run until idle and stop with an error unless
+                              the next events the services ran are these,
+                              SERVICE:EVENT[:PARAM], in this order; a runs
+                              with nothing left to run picks up where the
+                              one before it stopped checking
+     dump                     print the state tables and row coverage
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "HostRegs.h"
+#include "PacModel.h"
+#include "Trace.h"
+#include "CommService.h"
+#include "PairingSM.h"
+#include "ConfigStore.h"
+#include "PowerManager.h"
+#include "AdcSequencer.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define MAX_LINE 256
+#define MAX_ARGS (PAC_MAX_FRAME + 4)
+#define MAX_OVERRIDES 8
+#define STATUS_TYPE 0x03       // RF message type of status frames
+#define UNPAIRED_NO_ERROR 0x00 // status codes, see CommService
+#define UNPAIRED_DEC_ERROR 0x02
+#define DEFAULT_ADC 85
+#define MAX_POLL_MS 100
+#define MAX_RUNS 64
+#define ANY_PARAM 0xffff // in a Run_t to check, matches every EventParam
+#define MAX_REPLAY 8
+
+typedef char AssertTraceNames[(NUM_HOST_WATCHED + NUM_SERVICES <= TRACE_MAX_NAMES) ? 1 : -1];
+
+/*---------------------------- Module Types ---------------------------*/
+// config values that can be overridden from the command line
+typedef struct {
+    const char *Name;
+    uint8_t Offset;
+    uint8_t Size;
+} ConfigField_t;
+
+typedef struct {
+    const ConfigField_t *pField;
+    uint16_t Value;
+} Override_t;
+
+// events and timers that can be posted or checked by name
+typedef struct {
+    const char *Name;
+    uint16_t Value;
+} Name_t;
+
+typedef struct {
+    uint8_t Service;
+    ES_Event Event;
+} Run_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static int RunScript(const Override_t *pOverrides, uint8_t NumOverrides);
+static int RunTty(const char *Path, const Override_t *pOverrides, uint8_t NumOverrides);
+static bool PowerUp(const Override_t *pOverrides, uint8_t NumOverrides);
+static bool StartRecording(const char *Path);
+static void RecordQueues(void);
+static void PrintSummary(double Start, const Override_t *pOverrides, uint8_t NumOverrides);
+static int Sweep(const char *Spec, const Override_t *pOverrides, uint8_t NumOverrides);
+static bool ParseOverride(const char *Spec, Override_t *pOverride);
+static const ConfigField_t *FindField(const char *Name, size_t Length);
+static bool ApplyOverride(const Override_t *pOverride);
+static void OnTxByte(uint8_t Byte);
+static void OnOutput(uint8_t Index, uint8_t Old, uint8_t New);
+static void Advance(uint32_t Milliseconds);
+static void SendFrame(const uint8_t *pFrame, uint8_t Length);
+static bool RunLine(char *Line);
+static bool RunCommand(int Argc, char **Argv);
+static bool ReadOutput(const char *Name, uint8_t *pValue);
+static bool ParseName(const char *Text, const Name_t *pNames, size_t NumNames, uint16_t *pValue);
+static bool ParseRun(char *Text, Run_t *pRun);
+static bool CheckRuns(int Argc, char **Argv);
+static void OnRun(uint8_t WhichService, const ES_Event *pEvent, bool isUrgent);
+static double Now(void);
+
+/*---------------------------- Module Variables ---------------------------*/
+static PacModel_t Pac;
+static PacDecoder_t Decoder;
+static HostRegs_t Regs;
+static unsigned LineNumber;
+
+#define NAME(x) { #x, x }
+static const Name_t EventNames[] = {
+    NAME(ES_TIMEOUT), NAME(ES_NEW_PACKET), NAME(ES_MANUAL_UNPAIR), NAME(ES_DECRYPT_ERROR),
+    NAME(ES_DRIVE_COMMAND), NAME(ES_LiftFan), NAME(ES_TELEMETRY), NAME(ES_STATUS3),
+};
+static const Name_t TimerNames[] = {
+    NAME(MC_TIMER), NAME(PAIR_TIMER), NAME(XMIT_TIMER), NAME(ADC_TIMER), NAME(RESUME_TIMER),
+};
+#undef NAME
+
+static const ConfigField_t ConfigFields[] = {
+    { "PairTimeout",   offsetof(Config_t, PairTimeout),   2 },
+    { "XmitTimeout",   offsetof(Config_t, XmitTimeout),   2 },
+    { "ResumeWindow",  offsetof(Config_t, ResumeWindow),  1 },
+    { "MaxResumeSkip", offsetof(Config_t, MaxResumeSkip), 1 },
+};
+
+static char **ScriptLines;
+static unsigned NumScriptLines;
+static bool isQuiet = false;
+static Trace_t Recording;
+static bool isRecording = false;
+static bool isStalled = false;  // stall: post received bytes without running
+static int TtyFd = -1;       // -t mode: where transmitted bytes go
+
+// replay: the frames the PAC sent last, Sent[NumSent % MAX_REPLAY] next
+static uint8_t Sent[MAX_REPLAY][PAC_MAX_FRAME];
+static uint8_t SentLength[MAX_REPLAY];
+static unsigned NumSent;
+
+// runs: what the services ran, in order, and how much has been checked
+static Run_t Runs[MAX_RUNS];
+static unsigned NumRuns;
+static unsigned NumChecked;
+
+// run summary
+static unsigned NumTxFrames;
+static unsigned NumUnpairs;
+static uint32_t FirstUnpair;
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    FILE *pScript = stdin;
+    char Line[MAX_LINE];
+    Override_t Overrides[MAX_OVERRIDES + 1]; // room for the swept value
+    uint8_t NumOverrides = 0;
+    const char *SweepSpec = NULL;
+    const char *TracePath = NULL;
+    const char *TtyPath = NULL;
+    int Option;
+    int Result;
+
+    HostRegs_Reset(&Regs);
+    Regs.AdcInput[ADC_AN_TEAM] = DEFAULT_ADC;
+    while ((Option = getopt(argc, argv, "qr:s:w:t:a:")) != -1){
+        if (Option == 'q'){
+            isQuiet = true;
+        } else if (Option == 'r'){
+            TracePath = optarg;
+        } else if ((Option == 's') && (NumOverrides < MAX_OVERRIDES)
+                && ParseOverride(optarg, &Overrides[NumOverrides])){
+            NumOverrides++;
+        } else if (Option == 'w'){
+            SweepSpec = optarg;
+        } else if (Option == 't'){
+            TtyPath = optarg;
+        } else if (Option == 'a'){
+            Regs.AdcInput[ADC_AN_TEAM] = (uint8_t)strtoul(optarg, NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [-q] [-r TRACE] [-s NAME=VALUE]... "
+                    "[-w NAME=FROM:TO:STEP] [script]\n"
+                    "       %s [-q] [-r TRACE] [-s NAME=VALUE]... [-a ADC] -t TTY\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (TtyPath != NULL){
+        // no script to read
+    } else if (optind < argc){
+        pScript = fopen(argv[optind], "r");
+        if (pScript == NULL){
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    // keep the script in memory, a sweep replays it many times
+    while (fgets(Line, sizeof(Line), pScript) != NULL){
+        ScriptLines = realloc(ScriptLines, (NumScriptLines + 1)*sizeof(char *));
+        ScriptLines[NumScriptLines++] = strdup(Line);
+    }
+    if (SweepSpec != NULL){
+        return Sweep(SweepSpec, Overrides, NumOverrides);
+    }
+    if ((TracePath != NULL) && !StartRecording(TracePath)){
+        perror(TracePath);
+        return 1;
+    }
+    if (TtyPath != NULL){
+        Result = RunTty(TtyPath, Overrides, NumOverrides);
+    } else {
+        Result = RunScript(Overrides, NumOverrides);
+    }
+    if (isRecording){
+        RecordQueues();
+        if (!Trace_Close(&Recording)){
+            perror(TracePath);
+            return 1;
+        }
+    }
+    return Result;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// RunScript: power up the craft, run the whole script and print a summary
+static int RunScript(const Override_t *pOverrides, uint8_t NumOverrides)
+{
+    double Start = Now();
+    if (!PowerUp(pOverrides, NumOverrides)){
+        return 1;
+    }
+    for (LineNumber=1; LineNumber<=NumScriptLines; LineNumber++){
+        char Line[MAX_LINE];
+        strcpy(Line, ScriptLines[LineNumber - 1]);
+        if (!RunLine(Line)){
+            return 1;
+        }
+    }
+    PrintSummary(Start, pOverrides, NumOverrides);
+    return 0;
+}
+
+/* RunTty: real-time mode. Bytes read from the tty go to CommService as they
+ * arrive, transmitted bytes are written back, and the virtual clock is
+ * kept in step with the wall clock.
+ */
+static int RunTty(const char *Path, const Override_t *pOverrides, uint8_t NumOverrides)
+{
+    struct termios Settings;
+    double Start = Now();
+    double Last;
+
+    TtyFd = open(Path, O_RDWR | O_NOCTTY);
+    if (TtyFd < 0){
+        perror(Path);
+        return 1;
+    }
+    if (tcgetattr(TtyFd, &Settings) == 0){
+        cfmakeraw(&Settings);
+        tcsetattr(TtyFd, TCSANOW, &Settings);
+    }
+    if (!PowerUp(pOverrides, NumOverrides)){
+        return 1;
+    }
+    Last = Now();
+    for (;;){
+        struct pollfd Poll = { TtyFd, POLLIN, 0 };
+        uint32_t Next = ES_Timer_NextExpiry();
+        uint32_t Elapsed;
+        int Ready = poll(&Poll, 1, (Next < MAX_POLL_MS) ? (int)Next : MAX_POLL_MS);
+        // whole milliseconds of wall time go to the firmware, the rest waits
+        Elapsed = (uint32_t)((Now() - Last)*1e3);
+        if (Elapsed > 0){
+            ES_RunFor(Elapsed);
+            Last += Elapsed*1e-3;
+        }
+        if ((Ready > 0) && (Poll.revents & POLLIN)){
+            uint8_t Bytes[64];
+            ssize_t NumBytes = read(TtyFd, Bytes, sizeof(Bytes));
+            if (NumBytes <= 0){
+                break;
+            }
+            SendFrame(Bytes, (uint8_t)NumBytes);
+        } else if ((Ready > 0) && (Poll.revents & (POLLHUP | POLLERR))){
+            break;
+        }
+    }
+    close(TtyFd);
+    TtyFd = -1;
+    PrintSummary(Start, pOverrides, NumOverrides);
+    return 0;
+}
+
+// PowerUp: reset the register file and framework and start the services;
+// the analog inputs keep reading what they did
+static bool PowerUp(const Override_t *pOverrides, uint8_t NumOverrides)
+{
+    uint8_t AdcInput[HOST_ADC_INPUTS];
+    memcpy(AdcInput, Regs.AdcInput, sizeof(AdcInput));
+    HostRegs_Reset(&Regs);
+    memcpy(Regs.AdcInput, AdcInput, sizeof(AdcInput));
+    HostRegs_Select(&Regs);
+    HostRegs_SetCallbacks(OnTxByte, OnOutput);
+    Pac_Init(&Pac, 0x21, 0x82, 1);
+    Pac_ResetDecoder(&Decoder);
+    ES_Timer_Reset();
+    if (ES_Initialize() != Success){
+        fprintf(stderr, "framework failed to initialize\n");
+        return false;
+    }
+    for (uint8_t i=0; i<NumOverrides; i++){
+        if (!ApplyOverride(&pOverrides[i])){
+            fprintf(stderr, "config turned down %s=%u\n", pOverrides[i].pField->Name,
+                    pOverrides[i].Value);
+            return false;
+        }
+    }
+    ES_RunUntilIdle();
+    return true;
+}
+
+// StartRecording: the trace names the watched outputs, then the queues
+static bool StartRecording(const char *Path)
+{
+    static char QueueNames[NUM_SERVICES][TRACE_MAX_NAME + 1];
+    const char *Names[NUM_HOST_WATCHED + NUM_SERVICES];
+    for (uint8_t i=0; i<NUM_HOST_WATCHED; i++){
+        Names[i] = HostRegs_WatchedNames[i];
+    }
+    for (uint8_t i=0; i<NUM_SERVICES; i++){
+        snprintf(QueueNames[i], sizeof(QueueNames[i]), TRACE_QUEUE_PREFIX "%s",
+                 ES_GetServiceName(i));
+        Names[NUM_HOST_WATCHED + i] = QueueNames[i];
+    }
+    isRecording = Trace_Create(&Recording, Path, TRACE_HAS_RX | TRACE_HAS_TX | TRACE_HAS_OUTPUTS,
+                               Names, NUM_HOST_WATCHED + NUM_SERVICES);
+    return isRecording;
+}
+
+static void RecordQueues(void)
+{
+    for (uint8_t i=0; i<NUM_SERVICES; i++){
+        Trace_WriteOutput(&Recording, ES_Timer_GetTime32()*1000ULL, NUM_HOST_WATCHED + i,
+                          ES_GetQueueHighWater(i));
+    }
+}
+
+static void PrintSummary(double Start, const Override_t *pOverrides, uint8_t NumOverrides)
+{
+    for (uint8_t i=0; i<NumOverrides; i++){
+        printf("%s=%u ", pOverrides[i].pField->Name, pOverrides[i].Value);
+    }
+    printf("end=%lu tx=%u unpairs=%u first_unpair=", (unsigned long)ES_Timer_GetTime32(),
+           NumTxFrames, NumUnpairs);
+    if (NumUnpairs > 0){
+        printf("%lu", (unsigned long)FirstUnpair);
+    } else {
+        printf("-");
+    }
+    // asleep is exact here, the firmware's own figure is an estimate
+    printf(" lost_posts=%u awake_ms=%lu asleep_ms=%lu pm_asleep_ms=%lu wall_ms=%.2f\n",
+           ES_GetPostFailures(), (unsigned long)getPMAwakeMs(),
+           (unsigned long)(ES_Timer_GetTime32() - getPMAwakeMs()),
+           (unsigned long)getPMSleepMs(), (Now() - Start)*1e3);
+}
+
+/* Sweep: rerun the script for every value of one config field. The firmware
+ * runs from its single-craft contexts here, so each run gets a fresh process.
+ */
+static int Sweep(const char *Spec, const Override_t *pOverrides, uint8_t NumOverrides)
+{
+    const char *pEquals = strchr(Spec, '=');
+    const ConfigField_t *pField;
+    unsigned long From, To, Step;
+    Override_t RunOverrides[MAX_OVERRIDES + 1];
+    int Failures = 0;
+
+    if ((pEquals == NULL) || ((pField = FindField(Spec, pEquals - Spec)) == NULL)
+            || (sscanf(pEquals + 1, "%lu:%lu:%lu", &From, &To, &Step) != 3) || (Step == 0)){
+        fprintf(stderr, "bad sweep '%s'\n", Spec);
+        return 1;
+    }
+    memcpy(RunOverrides, pOverrides, NumOverrides*sizeof(Override_t));
+    isQuiet = true;
+    for (unsigned long Value=From; Value<=To; Value+=Step){
+        pid_t Child;
+        int Status;
+        RunOverrides[NumOverrides].pField = pField;
+        RunOverrides[NumOverrides].Value = (uint16_t)Value;
+        fflush(stdout);
+        Child = fork();
+        if (Child == 0){
+            exit(RunScript(RunOverrides, NumOverrides + 1));
+        }
+        if ((Child < 0) || (waitpid(Child, &Status, 0) < 0)
+                || !WIFEXITED(Status) || (WEXITSTATUS(Status) != 0)){
+            printf("%s=%lu failed\n", pField->Name, Value);
+            Failures++;
+        }
+    }
+    return (Failures == 0) ? 0 : 2;
+}
+
+static bool ParseOverride(const char *Spec, Override_t *pOverride)
+{
+    const char *pEquals = strchr(Spec, '=');
+    if (pEquals == NULL){
+        return false;
+    }
+    pOverride->pField = FindField(Spec, pEquals - Spec);
+    pOverride->Value = (uint16_t)strtoul(pEquals + 1, NULL, 0);
+    return (pOverride->pField != NULL);
+}
+
+static const ConfigField_t *FindField(const char *Name, size_t Length)
+{
+    for (uint8_t i=0; i<sizeof(ConfigFields)/sizeof(ConfigFields[0]); i++){
+        if ((strlen(ConfigFields[i].Name) == Length)
+                && (strncmp(ConfigFields[i].Name, Name, Length) == 0)){
+            return &ConfigFields[i];
+        }
+    }
+    fprintf(stderr, "unknown config field '%.*s'\n", (int)Length, Name);
+    return NULL;
+}
+
+// ApplyOverride: the same path a config write over the radio takes
+// returns false if ConfigStore turned the value down
+static bool ApplyOverride(const Override_t *pOverride)
+{
+    uint8_t Bytes[2];
+    if (pOverride->pField->Size == 1){
+        Bytes[0] = (uint8_t)pOverride->Value;
+    } else {
+        memcpy(Bytes, &pOverride->Value, sizeof(Bytes));
+    }
+    return UpdateConfig(pOverride->pField->Offset, Bytes, pOverride->pField->Size);
+}
+
+// RunLine: run one script line, handling the @TIME and every prefixes
+static bool RunLine(char *Line)
+{
+    char *Args[MAX_ARGS];
+    char **Argv = Args;
+    int Argc = 0;
+    char *pComment = strchr(Line, '#');
+    if (pComment != NULL){
+        *pComment = '\0';
+    }
+    for (char *pTok = strtok(Line, " \t\r\n"); (pTok != NULL) && (Argc < MAX_ARGS);
+            pTok = strtok(NULL, " \t\r\n")){
+        Argv[Argc++] = pTok;
+    }
+    if (Argc == 0){
+        return true;
+    }
+    if (Argv[0][0] == '@'){
+        uint32_t At = strtoul(&Argv[0][1], NULL, 0);
+        if (At < ES_Timer_GetTime32()){
+            fprintf(stderr, "line %u: @%lu is in the past\n", LineNumber, (unsigned long)At);
+            return false;
+        }
+        Advance(At - ES_Timer_GetTime32());
+        // and run the rest of the line as a command of its own
+        Argc--;
+        Argv++;
+        if (Argc == 0){
+            return true;
+        }
+    }
+    if ((strcmp(Argv[0], "every") == 0) && (Argc > 3)){
+        uint32_t Period = strtoul(Argv[1], NULL, 0);
+        uint32_t Count = strtoul(Argv[2], NULL, 0);
+        for (uint32_t i=0; i<Count; i++){
+            if (!RunCommand(Argc - 3, &Argv[3])){
+                fprintf(stderr, "line %u: bad command '%s'\n", LineNumber, Argv[3]);
+                return false;
+            }
+            Advance(Period);
+        }
+        return true;
+    }
+    if (!RunCommand(Argc, Argv)){
+        fprintf(stderr, "line %u: bad command '%s'\n", LineNumber, Argv[0]);
+        return false;
+    }
+    return true;
+}
+
+static bool RunCommand(int Argc, char **Argv)
+{
+    uint8_t Frame[PAC_MAX_FRAME];
+    uint8_t Length = 0;
+    const char *Cmd = Argv[0];
+
+    if ((strcmp(Cmd, "wait") == 0) && (Argc == 2)){
+        Advance(strtoul(Argv[1], NULL, 0));
+    } else if ((strcmp(Cmd, "adc") == 0) && (Argc == 2)){
+        Regs.AdcInput[ADC_AN_TEAM] = (uint8_t)strtoul(Argv[1], NULL, 0);
+    } else if ((strcmp(Cmd, "battery") == 0) && (Argc == 2)){
+        Regs.AdcInput[ADC_AN_BATTERY] = (uint8_t)strtoul(Argv[1], NULL, 0);
+    } else if ((strcmp(Cmd, "current") == 0) && (Argc == 2)){
+        Regs.AdcInput[ADC_AN_CURRENT] = (uint8_t)strtoul(Argv[1], NULL, 0);
+    } else if ((strcmp(Cmd, "pac") == 0) && (Argc >= 3)){
+        Pac_Init(&Pac, (uint8_t)strtoul(Argv[1], NULL, 16), (uint8_t)strtoul(Argv[2], NULL, 16),
+                 (Argc > 3) ? strtoul(Argv[3], NULL, 0) : 1);
+    } else if ((strcmp(Cmd, "pair") == 0) && (Argc >= 2)){
+        Length = Pac_PairRequest(&Pac, (uint8_t)strtoul(Argv[1], NULL, 0),
+                                 (Argc > 2) && (strcmp(Argv[2], "blue") == 0), Frame);
+    } else if ((strcmp(Cmd, "key") == 0) && (Argc == 1)){
+        Length = Pac_KeyFrame(&Pac, Frame);
+    } else if ((strcmp(Cmd, "control") == 0) && (Argc == 4)){
+        Length = Pac_ControlFrame(&Pac, (int8_t)strtol(Argv[1], NULL, 0),
+                                  (int8_t)strtol(Argv[2], NULL, 0),
+                                  (uint8_t)strtoul(Argv[3], NULL, 0), Frame);
+    } else if ((strcmp(Cmd, "batch") == 0) && (Argc >= 5) && (Argc % 2 == 1)){
+        BatchCommand_t Commands[CTRL_BATCH_MAX];
+        uint8_t Count = 0;
+        uint32_t Step = strtoul(Argv[2], NULL, 0) / BATCH_TICK_MS;
+        for (int i=3; (i<Argc) && (Count<CTRL_BATCH_MAX); i+=2){
+            Commands[Count].Drive = (uint8_t)strtol(Argv[i], NULL, 0);
+            Commands[Count].Turn = (uint8_t)strtol(Argv[i + 1], NULL, 0);
+            Commands[Count].At = (uint8_t)(Count*Step);
+            Count++;
+        }
+        Length = Pac_ControlBatch(&Pac, Commands, Count, (uint8_t)strtoul(Argv[1], NULL, 0), Frame);
+    } else if ((strcmp(Cmd, "skip") == 0) && (Argc == 2)){
+        Pac_Skip(&Pac, (uint8_t)strtoul(Argv[1], NULL, 0));
+    } else if ((strcmp(Cmd, "config") == 0) && (Argc >= 3)){
+        uint8_t Data[RECV_BUFFER_SIZE];
+        uint8_t NumData = 0;
+        for (int i=2; (i<Argc) && (NumData<sizeof(Data)); i++){
+            Data[NumData++] = (uint8_t)strtoul(Argv[i], NULL, 16);
+        }
+        Length = Pac_ConfigFrame(&Pac, (uint8_t)strtoul(Argv[1], NULL, 0), Data, NumData, Frame);
+    } else if ((strcmp(Cmd, "recorder") == 0) && (Argc <= 2)){
+        Length = Pac_DumpRequest(&Pac, (Argc == 2) && (strcmp(Argv[1], "rearm") == 0), Frame);
+    } else if ((strcmp(Cmd, "rx") == 0) && (Argc >= 2)){
+        for (int i=1; (i<Argc) && (Length<sizeof(Frame)); i++){
+            Frame[Length++] = (uint8_t)strtoul(Argv[i], NULL, 16);
+        }
+    } else if ((strcmp(Cmd, "replay") == 0) && (Argc == 2)){
+        unsigned Back = strtoul(Argv[1], NULL, 0);
+        if ((Back == 0) || (Back > MAX_REPLAY) || (Back > NumSent)){
+            return false;
+        }
+        Back = (NumSent - Back) % MAX_REPLAY;
+        SendFrame(Sent[Back], SentLength[Back]);
+        return true;
+    } else if ((strcmp(Cmd, "stall") == 0) && (Argc > 1)){
+        bool Result;
+        isStalled = true;
+        Result = RunCommand(Argc - 1, &Argv[1]);
+        isStalled = false;
+        return Result;
+    } else if ((strcmp(Cmd, "expect") == 0) && (Argc == 3)){
+        uint8_t Value;
+        if (!ReadOutput(Argv[1], &Value)){
+            return false;
+        }
+        if (Value != (uint8_t)strtoul(Argv[2], NULL, 0)){
+            fprintf(stderr, "line %u: %s is %u, expected %s\n",
+                    LineNumber, Argv[1], Value, Argv[2]);
+            exit(2);
+        }
+    } else if ((strcmp(Cmd, "post") == 0) && ((Argc == 3) || (Argc == 4))){
+        uint16_t Type;
+        uint16_t Param = 0;
+        ES_Event ThisEvent;
+        if (!ParseName(Argv[2], EventNames, sizeof(EventNames)/sizeof(EventNames[0]), &Type)
+                || ((Argc == 4) && !ParseName(Argv[3], TimerNames,
+                                               sizeof(TimerNames)/sizeof(TimerNames[0]), &Param))){
+            return false;
+        }
+        ThisEvent.EventType = (ES_EventTyp_t)Type;
+        ThisEvent.EventParam = Param;
+        if (!ES_PostToService((uint8_t)strtoul(Argv[1], NULL, 0), ThisEvent)){
+            fprintf(stderr, "line %u: service %s has no room for %s\n", LineNumber, Argv[1], Argv[2]);
+            exit(2);
+        }
+    } else if ((strcmp(Cmd, "runs") == 0) && (Argc > 1)){
+        return CheckRuns(Argc - 1, &Argv[1]);
+    } else if ((strcmp(Cmd, "dump") == 0) && (Argc == 1)){
+        printf("table,row,state,event,guard,action,next,hits\n");
+        DumpCommService();
+        DumpPairingSM();
+    } else {
+        return false;
+    }
+    if (Length > 0){
+        memcpy(Sent[NumSent % MAX_REPLAY], Frame, Length);
+        SentLength[NumSent % MAX_REPLAY] = Length;
+        NumSent++;
+        SendFrame(Frame, Length);
+    }
+    return true;
+}
+
+static void Advance(uint32_t Milliseconds)
+{
+    ES_RunFor(Milliseconds);
+}
+
+// SendFrame: hand the bytes to CommService the way the receive interrupt does
+static void SendFrame(const uint8_t *pFrame, uint8_t Length)
+{
+    for (uint8_t i=0; i<Length; i++){
+        if (isRecording){
+            Trace_WriteByte(&Recording, TRACE_RX, ES_Timer_GetTime32()*1000ULL, pFrame[i]);
+        }
+        HostRegs_Receive(pFrame[i]);
+        if (!isStalled){
+            ES_RunUntilIdle();
+        }
+    }
+}
+
+static void OnTxByte(uint8_t Byte)
+{
+    uint8_t Length = Pac_FeedDecoder(&Decoder, Byte);
+    PacStatus_t Status;
+    if (isRecording){
+        Trace_WriteByte(&Recording, TRACE_TX, ES_Timer_GetTime32()*1000ULL, Byte);
+    }
+    if ((TtyFd >= 0) && (write(TtyFd, &Byte, 1) != 1)){
+        perror("tty");
+    }
+    if (Length == 0){
+        return;
+    }
+    NumTxFrames++;
+    if (Pac_ParseStatus(Decoder.Buffer, Length, &Status) && (Status.Type == STATUS_TYPE)
+            && ((Status.Code == UNPAIRED_NO_ERROR) || (Status.Code == UNPAIRED_DEC_ERROR))){
+        if (NumUnpairs++ == 0){
+            FirstUnpair = ES_Timer_GetTime32();
+        }
+    }
+    if (isQuiet){
+        return;
+    }
+    printf("[%7lu] TX", (unsigned long)ES_Timer_GetTime32());
+    for (uint8_t i=0; i<Length; i++){
+        printf(" %02X", Decoder.Buffer[i]);
+    }
+    if (Pac_ParseStatus(Decoder.Buffer, Length, &Status)){
+        printf("  (to %02X%02X type %u code %u)", Status.DestMSB, Status.DestLSB,
+               Status.Type, Status.Code);
+    } else {
+        printf("  (malformed)");
+    }
+    printf("\n");
+}
+
+static void OnOutput(uint8_t Index, uint8_t Old, uint8_t New)
+{
+    if (isRecording){
+        Trace_WriteOutput(&Recording, ES_Timer_GetTime32()*1000ULL, Index, New);
+    }
+    if (isQuiet){
+        return;
+    }
+    printf("[%7lu] %-8s %3u -> %u\n", (unsigned long)ES_Timer_GetTime32(),
+           HostRegs_WatchedNames[Index], Old, New);
+}
+
+static bool ReadOutput(const char *Name, uint8_t *pValue)
+{
+#define X(Reg) \
+    if (strcmp(Name, #Reg) == 0){ \
+        *pValue = Regs.Reg; \
+        return true; \
+    }
+    HOST_WATCHED
+#undef X
+    return false;
+}
+
+// ParseName: a number, or one of the names in the list
+static bool ParseName(const char *Text, const Name_t *pNames, size_t NumNames, uint16_t *pValue)
+{
+    char *pEnd;
+    unsigned long Value = strtoul(Text, &pEnd, 0);
+    if ((*Text != '\0') && (*pEnd == '\0')){
+        *pValue = (uint16_t)Value;
+        return true;
+    }
+    for (size_t i=0; i<NumNames; i++){
+        if (strcmp(Text, pNames[i].Name) == 0){
+            *pValue = pNames[i].Value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ParseRun: SERVICE:EVENT[:PARAM], a PARAM left out matches any
+static bool ParseRun(char *Text, Run_t *pRun)
+{
+    char *pEvent = strchr(Text, ':');
+    char *pParam;
+    uint16_t Value;
+    if (pEvent == NULL){
+        return false;
+    }
+    *pEvent++ = '\0';
+    pParam = strchr(pEvent, ':');
+    if (pParam != NULL){
+        *pParam++ = '\0';
+    }
+    pRun->Service = (uint8_t)strtoul(Text, NULL, 0);
+    if (!ParseName(pEvent, EventNames, sizeof(EventNames)/sizeof(EventNames[0]), &Value)){
+        return false;
+    }
+    pRun->Event.EventType = (ES_EventTyp_t)Value;
+    pRun->Event.EventParam = ANY_PARAM;
+    return (pParam == NULL)
+           || ParseName(pParam, TimerNames, sizeof(TimerNames)/sizeof(TimerNames[0]),
+                        &pRun->Event.EventParam);
+}
+
+/* CheckRuns: run until idle, logging what each service is handed, then
+ * compare the runs not checked yet with the ones expected
+ */
+static bool CheckRuns(int Argc, char **Argv)
+{
+    if (NumChecked == NumRuns){
+        NumRuns = 0;
+        NumChecked = 0;
+    }
+    ES_SetRunHook(OnRun);
+    ES_RunUntilIdle();
+    ES_SetRunHook(NULL);
+    for (int i=0; i<Argc; i++){
+        Run_t Want;
+        const Run_t *pRan = &Runs[NumChecked];
+        char Text[MAX_LINE];
+        // ParseRun takes the text apart, keep it whole for the message
+        strcpy(Text, Argv[i]);
+        if (!ParseRun(Text, &Want)){
+            return false;
+        }
+        if ((NumChecked == NumRuns) || (pRan->Service != Want.Service)
+                || (pRan->Event.EventType != Want.Event.EventType)
+                || ((Want.Event.EventParam != ANY_PARAM)
+                    && (pRan->Event.EventParam != Want.Event.EventParam))){
+            fprintf(stderr, "line %u: expected %s, ran", LineNumber, Argv[i]);
+            for (unsigned j=NumChecked; j<NumRuns; j++){
+                fprintf(stderr, " %u:%u:%u", Runs[j].Service, Runs[j].Event.EventType,
+                        Runs[j].Event.EventParam);
+            }
+            fprintf(stderr, "\n");
+            exit(2);
+        }
+        NumChecked++;
+    }
+    return true;
+}
+
+// OnRun: the run hook while CheckRuns runs the services
+static void OnRun(uint8_t WhichService, const ES_Event *pEvent, bool isUrgent)
+{
+    if (NumRuns < MAX_RUNS){
+        Runs[NumRuns].Service = WhichService;
+        Runs[NumRuns].Event = *pEvent;
+        NumRuns++;
+    }
+}
+
+static double Now(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec + Time.tv_nsec*1e-9;
+}
@@ -0,0 +1,345 @@
+/****************************************************************************
+ Module
+   PacEmulator.c
+
+ Description
+   Stands in for a PAC and its XBee on a pseudo-terminal, so the host build
+   of the firmware (runner -t) can be paired and driven end to end, and the
+   link measured.
+
+ Notes
+   Usage: pacemu [options]
+     -r HZ        control packet rate (default 5)
+     -l LOSS      fraction of control packets the radio loses (default 0)
+     -j MS        send jitter, +/- MS around the nominal time (default 0)
+     -d SECONDS   how long to drive before reporting (default 10)
+     -T TEAM      team number to pair with (default 0), -b for blue
+     -D DRIVE     drive byte to send (default 64), -U TURN turn byte
+     -a MSBLSB    our address in hex (default 2182)
+     -s SEED      seed for the key, loss and jitter (default 1)
+     -k           print every frame received
+
+   The emulator prints the pty's name, then waits for the firmware to
+   open it (a Linux pty master reports a hangup until its slave is open). It retries the pair request every PAIR_RETRY_MS until the craft
+   acknowledges, sends a key, then streams control packets. The craft
+   echoes the encrypted checksum byte of every control packet in its
+   STATUS reply, which is how a reply is matched to the packet it
+   acknowledges for the round-trip time. Lost packets are encrypted but
+   never written, so the craft's DecryptCounter has to resync as it would
+   over a real radio. When the craft unpairs, the emulator pairs again
+   from the next address up, since the craft turns away the PAC it was
+   last paired with.
+
+   The report gives the time to pair, the time from the first pair request
+   until the first acknowledged nonzero drive command, and round-trip
+   statistics.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#define _GNU_SOURCE // posix_openpt and cfmakeraw
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include "PacModel.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define PAIR_RETRY_MS 500
+#define KEY_RETRY_MS 1000
+#define STATUS_TYPE 0x03
+#define PAIRED 0x01        // status codes, see CommService
+#define UNPAIRED 0x00
+#define UNPAIRED_DEC_ERROR 0x02
+#define CHECKSUM_SLOTS 256
+
+/*---------------------------- Module Types ---------------------------*/
+typedef enum { Pairing, Keying, Driving } EmuState_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static int OpenPty(void);
+static void WaitForSlave(void);
+static void Send(const uint8_t *pFrame, uint8_t Length);
+static void HandleFrame(const uint8_t *pFrame, uint8_t Length);
+static void StartPairing(void);
+static double Random(void);
+static double Now(void);
+static int CompareDoubles(const void *pA, const void *pB);
+static void Report(void);
+
+/*---------------------------- Module Variables ---------------------------*/
+static int MasterFd;
+static PacModel_t Pac;
+static PacDecoder_t Decoder;
+static EmuState_t State = Pairing;
+static double NextSend;    // when the next frame goes out
+static uint32_t RandomState = 1;
+
+// settings
+static double Rate = 5;
+static double Loss = 0;
+static double Jitter = 0;
+static double Duration = 10;
+static uint8_t Team = 0;
+static bool isBlue = false;
+static int8_t Drive = 64;
+static int8_t Turn = 0;
+static bool isVerbose = false;
+
+// measurements
+static double Start;
+static double FirstPairRequest = -1;
+static double Paired = -1;
+static double FirstDrive = -1;
+static double SentAt[CHECKSUM_SLOTS]; // send time by encrypted checksum, < 0 if none
+static double *RoundTrips;
+static unsigned long NumRoundTrips;
+static unsigned long NumSent;
+static unsigned long NumLost;
+static unsigned long NumStatus;
+static unsigned long NumUnmatched;
+static unsigned long NumUnpairs;
+static unsigned long NumDecryptErrors;
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    int Option;
+    uint16_t Address = 0x2182;
+    double Period;
+
+    while ((Option = getopt(argc, argv, "r:l:j:d:T:bD:U:a:s:k")) != -1){
+        switch (Option){
+            case 'r': Rate = atof(optarg); break;
+            case 'l': Loss = atof(optarg); break;
+            case 'j': Jitter = atof(optarg)*1e-3; break;
+            case 'd': Duration = atof(optarg); break;
+            case 'T': Team = (uint8_t)atoi(optarg); break;
+            case 'b': isBlue = true; break;
+            case 'D': Drive = (int8_t)atoi(optarg); break;
+            case 'U': Turn = (int8_t)atoi(optarg); break;
+            case 'a': Address = (uint16_t)strtoul(optarg, NULL, 16); break;
+            case 's': RandomState = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'k': isVerbose = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-r HZ] [-l LOSS] [-j MS] [-d SECONDS] [-T TEAM] [-b]"
+                        " [-D DRIVE] [-U TURN] [-a MSBLSB] [-s SEED] [-k]\n", argv[0]);
+                return 1;
+        }
+    }
+    if ((Rate <= 0) || (RandomState == 0)){
+        fprintf(stderr, "rate and seed must be nonzero\n");
+        return 1;
+    }
+    Period = 1.0/Rate;
+    for (int i=0; i<CHECKSUM_SLOTS; i++){
+        SentAt[i] = -1;
+    }
+    MasterFd = OpenPty();
+    if (MasterFd < 0){
+        return 1;
+    }
+    Pac_Init(&Pac, Address >> 8, Address & 0xFF, RandomState);
+    Pac_ResetDecoder(&Decoder);
+    RoundTrips = malloc(sizeof(double)*(size_t)(Rate*Duration + 16));
+
+    WaitForSlave();
+    Start = Now();
+    NextSend = Start;
+    while (Now() < Start + Duration){
+        struct pollfd Poll = { MasterFd, POLLIN, 0 };
+        double Wait = NextSend - Now();
+        if (Wait < 0){
+            Wait = 0;
+        }
+        if ((poll(&Poll, 1, (int)(Wait*1e3)) > 0) && (Poll.revents & POLLIN)){
+            uint8_t Bytes[64];
+            ssize_t NumBytes = read(MasterFd, Bytes, sizeof(Bytes));
+            for (ssize_t i=0; i<NumBytes; i++){
+                uint8_t Length = Pac_FeedDecoder(&Decoder, Bytes[i]);
+                if (Length > 0){
+                    HandleFrame(Decoder.Buffer, Length);
+                }
+            }
+            continue;
+        }
+        if (Now() < NextSend){
+            continue;
+        }
+        if (State == Pairing){
+            uint8_t Frame[PAC_MAX_FRAME];
+            if (FirstPairRequest < 0){
+                FirstPairRequest = Now();
+            }
+            Send(Frame, Pac_PairRequest(&Pac, Team, isBlue, Frame));
+            NextSend = Now() + PAIR_RETRY_MS*1e-3;
+        } else if (State == Keying){
+            uint8_t Frame[PAC_MAX_FRAME];
+            Send(Frame, Pac_KeyFrame(&Pac, Frame));
+            NextSend = Now() + KEY_RETRY_MS*1e-3;
+        } else {
+            uint8_t Frame[PAC_MAX_FRAME];
+            uint8_t Length = Pac_ControlFrame(&Pac, Drive, Turn, 0, Frame);
+            NumSent++;
+            if (Random() < Loss){
+                NumLost++;
+            } else {
+                // the checksum is the last RF byte, just before the API checksum
+                SentAt[Frame[Length - 2]] = Now();
+                Send(Frame, Length);
+            }
+            NextSend += Period + (2*Random() - 1)*Jitter;
+        }
+    }
+    Report();
+    close(MasterFd);
+    return 0;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// OpenPty: make a raw pty and print the name of its slave end
+static int OpenPty(void)
+{
+    struct termios Settings;
+    int SlaveFd;
+    int Fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((Fd < 0) || (grantpt(Fd) != 0) || (unlockpt(Fd) != 0)){
+        perror("pty");
+        return -1;
+    }
+    SlaveFd = open(ptsname(Fd), O_RDWR | O_NOCTTY);
+    if ((SlaveFd < 0) || (tcgetattr(SlaveFd, &Settings) != 0)){
+        perror(ptsname(Fd));
+        return -1;
+    }
+    cfmakeraw(&Settings);
+    tcsetattr(SlaveFd, TCSANOW, &Settings);
+    close(SlaveFd);
+    printf("%s\n", ptsname(Fd));
+    fflush(stdout);
+    return Fd;
+}
+
+// WaitForSlave: until the firmware opens its end, the master reads as hung up
+static void WaitForSlave(void)
+{
+    for (;;){
+        struct pollfd Poll = { MasterFd, POLLIN, 0 };
+        poll(&Poll, 1, 0);
+        if ((Poll.revents & POLLHUP) == 0){
+            return;
+        }
+        usleep(10000);
+    }
+}
+
+static void Send(const uint8_t *pFrame, uint8_t Length)
+{
+    if (write(MasterFd, pFrame, Length) != Length){
+        perror("write");
+    }
+}
+
+// HandleFrame: a frame from the craft, normally a status reply
+static void HandleFrame(const uint8_t *pFrame, uint8_t Length)
+{
+    PacStatus_t Status;
+    double Time = Now();
+    if (isVerbose){
+        printf("%9.3f RX", Time - Start);
+        for (uint8_t i=0; i<Length; i++){
+            printf(" %02X", pFrame[i]);
+        }
+        printf("\n");
+    }
+    if (!Pac_ParseStatus(pFrame, Length, &Status) || (Status.Type != STATUS_TYPE)
+            || (Status.DestMSB != Pac.AddressMSB) || (Status.DestLSB != Pac.AddressLSB)){
+        return;
+    }
+    NumStatus++;
+    if ((Status.Code == UNPAIRED) || (Status.Code == UNPAIRED_DEC_ERROR)){
+        NumUnpairs++;
+        NumDecryptErrors += (Status.Code == UNPAIRED_DEC_ERROR);
+        if (State != Pairing){
+            StartPairing();
+        }
+    } else if (State == Pairing){
+        if (Paired < 0){
+            Paired = Time;
+        }
+        State = Keying;
+        NextSend = Time;
+    } else if (State == Keying){
+        State = Driving;
+        NextSend = Time;
+    } else if ((Status.NumVars > 0) && (SentAt[Status.Vars[0]] >= 0)){
+        RoundTrips[NumRoundTrips++] = Time - SentAt[Status.Vars[0]];
+        SentAt[Status.Vars[0]] = -1;
+        if ((FirstDrive < 0) && (Drive != 0)){
+            FirstDrive = Time;
+        }
+    } else {
+        NumUnmatched++;
+    }
+}
+
+// StartPairing: start over from the next address, as the craft will not
+// pair with the last one again
+static void StartPairing(void)
+{
+    Pac.AddressLSB++;
+    State = Pairing;
+    NextSend = Now();
+}
+
+// Random: xorshift32, uniform in [0, 1)
+static double Random(void)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return RandomState/4294967296.0;
+}
+
+static double Now(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec + Time.tv_nsec*1e-9;
+}
+
+static int CompareDoubles(const void *pA, const void *pB)
+{
+    double A = *(const double *)pA;
+    double B = *(const double *)pB;
+    return (A > B) - (A < B);
+}
+
+static void Report(void)
+{
+    printf("control packets: %lu sent, %lu lost, %lu acknowledged, %lu replies unmatched\n",
+           NumSent, NumLost, NumRoundTrips, NumUnmatched);
+    printf("status frames:   %lu, %lu unpairs (%lu decrypt errors)\n",
+           NumStatus, NumUnpairs, NumDecryptErrors);
+    if (Paired >= 0){
+        printf("time to pair:    %.1f ms\n", (Paired - FirstPairRequest)*1e3);
+    } else {
+        printf("time to pair:    never paired\n");
+    }
+    if (FirstDrive >= 0){
+        printf("time to drive:   %.1f ms\n", (FirstDrive - FirstPairRequest)*1e3);
+    }
+    if (NumRoundTrips > 0){
+        double Sum = 0;
+        qsort(RoundTrips, NumRoundTrips, sizeof(double), CompareDoubles);
+        for (unsigned long i=0; i<NumRoundTrips; i++){
+            Sum += RoundTrips[i];
+        }
+        printf("round trip (ms): min %.3f  mean %.3f  p50 %.3f  p99 %.3f  max %.3f\n",
+               RoundTrips[0]*1e3, Sum/NumRoundTrips*1e3, RoundTrips[NumRoundTrips/2]*1e3,
+               RoundTrips[(NumRoundTrips*99)/100]*1e3, RoundTrips[NumRoundTrips - 1]*1e3);
+    }
+}
@@ -0,0 +1,245 @@
+/****************************************************************************
+ Module
+   PacModel.c
+
+ Description
+   PAC side of the pairing and control protocol for the host build: pair
+   requests, key frames, encrypted control frames and batches, config
+   writes and flight recorder dump requests going to the craft, status
+   frames coming back.
+
+ Notes
+   Control frames are encrypted the way the PAC does it: every RF byte is
+   XORed with the next byte of the 32-byte key, and the checksum is the sum
+   of the four plain bytes before it. Batches and config writes are
+   encrypted the same way, their checksum summing all the bytes before it.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <string.h>
+#include "PacModel.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define START_DELIMITER 0x7E
+#define TX16_API_ID 0x01
+#define TX16_HEADER_SIZE 5 // API id, frame id, destination MSB/LSB, options
+#define CTRL_PACKET_SIZE 5
+#define DEFAULT_RSSI 0x28
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static uint8_t NextKeyByte(PacModel_t *pPac);
+static uint8_t Encrypt(PacModel_t *pPac, uint8_t Plain);
+
+/*------------------------------ Module Code ------------------------------*/
+void Pac_Init(PacModel_t *pPac, uint8_t AddressMSB, uint8_t AddressLSB, uint32_t Seed)
+{
+    memset(pPac, 0, sizeof(*pPac));
+    pPac->AddressMSB = AddressMSB;
+    pPac->AddressLSB = AddressLSB;
+    pPac->RSSI = DEFAULT_RSSI;
+    pPac->Seed = Seed;
+}
+
+uint8_t Pac_PairRequest(PacModel_t *pPac, uint8_t Team, bool isBlue, uint8_t *pFrame)
+{
+    uint8_t RF[2];
+    RF[0] = PAIR_REQUEST_HEADER;
+    RF[1] = (Team & 0x7F) | (isBlue ? 0x80 : 0x00);
+    return Pac_WrapRX16(pPac, RF, sizeof(RF), pFrame);
+}
+
+// Pac_KeyFrame: pick a fresh key and restart the key counter
+uint8_t Pac_KeyFrame(PacModel_t *pPac, uint8_t *pFrame)
+{
+    uint8_t RF[1 + KEY_LENGTH];
+    RF[0] = KEY_HEADER;
+    for (uint8_t i=0; i<KEY_LENGTH; i++){
+        pPac->Key[i] = NextKeyByte(pPac);
+        RF[1 + i] = pPac->Key[i];
+    }
+    pPac->Counter = 0;
+    return Pac_WrapRX16(pPac, RF, sizeof(RF), pFrame);
+}
+
+uint8_t Pac_ControlFrame(PacModel_t *pPac, int8_t Drive, int8_t Turn,
+                         uint8_t Special, uint8_t *pFrame)
+{
+    uint8_t RF[CTRL_PACKET_SIZE];
+    uint8_t Sum = CONTROL_HEADER + (uint8_t)Drive + (uint8_t)Turn + Special;
+    RF[0] = Encrypt(pPac, CONTROL_HEADER);
+    RF[1] = Encrypt(pPac, (uint8_t)Drive);
+    RF[2] = Encrypt(pPac, (uint8_t)Turn);
+    RF[3] = Encrypt(pPac, Special);
+    RF[4] = Encrypt(pPac, Sum);
+    return Pac_WrapRX16(pPac, RF, sizeof(RF), pFrame);
+}
+
+// Pac_ControlBatch: Count commands in one frame, see ControlBatchFrame_t
+uint8_t Pac_ControlBatch(PacModel_t *pPac, const BatchCommand_t *pCommands, uint8_t Count,
+                         uint8_t Special, uint8_t *pFrame)
+{
+    uint8_t Plain[BATCH_RF_SIZE(CTRL_BATCH_MAX)];
+    uint8_t RF[BATCH_RF_SIZE(CTRL_BATCH_MAX)];
+    uint8_t Size = BATCH_RF_SIZE(Count);
+    uint8_t Sum = 0;
+    if ((Count == 0) || (Count > CTRL_BATCH_MAX)){
+        return 0;
+    }
+    Plain[0] = CONTROL_BATCH_HEADER;
+    Plain[1] = Special;
+    Plain[2] = Count;
+    memcpy(&Plain[3], pCommands, Count*sizeof(BatchCommand_t));
+    for (uint8_t i=0; i<Size-1; i++){
+        Sum += Plain[i];
+    }
+    Plain[Size-1] = Sum;
+    for (uint8_t i=0; i<Size; i++){
+        RF[i] = Encrypt(pPac, Plain[i]);
+    }
+    return Pac_WrapRX16(pPac, RF, Size, pFrame);
+}
+
+// Pac_ConfigFrame: Length record bytes from Offset on, see ConfigFrame_t
+uint8_t Pac_ConfigFrame(PacModel_t *pPac, uint8_t Offset, const uint8_t *pData,
+                        uint8_t Length, uint8_t *pFrame)
+{
+    uint8_t Plain[CONFIG_RF_SIZE(CONFIG_DATA_MAX)];
+    uint8_t RF[CONFIG_RF_SIZE(CONFIG_DATA_MAX)];
+    uint8_t Size = CONFIG_RF_SIZE(Length);
+    uint8_t Sum = 0;
+    if ((Length == 0) || (Length > CONFIG_DATA_MAX)){
+        return 0;
+    }
+    Plain[0] = CONFIG_WRITE_HEADER;
+    Plain[1] = Offset;
+    Plain[2] = Length;
+    memcpy(&Plain[3], pData, Length);
+    for (uint8_t i=0; i<Size-1; i++){
+        Sum += Plain[i];
+    }
+    Plain[Size-1] = Sum;
+    for (uint8_t i=0; i<Size; i++){
+        RF[i] = Encrypt(pPac, Plain[i]);
+    }
+    return Pac_WrapRX16(pPac, RF, Size, pFrame);
+}
+
+// Pac_DumpRequest: ask for the craft's flight recorder
+uint8_t Pac_DumpRequest(PacModel_t *pPac, bool isRearm, uint8_t *pFrame)
+{
+    uint8_t RF[2];
+    RF[0] = RECORDER_DUMP_HEADER;
+    RF[1] = isRearm ? DUMP_REARM : 0x00;
+    return Pac_WrapRX16(pPac, RF, sizeof(RF), pFrame);
+}
+
+// Pac_Skip: control packets the PAC sent that never reached the craft
+void Pac_Skip(PacModel_t *pPac, uint8_t NumPackets)
+{
+    pPac->Counter = (pPac->Counter + NumPackets*CTRL_PACKET_SIZE) % KEY_LENGTH;
+}
+
+/* Pac_WrapRX16: frame RF data as the craft's XBee delivers it, an RX16
+ * packet from this PAC
+ * returns the frame length, 0 if it would not fit
+ */
+uint8_t Pac_WrapRX16(const PacModel_t *pPac, const uint8_t *pRF, uint8_t RFLength,
+                     uint8_t *pFrame)
+{
+    uint8_t Length = sizeof(RX16Header_t) + RFLength;
+    uint8_t Checksum = 0;
+    if (Length > RECV_BUFFER_SIZE){
+        return 0;
+    }
+    pFrame[0] = START_DELIMITER;
+    pFrame[1] = 0x00;
+    pFrame[2] = Length;
+    pFrame[3] = RX16_API_ID;
+    pFrame[4] = pPac->AddressMSB;
+    pFrame[5] = pPac->AddressLSB;
+    pFrame[6] = pPac->RSSI;
+    pFrame[7] = 0x00;
+    memcpy(&pFrame[3 + sizeof(RX16Header_t)], pRF, RFLength);
+    for (uint8_t i=0; i<Length; i++){
+        Checksum += pFrame[3 + i];
+    }
+    pFrame[3 + Length] = 0xFF - Checksum;
+    return Length + 4;
+}
+
+void Pac_ResetDecoder(PacDecoder_t *pDecoder)
+{
+    pDecoder->Count = 0;
+    pDecoder->Expected = 0;
+}
+
+/* Pac_FeedDecoder: add one byte from the craft's UART
+ * returns the length of the frame it completes (left in Buffer), else 0
+ */
+uint8_t Pac_FeedDecoder(PacDecoder_t *pDecoder, uint8_t Byte)
+{
+    if ((pDecoder->Count == 0) && (Byte != START_DELIMITER)){
+        return 0;
+    }
+    pDecoder->Buffer[pDecoder->Count++] = Byte;
+    if (pDecoder->Count == 3){
+        if ((pDecoder->Buffer[1] != 0) || (pDecoder->Buffer[2] > PAC_MAX_FRAME - 4)){
+            Pac_ResetDecoder(pDecoder);
+            return 0;
+        }
+        pDecoder->Expected = pDecoder->Buffer[2] + 4;
+    }
+    if ((pDecoder->Count > 3) && (pDecoder->Count == pDecoder->Expected)){
+        uint8_t Length = pDecoder->Count;
+        Pac_ResetDecoder(pDecoder);
+        return Length;
+    }
+    return 0;
+}
+
+/* Pac_ParseStatus: decode a TX16 frame the craft sent
+ * returns false if it is not a well-formed frame
+ */
+bool Pac_ParseStatus(const uint8_t *pFrame, uint8_t Length, PacStatus_t *pStatus)
+{
+    uint8_t Checksum = 0;
+    if ((Length < 4 + TX16_HEADER_SIZE + 2) || (pFrame[0] != START_DELIMITER)
+            || (pFrame[2] + 4 != Length) || (pFrame[3] != TX16_API_ID)){
+        return false;
+    }
+    for (uint8_t i=3; i<Length; i++){
+        Checksum += pFrame[i];
+    }
+    if (Checksum != 0xFF){
+        return false;
+    }
+    pStatus->DestMSB = pFrame[5];
+    pStatus->DestLSB = pFrame[6];
+    pStatus->Type = pFrame[3 + TX16_HEADER_SIZE];
+    pStatus->Code = pFrame[4 + TX16_HEADER_SIZE];
+    pStatus->NumVars = Length - (4 + TX16_HEADER_SIZE + 2);
+    if (pStatus->NumVars > sizeof(pStatus->Vars)){
+        pStatus->NumVars = sizeof(pStatus->Vars);
+    }
+    memcpy(pStatus->Vars, &pFrame[5 + TX16_HEADER_SIZE], pStatus->NumVars);
+    return true;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// NextKeyByte: xorshift32, so a run with the same seed gets the same keys
+static uint8_t NextKeyByte(PacModel_t *pPac)
+{
+    uint32_t x = pPac->Seed ? pPac->Seed : 0x2545F491;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pPac->Seed = x;
+    return (uint8_t)(x >> 24);
+}
+
+static uint8_t Encrypt(PacModel_t *pPac, uint8_t Plain)
+{
+    uint8_t Cipher = Plain ^ pPac->Key[pPac->Counter];
+    pPac->Counter = (pPac->Counter + 1) % KEY_LENGTH;
+    return Cipher;
+}
@@ -0,0 +1,351 @@
+/****************************************************************************
+ Module
+   RecorderDecode.c
+
+ Description
+   Turns flight recorder dumps (see FlightRecorder.h) back into a readable
+   timeline of posts, state changes and the fault that froze the recorder.
+
+ Notes
+   Usage: recdecode [-t] [FILE]
+     -t   FILE is a trace (see Trace.h), e.g. from runner -r; the dump
+          frames are picked out of what the craft transmitted
+   Without -t, FILE (or stdin) is the raw byte stream of an XBee in API
+   mode: either the craft's own TX line (TX16 frames) or the serial port
+   of the XBee that received the dump (RX16 frames). Frames other than
+   dump frames are skipped.
+
+   Event, service and state names come from this tree's ES_Configure.h
+   and service headers, so decode with the tree the firmware was built
+   from.
+
+   Entries only carry the low byte of the ms clock, the high byte comes
+   from the FR_TIME marks and the dump's base, so the clock printed is the
+   firmware's 16-bit ms clock. The second column is the time before the
+   newest entry, which is how long before the freeze it happened.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "ES_Configure.h"
+#include "ES_Events.h"
+#include "CommService.h"
+#include "PairingSM.h"
+#include "FlightRecorder.h"
+#include "PacModel.h"
+#include "Trace.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define TX16_API_ID 0x01
+#define API_HEADER_SIZE 5 // TX16 and RX16 alike: API id, 2 address bytes and 2 more
+#define RF_OFFSET (3 + API_HEADER_SIZE)
+#define MAX_DUMP_FRAMES ((FR_NUM_ENTRIES + FR_ENTRIES_PER_DUMP - 1) / FR_ENTRIES_PER_DUMP)
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+/*---------------------------- Module Types ---------------------------*/
+typedef struct {
+    uint8_t AddressMSB;   // destination of a TX16 frame, source of an RX16
+    uint8_t AddressLSB;
+    uint8_t NumFrames;
+    uint8_t Cause;
+    uint8_t BaseMSB;
+    bool isSeen[MAX_DUMP_FRAMES];
+    uint8_t NumEntries[MAX_DUMP_FRAMES];
+    FR_Entry_t Entries[MAX_DUMP_FRAMES][FR_ENTRIES_PER_DUMP];
+} Dump_t;
+
+typedef struct {
+    const char *RunName;
+    const char * const *pStates;
+    uint8_t NumStates;
+} StateNames_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void FeedByte(uint8_t Byte);
+static void OnFrame(const uint8_t *pFrame, uint8_t Length);
+static void PrintDump(void);
+static const char *EventName(uint8_t Event, char *pBuffer);
+static const char *ServiceName(uint8_t Service);
+static const char *StateName(uint8_t Service, uint8_t State, char *pBuffer);
+
+/*---------------------------- Module Variables ---------------------------*/
+static const char * const EventNames[ES_NUM_EVENTS] = {
+    [ES_NO_EVENT] = "ES_NO_EVENT", [ES_ERROR] = "ES_ERROR", [ES_INIT] = "ES_INIT",
+    [ES_NEW_KEY] = "ES_NEW_KEY", [ES_TIMEOUT] = "ES_TIMEOUT", [ES_ENTRY] = "ES_ENTRY",
+    [ES_ENTRY_HISTORY] = "ES_ENTRY_HISTORY", [ES_EXIT] = "ES_EXIT",
+    [ES_DECRYPT_ERROR] = "ES_DECRYPT_ERROR", [ES_MANUAL_UNPAIR] = "ES_MANUAL_UNPAIR",
+    [ES_DRIVE_COMMAND] = "ES_DRIVE_COMMAND", [ES_STATUS1] = "ES_STATUS1",
+    [ES_STATUS2] = "ES_STATUS2", [ES_STATUS3] = "ES_STATUS3", [ES_STATUS4] = "ES_STATUS4",
+    [ES_NEW_PACKET] = "ES_NEW_PACKET", [ES_Transmit] = "ES_Transmit",
+    [ES_ReceivedByte] = "ES_ReceivedByte", [ES_LiftFan] = "ES_LiftFan",
+    [ES_TELEMETRY] = "ES_TELEMETRY", [ES_DUMP_RECORDER] = "ES_DUMP_RECORDER",
+    [ES_DRIVE_BATCH] = "ES_DRIVE_BATCH",
+#if DEBUG_SERVICES
+    [ES_DEBUG1] = "ES_DEBUG1", [ES_DEBUG2] = "ES_DEBUG2",
+    [ES_LOCK] = "ES_LOCK", [ES_UNLOCK] = "ES_UNLOCK",
+    [ES_BUTTON_DOWN] = "ES_BUTTON_DOWN", [ES_BUTTON_UP] = "ES_BUTTON_UP",
+    [ES_Fan1] = "ES_Fan1", [ES_Fan2] = "ES_Fan2", [ES_LED] = "ES_LED",
+#endif
+};
+
+// by priority, as in ES_Configure.h
+static const char * const ServiceNames[] = {
+    XSTR(SERV_0_RUN),
+#if NUM_SERVICES > 1
+    XSTR(SERV_1_RUN),
+#endif
+#if NUM_SERVICES > 2
+    XSTR(SERV_2_RUN),
+#endif
+#if NUM_SERVICES > 3
+    XSTR(SERV_3_RUN),
+#endif
+#if NUM_SERVICES > 4
+    XSTR(SERV_4_RUN),
+#endif
+#if NUM_SERVICES > 5
+    XSTR(SERV_5_RUN),
+#endif
+#if NUM_SERVICES > 6
+    XSTR(SERV_6_RUN),
+#endif
+#if NUM_SERVICES > 7
+    XSTR(SERV_7_RUN),
+#endif
+};
+
+static const char * const CommStates[] = {
+    [InitComm] = "InitComm", [WaitFor7E] = "WaitFor7E", [WaitForMSB] = "WaitForMSB",
+    [WaitForLSB] = "WaitForLSB", [SuckUpPacket] = "SuckUpPacket",
+};
+
+static const char * const PairingStates[] = {
+    [Waiting2Pair] = "Waiting2Pair", [Waiting4Encrypt] = "Waiting4Encrypt",
+    [Waiting4Control] = "Waiting4Control", [Suspended] = "Suspended",
+};
+
+static const StateNames_t StateNames[] = {
+    { "RunCommService", CommStates, sizeof(CommStates)/sizeof(CommStates[0]) },
+    { "RunPairingSM", PairingStates, sizeof(PairingStates)/sizeof(PairingStates[0]) },
+};
+
+static const char * const CauseNames[] = {
+    [FR_RECORDING] = "not frozen", [FR_DECRYPT_ERROR] = "decrypt error",
+    [FR_UNPAIR] = "unpair", [FR_QUEUE_FULL] = "queue full",
+    [FR_DUMP_REQUEST] = "dump request",
+};
+
+static PacDecoder_t Decoder;
+static Dump_t Dump;
+static bool isDumpOpen = false;
+static unsigned NumDumps;
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    bool isTrace = false;
+    int Option;
+    while ((Option = getopt(argc, argv, "t")) != -1){
+        if (Option == 't'){
+            isTrace = true;
+        } else {
+            fprintf(stderr, "usage: recdecode [-t] [FILE]\n");
+            return 2;
+        }
+    }
+    Pac_ResetDecoder(&Decoder);
+    if (isTrace){
+        Trace_t Trace;
+        TraceRecord_t Record;
+        int Result;
+        if ((optind >= argc) || !Trace_Open(&Trace, argv[optind])){
+            fprintf(stderr, "%s: not a trace\n", (optind < argc) ? argv[optind] : "-t");
+            return 2;
+        }
+        while ((Result = Trace_Read(&Trace, &Record)) == 1){
+            if (Record.Type == TRACE_TX){
+                for (uint8_t i=0; i<Record.Length; i++){
+                    FeedByte(Record.Data[i]);
+                }
+            }
+        }
+        Trace_Close(&Trace);
+        if (Result < 0){
+            fprintf(stderr, "%s: corrupt record\n", argv[optind]);
+        }
+    } else {
+        FILE *pFile = (optind < argc) ? fopen(argv[optind], "rb") : stdin;
+        int Byte;
+        if (pFile == NULL){
+            perror(argv[optind]);
+            return 2;
+        }
+        while ((Byte = getc(pFile)) != EOF){
+            FeedByte((uint8_t)Byte);
+        }
+    }
+    if (isDumpOpen){
+        // the last frames never arrived, show what did
+        PrintDump();
+    }
+    if (NumDumps == 0){
+        fprintf(stderr, "no flight recorder dump found\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static void FeedByte(uint8_t Byte)
+{
+    uint8_t Length = Pac_FeedDecoder(&Decoder, Byte);
+    if (Length > 0){
+        OnFrame(Decoder.Buffer, Length);
+    }
+}
+
+// OnFrame: file a dump frame away, and print the dump once it is complete
+static void OnFrame(const uint8_t *pFrame, uint8_t Length)
+{
+    const uint8_t *pRF = &pFrame[RF_OFFSET];
+    uint8_t Checksum = 0;
+    uint8_t Which, NumEntries;
+    for (uint8_t i=3; i<Length; i++){
+        Checksum += pFrame[i];
+    }
+    if ((Checksum != 0xFF) || (Length < RF_OFFSET + FR_DUMP_OVERHEAD + 1)
+            || ((pFrame[3] != TX16_API_ID) && (pFrame[3] != RX16_API_ID))
+            || (pRF[0] != FR_DUMP_TYPE)){
+        return;
+    }
+    Which = pRF[1];
+    NumEntries = (Length - 1 - RF_OFFSET - FR_DUMP_OVERHEAD) / sizeof(FR_Entry_t);
+    if ((Which >= MAX_DUMP_FRAMES) || (pRF[2] > MAX_DUMP_FRAMES)
+            || (NumEntries > FR_ENTRIES_PER_DUMP)){
+        fprintf(stderr, "dump frame %u of %u does not fit FR_NUM_ENTRIES %u\n",
+                Which, pRF[2], FR_NUM_ENTRIES);
+        return;
+    }
+    if (isDumpOpen && ((Which == 0) || (pRF[2] != Dump.NumFrames))){
+        PrintDump();
+    }
+    if (!isDumpOpen){
+        memset(&Dump, 0, sizeof(Dump));
+        // TX16 frames carry the destination where RX16 frames carry the source
+        Dump.AddressMSB = (pFrame[3] == TX16_API_ID) ? pFrame[5] : pFrame[4];
+        Dump.AddressLSB = (pFrame[3] == TX16_API_ID) ? pFrame[6] : pFrame[5];
+        Dump.NumFrames = pRF[2];
+        Dump.Cause = pRF[3];
+        Dump.BaseMSB = pRF[4];
+        isDumpOpen = true;
+    }
+    Dump.isSeen[Which] = true;
+    Dump.NumEntries[Which] = NumEntries;
+    memcpy(Dump.Entries[Which], &pRF[FR_DUMP_OVERHEAD], NumEntries*sizeof(FR_Entry_t));
+    if (Which + 1 == Dump.NumFrames){
+        PrintDump();
+    }
+}
+
+static void PrintDump(void)
+{
+    uint32_t Times[FR_NUM_ENTRIES];
+    const FR_Entry_t *pEntries[FR_NUM_ENTRIES];
+    uint8_t Count = 0;
+    uint8_t MSB = Dump.BaseMSB;
+    uint32_t Epoch = 0;
+    uint32_t Last = 0;
+    char Text1[16], Text2[16], Text3[16];
+
+    isDumpOpen = false;
+    NumDumps++;
+    printf("dump %u, %s %02X%02X: %s\n", NumDumps,
+           (Dump.AddressMSB == 0xFF) && (Dump.AddressLSB == 0xFF) ? "broadcast" : "address",
+           Dump.AddressMSB, Dump.AddressLSB,
+           (Dump.Cause < sizeof(CauseNames)/sizeof(CauseNames[0])) ? CauseNames[Dump.Cause] : "?");
+    // put the entries back on one clock, unwrapping the 16-bit ms counter
+    for (uint8_t f=0; f<Dump.NumFrames; f++){
+        if (!Dump.isSeen[f]){
+            printf("  (frame %u missing, its entries are lost)\n", f);
+            continue;
+        }
+        for (uint8_t i=0; i<Dump.NumEntries[f]; i++){
+            const FR_Entry_t *pEntry = &Dump.Entries[f][i];
+            uint32_t Time;
+            if ((pEntry->Head >> FR_KIND_SHIFT) == FR_TIME){
+                MSB = pEntry->A;
+            }
+            Time = Epoch + (((uint32_t)MSB << 8) | pEntry->TimeLSB);
+            if (Time < Last){
+                Epoch += 0x10000;
+                Time += 0x10000;
+            }
+            Last = Time;
+            Times[Count] = Time;
+            pEntries[Count++] = pEntry;
+        }
+    }
+    printf("  %7s %8s\n", "clock", "before");
+    for (uint8_t i=0; i<Count; i++){
+        const FR_Entry_t *pEntry = pEntries[i];
+        uint8_t Service = pEntry->Head & FR_SERVICE_MASK;
+        printf("  %7lu %8ld  ", (unsigned long)(Times[i] & 0xFFFF), -(long)(Last - Times[i]));
+        switch (pEntry->Head >> FR_KIND_SHIFT){
+        case FR_POST:
+            printf("post   %-14s -> %-14s %s %u\n",
+                   ServiceName((pEntry->Head >> FR_SOURCE_SHIFT) & FR_SERVICE_MASK),
+                   ServiceName(Service), EventName(pEntry->A, Text1), pEntry->B);
+            break;
+        case FR_STATE:
+            printf("state  %-14s    %s -> %s\n", ServiceName(Service),
+                   StateName(Service, pEntry->A, Text2), StateName(Service, pEntry->B, Text3));
+            break;
+        case FR_TIME:
+            printf("clock  high byte %02X\n", pEntry->A);
+            break;
+        default:
+            printf("freeze %s\n", (pEntry->A < sizeof(CauseNames)/sizeof(CauseNames[0]))
+                   ? CauseNames[pEntry->A] : "?");
+            break;
+        }
+    }
+}
+
+static const char *EventName(uint8_t Event, char *pBuffer)
+{
+    if ((Event < ES_NUM_EVENTS) && (EventNames[Event] != NULL)){
+        return EventNames[Event];
+    }
+    sprintf(pBuffer, "event %u", Event);
+    return pBuffer;
+}
+
+// ServiceName: the run function's name without "Run"
+static const char *ServiceName(uint8_t Service)
+{
+    if (Service == FR_NO_SERVICE){
+        return "(isr/init)";
+    }
+    if (Service >= NUM_SERVICES){
+        return "?";
+    }
+    if (strncmp(ServiceNames[Service], "Run", 3) == 0){
+        return ServiceNames[Service] + 3;
+    }
+    return ServiceNames[Service];
+}
+
+static const char *StateName(uint8_t Service, uint8_t State, char *pBuffer)
+{
+    for (uint8_t i=0; (Service < NUM_SERVICES) && (i<sizeof(StateNames)/sizeof(StateNames[0])); i++){
+        if ((strcmp(StateNames[i].RunName, ServiceNames[Service]) == 0)
+                && (State < StateNames[i].NumStates)){
+            return StateNames[i].pStates[State];
+        }
+    }
+    sprintf(pBuffer, "%u", State);
+    return pBuffer;
+}
@@ -0,0 +1,145 @@
+/****************************************************************************
+ Module
+   SmallPicModel.c
+
+ Description
+   PIC12F752 end of the SmallLink command link for the host build: decodes
+   start, bits, ack and stop from the line levels, and carries out team,
+   servo, LED and celebrate commands the way Small_PIC.asm does.
+
+ Notes
+   The state machine follows the one in Small_PIC.asm's IOC_ISR edge for
+   edge, including which edges it ignores, so a frame this model acks is
+   one the small PIC would ack too. The one difference: the small PIC turns
+   a frame down while its main loop has yet to carry out the previous one,
+   which takes microseconds; the model carries out commands at once.
+
+   A data line nobody drives reads high, like a missing small PIC would.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include "SmallPicModel.h"
+#include "SmallLink.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define CMD_SHIFT 4
+#define LENGTH_MASK 0x0F
+
+typedef enum { SP_IDLE = 0,      // waiting for a start
+               SP_RECEIVE,       // taking bits on rising clock edges
+               SP_ACK,           // last byte in, the next rising edge is the ack
+               SP_ACKING,        // driving the ack until the clock falls
+               SP_WAIT_STOP      // frame done, waiting for the stop
+             } SP_State_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void ClockRose(SmallPicModel_t *pModel, uint8_t Data);
+static void Carry(SmallPicModel_t *pModel);
+
+/*------------------------------ Module Code ------------------------------*/
+uint8_t SmallPic_Update(SmallPicModel_t *pModel, uint8_t Clock, uint8_t Data,
+                        bool isDataDriven)
+{
+    // who drives data: the craft, the ack, or nobody
+    if (!isDataDriven){
+        Data = (pModel->State == SP_ACKING) ? !pModel->isFrameOk : 1;
+    }
+    if (Clock != pModel->Clock){
+        // a data change in the same step is bit set-up, not start or stop
+        if (Clock){
+            ClockRose(pModel, Data);
+        } else if (pModel->State == SP_ACKING){
+            pModel->State = SP_WAIT_STOP;
+        }
+    } else if ((Data != pModel->Data) && Clock
+               && (pModel->State != SP_ACK) && (pModel->State != SP_ACKING)){
+        if (Data == 0){
+            // start
+            pModel->State = SP_RECEIVE;
+            pModel->Count = 0;
+            pModel->Sum = 0;
+            pModel->BitCount = 8;
+            pModel->Length = 0;
+            pModel->isFrameOk = false;
+        } else {
+            // stop: carry out a frame that was acked
+            if ((pModel->State == SP_WAIT_STOP) && pModel->isFrameOk){
+                Carry(pModel);
+            }
+            pModel->State = SP_IDLE;
+        }
+    }
+    // the ack starts and ends on a clock edge
+    if (!isDataDriven){
+        Data = (pModel->State == SP_ACKING) ? !pModel->isFrameOk : 1;
+    }
+    pModel->Clock = Clock;
+    pModel->Data = Data;
+    return Data;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static void ClockRose(SmallPicModel_t *pModel, uint8_t Data){
+    if (pModel->State == SP_ACK){
+        pModel->State = SP_ACKING;
+        return;
+    }
+    if (pModel->State != SP_RECEIVE){
+        return;
+    }
+    pModel->RxByte = (uint8_t)((pModel->RxByte << 1) | (Data ? 1 : 0));
+    if (--pModel->BitCount != 0){
+        return;
+    }
+    pModel->BitCount = 8;
+    pModel->Sum += pModel->RxByte;
+    if (pModel->Count == 0){
+        pModel->Length = (pModel->RxByte & LENGTH_MASK) + 2;
+    }
+    if (pModel->Count < SP_RX_SIZE){
+        pModel->Buf[pModel->Count] = pModel->RxByte;
+    }
+    if (++pModel->Count == pModel->Length){
+        pModel->isFrameOk = (pModel->Sum == 0xFF) && (pModel->Length <= SP_RX_SIZE);
+        if (!pModel->isFrameOk){
+            pModel->BadFrames++;
+        }
+        pModel->State = SP_ACK;
+    }
+}
+
+// Carry: what Small_PIC.asm's DoCommand does with the frame in RxBuf
+static void Carry(SmallPicModel_t *pModel){
+    uint8_t Value = pModel->Buf[1];
+    pModel->Frames++;
+    switch (pModel->Buf[0] >> CMD_SHIFT){
+        case SL_CMD_TEAM:
+            if ((Value != SL_TEAM_RED) && (Value != SL_TEAM_BLUE)){
+                Value = SL_TEAM_NONE;
+            }
+            pModel->Team = Value;
+            pModel->Leds = (Value == SL_TEAM_RED) ? SL_LED_RED
+                         : (Value == SL_TEAM_BLUE) ? SL_LED_BLUE : 0;
+            if (Value == SL_TEAM_NONE){
+                pModel->Servo = SP_FLAG_DOWN;
+                pModel->isRaised = false;
+            } else if (!pModel->isRaised){
+                pModel->Servo = SP_FLAG_UP;
+                pModel->isRaised = true;
+            }
+            break;
+        case SL_CMD_SERVO:
+            pModel->Servo = (Value < SP_FLAG_DOWN) ? SP_FLAG_DOWN
+                          : (Value > SP_FLAG_UP) ? SP_FLAG_UP : Value;
+            break;
+        case SL_CMD_LEDS:
+            pModel->Leds = Value;
+            break;
+        case SL_CMD_CELEBRATE:
+            pModel->Waves++;
+            pModel->Servo = SP_FLAG_UP;
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,254 @@
+/****************************************************************************
+ Module
+   Trace.c
+
+ Description
+   Reads and writes the binary UART trace format described in Trace.h.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <string.h>
+#include "Trace.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+static const char Magic[4] = { 'X', 'B', 'T', 'R' };
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void WriteRecord(Trace_t *pTrace, const TraceRecord_t *pRecord);
+static void WriteVarint(FILE *pFile, uint64_t Value);
+static bool ReadHeader(Trace_t *pTrace);
+static int GetByte(Trace_t *pTrace);
+static bool GetBytes(Trace_t *pTrace, uint8_t *pBytes, size_t Count);
+static bool ReadVarint(Trace_t *pTrace, uint64_t *pValue, bool *pisEnd);
+
+/*------------------------------ Module Code ------------------------------*/
+/***********************************
+              Writing
+ ***********************************/
+// Trace_Create: "-" writes to stdout
+bool Trace_Create(Trace_t *pTrace, const char *Path, uint8_t Flags,
+                  const char * const *pNames, uint8_t NumNames)
+{
+    memset(pTrace, 0, sizeof(*pTrace));
+    if (NumNames > TRACE_MAX_NAMES){
+        return false;
+    }
+    pTrace->pFile = (strcmp(Path, "-") == 0) ? stdout : fopen(Path, "wb");
+    if (pTrace->pFile == NULL){
+        return false;
+    }
+    pTrace->Flags = Flags;
+    pTrace->NumNames = NumNames;
+    fwrite(Magic, 1, sizeof(Magic), pTrace->pFile);
+    fputc(TRACE_VERSION, pTrace->pFile);
+    fputc(Flags, pTrace->pFile);
+    fputc(NumNames, pTrace->pFile);
+    for (uint8_t i=0; i<NumNames; i++){
+        uint8_t Length = strlen(pNames[i]) > TRACE_MAX_NAME ? TRACE_MAX_NAME : strlen(pNames[i]);
+        memcpy(pTrace->Names[i], pNames[i], Length);
+        fputc(Length, pTrace->pFile);
+        fwrite(pNames[i], 1, Length, pTrace->pFile);
+    }
+    return true;
+}
+
+/* Trace_WriteByte: add one UART byte, joining it to the burst in progress
+ * when it follows on closely in the same direction. A time earlier than the
+ * last one written is moved up to it, records stay in time order.
+ */
+void Trace_WriteByte(Trace_t *pTrace, uint8_t Type, uint64_t Time, uint8_t Byte)
+{
+    TraceRecord_t *pBurst = &pTrace->Burst;
+    if (Time < pTrace->BurstEnd){
+        Time = pTrace->BurstEnd;
+    }
+    if ((pBurst->Length > 0) && ((pBurst->Type != Type)
+            || (Time - pTrace->BurstEnd > TRACE_BURST_GAP_US)
+            || (pBurst->Length == sizeof(pBurst->Data)))){
+        WriteRecord(pTrace, pBurst);
+        pBurst->Length = 0;
+    }
+    if (pBurst->Length == 0){
+        pBurst->Time = Time;
+        pBurst->Type = Type;
+    }
+    pBurst->Data[pBurst->Length++] = Byte;
+    pTrace->BurstEnd = Time;
+}
+
+void Trace_WriteOutput(Trace_t *pTrace, uint64_t Time, uint8_t Index, uint8_t Value)
+{
+    TraceRecord_t Record;
+    if (Time < pTrace->BurstEnd){
+        Time = pTrace->BurstEnd;
+    }
+    pTrace->BurstEnd = Time;
+    // keep records in time order: a burst that started earlier goes first
+    if (pTrace->Burst.Length > 0){
+        WriteRecord(pTrace, &pTrace->Burst);
+        pTrace->Burst.Length = 0;
+    }
+    Record.Time = Time;
+    Record.Type = TRACE_OUTPUT;
+    Record.Length = 2;
+    Record.Data[0] = Index;
+    Record.Data[1] = Value;
+    WriteRecord(pTrace, &Record);
+}
+
+bool Trace_Close(Trace_t *pTrace)
+{
+    bool isOK;
+    if (pTrace->pFile == NULL){
+        return true; // a buffer, the caller owns it
+    }
+    if (pTrace->Burst.Length > 0){
+        WriteRecord(pTrace, &pTrace->Burst);
+        pTrace->Burst.Length = 0;
+    }
+    isOK = (ferror(pTrace->pFile) == 0);
+    if ((pTrace->pFile != stdout) && (pTrace->pFile != stdin)){
+        isOK &= (fclose(pTrace->pFile) == 0);
+    }
+    pTrace->pFile = NULL;
+    return isOK;
+}
+
+/***********************************
+              Reading
+ ***********************************/
+// Trace_Open: read the header; "-" reads from stdin
+bool Trace_Open(Trace_t *pTrace, const char *Path)
+{
+    memset(pTrace, 0, sizeof(*pTrace));
+    pTrace->pFile = (strcmp(Path, "-") == 0) ? stdin : fopen(Path, "rb");
+    if (pTrace->pFile == NULL){
+        return false;
+    }
+    return ReadHeader(pTrace);
+}
+
+// Trace_OpenBuffer: read the header of a trace of Size bytes at pData
+bool Trace_OpenBuffer(Trace_t *pTrace, const uint8_t *pData, size_t Size)
+{
+    memset(pTrace, 0, sizeof(*pTrace));
+    pTrace->pData = pData;
+    pTrace->Size = Size;
+    return ReadHeader(pTrace);
+}
+
+/* Trace_Read: the next record
+ * returns 1 for a record, 0 at the end of the trace, -1 if it is corrupt
+ */
+int Trace_Read(Trace_t *pTrace, TraceRecord_t *pRecord)
+{
+    uint64_t Delta;
+    bool isEnd;
+    int Type;
+    int Length;
+    if (!ReadVarint(pTrace, &Delta, &isEnd)){
+        return isEnd ? 0 : -1;
+    }
+    Type = GetByte(pTrace);
+    Length = GetByte(pTrace);
+    if ((Type < 0) || (Type >= NUM_TRACE_TYPES) || (Length < 0)
+            || !GetBytes(pTrace, pRecord->Data, (size_t)Length)){
+        return -1;
+    }
+    if ((Type == TRACE_OUTPUT) && ((Length != 2) || (pRecord->Data[0] >= pTrace->NumNames))){
+        return -1;
+    }
+    pTrace->Time += Delta;
+    pRecord->Time = pTrace->Time;
+    pRecord->Type = (uint8_t)Type;
+    pRecord->Length = (uint8_t)Length;
+    return 1;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static void WriteRecord(Trace_t *pTrace, const TraceRecord_t *pRecord)
+{
+    WriteVarint(pTrace->pFile, pRecord->Time - pTrace->Time);
+    pTrace->Time = pRecord->Time;
+    fputc(pRecord->Type, pTrace->pFile);
+    fputc(pRecord->Length, pTrace->pFile);
+    fwrite(pRecord->Data, 1, pRecord->Length, pTrace->pFile);
+}
+
+static void WriteVarint(FILE *pFile, uint64_t Value)
+{
+    while (Value >= 0x80){
+        fputc((uint8_t)(Value | 0x80), pFile);
+        Value >>= 7;
+    }
+    fputc((uint8_t)Value, pFile);
+}
+
+static bool ReadHeader(Trace_t *pTrace)
+{
+    uint8_t Header[sizeof(Magic)];
+    if (!GetBytes(pTrace, Header, sizeof(Header))
+            || (memcmp(Header, Magic, sizeof(Magic)) != 0)
+            || (GetByte(pTrace) != TRACE_VERSION)){
+        return false;
+    }
+    pTrace->Flags = (uint8_t)GetByte(pTrace);
+    pTrace->NumNames = (uint8_t)GetByte(pTrace);
+    if (pTrace->NumNames > TRACE_MAX_NAMES){
+        return false;
+    }
+    for (uint8_t i=0; i<pTrace->NumNames; i++){
+        int Length = GetByte(pTrace);
+        if ((Length < 0) || (Length > TRACE_MAX_NAME)
+                || !GetBytes(pTrace, (uint8_t *)pTrace->Names[i], (size_t)Length)){
+            return false;
+        }
+        pTrace->Names[i][Length] = '\0';
+    }
+    return (pTrace->pFile == NULL) || !ferror(pTrace->pFile);
+}
+
+// GetByte: the next byte of the file or buffer, -1 at its end
+static int GetByte(Trace_t *pTrace)
+{
+    if (pTrace->pFile != NULL){
+        return getc(pTrace->pFile);
+    }
+    if (pTrace->Offset == pTrace->Size){
+        return -1;
+    }
+    return pTrace->pData[pTrace->Offset++];
+}
+
+static bool GetBytes(Trace_t *pTrace, uint8_t *pBytes, size_t Count)
+{
+    if (pTrace->pFile != NULL){
+        return fread(pBytes, 1, Count, pTrace->pFile) == Count;
+    }
+    if (pTrace->Size - pTrace->Offset < Count){
+        return false;
+    }
+    memcpy(pBytes, &pTrace->pData[pTrace->Offset], Count);
+    pTrace->Offset += Count;
+    return true;
+}
+
+// ReadVarint: *pisEnd is set if the trace ended cleanly before the first byte
+static bool ReadVarint(Trace_t *pTrace, uint64_t *pValue, bool *pisEnd)
+{
+    uint64_t Value = 0;
+    *pisEnd = false;
+    for (uint8_t Shift=0; Shift<64; Shift+=7){
+        int Byte = GetByte(pTrace);
+        if (Byte < 0){
+            *pisEnd = (Shift == 0) && ((pTrace->pFile == NULL) || !ferror(pTrace->pFile));
+            return false;
+        }
+        Value |= (uint64_t)(Byte & 0x7F) << Shift;
+        if ((Byte & 0x80) == 0){
+            *pValue = Value;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,633 @@
+/****************************************************************************
+ Module
+   TraceAnalyzer.c
+
+ Description
+   Crunches a pile of recorded traces (see Trace.h), e.g. every match of a
+   competition day, into a report per match and one for all of them: reply
+   latency, decrypt errors, what ended each session, runs of lost control
+   frames, RSSI, telemetry, flight recorder dumps and queue high-water marks.
+
+ Notes
+   Usage: analyze [-q] [-j THREADS] [-p PERIOD_MS] TRACE...
+     -q   print only the report for all the traces together
+     -j   worker threads (default: one per online CPU)
+     -p   how often the PAC sends control frames (default 200 ms, 5 Hz);
+          a longer gap between two of them counts as lost frames
+
+   Each trace is mapped into memory and read in place (Trace_OpenBuffer),
+   and the traces are shared out between the threads one at a time, so a
+   day of traces spreads over every core while a single trace is read by
+   one. The threads only write their own trace's results; everything is
+   added up once they are done, and the reports come out in the order the
+   traces were given whatever the thread count.
+
+   What is measured, from the XBee API frames on both UART lines:
+     latency       from the start of a pair, key or control frame the craft
+                   received to the start of the status frame it sent back;
+                   the request's own time on the wire is included. A request
+                   overtaken by the next one is counted as unanswered;
+                   control frames to an unpaired craft expect no answer.
+     lost frames   a gap of n periods between two control frames in a
+                   session is n-1 frames lost in a row
+     unpairs       a session that ended with the decrypt error status, with
+                   no control frame answered for 2.5 periods (link lost), or
+                   while they were still being answered (the PAC's unpair
+                   request or the pairing timer)
+     decrypt errs  status frames reporting a decrypt error, paired or not
+   Control frames and batches are encrypted, so they are told apart from
+   the other frames by their length alone, and a batch counts as one
+   control frame: for a PAC that batches, give -p its frame period.
+
+   Latencies are kept in 100 us bins; a percentile is interpolated within
+   its bin and capped at the slowest reply. As a check on that, analyze
+   exits 1 if any report's p50, p90, p99 and max are not in rising order.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ES_Configure.h"
+#include "ES_Events.h"
+#include "XBeeFrames.h"
+#include "CommService.h"
+#include "FlightRecorder.h"
+#include "PacModel.h"
+#include "Trace.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define TX16_API_ID 0x01
+#define STATUS_TYPE 0x03        // RF message type of status frames
+#define UNPAIRED_NO_ERROR 0x00  // status codes, see CommService
+#define PAIRED_NO_ERROR 0x01
+#define UNPAIRED_DEC_ERROR 0x02
+#define PAIRED_DEC_ERROR 0x03
+#define RF_OFFSET 8             // RX16 and TX16 alike: delimiter, length, 5 header bytes
+#define RSSI_OFFSET 6
+#define DEFAULT_PERIOD_MS 200
+#define LINK_LOST_PERIODS 2.5
+#define LATENCY_BIN_US 100
+#define LATENCY_BINS 10000      // 1 s; slower replies share the last bin
+#define MAX_LOSS_RUN 16         // longer runs share the last bin
+#define NUM_FR_CAUSES (FR_DUMP_REQUEST + 1)
+#define NO_TIME UINT64_MAX
+
+/*---------------------------- Module Types ---------------------------*/
+typedef enum { REQ_NONE = 0, REQ_PAIR, REQ_KEY, REQ_CONTROL, REQ_OTHER } Request_t;
+
+// what one trace, or all of them added up, comes to
+typedef struct {
+    const char *pError;       // why the trace could not be read, NULL if it was
+    bool isCorrupt;           // read up to a bad record
+    uint64_t Bytes;
+    uint64_t Duration;        // us, to the last record
+    uint32_t NumTraces;
+    uint32_t RxFrames;
+    uint32_t TxFrames;
+    uint32_t BadFrames;       // API checksum wrong
+    uint32_t Controls;
+    uint32_t Latency[LATENCY_BINS];
+    uint32_t Replies;
+    uint64_t MaxLatency;      // us
+    uint32_t Unanswered;
+    uint32_t Lost;
+    uint32_t LossRuns[MAX_LOSS_RUN + 1];
+    uint32_t LongestRun;
+    uint32_t Sessions;
+    uint32_t DecryptErrors;
+    uint32_t UnpairsDecrypt;
+    uint32_t UnpairsLinkLost;
+    uint32_t UnpairsDriving;
+    uint32_t Rssi[256];
+    uint32_t Telemetry;
+    uint8_t BatteryMin;
+    uint8_t CurrentMax;
+    uint32_t Dumps[NUM_FR_CAUSES];
+    uint8_t NumQueues;
+    char QueueNames[TRACE_MAX_NAMES][TRACE_MAX_NAME + 1];
+    uint8_t QueueHighWater[TRACE_MAX_NAMES];
+} Stats_t;
+
+// where the walk through one trace is
+typedef struct {
+    Stats_t *pStats;
+    PacDecoder_t Decoders[2];     // RX, TX
+    uint64_t FrameStart[2];
+    uint64_t PendingRequest;      // start of the request awaiting a reply
+    uint64_t LastControl;         // in this session
+    uint64_t LastAccepted;        // the last paired status
+    bool isPaired;
+} Walk_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void *Worker(void *pArg);
+static void AnalyzeFile(const char *Path, Stats_t *pStats);
+static void Analyze(Trace_t *pTrace, Stats_t *pStats);
+static void OnRxFrame(Walk_t *pWalk, uint64_t Time, const uint8_t *pFrame, uint8_t Length);
+static void OnTxFrame(Walk_t *pWalk, uint64_t Time, const uint8_t *pFrame, uint8_t Length);
+static void OnStatus(Walk_t *pWalk, uint64_t Time, uint8_t Code);
+static void OnQueue(Stats_t *pStats, const char *Name, uint8_t HighWater);
+static bool isChecksumOK(const uint8_t *pFrame, uint8_t Length);
+static void Merge(Stats_t *pTotal, const Stats_t *pStats);
+static void Print(const char *Title, const Stats_t *pStats);
+static double Percentile(const Stats_t *pStats, double Fraction);
+static bool IsOrdered(const Stats_t *pStats);
+static double Now(void);
+
+/*---------------------------- Module Variables ---------------------------*/
+static const char * const CauseNames[NUM_FR_CAUSES] = {
+    [FR_RECORDING] = "none", [FR_DECRYPT_ERROR] = "decrypt error", [FR_UNPAIR] = "unpair",
+    [FR_QUEUE_FULL] = "queue full", [FR_DUMP_REQUEST] = "request",
+};
+
+static char **Paths;
+static Stats_t *Results;
+static unsigned NumPaths;
+static unsigned NextPath;       // next trace for a worker to take
+static uint64_t Period = DEFAULT_PERIOD_MS*1000ULL;
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    long NumThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool isQuiet = false;
+    bool isOrdered = true;
+    pthread_t *Threads;
+    Stats_t *pTotal;
+    double Start;
+    int Option;
+
+    while ((Option = getopt(argc, argv, "qj:p:")) != -1){
+        if (Option == 'q'){
+            isQuiet = true;
+        } else if (Option == 'j'){
+            NumThreads = strtol(optarg, NULL, 0);
+        } else if ((Option == 'p') && (strtoul(optarg, NULL, 0) > 0)){
+            Period = strtoull(optarg, NULL, 0)*1000ULL;
+        } else {
+            optind = argc;
+            break;
+        }
+    }
+    if (optind >= argc){
+        fprintf(stderr, "usage: %s [-q] [-j THREADS] [-p PERIOD_MS] TRACE...\n", argv[0]);
+        return 2;
+    }
+    Paths = &argv[optind];
+    NumPaths = (unsigned)(argc - optind);
+    if ((NumThreads < 1) || ((unsigned long)NumThreads > NumPaths)){
+        NumThreads = (NumThreads < 1) ? 1 : (long)NumPaths;
+    }
+    Results = calloc(NumPaths, sizeof(Stats_t));
+    pTotal = calloc(1, sizeof(Stats_t));
+    Threads = malloc(NumThreads*sizeof(pthread_t));
+    if ((Results == NULL) || (pTotal == NULL) || (Threads == NULL)){
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    Start = Now();
+    for (long i=0; i<NumThreads; i++){
+        pthread_create(&Threads[i], NULL, Worker, NULL);
+    }
+    for (long i=0; i<NumThreads; i++){
+        pthread_join(Threads[i], NULL);
+    }
+
+    for (unsigned i=0; i<NumPaths; i++){
+        if (Results[i].pError != NULL){
+            fprintf(stderr, "%s: %s\n", Paths[i], Results[i].pError);
+            continue;
+        }
+        if (Results[i].isCorrupt){
+            fprintf(stderr, "%s: corrupt after %.1f s, read up to there\n", Paths[i],
+                    Results[i].Duration*1e-6);
+        }
+        if (!isQuiet){
+            Print(Paths[i], &Results[i]);
+        }
+        if (!IsOrdered(&Results[i])){
+            fprintf(stderr, "%s: latency percentiles out of order\n", Paths[i]);
+            isOrdered = false;
+        }
+        Merge(pTotal, &Results[i]);
+    }
+    if (pTotal->NumTraces > 0){
+        char Title[64];
+        snprintf(Title, sizeof(Title), "all %u traces", pTotal->NumTraces);
+        Print(Title, pTotal);
+        if (!IsOrdered(pTotal)){
+            fprintf(stderr, "all traces: latency percentiles out of order\n");
+            isOrdered = false;
+        }
+    }
+    printf("%.1f MB in %.3f s on %ld threads\n", pTotal->Bytes*1e-6, Now() - Start, NumThreads);
+    return ((pTotal->NumTraces == NumPaths) && isOrdered) ? 0 : 1;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static void *Worker(void *pArg)
+{
+    unsigned i;
+    (void)pArg;
+    while ((i = __atomic_fetch_add(&NextPath, 1, __ATOMIC_RELAXED)) < NumPaths){
+        AnalyzeFile(Paths[i], &Results[i]);
+    }
+    return NULL;
+}
+
+// AnalyzeFile: map the trace and read it in place
+static void AnalyzeFile(const char *Path, Stats_t *pStats)
+{
+    struct stat Info;
+    Trace_t Trace;
+    void *pData;
+    int Fd = open(Path, O_RDONLY);
+    if ((Fd < 0) || (fstat(Fd, &Info) != 0)){
+        pStats->pError = "cannot open";
+        if (Fd >= 0){
+            close(Fd);
+        }
+        return;
+    }
+    pData = (Info.st_size > 0) ? mmap(NULL, Info.st_size, PROT_READ, MAP_PRIVATE, Fd, 0)
+                               : MAP_FAILED;
+    close(Fd);
+    if (pData == MAP_FAILED){
+        pStats->pError = "cannot map";
+        return;
+    }
+    madvise(pData, Info.st_size, MADV_SEQUENTIAL);
+    if (Trace_OpenBuffer(&Trace, pData, Info.st_size)){
+        pStats->Bytes = Info.st_size;
+        Analyze(&Trace, pStats);
+    } else {
+        pStats->pError = "not a trace";
+    }
+    munmap(pData, Info.st_size);
+}
+
+static void Analyze(Trace_t *pTrace, Stats_t *pStats)
+{
+    TraceRecord_t Record;
+    Walk_t Walk;
+    int Result;
+
+    memset(&Walk, 0, sizeof(Walk));
+    Walk.pStats = pStats;
+    Walk.PendingRequest = NO_TIME;
+    Walk.LastControl = NO_TIME;
+    Walk.LastAccepted = NO_TIME;
+    Pac_ResetDecoder(&Walk.Decoders[TRACE_RX]);
+    Pac_ResetDecoder(&Walk.Decoders[TRACE_TX]);
+    pStats->NumTraces = 1;
+    pStats->BatteryMin = UINT8_MAX;
+
+    while ((Result = Trace_Read(pTrace, &Record)) == 1){
+        pStats->Duration = Record.Time;
+        if (Record.Type == TRACE_OUTPUT){
+            const char *Name = pTrace->Names[Record.Data[0]];
+            if (strncmp(Name, TRACE_QUEUE_PREFIX, strlen(TRACE_QUEUE_PREFIX)) == 0){
+                OnQueue(pStats, Name + strlen(TRACE_QUEUE_PREFIX), Record.Data[1]);
+            }
+            continue;
+        }
+        // a frame starts at its burst's time; the host runner puts a whole
+        // frame at one instant, so byte times within a burst would only be
+        // a guess, and one that makes replies come before their requests
+        for (uint8_t i=0; i<Record.Length; i++){
+            PacDecoder_t *pDecoder = &Walk.Decoders[Record.Type];
+            uint8_t Length;
+            if (pDecoder->Count == 0){
+                Walk.FrameStart[Record.Type] = Record.Time;
+            }
+            Length = Pac_FeedDecoder(pDecoder, Record.Data[i]);
+            if (Length == 0){
+                continue;
+            }
+            if (!isChecksumOK(pDecoder->Buffer, Length)){
+                pStats->BadFrames++;
+            } else if (Record.Type == TRACE_RX){
+                OnRxFrame(&Walk, Walk.FrameStart[TRACE_RX], pDecoder->Buffer, Length);
+            } else {
+                OnTxFrame(&Walk, Walk.FrameStart[TRACE_TX], pDecoder->Buffer, Length);
+            }
+        }
+    }
+    pStats->isCorrupt = (Result < 0);
+}
+
+static void OnRxFrame(Walk_t *pWalk, uint64_t Time, const uint8_t *pFrame, uint8_t Length)
+{
+    Stats_t *pStats = pWalk->pStats;
+    const uint8_t *pRF = &pFrame[RF_OFFSET];
+    uint8_t RFLength;
+    Request_t Request;
+    if ((pFrame[3] != RX16_API_ID) || (Length <= RF_OFFSET + 1)){
+        return;
+    }
+    RFLength = Length - RF_OFFSET - 1;
+    pStats->RxFrames++;
+    pStats->Rssi[pFrame[RSSI_OFFSET]]++;
+    if ((pRF[0] == PAIR_REQUEST_HEADER) && (RFLength == RF_SIZE(PairRequestFrame_t))){
+        Request = REQ_PAIR;
+    } else if ((pRF[0] == RECORDER_DUMP_HEADER) && (RFLength == RF_SIZE(DumpRequestFrame_t))){
+        Request = REQ_OTHER;
+    } else if ((pRF[0] == KEY_HEADER) && (RFLength == RF_SIZE(KeyFrame_t))){
+        Request = REQ_KEY;
+    } else if ((RFLength == RF_SIZE(ControlFrame_t))
+               || ((RFLength >= BATCH_RF_SIZE(1)) && (RFLength <= BATCH_RF_SIZE(CTRL_BATCH_MAX))
+                   && ((RFLength - BATCH_RF_SIZE(0)) % sizeof(BatchCommand_t) == 0))){
+        Request = REQ_CONTROL;
+    } else {
+        Request = REQ_OTHER;
+    }
+    if (Request == REQ_CONTROL){
+        pStats->Controls++;
+    }
+    // an unpaired craft does not answer control frames
+    if ((Request == REQ_OTHER) || ((Request == REQ_CONTROL) && !pWalk->isPaired)){
+        return;
+    }
+    if (pWalk->PendingRequest != NO_TIME){
+        pStats->Unanswered++;
+    }
+    pWalk->PendingRequest = Time;
+    if (Request != REQ_CONTROL){
+        return;
+    }
+    if (pWalk->isPaired && (pWalk->LastControl != NO_TIME)){
+        uint32_t Run = (uint32_t)((Time - pWalk->LastControl + Period/2) / Period);
+        if (Run > 1){
+            Run--;
+            pStats->Lost += Run;
+            pStats->LossRuns[(Run < MAX_LOSS_RUN) ? Run : MAX_LOSS_RUN]++;
+            if (Run > pStats->LongestRun){
+                pStats->LongestRun = Run;
+            }
+        }
+    }
+    pWalk->LastControl = Time;
+}
+
+static void OnTxFrame(Walk_t *pWalk, uint64_t Time, const uint8_t *pFrame, uint8_t Length)
+{
+    Stats_t *pStats = pWalk->pStats;
+    const uint8_t *pRF = &pFrame[RF_OFFSET];
+    uint8_t RFLength;
+    if ((pFrame[3] != TX16_API_ID) || (Length <= RF_OFFSET + 1)){
+        return;
+    }
+    RFLength = Length - RF_OFFSET - 1;
+    pStats->TxFrames++;
+    if ((pRF[0] == STATUS_TYPE) && (RFLength >= 2)){
+        OnStatus(pWalk, Time, pRF[1]);
+    } else if ((pRF[0] == TELEMETRY_TYPE) && (RFLength >= TELEMETRY_LENGTH)){
+        pStats->Telemetry++;
+        if (pRF[1] < pStats->BatteryMin){
+            pStats->BatteryMin = pRF[1];
+        }
+        if (pRF[2] > pStats->CurrentMax){
+            pStats->CurrentMax = pRF[2];
+        }
+    } else if ((pRF[0] == FR_DUMP_TYPE) && (RFLength >= FR_DUMP_OVERHEAD) && (pRF[1] == 0)
+               && (pRF[3] < NUM_FR_CAUSES)){
+        pStats->Dumps[pRF[3]]++;
+    }
+}
+
+// OnStatus: a reply, and maybe the start or end of a session
+static void OnStatus(Walk_t *pWalk, uint64_t Time, uint8_t Code)
+{
+    Stats_t *pStats = pWalk->pStats;
+    bool isPaired = (Code == PAIRED_NO_ERROR) || (Code == PAIRED_DEC_ERROR);
+    // the unpaired statuses tell of a session ending, they answer nothing
+    if (isPaired && (pWalk->PendingRequest != NO_TIME) && (Time >= pWalk->PendingRequest)){
+        uint64_t Latency = Time - pWalk->PendingRequest;
+        uint64_t Bin = Latency / LATENCY_BIN_US;
+        pStats->Latency[(Bin < LATENCY_BINS) ? Bin : LATENCY_BINS - 1]++;
+        pStats->Replies++;
+        if (Latency > pStats->MaxLatency){
+            pStats->MaxLatency = Latency;
+        }
+        pWalk->PendingRequest = NO_TIME;
+    }
+    if ((Code == UNPAIRED_DEC_ERROR) || (Code == PAIRED_DEC_ERROR)){
+        pStats->DecryptErrors++;
+    }
+    if (isPaired){
+        if (!pWalk->isPaired){
+            pStats->Sessions++;
+            pWalk->LastControl = NO_TIME;
+        }
+        pWalk->isPaired = true;
+        pWalk->LastAccepted = Time;
+        return;
+    }
+    if (!pWalk->isPaired){
+        return;
+    }
+    if (Code == UNPAIRED_DEC_ERROR){
+        pStats->UnpairsDecrypt++;
+    } else if ((pWalk->LastAccepted == NO_TIME)
+               || (Time - pWalk->LastAccepted >= (uint64_t)(LINK_LOST_PERIODS*Period))){
+        pStats->UnpairsLinkLost++;
+    } else {
+        pStats->UnpairsDriving++;
+    }
+    if (pWalk->PendingRequest != NO_TIME){
+        pStats->Unanswered++;
+        pWalk->PendingRequest = NO_TIME;
+    }
+    pWalk->isPaired = false;
+    pWalk->LastControl = NO_TIME;
+    pWalk->LastAccepted = NO_TIME;
+}
+
+static void OnQueue(Stats_t *pStats, const char *Name, uint8_t HighWater)
+{
+    uint8_t i;
+    for (i=0; (i<pStats->NumQueues) && (strcmp(pStats->QueueNames[i], Name) != 0); i++){
+    }
+    if (i == pStats->NumQueues){
+        if (i == TRACE_MAX_NAMES){
+            return;
+        }
+        strcpy(pStats->QueueNames[i], Name);
+        pStats->QueueHighWater[i] = 0;
+        pStats->NumQueues++;
+    }
+    if (HighWater > pStats->QueueHighWater[i]){
+        pStats->QueueHighWater[i] = HighWater;
+    }
+}
+
+static bool isChecksumOK(const uint8_t *pFrame, uint8_t Length)
+{
+    uint8_t Sum = 0;
+    for (uint8_t i=3; i<Length; i++){
+        Sum += pFrame[i];
+    }
+    return (Sum == 0xFF);
+}
+
+static void Merge(Stats_t *pTotal, const Stats_t *pStats)
+{
+    if (pTotal->NumTraces == 0){
+        pTotal->BatteryMin = UINT8_MAX;
+    }
+    pTotal->NumTraces += pStats->NumTraces;
+    pTotal->Bytes += pStats->Bytes;
+    pTotal->Duration += pStats->Duration;
+    pTotal->RxFrames += pStats->RxFrames;
+    pTotal->TxFrames += pStats->TxFrames;
+    pTotal->BadFrames += pStats->BadFrames;
+    pTotal->Controls += pStats->Controls;
+    for (unsigned i=0; i<LATENCY_BINS; i++){
+        pTotal->Latency[i] += pStats->Latency[i];
+    }
+    pTotal->Replies += pStats->Replies;
+    if (pStats->MaxLatency > pTotal->MaxLatency){
+        pTotal->MaxLatency = pStats->MaxLatency;
+    }
+    pTotal->Unanswered += pStats->Unanswered;
+    pTotal->Lost += pStats->Lost;
+    for (unsigned i=0; i<=MAX_LOSS_RUN; i++){
+        pTotal->LossRuns[i] += pStats->LossRuns[i];
+    }
+    if (pStats->LongestRun > pTotal->LongestRun){
+        pTotal->LongestRun = pStats->LongestRun;
+    }
+    pTotal->Sessions += pStats->Sessions;
+    pTotal->DecryptErrors += pStats->DecryptErrors;
+    pTotal->UnpairsDecrypt += pStats->UnpairsDecrypt;
+    pTotal->UnpairsLinkLost += pStats->UnpairsLinkLost;
+    pTotal->UnpairsDriving += pStats->UnpairsDriving;
+    for (unsigned i=0; i<256; i++){
+        pTotal->Rssi[i] += pStats->Rssi[i];
+    }
+    pTotal->Telemetry += pStats->Telemetry;
+    if (pStats->BatteryMin < pTotal->BatteryMin){
+        pTotal->BatteryMin = pStats->BatteryMin;
+    }
+    if (pStats->CurrentMax > pTotal->CurrentMax){
+        pTotal->CurrentMax = pStats->CurrentMax;
+    }
+    for (unsigned i=0; i<NUM_FR_CAUSES; i++){
+        pTotal->Dumps[i] += pStats->Dumps[i];
+    }
+    for (uint8_t i=0; i<pStats->NumQueues; i++){
+        OnQueue(pTotal, pStats->QueueNames[i], pStats->QueueHighWater[i]);
+    }
+}
+
+static void Print(const char *Title, const Stats_t *pStats)
+{
+    unsigned RssiMin = 0, RssiMax = 0;
+    uint32_t RssiCount = 0, RssiHalf = 0;
+    unsigned RssiMedian = 0;
+    printf("== %s: %.1f s, %u frames in, %u out, %u bad\n", Title, pStats->Duration*1e-6,
+           pStats->RxFrames, pStats->TxFrames, pStats->BadFrames);
+    if (pStats->Replies > 0){
+        printf("  latency ms      p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  (%u replies,"
+               " %u unanswered)\n", Percentile(pStats, 0.50), Percentile(pStats, 0.90),
+               Percentile(pStats, 0.99), pStats->MaxLatency*1e-3, pStats->Replies,
+               pStats->Unanswered);
+    } else {
+        printf("  latency ms      - (%u unanswered)\n", pStats->Unanswered);
+    }
+    printf("  control frames  %u, %u lost in", pStats->Controls, pStats->Lost);
+    if (pStats->Lost == 0){
+        printf(" no runs\n");
+    } else {
+        for (unsigned i=1; i<=MAX_LOSS_RUN; i++){
+            if (pStats->LossRuns[i] > 0){
+                printf(" %ux%u%s", pStats->LossRuns[i], i, (i == MAX_LOSS_RUN) ? "+" : "");
+            }
+        }
+        printf(", longest %u\n", pStats->LongestRun);
+    }
+    printf("  sessions        %u; ended by decrypt error %u, link lost %u, while driving %u\n",
+           pStats->Sessions, pStats->UnpairsDecrypt, pStats->UnpairsLinkLost,
+           pStats->UnpairsDriving);
+    printf("  decrypt errors  %u\n", pStats->DecryptErrors);
+    for (unsigned i=0; i<256; i++){
+        RssiCount += pStats->Rssi[i];
+    }
+    if (RssiCount > 0){
+        for (unsigned i=0; i<256; i++){
+            if (pStats->Rssi[i] == 0){
+                continue;
+            }
+            if (RssiHalf == 0){
+                RssiMin = i;
+            }
+            if ((RssiHalf < (RssiCount + 1)/2) && (RssiHalf + pStats->Rssi[i] >= (RssiCount + 1)/2)){
+                RssiMedian = i;
+            }
+            RssiHalf += pStats->Rssi[i];
+            RssiMax = i;
+        }
+        printf("  rssi -dBm       best %u  median %u  worst %u\n", RssiMin, RssiMedian, RssiMax);
+    }
+    if (pStats->Telemetry > 0){
+        printf("  telemetry       %u frames, battery low %u, current peak %u\n",
+               pStats->Telemetry, pStats->BatteryMin, pStats->CurrentMax);
+    }
+    for (unsigned i=0; i<NUM_FR_CAUSES; i++){
+        if (pStats->Dumps[i] > 0){
+            printf("  recorder dumps  %u frozen by %s\n", pStats->Dumps[i], CauseNames[i]);
+        }
+    }
+    if (pStats->NumQueues > 0){
+        printf("  queue peaks    ");
+        for (uint8_t i=0; i<pStats->NumQueues; i++){
+            printf(" %s %u", pStats->QueueNames[i], pStats->QueueHighWater[i]);
+        }
+        printf("\n");
+    }
+}
+
+/* Percentile: in ms, interpolated within its bin and never past the
+ * slowest reply, so it cannot come out above max
+ */
+static double Percentile(const Stats_t *pStats, double Fraction)
+{
+    uint32_t Rank = (uint32_t)(Fraction*pStats->Replies + 0.5);
+    uint32_t Count = 0;
+    double Latency;
+    if (Rank == 0){
+        Rank = 1;
+    }
+    for (unsigned i=0; i<LATENCY_BINS; i++){
+        if (Count + pStats->Latency[i] >= Rank){
+            Latency = (i + (double)(Rank - Count)/pStats->Latency[i])*LATENCY_BIN_US;
+            return ((Latency < pStats->MaxLatency) ? Latency : pStats->MaxLatency)*1e-3;
+        }
+        Count += pStats->Latency[i];
+    }
+    return pStats->MaxLatency*1e-3;
+}
+
+// IsOrdered: the percentiles Print reports rise to the slowest reply
+static bool IsOrdered(const Stats_t *pStats)
+{
+    double P50 = Percentile(pStats, 0.50);
+    double P90 = Percentile(pStats, 0.90);
+    double P99 = Percentile(pStats, 0.99);
+    return (P50 <= P90) && (P90 <= P99) && (P99 <= pStats->MaxLatency*1e-3);
+}
+
+static double Now(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return Time.tv_sec + Time.tv_nsec*1e-9;
+}
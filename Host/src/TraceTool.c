@@ -0,0 +1,247 @@
+/****************************************************************************
+ Module
+   TraceTool.c
+
+ Description
+   Converts logic analyzer captures to the binary trace format, and prints
+   traces as text.
+
+ Notes
+   Usage:
+     tracetool dump TRACE
+     tracetool csv [-r NAME] [-t NAME] [-d rx|tx] CSV TRACE
+
+   csv reads the decoded-bytes export of an async serial analyzer: a
+   header line, then one line per byte. The columns are found by name:
+   time ("start_time" or "Time [s]", in seconds), data ("data" or "Value",
+   hex like 0x7E) and, when two analyzers are exported together, the
+   analyzer name ("name" or "Analyzer Name"). -r and -t give the analyzer
+   names of the XBee-to-PIC (RX) and PIC-to-XBee (TX) lines; a single
+   analyzer export uses -d for its direction. Times are made relative to
+   the first byte.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "Trace.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define MAX_LINE 512
+#define MAX_FIELDS 16
+#define NO_COLUMN (-1)
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static int Dump(const char *Path);
+static int ImportCSV(int argc, char **argv);
+static int SplitCSV(char *Line, char **pFields);
+static int FindColumn(char **pFields, int NumFields, const char *Name1, const char *Name2);
+static void Usage(void);
+
+/*------------------------------ Module Code ------------------------------*/
+int main(int argc, char **argv)
+{
+    if ((argc == 3) && (strcmp(argv[1], "dump") == 0)){
+        return Dump(argv[2]);
+    }
+    if ((argc >= 4) && (strcmp(argv[1], "csv") == 0)){
+        return ImportCSV(argc - 1, argv + 1);
+    }
+    Usage();
+    return 2;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static int Dump(const char *Path)
+{
+    static const char * const TypeNames[NUM_TRACE_TYPES] = { "RX", "TX", "OUT" };
+    Trace_t Trace;
+    TraceRecord_t Record;
+    int Result;
+    if (!Trace_Open(&Trace, Path)){
+        fprintf(stderr, "%s: not a trace\n", Path);
+        return 2;
+    }
+    printf("# flags %02X:%s%s%s\n", Trace.Flags,
+           (Trace.Flags & TRACE_HAS_RX) ? " rx" : "",
+           (Trace.Flags & TRACE_HAS_TX) ? " tx" : "",
+           (Trace.Flags & TRACE_HAS_OUTPUTS) ? " outputs" : "");
+    while ((Result = Trace_Read(&Trace, &Record)) == 1){
+        printf("%12.3f %-3s", Record.Time*1e-3, TypeNames[Record.Type]);
+        if (Record.Type == TRACE_OUTPUT){
+            printf(" %s=%u", Trace.Names[Record.Data[0]], Record.Data[1]);
+        } else {
+            for (uint8_t i=0; i<Record.Length; i++){
+                printf(" %02X", Record.Data[i]);
+            }
+        }
+        printf("\n");
+    }
+    Trace_Close(&Trace);
+    if (Result < 0){
+        fprintf(stderr, "%s: corrupt record\n", Path);
+        return 1;
+    }
+    return 0;
+}
+
+static int ImportCSV(int argc, char **argv)
+{
+    const char *RxName = NULL;
+    const char *TxName = NULL;
+    int Direction = NO_COLUMN;
+    char Line[MAX_LINE];
+    char *Fields[MAX_FIELDS];
+    int NumFields;
+    int TimeColumn, DataColumn, NameColumn;
+    double FirstTime = 0;
+    bool isFirst = true;
+    unsigned long LineNumber = 1;
+    unsigned long NumBytes = 0;
+    FILE *pCSV;
+    Trace_t Trace;
+    int i;
+
+    for (i=1; (i<argc - 2) && (argv[i][0] == '-'); i+=2){
+        if (strcmp(argv[i], "-r") == 0){
+            RxName = argv[i + 1];
+        } else if (strcmp(argv[i], "-t") == 0){
+            TxName = argv[i + 1];
+        } else if (strcmp(argv[i], "-d") == 0){
+            Direction = (strcmp(argv[i + 1], "tx") == 0) ? TRACE_TX : TRACE_RX;
+        } else {
+            Usage();
+            return 2;
+        }
+    }
+    if (i != argc - 2){
+        Usage();
+        return 2;
+    }
+    pCSV = fopen(argv[i], "r");
+    if ((pCSV == NULL) || (fgets(Line, sizeof(Line), pCSV) == NULL)){
+        perror(argv[i]);
+        return 2;
+    }
+    NumFields = SplitCSV(Line, Fields);
+    TimeColumn = FindColumn(Fields, NumFields, "start_time", "Time [s]");
+    DataColumn = FindColumn(Fields, NumFields, "data", "Value");
+    NameColumn = FindColumn(Fields, NumFields, "name", "Analyzer Name");
+    if ((TimeColumn == NO_COLUMN) || (DataColumn == NO_COLUMN)){
+        fprintf(stderr, "%s: no time or data column in the header\n", argv[i]);
+        return 2;
+    }
+    if ((NameColumn == NO_COLUMN) && (Direction == NO_COLUMN)){
+        Direction = TRACE_RX;
+    }
+    if (!Trace_Create(&Trace, argv[i + 1],
+            ((NameColumn == NO_COLUMN) ? ((Direction == TRACE_TX) ? TRACE_HAS_TX : TRACE_HAS_RX)
+                    : ((RxName ? TRACE_HAS_RX : 0) | (TxName ? TRACE_HAS_TX : 0))),
+            NULL, 0)){
+        perror(argv[i + 1]);
+        return 2;
+    }
+    while (fgets(Line, sizeof(Line), pCSV) != NULL){
+        int Type = Direction;
+        double Time;
+        char *pEnd;
+        unsigned long Byte;
+        LineNumber++;
+        NumFields = SplitCSV(Line, Fields);
+        if ((NumFields <= TimeColumn) || (NumFields <= DataColumn)
+                || ((NameColumn != NO_COLUMN) && (NumFields <= NameColumn))){
+            continue;
+        }
+        if (NameColumn != NO_COLUMN){
+            if ((RxName != NULL) && (strcmp(Fields[NameColumn], RxName) == 0)){
+                Type = TRACE_RX;
+            } else if ((TxName != NULL) && (strcmp(Fields[NameColumn], TxName) == 0)){
+                Type = TRACE_TX;
+            } else {
+                continue; // another analyzer, or a non-data row
+            }
+        }
+        Time = strtod(Fields[TimeColumn], &pEnd);
+        Byte = strtoul(Fields[DataColumn], NULL, 16);
+        if ((pEnd == Fields[TimeColumn]) || (Byte > 0xFF)){
+            fprintf(stderr, "line %lu: cannot read time or byte\n", LineNumber);
+            continue;
+        }
+        if (isFirst){
+            FirstTime = Time;
+            isFirst = false;
+        }
+        Trace_WriteByte(&Trace, (uint8_t)Type, (uint64_t)((Time - FirstTime)*1e6 + 0.5),
+                        (uint8_t)Byte);
+        NumBytes++;
+    }
+    fclose(pCSV);
+    if (!Trace_Close(&Trace)){
+        perror(argv[i + 1]);
+        return 2;
+    }
+    fprintf(stderr, "%lu bytes\n", NumBytes);
+    return 0;
+}
+
+// SplitCSV: split a line in place, dropping quotes and surrounding spaces
+static int SplitCSV(char *Line, char **pFields)
+{
+    int NumFields = 0;
+    char *p = Line;
+    while ((*p != '\0') && (NumFields < MAX_FIELDS)){
+        char *pField;
+        char *pEnd;
+        while (isspace((unsigned char)*p)){
+            p++;
+        }
+        if (*p == '"'){
+            pField = ++p;
+            while ((*p != '\0') && (*p != '"')){
+                p++;
+            }
+            pEnd = p;
+            if (*p == '"'){
+                p++;
+            }
+            while ((*p != '\0') && (*p != ',')){
+                p++;
+            }
+        } else {
+            pField = p;
+            while ((*p != '\0') && (*p != ',') && (*p != '\n') && (*p != '\r')){
+                p++;
+            }
+            pEnd = p;
+            while ((pEnd > pField) && isspace((unsigned char)pEnd[-1])){
+                pEnd--;
+            }
+        }
+        if (*p == ','){
+            p++;
+        } else {
+            *p = '\0';
+        }
+        *pEnd = '\0';
+        pFields[NumFields++] = pField;
+    }
+    return NumFields;
+}
+
+static int FindColumn(char **pFields, int NumFields, const char *Name1, const char *Name2)
+{
+    for (int i=0; i<NumFields; i++){
+        if ((strcmp(pFields[i], Name1) == 0) || (strcmp(pFields[i], Name2) == 0)){
+            return i;
+        }
+    }
+    return NO_COLUMN;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: tracetool dump TRACE\n"
+                    "       tracetool csv [-r NAME] [-t NAME] [-d rx|tx] CSV TRACE\n");
+}
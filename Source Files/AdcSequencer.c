@@ -0,0 +1,181 @@
+/****************************************************************************
+ Module
+   AdcSequencer.c
+
+ Description
+   Interrupt driven scan of the analog inputs: team select resistor,
+   battery voltage and motor current, each filtered and kept for reading
+   at any time.
+
+ Notes
+   The interrupt routine calls ADC_ISR whenever TMR6IF or ADIF is set.
+   Each entry in the scan list takes two interrupts:
+     - ADIF: the last conversion is done; filter it in, select the next
+       input and start Timer6 on its acquisition time
+     - TMR6IF: the input has settled; stop Timer6 and start the conversion
+   After the last entry Timer6 runs out ADC_SCAN_REST_US instead, so a scan
+   starts about every 2.1 ms: some 2800 short interrupts a second.
+
+   SLEEP stops Timer6 along with Fosc, so the scan stands still while the
+   craft sleeps and carries on where it was when it wakes; the values are
+   the ones from before. PowerManager does not sleep with a conversion
+   under way.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <xc.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "PIC16F1788.h"
+#include "AdcSequencer.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+// Timer6 at Fosc/4 with a 1:16 prescaler, 8 us a count
+#define FOSC 8000000
+#define T6_US ((4*16) / (FOSC/1000000))
+#define T6_PR6(Us) ((Us) / T6_US - 1)
+
+typedef char ADC_AssertRest[(T6_PR6(ADC_SCAN_REST_US) <= 255) ? 1 : -1];
+
+typedef struct {
+    uint8_t Input;   // CHS
+    uint8_t Acquire; // PR6 for the acquisition time
+    uint8_t Shift;   // filter: 0 takes each reading as it is
+} ADCChannel_t;
+
+// the scan list; the divider and sense resistor need longer to settle
+static const ADCChannel_t Channels[ADC_NUM_CHANNELS] = {
+    [ADC_CH_TEAM]    = { ADC_AN_TEAM,    T6_PR6(24), 0 },
+    [ADC_CH_BATTERY] = { ADC_AN_BATTERY, T6_PR6(56), 3 },
+    [ADC_CH_CURRENT] = { ADC_AN_CURRENT, T6_PR6(16), 2 },
+};
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void Acquire(uint8_t Entry, uint8_t Period);
+
+/*---------------------------- Module Variables ---------------------------*/
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL ADCContext_t *pADCContext;
+#define Scan (*pADCContext)
+#else
+static ADCContext_t Scan;
+#endif
+
+/*------------------------------ Module Code ------------------------------*/
+/***********************************
+            Init function
+ ***********************************/
+// Called from InitPairingSM; the first reading of each input is in within
+// a few hundred microseconds
+void InitADCSequencer(void)
+{
+    //Port configuration: analog inputs, no pull-up on the team resistor
+    ANSB3 = 1;
+    TRISB3 = 1;
+    WPUB3 = 0;
+    ANSB1 = 1;
+    TRISB1 = 1;
+    ANSB2 = 1;
+    TRISB2 = 1;
+    //Use a single ended ADC converter by setting all of CHSN<3:0> bits in ADCON2 register
+    CHSN0 = 1;
+    CHSN1 = 1;
+    CHSN2 = 1;
+    CHSN3 = 1;
+    //VDD and VSS references
+    ADPREF0 = 0;
+    ADPREF1 = 0;
+    ADNREF = 0;
+    //FOSC/8, the fastest conversion clock allowed at 8 MHz
+    ADCS2 = 0;
+    ADCS1 = 0;
+    ADCS0 = 1;
+    //Format the results as sign and magnitude so that we can just read the high byte and still get 8-bit resolution
+    ADFM = 0;
+    ADRMD = 1;
+    ADON = 1;
+    //Timer6 times the acquisitions
+    TMR6ON = 0;
+    T6CKPS0 = 0;
+    T6CKPS1 = 1;
+    //Interrupt Control
+    ADIF = 0;
+    TMR6IF = 0;
+    ADIE = 1;
+    TMR6IE = 1;
+    PEIE = 1;
+    GIE = 1;
+    Acquire(0, Channels[0].Acquire);
+}
+
+/***********************************
+           Interrupt service
+ ***********************************/
+void ADC_ISR(void)
+{
+    if (TMR6IF){
+        TMR6IF = 0;
+        TMR6ON = 0;
+        GO_nDONE = 1;
+    }
+    if (ADIF){
+        uint8_t Next = Scan.Current + 1;
+        ADIF = 0;
+        ADC_Publish(Scan.Current, ADRESH);
+        if (Next == ADC_NUM_CHANNELS){
+            // rest before the next scan, long enough to settle as well
+            Scan.Scans++;
+            Acquire(0, T6_PR6(ADC_SCAN_REST_US));
+        } else {
+            Acquire(Next, Channels[Next].Acquire);
+        }
+    }
+}
+
+/* ADC_Publish: filter a reading into an entry of the scan list. The ISR
+ * uses it for every conversion; the cycle benchmark, which runs with
+ * interrupts off, uses it to stand in for the team resistor.
+ */
+void ADC_Publish(uint8_t Channel, uint8_t Reading)
+{
+    uint8_t Shift = Channels[Channel].Shift;
+    uint8_t Mask = (uint8_t)(1 << Channel);
+    if (Scan.ValidMask & Mask){
+        Scan.Filter[Channel] -= Scan.Filter[Channel] >> Shift;
+        Scan.Filter[Channel] += Reading;
+    } else {
+        // start the filter at the first reading, not at zero
+        Scan.Filter[Channel] = (uint16_t)Reading << Shift;
+        Scan.ValidMask |= Mask;
+    }
+    Scan.Value[Channel] = (uint8_t)(Scan.Filter[Channel] >> Shift);
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+// Acquire: connect an entry's input and give it Period+1 Timer6 counts to
+// settle before converting
+static void Acquire(uint8_t Entry, uint8_t Period){
+    uint8_t Input = Channels[Entry].Input;
+    Scan.Current = Entry;
+    CHS0 = Input & 0x01;
+    CHS1 = (Input >> 1) & 0x01;
+    CHS2 = (Input >> 2) & 0x01;
+    CHS3 = (Input >> 3) & 0x01;
+    CHS4 = (Input >> 4) & 0x01;
+    TMR6 = 0;
+    PR6 = Period;
+    TMR6ON = 1;
+}
+
+// public getter functions
+uint8_t getADCValue(uint8_t Channel){
+    return Scan.Value[Channel];
+}
+
+bool getADCValid(uint8_t Channel){
+    return (Scan.ValidMask & (1 << Channel)) != 0;
+}
+
+uint16_t getADCScans(void){
+    return Scan.Scans;
+}
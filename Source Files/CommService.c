@@ -6,7 +6,13 @@
    Communication from TIVA to XBee
 
  Notes
-
+   Received bytes are followed twice. The state table below takes them one
+   event at a time, behind whatever the higher priority services have
+   queued. TrackByte follows the same frames as the bytes are posted, in
+   the receive interrupt, and hands every complete frame that could carry
+   an e-brake to FastBrake, so a stop waits for nothing but its own last
+   byte. TrackByte drops what it cannot check, and leaves everything else
+   to the state table.
 ****************************************************************************/
 /*----------------------------- Include Files -----------------------------*/
 /* include header files for this state machine as well as any machines at the
@@ -20,59 +26,152 @@
 #include "PIC16F1788.h"
 #include "MotorControl.h"
 #include "PairingSM.h"
+#include "StateTable.h"
+#include "FlightRecorder.h"
+#include "AdcSequencer.h"
 
 /*----------------------------- Module Defines ----------------------------*/
-#define REQ_PAIR 0x00
-#define ENCR_KEY 0x01
-#define INCOMING_PCKT 0x81
+#define NUM_STATES (SuckUpPacket + 1)
+#define ANY_STATE SM_ANY_STATE(NUM_STATES)
 
 /*---------------------------- Module Functions ---------------------------*/
 static void initBRG( void);
 static void initTXUART( void);
 static void initRXUART( void);
-static void SendPacket(uint8_t);
-static void BuildPacket(uint8_t);
+static void SendPacket(uint8_t WhichData, const uint8_t *pVars);
+static uint8_t SendHeader(uint8_t RFLength, uint8_t DestMSB, uint8_t DestLSB);
+static void SendByte(uint8_t Data);
+static void TrackByte(uint8_t Byte);
+// guards
+static bool IsCommTimeout(const ES_Event *pEvent);
+static bool Is7E(const ES_Event *pEvent);
+static bool IsZero(const ES_Event *pEvent);
+static bool IsMoreToCome(const ES_Event *pEvent);
+static bool FitsBuffer(const ES_Event *pEvent);
+// actions
+static void SendStatus(const ES_Event *pEvent);
+#if DEBUG_SERVICES
+static void SendDebug1(const ES_Event *pEvent);
+static void SendDebug2(const ES_Event *pEvent);
+#endif
+static void SendDumpFrame(const ES_Event *pEvent);
+static void SendTelemetry(const ES_Event *pEvent);
+static void StartComm(const ES_Event *pEvent);
+static void StartByteTimer(const ES_Event *pEvent);
+static void StartPacket(const ES_Event *pEvent);
+static void StoreByte(const ES_Event *pEvent);
+static void FinishPacket(const ES_Event *pEvent);
 
 /*---------------------------- Module Variables ---------------------------*/
-static CommServiceState_t CurrentState;
-static uint8_t MyPriority;
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL CommContext_t *pCommContext;
+#define Comm (*pCommContext)
+#else
+static CommContext_t Comm;
+#endif
 
-static uint8_t ReceiveLength;  // length of array that we are receiving
-static uint8_t ReceiveCounter; // index of array that we are currently writing
-static uint8_t ReceiveArray[50]; // RecvArray: holds bytes from received packet
-static uint8_t ReceiveCheckSum = 0; //keeps running total of data bytes received
-static uint8_t RecvDataLength; // length of RF data portion of packet
-static uint8_t ThisData;
+// List different data arrays here
+enum { PAIRED_NO_ERROR,    // STATUS1
+       PAIRED_DEC_ERROR,   // STATUS2
+       UNPAIRED_NO_ERROR,  // STATUS3
+       UNPAIRED_DEC_ERROR, // STATUS4
+#if DEBUG_SERVICES
+       DEBUG1,             // DEBUG message
+       DEBUG2,             // DEBUG message
+#endif
+       NUM_TEMPLATES };
 
-static uint8_t PACAddressLSB;
-static uint8_t PACAddressMSB;
+/* RF data templates, kept in flash. Only the message type and code are
+ * fixed; the remaining Length-2 bytes (encrypted checksum first) are passed
+ * to SendPacket when the message goes out.
+ */
+typedef struct {
+    uint8_t Length; // RF data bytes, including the variable ones
+    uint8_t Type;
+    uint8_t Code;
+} MsgTemplate_t;
 
-// initialize a pointer to ReceiveArray's location in memory
-static uint8_t *recvPointer;
+static const MsgTemplate_t MsgTemplates[NUM_TEMPLATES] = {
+    {3,   0x03,0x01} ,          // Paired with no decrypt error
+    {3,   0x03,0x03} ,          // Paired with decrypt error
+    {3,   0x03,0x00} ,          // Not Paired with no decrypt error
+    {3,   0x03,0x02} ,          // Not Paired with decrypt error
+#if DEBUG_SERVICES
+    {4,   0x03,0x01} ,          // DEBUG message
+    {5,   0x03,0x02}            // DEBUG message
+#endif
+};
 
-// List different data arrays here
-#define PAIRED_NO_ERROR 0x00; // STATUS1
-#define PAIRED_DEC_ERROR 0x01; // STATUS2
-#define UNPAIRED_NO_ERROR 0x02; // STATUS3
-#define UNPAIRED_DEC_ERROR 0x03; // STATUS4
-#define DEBUG1 0x04; // DEBUG message
-#define DEBUG2 0x05 // DEBUG message
-
-static uint8_t DataArrays[6][6] = {
-    // first entry in each row is the length of the data
-    {5,   0x03,0x01,0x00} ,          // Paired with no decrypt error
-    {3,   0x03,0x03,0x00} ,          // Paired with decrypt error
-    {5,   0x03,0x00,0x00} ,          // Not Paired with no decrypt error
-    {3,   0x03,0x02,0x00} ,          // Not Paired with decrypt error
-    {4,   0x03,0x01,0x00,0x00},         // DEBUG message
-    {5,   0x03,0x02,0x00,0x00,0x00}     // DEBUG message
+/*------------------------------ State Table ------------------------------*/
+// row numbers (1-based) of the first transition for each (state, event) pair
+enum { INIT_INIT = 1, W7E_BYTE, MSB_BYTE, MSB_TIMEOUT = MSB_BYTE + 2,
+       LSB_BYTE, LSB_TIMEOUT = LSB_BYTE + 2, SUCK_BYTE, SUCK_TIMEOUT = SUCK_BYTE + 2,
+       ANY_STATUS1, ANY_STATUS3, ANY_STATUS4, ANY_DUMP, ANY_TELEMETRY,
+#if DEBUG_SERVICES
+       ANY_DEBUG1, ANY_DEBUG2, NUM_ROWS = ANY_DEBUG2 };
+#else
+       NUM_ROWS = ANY_TELEMETRY };
+#endif
+
+static const SM_Transition_t CommRows[NUM_ROWS] = {
+    { InitComm,     ES_INIT,         NULL,          StartComm,      WaitFor7E },
+    { WaitFor7E,    ES_ReceivedByte, Is7E,          StartByteTimer, WaitForMSB },
+    { WaitForMSB,   ES_ReceivedByte, IsZero,        StartByteTimer, WaitForLSB },
+    { WaitForMSB,   ES_ReceivedByte, NULL,          NULL,           WaitFor7E },
+    { WaitForMSB,   ES_TIMEOUT,      IsCommTimeout, NULL,           WaitFor7E },
+    // drop frames that would not fit in the receive buffer
+    { WaitForLSB,   ES_ReceivedByte, FitsBuffer,    StartPacket,    SuckUpPacket },
+    { WaitForLSB,   ES_ReceivedByte, NULL,          NULL,           WaitFor7E },
+    { WaitForLSB,   ES_TIMEOUT,      IsCommTimeout, NULL,           WaitFor7E },
+    { SuckUpPacket, ES_ReceivedByte, IsMoreToCome,  StoreByte,      SM_SAME_STATE },
+    { SuckUpPacket, ES_ReceivedByte, NULL,          FinishPacket,   WaitFor7E },
+    { SuckUpPacket, ES_TIMEOUT,      IsCommTimeout, NULL,           WaitFor7E },
+    // transmit requests are handled the same way in every state
+    { ANY_STATE,    ES_STATUS1,      NULL,          SendStatus,     SM_SAME_STATE },
+    { ANY_STATE,    ES_STATUS3,      NULL,          SendStatus,     SM_SAME_STATE },
+    { ANY_STATE,    ES_STATUS4,      NULL,          SendStatus,     SM_SAME_STATE },
+    { ANY_STATE,    ES_DUMP_RECORDER, NULL,         SendDumpFrame,  SM_SAME_STATE },
+    { ANY_STATE,    ES_TELEMETRY,    NULL,          SendTelemetry,  SM_SAME_STATE },
+#if DEBUG_SERVICES
+    // the debug frames stand in for STATUS1 and STATUS4, see PairingSM
+    { ANY_STATE,    ES_DEBUG1,       NULL,          SendDebug1,     SM_SAME_STATE },
+    { ANY_STATE,    ES_DEBUG2,       NULL,          SendDebug2,     SM_SAME_STATE },
+#endif
 };
 
-// PacketArray to hold transmit data (set to hold max number of possible bytes)
-static uint8_t TransmitArray[20];
-static uint8_t Checksum = 0;
-static uint8_t DataLength = 0;
-static uint8_t PacketLength = 0;
+static const uint8_t CommIndex[SM_INDEX_SIZE(NUM_STATES)] = {
+    [SM_INDEX(InitComm,     ES_INIT)]         = INIT_INIT,
+    [SM_INDEX(WaitFor7E,    ES_ReceivedByte)] = W7E_BYTE,
+    [SM_INDEX(WaitForMSB,   ES_ReceivedByte)] = MSB_BYTE,
+    [SM_INDEX(WaitForMSB,   ES_TIMEOUT)]      = MSB_TIMEOUT,
+    [SM_INDEX(WaitForLSB,   ES_ReceivedByte)] = LSB_BYTE,
+    [SM_INDEX(WaitForLSB,   ES_TIMEOUT)]      = LSB_TIMEOUT,
+    [SM_INDEX(SuckUpPacket, ES_ReceivedByte)] = SUCK_BYTE,
+    [SM_INDEX(SuckUpPacket, ES_TIMEOUT)]      = SUCK_TIMEOUT,
+    [SM_INDEX(ANY_STATE,    ES_STATUS1)]      = ANY_STATUS1,
+    [SM_INDEX(ANY_STATE,    ES_STATUS3)]      = ANY_STATUS3,
+    [SM_INDEX(ANY_STATE,    ES_STATUS4)]      = ANY_STATUS4,
+    [SM_INDEX(ANY_STATE,    ES_DUMP_RECORDER)] = ANY_DUMP,
+    [SM_INDEX(ANY_STATE,    ES_TELEMETRY)]    = ANY_TELEMETRY,
+#if DEBUG_SERVICES
+    [SM_INDEX(ANY_STATE,    ES_DEBUG1)]       = ANY_DEBUG1,
+    [SM_INDEX(ANY_STATE,    ES_DEBUG2)]       = ANY_DEBUG2,
+#endif
+};
+
+#ifdef SM_COVERAGE
+static uint16_t CommHits[NUM_ROWS];
+#endif
+
+static const SM_Table_t CommTable = {
+    CommRows, CommIndex, NUM_ROWS, NUM_STATES,
+#ifdef SM_COVERAGE
+    CommHits,
+#endif
+#ifdef SM_DUMP
+    "CommService",
+#endif
+};
 
 /*------------------------------ Module Code ------------------------------*/
 /***********************************
@@ -80,11 +179,13 @@ static uint8_t PacketLength = 0;
  ***********************************/
 bool InitCommService ( uint8_t Priority )
 {
-    MyPriority = Priority;
+    // the first firmware service to start, so the recorder is ready before
+    // anything posts
+    InitFlightRecorder();
+    Comm.MyPriority = Priority;
     // put us into the Initial PseudoState
-    CurrentState = InitComm;
-    // pull in pointer to receive array
-    recvPointer = &ReceiveArray[0];
+    Comm.CurrentState = InitComm;
+    Comm.FastCount = 0;
     // init UART hardware
     initBRG();    //Configure the baudrate generator
     initRXUART(); //Init EUSART module for RX
@@ -101,7 +202,16 @@ bool InitCommService ( uint8_t Priority )
  ***********************************/
 bool PostCommService( ES_Event ThisEvent )
 {
-  return ES_PostToService( MyPriority, ThisEvent);
+  bool isPosted = ES_PostToService( Comm.MyPriority, ThisEvent);
+  if (isPosted && (ThisEvent.EventType == ES_ReceivedByte)){
+      Comm.RxQueued++;
+  }
+  if (ThisEvent.EventType == ES_ReceivedByte){
+      // a byte the queue had no room for is still on the wire
+      TrackByte(ThisEvent.EventParam);
+  }
+  FR_RecordPost(Comm.MyPriority, &ThisEvent, isPosted);
+  return isPosted;
 }
 
 /***********************************
@@ -111,114 +221,236 @@ ES_Event RunCommService( ES_Event ThisEvent )
 {
     ES_Event ReturnEvent;
     ReturnEvent.EventType = ES_NO_EVENT; // assume no errors
-    CommServiceState_t NextState = CurrentState;
-    /******************   Transmitting   ********************/
-    if ( ThisEvent.EventType == ES_STATUS1 ){
-        ThisData = PAIRED_NO_ERROR;
-        DataArrays[ThisData][0x03] = getEncryptedCHKSM();
-        SendPacket(ThisData);
-    } else if (ThisEvent.EventType == ES_STATUS3) {
-        ThisData = UNPAIRED_NO_ERROR;
-        DataArrays[ThisData][0x03] = getEncryptedCHKSM();
-        SendPacket(ThisData);
-    } else if (ThisEvent.EventType == ES_STATUS4) {
-        ThisData = UNPAIRED_DEC_ERROR;
-        DataArrays[ThisData][0x03] = getEncryptedCHKSM();
-        SendPacket(ThisData);
-    } else if (ThisEvent.EventType == ES_DEBUG1) {
-        // DEBUGGING MESSAGE 
-        ThisData = DEBUG1;
-        DataArrays[ThisData][0x03] = getEncryptedCHKSM();
-        DataArrays[ThisData][0x04] = *(getEncryptionKey() + 31);
-        SendPacket(ThisData);
-    } else if (ThisEvent.EventType == ES_DEBUG2) {
-        // DEBUGGING MESSAGE 
-        ThisData = DEBUG2;
-        DataArrays[ThisData][0x03] = getEncryptedCHKSM();
-        DataArrays[ThisData][0x04] = getCtrlCheckSum();
-        DataArrays[ThisData][0x05] = getCtrlCheckSum2();
-        SendPacket(ThisData);
-    }
-    /********************   Receiving   *********************/
-    switch ( CurrentState )
-    {
-        case InitComm: 
-            if ( ThisEvent.EventType == ES_INIT ){ 
-                NextState = WaitFor7E;
-                ES_Timer_InitTimer( CommTimer, 100 );
-            }
-        break;
-        case WaitFor7E:
-            if ( ThisEvent.EventType == ES_ReceivedByte && ThisEvent.EventParam == 0x7E){  
-                NextState = WaitForMSB;
-                ES_Timer_InitTimer( CommTimer, 200);
-            }
-        break;
-        case WaitForMSB:  
-            if ( ThisEvent.EventType == ES_ReceivedByte && ThisEvent.EventParam == 0x0){  
-                NextState = WaitForLSB;
-                ES_Timer_InitTimer(CommTimer, 200);
-             }
-            else if ( ThisEvent.EventType == ES_ReceivedByte && ThisEvent.EventParam != 0x0){  
-                NextState = WaitFor7E;
-             }
-            else if ( ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == CommTimer){  
-                NextState = WaitFor7E;
-             }
-        break;
-        case WaitForLSB:
-            if ( ThisEvent.EventType == ES_ReceivedByte){  
-                ReceiveLength = ThisEvent.EventParam;
-                ReceiveCounter = ReceiveLength;
-                ReceiveCheckSum = 0;
-                NextState = SuckUpPacket;
-                ES_Timer_InitTimer(CommTimer, 200);
-            }
-            else if ( ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == CommTimer){  
-                NextState = WaitFor7E;
-             }
-         break;
-         case SuckUpPacket:
-            if ( ThisEvent.EventType == ES_ReceivedByte){  
-                if(ReceiveCounter != 0){
-                    ReceiveArray[ReceiveLength-ReceiveCounter] = ThisEvent.EventParam;
-                    ReceiveCheckSum += ThisEvent.EventParam;
-                    ReceiveCounter--;
-                    ES_Timer_InitTimer(CommTimer, 200);
-                } else{
-                    NextState = WaitFor7E;
-                    if (ReceiveCheckSum + ThisEvent.EventParam != 0xFF){
-                        //Raise a flag for bad checksum
-                        LATA3 = 1; // Using RA3 for indicating checksum error
-                    } else{
-                        LATA3 = 0;
-                    }
-                    // if received packet is of type "incoming packet"
-                    if (ReceiveArray[0] == INCOMING_PCKT){
-                        // pull in address LSB and MSB
-                        PACAddressMSB = ReceiveArray[1];
-                        PACAddressLSB = ReceiveArray[2];
-                        RecvDataLength = ReceiveLength - 5;
-                        // post to PairingSM to let it know we got a new packet
-                        ThisEvent.EventType = ES_NEW_PACKET;
-                        ThisEvent.EventParam = RecvDataLength; // pass length of RF data as event parameter
-                        PostPairingSM(ThisEvent);
-                    }
-                }
-            
-            } else if ( ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == CommTimer){  
-                NextState = WaitFor7E;
-            }
-            break;
+    uint8_t NextState = Comm.CurrentState;
+    // receive states change with every byte, so only posts are recorded
+    FR_SetRunning(Comm.MyPriority);
+    if (ThisEvent.EventType == ES_ReceivedByte){
+        Comm.RxQueued--;
+    } else if ((ThisEvent.EventType == ES_TIMEOUT) && (ThisEvent.EventParam == CommTimer)){
+        // the line went quiet mid-frame, start over with the state table
+        Comm.FastCount = 0;
     }
-    CurrentState = NextState;                  
+    SM_Dispatch(&CommTable, &NextState, &ThisEvent);
+    Comm.CurrentState = NextState;
+    FR_SetRunning(FR_NO_SERVICE);
     return ReturnEvent;
 }
 
+#ifdef SM_DUMP
+bool DumpCommService(void)
+{
+    return SM_Dump(&CommTable);
+}
+#endif
+
+/*--------------------------------- Guards --------------------------------*/
+static bool IsCommTimeout(const ES_Event *pEvent){
+    return (pEvent->EventParam == CommTimer);
+}
+
+static bool Is7E(const ES_Event *pEvent){
+    return (pEvent->EventParam == 0x7E);
+}
+
+static bool IsZero(const ES_Event *pEvent){
+    return (pEvent->EventParam == 0x0);
+}
+
+static bool IsMoreToCome(const ES_Event *pEvent){
+    return (Comm.ReceiveCounter != 0);
+}
+
+// the length byte is the only thing standing between a frame and the end
+// of the receive buffer, so this is the one place it gets checked
+static bool FitsBuffer(const ES_Event *pEvent){
+    return (pEvent->EventParam <= RECV_BUFFER_SIZE);
+}
+
+/*--------------------------------- Actions -------------------------------*/
+/******************   Transmitting   ********************/
+static void SendStatus(const ES_Event *pEvent){
+    uint8_t Vars[1];
+    Vars[0] = getEncryptedCHKSM();
+    if (pEvent->EventType == ES_STATUS1){
+        SendPacket(PAIRED_NO_ERROR, Vars);
+    } else if (pEvent->EventType == ES_STATUS3){
+        SendPacket(UNPAIRED_NO_ERROR, Vars);
+    } else {
+        SendPacket(UNPAIRED_DEC_ERROR, Vars);
+    }
+}
+
+#if DEBUG_SERVICES
+static void SendDebug1(const ES_Event *pEvent){
+    // DEBUGGING MESSAGE 
+    uint8_t Vars[2];
+    Vars[0] = getEncryptedCHKSM();
+    Vars[1] = *(getEncryptionKey() + 31);
+    SendPacket(DEBUG1, Vars);
+}
+
+static void SendDebug2(const ES_Event *pEvent){
+    // DEBUGGING MESSAGE 
+    uint8_t Vars[3];
+    Vars[0] = getEncryptedCHKSM();
+    Vars[1] = getCtrlCheckSum();
+    Vars[2] = getCtrlCheckSum2();
+    SendPacket(DEBUG2, Vars);
+}
+#endif
+
+/* SendDumpFrame: send frame EventParam of the flight recorder dump to
+ * whoever asked for it, then queue the next one so other events get a
+ * look in between frames
+ */
+static void SendDumpFrame(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    uint8_t Count = getFRCount();
+    uint8_t NumFrames = (Count + FR_ENTRIES_PER_DUMP - 1) / FR_ENTRIES_PER_DUMP;
+    uint8_t First = pEvent->EventParam * FR_ENTRIES_PER_DUMP;
+    uint8_t NumEntries = Count - First;
+    uint8_t Checksum;
+    if (NumFrames == 0){
+        NumFrames = 1; // an empty buffer still gets an answer
+    }
+    if (First > Count){
+        NumEntries = 0;
+    } else if (NumEntries > FR_ENTRIES_PER_DUMP){
+        NumEntries = FR_ENTRIES_PER_DUMP;
+    }
+    Checksum = SendHeader(FR_DUMP_OVERHEAD + NumEntries*sizeof(FR_Entry_t),
+                          getFRDumpMSB(), getFRDumpLSB());
+    SendByte(FR_DUMP_TYPE);
+    SendByte(pEvent->EventParam);
+    SendByte(NumFrames);
+    SendByte(getFRCause());
+    SendByte(getFRBaseMSB());
+    Checksum += FR_DUMP_TYPE + pEvent->EventParam + NumFrames + getFRCause() + getFRBaseMSB();
+    for (uint8_t i=0; i<NumEntries; i++){
+        const uint8_t *pBytes = (const uint8_t *)getFREntry(First + i);
+        for (uint8_t j=0; j<sizeof(FR_Entry_t); j++){
+            SendByte(pBytes[j]);
+            Checksum += pBytes[j];
+        }
+    }
+    SendByte(0xff - Checksum);
+    if (pEvent->EventParam + 1 < NumFrames){
+        ThisEvent.EventType = ES_DUMP_RECORDER;
+        ThisEvent.EventParam = pEvent->EventParam + 1;
+        PostCommService(ThisEvent);
+    } else {
+        FR_DumpDone();
+    }
+}
+
+// SendTelemetry: the latest battery, motor current and team readings, to
+// the PAC we are paired with
+static void SendTelemetry(const ES_Event *pEvent){
+    uint8_t Vars[TELEMETRY_LENGTH];
+    uint8_t Checksum = SendHeader(TELEMETRY_LENGTH, getPairAddressMSB(), getPairAddressLSB());
+    Vars[0] = TELEMETRY_TYPE;
+    Vars[1] = getADCValue(ADC_CH_BATTERY);
+    Vars[2] = getADCValue(ADC_CH_CURRENT);
+    Vars[3] = getADCValue(ADC_CH_TEAM);
+    for (uint8_t i=0; i<TELEMETRY_LENGTH; i++){
+        SendByte(Vars[i]);
+        Checksum += Vars[i];
+    }
+    SendByte(0xff - Checksum);
+}
+
+/********************   Receiving   *********************/
+static void StartByteTimer(const ES_Event *pEvent){
+    ES_Timer_InitTimer( CommTimer, 200);
+}
+
+static void StartComm(const ES_Event *pEvent){
+    ES_Timer_InitTimer( CommTimer, 100 );
+}
+
+static void StartPacket(const ES_Event *pEvent){
+    Comm.ReceiveLength = pEvent->EventParam;
+    Comm.ReceiveCounter = Comm.ReceiveLength;
+    Comm.ReceiveCheckSum = 0;
+    ES_Timer_InitTimer(CommTimer, 200);
+}
+
+static void StoreByte(const ES_Event *pEvent){
+    Comm.RecvFrame.Bytes[Comm.ReceiveLength-Comm.ReceiveCounter] = pEvent->EventParam;
+    Comm.ReceiveCheckSum += pEvent->EventParam;
+    Comm.ReceiveCounter--;
+    ES_Timer_InitTimer(CommTimer, 200);
+}
+
+// FinishPacket: the event holds the checksum byte
+static void FinishPacket(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    if (Comm.ReceiveCheckSum + pEvent->EventParam != 0xFF){
+#if DEBUG_PIN
+        //Raise a flag for bad checksum
+        LATA3 = 1; // Using RA3 for indicating checksum error
+#endif
+        // and drop it, nothing downstream should see a corrupt frame
+        return;
+    }
+#if DEBUG_PIN
+    LATA3 = 0;
+#endif
+    // if received packet is of type "incoming packet" and carries RF data
+    if ((Comm.RecvFrame.Rx.ApiId == RX16_API_ID) && (Comm.ReceiveLength >= MIN_RX16_LENGTH)){
+        // pull in address LSB and MSB
+        Comm.PACAddressMSB = Comm.RecvFrame.Rx.SourceMSB;
+        Comm.PACAddressLSB = Comm.RecvFrame.Rx.SourceLSB;
+        Comm.RecvDataLength = Comm.ReceiveLength - sizeof(RX16Header_t);
+        // post to PairingSM to let it know we got a new packet
+        ThisEvent.EventType = ES_NEW_PACKET;
+        ThisEvent.EventParam = Comm.RecvDataLength; // pass length of RF data as event parameter
+        PostPairingSM(ThisEvent);
+    }
+}
+
 
 /***************************************************************************
  private functions
  ***************************************************************************/
+/* TrackByte: follow the receive stream as it is posted, framing it the way
+ * the state table does. Runs in the receive interrupt, so it only keeps
+ * the frames FastBrake wants and checks nothing but the XBee checksum.
+ */
+static void TrackByte(uint8_t Byte){
+    uint8_t Index = Comm.FastCount;
+    Comm.FastCount++;
+    if (Index == 0){
+        if (Byte != 0x7E){
+            Comm.FastCount = 0;
+        }
+    } else if (Index == 1){
+        if (Byte != 0){
+            Comm.FastCount = 0;
+        }
+    } else if (Index == 2){
+        if (Byte > RECV_BUFFER_SIZE){
+            Comm.FastCount = 0;
+        }
+        Comm.FastLength = Byte;
+        Comm.FastSum = 0;
+    } else if (Index < Comm.FastLength + 3){
+        if (Index - 3 < sizeof(BrakeFrame_t)){
+            Comm.FastFrame.Bytes[Index - 3] = Byte;
+        }
+        Comm.FastSum += Byte;
+    } else {
+        // the checksum byte: the frame is complete
+        Comm.FastCount = 0;
+        if (((uint8_t)(Comm.FastSum + Byte) == 0xFF)
+                && (Comm.FastFrame.Rx.ApiId == RX16_API_ID)
+                && (Comm.FastLength >= MIN_RX16_LENGTH)
+                && (Comm.FastLength <= sizeof(BrakeFrame_t))){
+            FastBrake(&Comm.FastFrame, Comm.FastLength - sizeof(RX16Header_t));
+        }
+    }
+}
+
 //Init EUSART module for Transmitting
 static void initTXUART( void){
     //GPIO config for TX
@@ -255,79 +487,79 @@ static void initBRG( void){
 
 }
 
-/* 
-BuildPacket: takes a data array and builds it into a full transmission packet
+/*
+SendPacket: builds a message from its template and transmits it to the
+Xbee via UART, computing the checksum on the way out
 
-input parameters: uint8_t WhichData (which data to use)
+input parameters: uint8_t WhichData (which template to use)
+                  const uint8_t *pVars (the Length-2 variable bytes)
 
 example function call: 
-    BuildPacket(TESTDATA1);
+    SendPacket(PAIRED_NO_ERROR, Vars);
 */
-
-static void BuildPacket(uint8_t WhichData){
+static void SendPacket(uint8_t WhichData, const uint8_t *pVars){
     // pull in length of data to transmit
-    DataLength = DataArrays[WhichData][0];
-    // calculate total packet length (data length + 9)
-    PacketLength = DataLength + 9;
-    /********************   build PacketArray   *****************/
+    uint8_t DataLength = MsgTemplates[WhichData].Length;
+    // Destination Address = 0x2182 or 0x2082 for our Xbees
+    uint8_t Checksum = SendHeader(DataLength, getPairAddressMSB(), getPairAddressLSB());
+    /********************   RF Data   *****************/
+    SendByte(MsgTemplates[WhichData].Type);
+    Checksum += MsgTemplates[WhichData].Type;
+    SendByte(MsgTemplates[WhichData].Code);
+    Checksum += MsgTemplates[WhichData].Code;
+    for(uint8_t i=0; i<DataLength-2; i++){
+        SendByte(pVars[i]);
+        Checksum += pVars[i];
+    }
+    // Checksum
+    SendByte(0xff - Checksum);
+}
+
+/* SendHeader: send everything of a TX16 frame ahead of its RF data
+ * returns the checksum of the bytes it sent that the checksum covers
+ */
+static uint8_t SendHeader(uint8_t RFLength, uint8_t DestMSB, uint8_t DestLSB){
+    uint8_t Checksum = 0;
     // start delimiter = 0x7E
-    TransmitArray[0] = 0x7e;
+    SendByte(0x7e);
     // MSB of length = 0x00
-    TransmitArray[1] = 0x00;
-    // LSB of length = DataLength+5
-    TransmitArray[2] = DataLength+5;
+    SendByte(0x00);
+    // LSB of length = RFLength+5
+    SendByte(RFLength+5);
+    // the checksum covers everything from here on
     // API Identifier = 0x01
-    TransmitArray[3] = 0x01;
+    SendByte(0x01);
+    Checksum += 0x01;
     // Frame ID = 0x00
-    TransmitArray[4] = 0x00;
-    // Destination Address = 0x2182 or 0x2082 for our Xbees
-    TransmitArray[5] = getPairAddressMSB(); 
-    TransmitArray[6] = getPairAddressLSB();
+    SendByte(0x00);
+    SendByte(DestMSB);
+    Checksum += DestMSB;
+    SendByte(DestLSB);
+    Checksum += DestLSB;
     // Options byte = 0x00
-    TransmitArray[7] = 0x00;
-    // RF Data
-    for(int i=0; i<DataLength; i++){
-        TransmitArray[8+i] = DataArrays[WhichData][i+1];
-    }
-    // Checksum
-    Checksum = 0;
-    for(int i=3; i<8+DataLength; i++){
-        Checksum += TransmitArray[i];
-    }
-    Checksum = 0xff - Checksum;
-    TransmitArray[8+DataLength] = Checksum;
-    /****************   end: build PacketArray   ****************/
+    SendByte(0x00);
+    return Checksum;
 }
 
-/*
-SendPacket: transmits a full packet to Xbee via UART
-
-input parameters: uint8_t WhichData (which data to use)
-
-example function call: 
-    SendPacket(TESTDATA1);
-*/
-static void SendPacket(uint8_t WhichData){
-    // build the packet
-    BuildPacket(WhichData);
-    // send each byte of the packet
-    for(int i=0; i<PacketLength; i++){
-        // load data register
-        TX1REG = TransmitArray[i];
-        // wait for data register to empty
-        while( TRMT == 0 );
-         
-    }
+// SendByte: load the data register and wait for it to go out
+static void SendByte(uint8_t Data){
+    TX1REG = Data;
+    while( TRMT == 0 );
 }
 
-uint8_t* getRecvArray(void){
-    return ReceiveArray;
+const RecvFrame_t* getRecvFrame(void){
+    return &Comm.RecvFrame;
 }
 
 uint8_t getPACAddressLSB(void){
-    return PACAddressLSB;
+    return Comm.PACAddressLSB;
 }
 
 uint8_t getPACAddressMSB(void){
-    return PACAddressMSB;
+    return Comm.PACAddressMSB;
+}
+
+// getCommIdle: between frames, with no received byte waiting in the queue
+bool getCommIdle(void){
+    return (Comm.CurrentState == WaitFor7E) && (Comm.RxQueued == 0);
 }
\ No newline at end of file
@@ -0,0 +1,303 @@
+/****************************************************************************
+ Module
+   ConfigStore.c
+
+ Description
+   Keeps the craft's tunable constants and pairing memory in a versioned,
+   CRC-protected record in the PIC16F1788 data EEPROM.
+
+ Notes
+   The record is read once at init, so the craft knows its team number and
+   last PAC as soon as it powers up. Writes never block: changed bytes are
+   marked pending and the CheckConfigWrite event checker commits them one at
+   a time, starting the next byte only once the previous self-timed write
+   has finished.
+
+   Radio writes come only from the PAC the craft is paired with, encrypted
+   with the session key (see PairingSM). A write only goes in if the whole
+   record still makes sense after it (see IsValid): one bad field and none
+   of the write is kept, so a mistyped frame cannot leave the craft unable
+   to time out a lost link, nor carry that over to the next power-up.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "PIC16F1788.h"
+#include "ConfigStore.h"
+#include "MotorControl.h"
+#include "XBeeFrames.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define CONFIG_EE_ADDR 0x00 // data EEPROM address of the record
+
+// defaults, used when the EEPROM is blank, corrupt or from an older layout
+#define DEFAULT_PAIR_TIMEOUT 45000 // amount of time before pairing times out (in ms)
+#define DEFAULT_XMIT_TIMEOUT 2000
+#define DEFAULT_PWM_FREQ PWM_FREQ
+#define DEFAULT_TEAM_NUMBER 6 // no assigned team
+#define DEFAULT_RESUME_WINDOW 100 // 1 s
+#define DEFAULT_MAX_RESUME_SKIP 5
+
+// what UpdateConfig will accept
+#define MIN_PAIR_TIMEOUT 5000
+#define MAX_PAIR_TIMEOUT 60000
+#define MIN_XMIT_TIMEOUT 100
+#define MAX_XMIT_TIMEOUT 10000
+#define MIN_RESUME_WINDOW 1   // 10 ms
+#define MAX_RESUME_WINDOW 250 // 2.5 s
+// a resume never looks as far round the key as the packets already taken
+#define MAX_RESUME_SKIP (KEY_LENGTH/RF_SIZE(ControlFrame_t) - 1)
+
+#define CRC8_POLY 0x07
+
+typedef char CS_AssertResumeSkip[(DEFAULT_MAX_RESUME_SKIP <= MAX_RESUME_SKIP) ? 1 : -1];
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static uint8_t CalcCRC(void);
+static bool IsValid(const Config_t *pConfig);
+static void LoadDefaults(void);
+static uint8_t ReadEEPROM(uint8_t Address);
+static void StartWriteEEPROM(uint8_t Address, uint8_t Data);
+static void Commit(void);
+
+/*---------------------------- Module Variables ---------------------------*/
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL ConfigStoreContext_t *pConfigStoreContext;
+#define Store (*pConfigStoreContext)
+#else
+static ConfigStoreContext_t Store;
+#endif
+
+// the record viewed as bytes, for CRC and EEPROM transfers
+#define ConfigBytes ((uint8_t *)&Store.Config)
+
+/*------------------------------ Module Code ------------------------------*/
+/***********************************
+            Init function
+ ***********************************/
+// Safe to call from every service init that needs the record; only the
+// first call touches the EEPROM.
+void InitConfigStore(void)
+{
+    if (Store.isLoaded){
+        return;
+    }
+    for (uint8_t i=0; i<sizeof(Config_t); i++){
+        ConfigBytes[i] = ReadEEPROM(CONFIG_EE_ADDR + i);
+    }
+    if ((Store.Config.Version != CONFIG_VERSION)
+            || (Store.Config.Length != sizeof(Config_t))
+            || (Store.Config.CRC != CalcCRC())){
+        LoadDefaults();
+        Commit();
+    }
+    Store.isLoaded = true;
+}
+
+/***********************************
+        Radio update function
+ ***********************************/
+/* UpdateConfig: patch Length bytes of the record starting at Offset and
+ * schedule them for writing. The version, length and CRC bytes cannot be
+ * written directly.
+ * returns false (and changes nothing) if the range is out of bounds or the
+ * patched record fails IsValid
+ */
+bool UpdateConfig(uint8_t Offset, const uint8_t *pData, uint8_t Length)
+{
+    Config_t Patched;
+    if ((Offset < 2) || (Length == 0)
+            || (Length > sizeof(Config_t) - 1)
+            || (Offset > sizeof(Config_t) - 1 - Length)){
+        return false;
+    }
+    Patched = Store.Config;
+    for (uint8_t i=0; i<Length; i++){
+        ((uint8_t *)&Patched)[Offset + i] = pData[i];
+    }
+    if (!IsValid(&Patched)){
+        return false;
+    }
+    Store.Config = Patched;
+    Commit();
+    return true;
+}
+
+/***********************************
+         Event checker
+ ***********************************/
+/* CheckConfigWrite: writes at most one pending byte per call. Never posts an
+ * event, it just rides along with the other event checkers so that EEPROM
+ * writes (~4 ms each) never stall the run loop.
+ */
+bool CheckConfigWrite(void)
+{
+    if (!Store.isWritePending || (WR == 1)){
+        return false;
+    }
+    // skip over bytes that already match what is in EEPROM
+    while (Store.WriteIndex < sizeof(Config_t)){
+        if (ReadEEPROM(CONFIG_EE_ADDR + Store.WriteIndex) != ConfigBytes[Store.WriteIndex]){
+            StartWriteEEPROM(CONFIG_EE_ADDR + Store.WriteIndex, ConfigBytes[Store.WriteIndex]);
+            Store.WriteIndex++;
+            return false;
+        }
+        Store.WriteIndex++;
+    }
+    Store.isWritePending = false;
+    return false;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static uint8_t CalcCRC(void){
+    uint8_t CRC = 0;
+    for (uint8_t i=0; i<sizeof(Config_t)-1; i++){
+        CRC ^= ConfigBytes[i];
+        for (uint8_t j=0; j<8; j++){
+            if (CRC & 0x80){
+                CRC = (CRC << 1) ^ CRC8_POLY;
+            } else {
+                CRC <<= 1;
+            }
+        }
+    }
+    return CRC;
+}
+
+/* IsValid: every field within the limits above. The transmit timeout must
+ * be the shorter one, the PWM frequency one MotorControl can plan, and the
+ * team bands each low below high and in ascending order without overlap.
+ */
+static bool IsValid(const Config_t *pConfig){
+    if ((pConfig->PairTimeout < MIN_PAIR_TIMEOUT) || (pConfig->PairTimeout > MAX_PAIR_TIMEOUT)
+            || (pConfig->XmitTimeout < MIN_XMIT_TIMEOUT) || (pConfig->XmitTimeout > MAX_XMIT_TIMEOUT)
+            || (pConfig->XmitTimeout >= pConfig->PairTimeout)
+            || !MC_CanPlanPWM(pConfig->PwmFreq)
+            || ((pConfig->TeamNumber >= CONFIG_NUM_TEAMS) && (pConfig->TeamNumber != DEFAULT_TEAM_NUMBER))
+            || (pConfig->ResumeWindow < MIN_RESUME_WINDOW) || (pConfig->ResumeWindow > MAX_RESUME_WINDOW)
+            || (pConfig->MaxResumeSkip > MAX_RESUME_SKIP)){
+        return false;
+    }
+    for (uint8_t i=0; i<2*CONFIG_NUM_TEAMS - 1; i++){
+        if (pConfig->TeamThresholds[i] >= pConfig->TeamThresholds[i + 1]){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void LoadDefaults(void){
+    Store.Config.Version = CONFIG_VERSION;
+    Store.Config.Length = sizeof(Config_t);
+    Store.Config.PairTimeout = DEFAULT_PAIR_TIMEOUT;
+    Store.Config.XmitTimeout = DEFAULT_XMIT_TIMEOUT;
+    Store.Config.PwmFreq = DEFAULT_PWM_FREQ;
+    Store.Config.TeamNumber = DEFAULT_TEAM_NUMBER;
+    Store.Config.LastPairMSB = 0x00;
+    Store.Config.LastPairLSB = 0x00;
+    // 2% tolerance bands around the expected readings of each team resistor
+    Store.Config.TeamThresholds[0] = 70;  // Team 1: expected 85.33
+    Store.Config.TeamThresholds[1] = 100;
+    Store.Config.TeamThresholds[2] = 101; // Team 2: expected 125
+    Store.Config.TeamThresholds[3] = 139;
+    Store.Config.TeamThresholds[4] = 140; // Team 3: expected 153.6
+    Store.Config.TeamThresholds[5] = 162;
+    Store.Config.TeamThresholds[6] = 163; // Team 4: expected 170.66
+    Store.Config.TeamThresholds[7] = 190;
+    Store.Config.ResumeWindow = DEFAULT_RESUME_WINDOW;
+    Store.Config.MaxResumeSkip = DEFAULT_MAX_RESUME_SKIP;
+}
+
+// Commit: reseal the record and (re)start the background write
+static void Commit(void){
+    Store.Config.CRC = CalcCRC();
+    Store.WriteIndex = 0;
+    Store.isWritePending = true;
+}
+
+static uint8_t ReadEEPROM(uint8_t Address){
+    EEADRL = Address;
+    CFGS = 0;    // data EEPROM, not configuration space
+    EEPGD = 0;   // data EEPROM, not program flash
+    RD = 1;      // read completes in one cycle
+    return EEDATL;
+}
+
+static void StartWriteEEPROM(uint8_t Address, uint8_t Data){
+    EEADRL = Address;
+    EEDATL = Data;
+    CFGS = 0;
+    EEPGD = 0;
+    WREN = 1;
+    // the unlock sequence must not be interrupted
+    GIE = 0;
+    EECON2 = 0x55;
+    EECON2 = 0xAA;
+    WR = 1;
+    GIE = 1;
+    // WR stays set in hardware until the write finishes
+    WREN = 0;
+}
+
+// public getter functions
+uint16_t getConfigPairTimeout(void){
+    return Store.Config.PairTimeout;
+}
+
+uint16_t getConfigXmitTimeout(void){
+    return Store.Config.XmitTimeout;
+}
+
+uint16_t getConfigPwmFreq(void){
+    return Store.Config.PwmFreq;
+}
+
+uint8_t getConfigTeamNumber(void){
+    return Store.Config.TeamNumber;
+}
+
+uint8_t getConfigLastPairMSB(void){
+    return Store.Config.LastPairMSB;
+}
+
+uint8_t getConfigLastPairLSB(void){
+    return Store.Config.LastPairLSB;
+}
+
+uint8_t getConfigTeamLow(uint8_t Team){
+    return Store.Config.TeamThresholds[2*Team];
+}
+
+uint8_t getConfigTeamHigh(uint8_t Team){
+    return Store.Config.TeamThresholds[2*Team + 1];
+}
+
+uint8_t getConfigResumeWindow(void){
+    return Store.Config.ResumeWindow;
+}
+
+uint8_t getConfigMaxResumeSkip(void){
+    return Store.Config.MaxResumeSkip;
+}
+
+// getConfigWritePending: the record is still being written out to EEPROM
+bool getConfigWritePending(void){
+    return Store.isWritePending;
+}
+
+// public setter functions, each schedules a background write if needed
+void setConfigTeamNumber(uint8_t Team){
+    if (Store.Config.TeamNumber != Team){
+        Store.Config.TeamNumber = Team;
+        Commit();
+    }
+}
+
+void setConfigLastPair(uint8_t PairMSB, uint8_t PairLSB){
+    if ((Store.Config.LastPairMSB != PairMSB) || (Store.Config.LastPairLSB != PairLSB)){
+        Store.Config.LastPairMSB = PairMSB;
+        Store.Config.LastPairLSB = PairLSB;
+        Commit();
+    }
+}
@@ -0,0 +1,189 @@
+/****************************************************************************
+ Module
+   FlightRecorder.c
+
+ Description
+   Ring buffer of recent framework events (posts and state changes) that
+   freezes on the first fault, so the lead-up to an unpair can be dumped
+   over the radio afterwards.
+
+ Notes
+   Recording sits on the path of every post, so it is kept to a few loads
+   and stores: no loops, no division, a power-of-two ring index. Interrupts
+   are held off while an entry is written, since the receive and ADC
+   interrupts post too. Received UART bytes are not recorded, one entry per
+   byte would flush the buffer with every frame; the frame shows up as the
+   ES_NEW_PACKET that follows it.
+
+   The entry format is described in FlightRecorder.h.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "PIC16F1788.h"
+#include "FlightRecorder.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define FR_INDEX_MASK (FR_NUM_ENTRIES - 1)
+#define FR_HEAD(Kind) ((uint8_t)((Kind) << FR_KIND_SHIFT))
+
+typedef char FR_AssertPowerOfTwo[((FR_NUM_ENTRIES & FR_INDEX_MASK) == 0) ? 1 : -1];
+typedef char FR_AssertServices[(NUM_SERVICES <= FR_NO_SERVICE) ? 1 : -1];
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static void Record(uint8_t Head, uint8_t A, uint8_t B);
+static void Write(uint8_t Head, uint8_t A, uint8_t B, uint8_t TimeLSB);
+
+/*---------------------------- Module Variables ---------------------------*/
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL FlightRecorderContext_t *pFlightRecorderContext;
+#define Recorder (*pFlightRecorderContext)
+#else
+static FlightRecorderContext_t Recorder;
+#endif
+
+/*------------------------------ Module Code ------------------------------*/
+/***********************************
+            Init function
+ ***********************************/
+// Called from the first firmware service init, before anything posts
+void InitFlightRecorder(void)
+{
+    Recorder.Running = FR_NO_SERVICE;
+}
+
+/***********************************
+          Recording hooks
+ ***********************************/
+// FR_SetRunning: run functions call this on the way in, and with
+// FR_NO_SERVICE on the way out
+void FR_SetRunning(uint8_t Service)
+{
+    Recorder.Running = Service;
+}
+
+/* FR_RecordPost: called by each Post function with the result of its
+ * ES_PostToService. Freezes on a failed post and on ES_DECRYPT_ERROR.
+ */
+void FR_RecordPost(uint8_t Dest, const ES_Event *pEvent, bool isPosted)
+{
+    uint8_t Source;
+    if (isPosted && (pEvent->EventType == ES_ReceivedByte)){
+        return;
+    }
+    // interrupts are only ever off in an interrupt or before init is done
+    Source = GIE ? Recorder.Running : FR_NO_SERVICE;
+    Record(FR_HEAD(FR_POST) | (Source << FR_SOURCE_SHIFT) | Dest,
+           pEvent->EventType, (uint8_t)pEvent->EventParam);
+    if (!isPosted){
+        FR_Freeze(FR_QUEUE_FULL);
+    } else if (pEvent->EventType == ES_DECRYPT_ERROR){
+        FR_Freeze(FR_DECRYPT_ERROR);
+    }
+}
+
+// FR_RecordState: record a state machine transition, if it is one
+void FR_RecordState(uint8_t Service, uint8_t OldState, uint8_t NewState)
+{
+    if (OldState != NewState){
+        Record(FR_HEAD(FR_STATE) | Service, OldState, NewState);
+    }
+}
+
+// FR_Freeze: stop recording; the first cause sticks until a re-arm
+void FR_Freeze(uint8_t Cause)
+{
+    if (Recorder.Cause == FR_RECORDING){
+        Record(FR_HEAD(FR_FREEZE), Cause, 0);
+        Recorder.Cause = Cause;
+    }
+}
+
+/***********************************
+             Dumping
+ ***********************************/
+/* FR_RequestDump: freeze (if a fault has not already) and remember where
+ * the dump goes. With isRearm the buffer is cleared and recording starts
+ * again once FR_DumpDone says the last of it is out.
+ */
+void FR_RequestDump(uint8_t RequesterMSB, uint8_t RequesterLSB, bool isRearm)
+{
+    FR_Freeze(FR_DUMP_REQUEST);
+    Recorder.DumpMSB = RequesterMSB;
+    Recorder.DumpLSB = RequesterLSB;
+    Recorder.isRearmPending = isRearm;
+}
+
+void FR_DumpDone(void)
+{
+    if (Recorder.isRearmPending){
+        Recorder.Next = 0;
+        Recorder.Count = 0;
+        Recorder.BaseMSB = Recorder.TimeMSB;
+        Recorder.isRearmPending = false;
+        Recorder.Cause = FR_RECORDING;
+    }
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static void Record(uint8_t Head, uint8_t A, uint8_t B){
+    uint16_t Now;
+    uint8_t SavedGIE;
+    if (Recorder.Cause != FR_RECORDING){
+        return;
+    }
+    SavedGIE = GIE;
+    GIE = 0;
+    Now = ES_Timer_GetTime();
+    if ((uint8_t)(Now >> 8) != Recorder.TimeMSB){
+        Recorder.TimeMSB = (uint8_t)(Now >> 8);
+        Write(FR_HEAD(FR_TIME), Recorder.TimeMSB, 0, (uint8_t)Now);
+    }
+    Write(Head, A, B, (uint8_t)Now);
+    GIE = SavedGIE;
+}
+
+static void Write(uint8_t Head, uint8_t A, uint8_t B, uint8_t TimeLSB){
+    FR_Entry_t *pEntry = &Recorder.Entries[Recorder.Next];
+    if (Recorder.Count == FR_NUM_ENTRIES){
+        // overwriting the oldest entry; a time mark there dates the new oldest
+        if ((pEntry->Head >> FR_KIND_SHIFT) == FR_TIME){
+            Recorder.BaseMSB = pEntry->A;
+        }
+    } else {
+        Recorder.Count++;
+    }
+    pEntry->Head = Head;
+    pEntry->A = A;
+    pEntry->B = B;
+    pEntry->TimeLSB = TimeLSB;
+    Recorder.Next = (Recorder.Next + 1) & FR_INDEX_MASK;
+}
+
+// public getter functions, used by CommService to send the dump
+uint8_t getFRCount(void){
+    return Recorder.Count;
+}
+
+// getFREntry: Index 0 is the oldest entry
+const FR_Entry_t* getFREntry(uint8_t Index){
+    return &Recorder.Entries[(Recorder.Next - Recorder.Count + Index) & FR_INDEX_MASK];
+}
+
+uint8_t getFRCause(void){
+    return Recorder.Cause;
+}
+
+uint8_t getFRBaseMSB(void){
+    return Recorder.BaseMSB;
+}
+
+uint8_t getFRDumpMSB(void){
+    return Recorder.DumpMSB;
+}
+
+uint8_t getFRDumpLSB(void){
+    return Recorder.DumpLSB;
+}
@@ -6,36 +6,106 @@
    Give all direct controls to lift fan and thrust motors.
 
  Notes
+   Drive duty cycles are kept in Timer2 counts, the 10-bit CCPRxL:DCxB
+   value, from the stick bytes to the registers: full duty is
+   4*(PR2+1) counts (DutySteps), and nothing goes through percent on the
+   way.
+
+   A batch of drive commands (ES_DRIVE_BATCH) is copied out of PairingSM
+   and carried out on MC_TIMER, each command at its At; the first is due
+   at once. Any new command, batch or plain, replaces what is left of the
+   last batch, so StopDrive stops a batch too.
+
+   MC_EmergencyStop is the one thing here that runs outside RunMC:
+   PairingSM calls it from the receive interrupt as the last byte of a
+   frame carrying the e-brake is posted. It only clears the lift fan and
+   direction pins and the duty registers, each a single write, and counts
+   the brake in Brakes; MC_TIMER, the batch and the duty low bits are left
+   to the main loop. Anything RunMC writes while Brakes is ahead of
+   BrakesReleased is taken back by HoldBrake, which runs after every such
+   write, so a drive command the interrupt landed in the middle of cannot
+   leave a duty behind. Only an ES_LiftFan MC_FAN_ON asked for with the
+   latest count lets go: PairingSM asks after the packet that lifts the
+   brake, and a request made before the interrupt is stale.
+
+   The PWM plan (Timer2 prescaler and PR2) for PWM_FREQ is worked out by
+   the preprocessor, which refuses to build a plan that cannot be met. A
+   frequency set through ConfigStore is planned the same way at power-up;
+   one that cannot be met falls back to the compiled plan. The smallest
+   prescaler that fits gives the most duty steps:
+       PWM_FREQ   prescaler  PR2  duty steps
+       20 kHz     1:1         99     400
+       10 kHz     1:1        199     800
+        7.8 kHz   1:1        255    1024
+        7.5 kHz   1:4         65     264
 
 ****************************************************************************/
 /*----------------------------- Include Files -----------------------------*/
 #include <xc.h>
 #include "ES_Configure.h"
 #include "ES_Framework.h"
+#include "ES_Timers.h"
 #include "PIC16F1788.h"
 #include "MotorControl.h"
 #include <stdio.h>
-#include "bitdefs.h"
 #include "PairingSM.h"
+#include "ConfigStore.h"
+#include "FlightRecorder.h"
+#include "AdcSequencer.h"
 
 /*----------------------------- Module Defines ----------------------------*/
-#define PWM_FREQ 7500 
-#define PR2_VAL (8000000/PWM_FREQ) / (4*4) - 1
+#define FOSC 8000000
+#define PWM_MIN_STEPS 256     // at least 8 bits of duty
+#define PWM_TOLERANCE 2       // percent the frequency may come out high by
+// Timer2 counts in a period at prescaler Pre; Pre is 1, 4, 16 or 64
+#define PWM_PERIOD(Pre, Freq) (FOSC/(4UL*(Pre)*(Freq)))
+
+#if PWM_PERIOD(1, PWM_FREQ) <= 256
+#define PWM_PRESCALE 1
+#elif PWM_PERIOD(4, PWM_FREQ) <= 256
+#define PWM_PRESCALE 4
+#elif PWM_PERIOD(16, PWM_FREQ) <= 256
+#define PWM_PRESCALE 16
+#elif PWM_PERIOD(64, PWM_FREQ) <= 256
+#define PWM_PRESCALE 64
+#else
+#error "PWM_FREQ is too low for Timer2, even at 1:64"
+#define PWM_PRESCALE 64 // only to keep the checks below quiet
+#endif
+#define PWM_PR2 (PWM_PERIOD(PWM_PRESCALE, PWM_FREQ) - 1)
+#define PWM_DUTY_STEPS (4*(PWM_PR2 + 1))
+#if PWM_DUTY_STEPS < PWM_MIN_STEPS
+#error "PWM_FREQ is too high to give PWM_MIN_STEPS duty steps at this Fosc"
+#endif
+// a short period comes out fast; PR2 is a whole number of counts
+#if (FOSC/(4UL*PWM_PRESCALE*(PWM_PR2 + 1)) - PWM_FREQ)*100 > PWM_FREQ*PWM_TOLERANCE
+#error "PWM_FREQ is not within PWM_TOLERANCE of any Timer2 period"
+#endif
+
 #define LSB8_MASK 0xff
 #define LSB2_MASK 0x03
 #define BITS_5and4_MASK 0x30 
+#define BATTERY_FLOOR 148 // 9.0 V: a flatter battery gets no more help than this
 #define FORWARD = 0x01
 #define BACKWARD = 0x00
 
 /*---------------------------- Module Prototypes ---------------------------*/
 static void InitPWM(void);
-static void GetSpeed(void);
+static void SetDrive(int8_t DriveByte, int8_t TurnByte);
+static bool HoldBrake(void);
+static void RunSchedule(void);
+static bool PlanPWM(uint32_t Freq);
+static bool FindPlan(uint32_t Freq, uint8_t *pPrescale, uint16_t *pPeriod);
 static void InitOtherPins(void);
+static int16_t Compensate(int16_t Duty);
 
 /*---------------------------- Module Variables ---------------------------*/
-static uint8_t MyPriority;
-static uint8_t MotorSpeed;
-static int8_t DriveCommand;
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL MCContext_t *pMCContext;
+#define MC (*pMCContext)
+#else
+static MCContext_t MC;
+#endif
 
 /*------------------------------ Framework Code ------------------------------*/
 /***********************************
@@ -43,7 +113,11 @@ static int8_t DriveCommand;
  ***********************************/
 bool InitMC ( uint8_t Priority )
 {
-  MyPriority = Priority;
+  MC.MyPriority = Priority;
+  MC.Brakes = 0;
+  MC.BrakesReleased = 0;
+  // make sure the configured PWM frequency is available
+  InitConfigStore();
   // Initialize PWM hardware
   InitPWM();
   // Init other pins
@@ -57,7 +131,9 @@ bool InitMC ( uint8_t Priority )
  ***********************************/
 bool PostMC( ES_Event ThisEvent ) 
 {
-    return ES_PostToService( MyPriority, ThisEvent);
+    bool isPosted = ES_PostToService( MC.MyPriority, ThisEvent);
+    FR_RecordPost(MC.MyPriority, &ThisEvent, isPosted);
+    return isPosted;
 }
 
 /***********************************
@@ -67,49 +143,25 @@ ES_Event RunMC( ES_Event CurrentEvent )
 {
     ES_Event ReturnEvent;
     ReturnEvent.EventType = ES_NO_EVENT; // assume no errors 
-    static int16_t RightDuty;
-    static int16_t LeftDuty;
-    static int16_t RightDuty2Register;
-    static int16_t LeftDuty2Register;
     if(CurrentEvent.EventType == ES_INIT){
         //ES_Timer_InitTimer(MC_TIMER,10);
     } else if (CurrentEvent.EventType == ES_DRIVE_COMMAND){
-        RightDuty = 100*getDriveByte()/128;
-        LeftDuty = 100*getDriveByte()/128;
-        RightDuty -= (50*getTurnByte()/128);
-        LeftDuty += (50*getTurnByte()/128);
-        if (RightDuty > 99){
-            RightDuty = 99;
-        }
-        else if (RightDuty < -99){
-            RightDuty = -99;
-        }
-        if (LeftDuty > 99){
-            LeftDuty = 99;
+        ES_Timer_StopTimer(MC_TIMER);
+        MC.NumScheduled = 0;
+        SetDrive(getDriveByte(), getTurnByte());
+    } else if (CurrentEvent.EventType == ES_DRIVE_BATCH){
+        const BatchCommand_t *pBatch = getDriveBatch();
+        ES_Timer_StopTimer(MC_TIMER);
+        MC.NumScheduled = (CurrentEvent.EventParam <= CTRL_BATCH_MAX) ? CurrentEvent.EventParam : CTRL_BATCH_MAX;
+        for (uint8_t i=0; i<MC.NumScheduled; i++){
+            MC.Schedule[i] = pBatch[i];
         }
-        else if (LeftDuty < -99){
-            LeftDuty = -99;
-        }
-        RightDuty2Register = RightDuty*4*(PR2_VAL+1)/100;   // This values goes from -MAX to MAX, MAX = 4*(PR2_VAL+1))
-        LeftDuty2Register = LeftDuty*4*(PR2_VAL+1)/100;     // This values goes from -MAX to MAX, MAX = 4*(PR2_VAL+1))
-        //Take care of right motor
-        if (RightDuty2Register < 0) {
-            RightDuty2Register = (100+RightDuty)*4*(PR2_VAL+1)/100; // This would make it positive and inverts the polarity
-            LATC2 = 1;
-        } else {
-            LATC2 = 0;
-        }
-        CCPR2L = (RightDuty2Register >> 2) & LSB8_MASK; // mask bits 2-9 of 16-bit integer before writing to 8-bit register
-        CCP2CON |= (((RightDuty2Register & (LSB2_MASK)) << 4) & BITS_5and4_MASK);
-        //Take care of left motor
-        if (LeftDuty2Register < 0) {
-            LeftDuty2Register = (100+LeftDuty)*4*(PR2_VAL+1)/100; // This would make it positive and inverts the polarity
-            LATC5 = 1;
-        } else {
-            LATC5 = 0;
-        }
-        CCPR3L = (LeftDuty2Register >> 2) & LSB8_MASK; // mask bits 2-9 of 16-bit integer before writing to 8-bit register
-        CCP3CON |= (((LeftDuty2Register & (LSB2_MASK)) << 4) & BITS_5and4_MASK);    
+        MC.NextScheduled = 0;
+        MC.ScheduleAt = 0;
+        RunSchedule();
+    } else if ((CurrentEvent.EventType == ES_TIMEOUT) && (CurrentEvent.EventParam == MC_TIMER)){
+        RunSchedule();
+#if DEBUG_SERVICES
     }else if (CurrentEvent.EventType == ES_LED){
         if (CurrentEvent.EventParam == 0x01){
             //turn on LED
@@ -118,11 +170,17 @@ ES_Event RunMC( ES_Event CurrentEvent )
             //turn off LED
             LATA1 = 0;
         }
+#endif
     }else if (CurrentEvent.EventType == ES_LiftFan){
-        if (CurrentEvent.EventParam == 0x01){
+        if ((CurrentEvent.EventParam & MC_FAN_ON(0)) == MC_FAN_ON(0)){
+            // asked for after the last e-brake, so it lets go of them all
+            if ((uint8_t)CurrentEvent.EventParam == MC.Brakes){
+                MC.BrakesReleased = (uint8_t)CurrentEvent.EventParam;
+            }
             //turn on LiftFan
             LATA0 = 1;
-        }else if (CurrentEvent.EventParam == 0x00){
+            HoldBrake();
+        }else if (CurrentEvent.EventParam == MC_FAN_OFF){
             //turn off LiftFan
             LATA0 = 0;
         }
@@ -130,6 +188,23 @@ ES_Event RunMC( ES_Event CurrentEvent )
     return ReturnEvent;
 }
 
+/***********************************
+          Emergency stop
+ ***********************************/
+/* MC_EmergencyStop: lift fan off and both drives to (all but) zero duty
+ * straight away, and the brake latched. Receive interrupt only: no framework
+ * calls and no read-modify-write of anything RunMC writes.
+ */
+void MC_EmergencyStop(void)
+{
+    LATA0 = 0;
+    LATC2 = 0;
+    LATC5 = 0;
+    CCPR2L = 0;
+    CCPR3L = 0;
+    MC.Brakes++;
+}
+
 /*****************************Helper Functions******************************/
 // InitPWM: function to initialize PWM for drive motors
 static void InitPWM(){
@@ -142,8 +217,14 @@ static void InitPWM(){
     TRISC1 = 0x01;
     TRISC6 = 0x01;
     
-    // Load PR2 register with PWM period
-    PR2 = PR2_VAL;
+    // Load PR2 register with PWM period, falling back to the compiled plan
+    // if the configured frequency cannot be met
+    if (!PlanPWM(getConfigPwmFreq())){
+        MC.PR2Value = PWM_PR2;
+        MC.Prescale = PWM_PRESCALE;
+        MC.DutySteps = PWM_DUTY_STEPS;
+    }
+    PR2 = MC.PR2Value;
     
     // Configure CCP Modules for PWM mode 
     CCP3M0 = 0x00;
@@ -171,8 +252,8 @@ static void InitPWM(){
      * Enable Timer2 by setting TMR2ON in T2CON
      */
     TMR2IF = 0x00;
-    T2CKPS0 = 0x00;
-    T2CKPS1 = 0x01;
+    T2CKPS0 = (MC.Prescale == 4) || (MC.Prescale == 64);
+    T2CKPS1 = (MC.Prescale >= 16);
     TMR2ON = 0x01;
     
     // Enable CCP1 and CCP2 via TRISC
@@ -184,25 +265,172 @@ static void InitPWM(){
     TRISC5 = 0x00;
 }
 
-// GetSpeed: function to decide PWM duty cycle based on input pins
-// input pins: C4, C5, C7 (8 different possible speeds)
-static void GetSpeed(){
-    MotorSpeed = 0x00;
-    if(RC4 == 0x01){
-        MotorSpeed |= BIT0HI;
-        // Debug: toggle A2 
-        //LATA2 ^= 1;
+/* SetDrive: set both drive motors from a drive and a turn byte, as the
+ * PAC sends them
+ */
+static void SetDrive(int8_t DriveByte, int8_t TurnByte){
+    int16_t RightDuty;
+    int16_t LeftDuty;
+    int16_t Drive;
+    int16_t Turn;
+    int16_t Limit = MC.DutySteps - MC.DutySteps/100; // 99%
+    if (HoldBrake()){
+        return;
+    }
+    // full stick is full duty, full turn half of it, all in counts
+    Drive = (int32_t)DriveByte*MC.DutySteps/128;
+    Turn = (int32_t)TurnByte*MC.DutySteps/256;
+    RightDuty = Compensate(Drive - Turn);
+    LeftDuty = Compensate(Drive + Turn);
+    if (RightDuty > Limit){
+        RightDuty = Limit;
+    }
+    else if (RightDuty < -Limit){
+        RightDuty = -Limit;
+    }
+    if (LeftDuty > Limit){
+        LeftDuty = Limit;
+    }
+    else if (LeftDuty < -Limit){
+        LeftDuty = -Limit;
+    }
+    //Take care of right motor
+    if (RightDuty < 0) {
+        RightDuty += MC.DutySteps; // This would make it positive and inverts the polarity
+        LATC2 = 1;
+    } else {
+        LATC2 = 0;
+    }
+    CCPR2L = (RightDuty >> 2) & LSB8_MASK; // mask bits 2-9 of the count before writing to 8-bit register
+    CCP2CON = (CCP2CON & ~BITS_5and4_MASK) | ((RightDuty & LSB2_MASK) << 4);
+    //Take care of left motor
+    if (LeftDuty < 0) {
+        LeftDuty += MC.DutySteps; // This would make it positive and inverts the polarity
+        LATC5 = 1;
+    } else {
+        LATC5 = 0;
+    }
+    CCPR3L = (LeftDuty >> 2) & LSB8_MASK; // mask bits 2-9 of the count before writing to 8-bit register
+    CCP3CON = (CCP3CON & ~BITS_5and4_MASK) | ((LeftDuty & LSB2_MASK) << 4);
+    // the brake may have come in while this was being written
+    HoldBrake();
+}
+
+/* HoldBrake: while the brake is latched, keep the fan and drives off and
+ * finish what MC_EmergencyStop leaves to the main loop
+ * returns true if the brake is latched
+ */
+static bool HoldBrake(void){
+    if (MC.Brakes == MC.BrakesReleased){
+        return false;
     }
-    if(RC5 == 0x01){
-        MotorSpeed |= BIT1HI;
+    ES_Timer_StopTimer(MC_TIMER);
+    MC.NumScheduled = 0;
+    LATA0 = 0;
+    LATC2 = 0;
+    CCPR2L = 0;
+    CCP2CON &= ~BITS_5and4_MASK;
+    LATC5 = 0;
+    CCPR3L = 0;
+    CCP3CON &= ~BITS_5and4_MASK;
+    return true;
+}
+
+/* RunSchedule: carry out the batch commands that are due, the last of them
+ * being the one that counts, and time the next
+ */
+static void RunSchedule(void){
+    const BatchCommand_t *pCommand = NULL;
+    while ((MC.NextScheduled < MC.NumScheduled)
+            && (MC.Schedule[MC.NextScheduled].At <= MC.ScheduleAt)){
+        pCommand = &MC.Schedule[MC.NextScheduled++];
     }
-    if(RC7 == 0x01){
-        MotorSpeed |= BIT2HI;
+    if (pCommand != NULL){
+        SetDrive((int8_t)pCommand->Drive, (int8_t)pCommand->Turn);
+    }
+    if (MC.NextScheduled < MC.NumScheduled){
+        ES_Timer_InitTimer(MC_TIMER, (uint16_t)(MC.Schedule[MC.NextScheduled].At - MC.ScheduleAt)*BATCH_TICK_MS);
+        MC.ScheduleAt = MC.Schedule[MC.NextScheduled].At;
     }
 }
 
+/* PlanPWM: the run-time version of the PWM plan, for a configured
+ * frequency (see FindPlan)
+ * returns false, leaving the plan alone, if Freq cannot be met
+ */
+static bool PlanPWM(uint32_t Freq){
+    uint8_t Prescale;
+    uint16_t Period;
+    if (!FindPlan(Freq, &Prescale, &Period)){
+        return false;
+    }
+    MC.PR2Value = Period - 1;
+    MC.Prescale = Prescale;
+    MC.DutySteps = 4*Period;
+    return true;
+}
+
+/* FindPlan: the smallest prescaler whose period for Freq fits in PR2
+ * returns false if there is none, or if it gives fewer than PWM_MIN_STEPS
+ * duty steps or misses Freq by over PWM_TOLERANCE
+ */
+static bool FindPlan(uint32_t Freq, uint8_t *pPrescale, uint16_t *pPeriod){
+    uint32_t Period;
+    uint8_t Prescale = 1;
+    if (Freq == 0){
+        return false;
+    }
+    while ((Period = PWM_PERIOD(Prescale, Freq)) > 256){
+        if (Prescale == 64){
+            return false;
+        }
+        Prescale *= 4;
+    }
+    if ((4*Period < PWM_MIN_STEPS)
+            || ((FOSC/(4UL*Prescale*Period) - Freq)*100 > Freq*PWM_TOLERANCE)){
+        return false;
+    }
+    *pPrescale = Prescale;
+    *pPeriod = (uint16_t)Period;
+    return true;
+}
+
+/* Compensate: scale a duty cycle by nominal over actual battery voltage, so
+ * a stick position gives the same thrust on a full battery as on a tired
+ * one. On bench power, or before the first reading, it is left alone.
+ */
+static int16_t Compensate(int16_t Duty){
+    uint8_t Battery = getADCValue(ADC_CH_BATTERY);
+    if (!getADCValid(ADC_CH_BATTERY) || (Battery < ADC_BATTERY_ABSENT)){
+        return Duty;
+    }
+    if (Battery < BATTERY_FLOOR){
+        Battery = BATTERY_FLOOR;
+    }
+    return (int32_t)Duty*ADC_BATTERY_NOMINAL/Battery;
+}
+
 //InitOtherPins: function to initialize miscellaneous I/O pins
 static void InitOtherPins(){
     // ensure PA0 is cleared to start (this controls lift fan)
 	LATA0 = 0;
-}
\ No newline at end of file
+}
+
+// MC_CanPlanPWM: whether PlanPWM would take Freq, for ConfigStore to check
+// a new frequency before it is saved
+bool MC_CanPlanPWM(uint16_t Freq){
+    uint8_t Prescale;
+    uint16_t Period;
+    return FindPlan(Freq, &Prescale, &Period);
+}
+
+// public getter functions
+uint16_t getMCDutySteps(void){
+    return MC.DutySteps;
+}
+
+// getMCBrakes: e-brakes latched so far, for PairingSM to ask the lift fan
+// back on with (see MC_FAN_ON)
+uint8_t getMCBrakes(void){
+    return MC.Brakes;
+}
@@ -6,6 +6,17 @@
    State machine to control process of pairing with a controller.
 
  Notes
+   An e-brake does not wait for its turn in the queues: the receive
+   interrupt calls FastBrake, through PostCommService, as the last byte of
+   a frame comes in, and a control packet or batch from our PAC that
+   decrypts and carries the brake stops the craft there and then. The frame
+   still comes through as ES_NEW_PACKET and is handled the usual way, which
+   holds the drive at zero for as long as the brake is on, so the two agree.
+   FastBrake runs in the interrupt, so it only reads what PairingSM keeps;
+   the brake is latched in MotorControl, and held there until PairingSM
+   asks for the lift fan with MotorControl's latest brake count. That
+   happens after the first packet without the brake, even when the braking
+   frame itself was dropped by a full queue and never came through.
 
 ****************************************************************************/
 /*----------------------------- Include Files -----------------------------*/
@@ -17,15 +28,28 @@
 #include "PIC16F1788.h"
 #include "PairingSM.h"
 #include "MotorControl.h"
+#include "ConfigStore.h"
+#include "StateTable.h"
+#include "FlightRecorder.h"
+#include "SmallLink.h"
+#include "AdcSequencer.h"
 
 /*----------------------------- Module Defines ----------------------------*/
-#define PAIR_TIMEOUT 45000 // amount of time before pairing times out (in ms)
-#define XMIT_TIMEOUT 2000
-
-#define UNPAIRED 0x00
-#define RED_TEAM 0x01
-#define BLUE_TEAM 0x02
-#define EBRAKE 0x03
+#define NUM_TEAMS CONFIG_NUM_TEAMS
+#define CTRL_PACKET_SIZE 5 // key bytes used per control packet (header, drive, turn, special, checksum)
+#define KEY_INDEX_MASK 0x1f // key is 32 bytes long
+#define RECV_RF (&Pairing.pFrame->Control.Header) // RF data of the received frame
+#define NO_RESYNC KEY_LENGTH // Resync found no key counter
+#define NO_TEAM 6
+#define NUM_STATES (Suspended + 1)
+// ADC_TIMER: read the team while unpaired, send telemetry while paired
+#define ADC_TIMER_MS 500
+
+// control packet special byte
+#define SPECIAL_EBRAKE BIT0HI
+#define SPECIAL_UNPAIR BIT1HI
+#define SPECIAL_CELEBRATE BIT2HI
+#define SPECIAL_TELEMETRY BIT3HI
 
 #define TEAM_NUMBER_MASK BIT7LO
 
@@ -33,44 +57,115 @@
 #define BACKWARD = 0x00
 
 /*---------------------------- Module Prototypes ---------------------------*/
+// guards
+static bool IsADCTimeout(const ES_Event *pEvent);
+static bool IsXmitTimeout(const ES_Event *pEvent);
+static bool IsPairTimeout(const ES_Event *pEvent);
+static bool IsResumeTimeout(const ES_Event *pEvent);
+static bool IsDumpRequest(const ES_Event *pEvent);
+static bool IsPairRequest(const ES_Event *pEvent);
+static bool IsKeyFromPAC(const ES_Event *pEvent);
+static bool IsControlFromPAC(const ES_Event *pEvent);
+static bool IsBatchFromPAC(const ES_Event *pEvent);
+static bool IsConfigFromPAC(const ES_Event *pEvent);
+static bool CanResume(const ES_Event *pEvent);
+// actions
+static void StopDrive(const ES_Event *pEvent);
+static void UpdateTeam(const ES_Event *pEvent);
+static void SendTelemetry(const ES_Event *pEvent);
+static void ApplyConfig(const ES_Event *pEvent);
+static void StartDump(const ES_Event *pEvent);
+static void AcceptPair(const ES_Event *pEvent);
+static void SaveKey(const ES_Event *pEvent);
+static void HandleControlPacket(const ES_Event *pEvent);
+static void HandleBatchPacket(const ES_Event *pEvent);
+static void Suspend(const ES_Event *pEvent);
+static void Resume(const ES_Event *pEvent);
+static void CatchUp(const ES_Event *pEvent);
+static void Unpair(const ES_Event *pEvent);
+// helpers
+static bool IsFromPAC(void);
+static void ApplySpecial(void);
+static uint8_t Resync(uint8_t Length);
+static bool IsValidControl(const uint8_t *pData, uint8_t Counter, uint8_t Length);
+static uint8_t BatchCount(const uint8_t *pData, uint8_t Counter);
+static uint8_t ConfigLength(const uint8_t *pData, uint8_t Counter);
 static void IncrementCounter(void);
-static void UpdateSmallPIC(uint8_t PairStatus);
-static void InitADC(void);
-static void GetADC(void);
 
 /*---------------------------- Module Variables ---------------------------*/
-static ES_Event ThatEvent;
-static PairingState_t CurrentState;
-static uint8_t MyPriority;
-
-static uint8_t DataLength;
-static uint16_t PairAddressMSB;
-static uint8_t PairAddressLSB;
-static uint8_t LastPairMSB;
-static uint8_t LastPairLSB;
-
-static uint8_t currTeam = 0;
-
-static int8_t DriveByte;
-static int8_t TurnByte;
-static uint8_t SpecialByte;
-static int16_t DriveCommand;
-
-static int8_t DriveLeft;
-static int8_t DriveRight;
-
-static uint8_t EncryptionKey[32];
-static uint8_t DecryptCounter;
-static uint8_t ControlSum = 0;
-static uint8_t EncryptedCHKSM;
-
-static bool isLiftFanOn = false;
-
-static uint8_t RawADCValue = 0; 
-static uint8_t TeamNumber = 6; // start off as team 6 (arbitrary, for debugging)
-
-// initialize a pointer to ReceiveArray's location in memory
-static uint8_t *recvPointer;
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL PairingContext_t *pPairingContext;
+#define Pairing (*pPairingContext)
+#else
+static PairingContext_t Pairing;
+#endif
+
+/*------------------------------ State Table ------------------------------*/
+// row numbers (1-based) of the first transition for each (state, event) pair
+enum { W2P_INIT = 1, W2P_TIMEOUT, W2P_PACKET,
+       W4E_TIMEOUT = W2P_PACKET + 2, W4E_PACKET,
+       W4C_PACKET, W4C_TIMEOUT = W4C_PACKET + 4, W4C_UNPAIR = W4C_TIMEOUT + 3, W4C_DECRYPT,
+       SUS_PACKET, SUS_TIMEOUT, SUS_UNPAIR = SUS_TIMEOUT + 2, SUS_DECRYPT,
+       NUM_ROWS = SUS_DECRYPT };
+
+static const SM_Transition_t PairingRows[NUM_ROWS] = {
+    { Waiting2Pair,    ES_INIT,          NULL,             StopDrive,           SM_SAME_STATE },
+    { Waiting2Pair,    ES_TIMEOUT,       IsADCTimeout,     UpdateTeam,          SM_SAME_STATE },
+    { Waiting2Pair,    ES_NEW_PACKET,    IsDumpRequest,    StartDump,           SM_SAME_STATE },
+    { Waiting2Pair,    ES_NEW_PACKET,    IsPairRequest,    AcceptPair,          Waiting4Encrypt },
+
+    { Waiting4Encrypt, ES_TIMEOUT,       IsXmitTimeout,    Unpair,              Waiting2Pair },
+    { Waiting4Encrypt, ES_NEW_PACKET,    IsKeyFromPAC,     SaveKey,             Waiting4Control },
+
+    { Waiting4Control, ES_NEW_PACKET,    IsControlFromPAC, HandleControlPacket, SM_SAME_STATE },
+    { Waiting4Control, ES_NEW_PACKET,    IsBatchFromPAC,   HandleBatchPacket,   SM_SAME_STATE },
+    { Waiting4Control, ES_NEW_PACKET,    IsConfigFromPAC,  ApplyConfig,         SM_SAME_STATE },
+    // a lost packet leaves our key counter behind the PAC's: catch up at once
+    { Waiting4Control, ES_NEW_PACKET,    CanResume,        CatchUp,             SM_SAME_STATE },
+    // if the link went quiet, hold on to the session for a while
+    { Waiting4Control, ES_TIMEOUT,       IsXmitTimeout,    Suspend,             Suspended },
+    { Waiting4Control, ES_TIMEOUT,       IsPairTimeout,    Unpair,              Waiting2Pair },
+    { Waiting4Control, ES_TIMEOUT,       IsADCTimeout,     SendTelemetry,       SM_SAME_STATE },
+    { Waiting4Control, ES_MANUAL_UNPAIR, NULL,             Unpair,              Waiting2Pair },
+    { Waiting4Control, ES_DECRYPT_ERROR, NULL,             Unpair,              Waiting2Pair },
+
+    // resume if our PAC is back and we can find where its key counter got to
+    { Suspended,       ES_NEW_PACKET,    CanResume,        Resume,              Waiting4Control },
+    { Suspended,       ES_TIMEOUT,       IsResumeTimeout,  Unpair,              Waiting2Pair },
+    { Suspended,       ES_TIMEOUT,       IsPairTimeout,    Unpair,              Waiting2Pair },
+    { Suspended,       ES_MANUAL_UNPAIR, NULL,             Unpair,              Waiting2Pair },
+    { Suspended,       ES_DECRYPT_ERROR, NULL,             Unpair,              Waiting2Pair },
+};
+
+static const uint8_t PairingIndex[SM_INDEX_SIZE(NUM_STATES)] = {
+    [SM_INDEX(Waiting2Pair,    ES_INIT)]          = W2P_INIT,
+    [SM_INDEX(Waiting2Pair,    ES_TIMEOUT)]       = W2P_TIMEOUT,
+    [SM_INDEX(Waiting2Pair,    ES_NEW_PACKET)]    = W2P_PACKET,
+    [SM_INDEX(Waiting4Encrypt, ES_TIMEOUT)]       = W4E_TIMEOUT,
+    [SM_INDEX(Waiting4Encrypt, ES_NEW_PACKET)]    = W4E_PACKET,
+    [SM_INDEX(Waiting4Control, ES_NEW_PACKET)]    = W4C_PACKET,
+    [SM_INDEX(Waiting4Control, ES_TIMEOUT)]       = W4C_TIMEOUT,
+    [SM_INDEX(Waiting4Control, ES_MANUAL_UNPAIR)] = W4C_UNPAIR,
+    [SM_INDEX(Waiting4Control, ES_DECRYPT_ERROR)] = W4C_DECRYPT,
+    [SM_INDEX(Suspended,       ES_NEW_PACKET)]    = SUS_PACKET,
+    [SM_INDEX(Suspended,       ES_TIMEOUT)]       = SUS_TIMEOUT,
+    [SM_INDEX(Suspended,       ES_MANUAL_UNPAIR)] = SUS_UNPAIR,
+    [SM_INDEX(Suspended,       ES_DECRYPT_ERROR)] = SUS_DECRYPT,
+};
+
+#ifdef SM_COVERAGE
+static uint16_t PairingHits[NUM_ROWS];
+#endif
+
+static const SM_Table_t PairingTable = {
+    PairingRows, PairingIndex, NUM_ROWS, NUM_STATES,
+#ifdef SM_COVERAGE
+    PairingHits,
+#endif
+#ifdef SM_DUMP
+    "PairingSM",
+#endif
+};
 
 /*------------------------------ Framework Code ------------------------------*/
 /***********************************
@@ -78,18 +173,24 @@ static uint8_t *recvPointer;
  ***********************************/
 bool InitPairingSM ( uint8_t Priority )
 {
-    MyPriority = Priority;
+    Pairing.MyPriority = Priority;
     // put us into Waiting2Pair
-    CurrentState = Waiting2Pair;
-    // change output pins to PIC12F752 to reflect unpaired state
-    UpdateSmallPIC(UNPAIRED);
+    Pairing.CurrentState = Waiting2Pair;
+    // pick up the team and last PAC from EEPROM so we can pair right away
+    InitConfigStore();
+    Pairing.TeamNumber = getConfigTeamNumber();
+    Pairing.LastPairMSB = getConfigLastPairMSB();
+    Pairing.LastPairLSB = getConfigLastPairLSB();
+    // tell the PIC12F752 we are unpaired
+    InitSmallLink();
+    SL_SendTeam(SL_TEAM_NONE);
     // get into state machine
     ES_Event ThisEvent;
     ThisEvent.EventType = ES_INIT;
     PostPairingSM(ThisEvent);
-    // init ADC module
-    InitADC();
-    // start ADC timer to timeout after acquisition delay (1 ms)
+    // start scanning the team resistor, battery and motor current
+    InitADCSequencer();
+    // read the team as soon as the first scan is in (1 ms)
     ES_Timer_InitTimer(ADC_TIMER, 1);
     return true;
 }
@@ -98,7 +199,9 @@ bool InitPairingSM ( uint8_t Priority )
  ***********************************/
 bool PostPairingSM( ES_Event ThisEvent )
 {
-  return ES_PostToService( MyPriority, ThisEvent);
+  bool isPosted = ES_PostToService( Pairing.MyPriority, ThisEvent);
+  FR_RecordPost(Pairing.MyPriority, &ThisEvent, isPosted);
+  return isPosted;
 }
 /***********************************
             Run function
@@ -107,386 +210,652 @@ ES_Event RunPairingSM( ES_Event ThisEvent )
 {
     ES_Event ReturnEvent;
     ReturnEvent.EventType = ES_NO_EVENT; // assume no errors
-    // pull in pointer to receive array
-    recvPointer = getRecvArray();
+    uint8_t NextState = Pairing.CurrentState;
+    // pull in the received frame
+    Pairing.pFrame = getRecvFrame();
     // enter state machine
-    switch ( CurrentState )
-    {
-        case Waiting2Pair:
-            if (ThisEvent.EventType == ES_INIT){
-                // turn off drive propeller motors
-                DriveLeft = 0;
-                DriveRight = 0;
-                ThatEvent.EventType = ES_DRIVE_COMMAND;
-                ThatEvent.EventParam = 0x01; // FORWARD
-                PostMC(ThatEvent);
-            }
-            else if((ThisEvent.EventType == ES_TIMEOUT)&&(ThisEvent.EventParam == ADC_TIMER)){
-                GetADC(); // Start the process to read the pin to determine TeamNumber
-                ES_Timer_InitTimer(ADC_TIMER,500); //Set a timer for when we should read the pin again
-            }
-            else if(ThisEvent.EventType == ES_ADCNewRead){
-                RawADCValue = ThisEvent.EventParam;
-                if ((RawADCValue > 70)&&(RawADCValue < 100)){ //2% tolerance on the expected value of 85.33 //83 to 88
-                    TeamNumber = 0; //Team 1
-                }
-                else if ((RawADCValue > 101)&&(RawADCValue < 139)){ //2% tolerance on the expected value of 125 //125 to 131
-                    TeamNumber = 1; //Team 2
-                }
-                else if ((RawADCValue > 140)&&(RawADCValue < 162)){ //2% tolerance on the expected value of 153.6 //150  to 157
-                    TeamNumber = 2; //Team 3
-                }
-                else if ((RawADCValue > 163)&&(RawADCValue < 190)){ //2% tolerance on the expected value of 170.66 //167 to 174
-                    TeamNumber = 3; // Team 4
-                }
-                else{
-                    TeamNumber = 6; // no assigned team
-                }
-            }
-            // else if we just got a pairing request
-            else if( ThisEvent.EventType == ES_NEW_PACKET 
-                    && *(recvPointer + 5) == 0x00 
-                    && *(recvPointer+1) != LastPairMSB
-                    && *(recvPointer+2) != LastPairLSB ){
-                //check that they are trying to pair with my number
-                if (((*(recvPointer + 6))&TEAM_NUMBER_MASK) != TeamNumber){
-                    break;
-                }
-                // update Small PIC to display pairing status
-                if (((*(recvPointer + 6))&BIT7HI) == BIT7HI){
-                    UpdateSmallPIC(BLUE_TEAM);
-                    currTeam = BLUE_TEAM;
-                } else if (((*(recvPointer + 6))&BIT7HI) == 0x00){
-                    UpdateSmallPIC(RED_TEAM);
-                    currTeam = RED_TEAM;
-                }
-                // change states
-                CurrentState = Waiting4Encrypt;
-                // pull in length of RF data
-                DataLength = ThisEvent.EventParam;
-                // start a 45 s timer
-                ES_Timer_InitTimer(PAIR_TIMER,PAIR_TIMEOUT);
-                // start a 1 s timer
-                ES_Timer_InitTimer(XMIT_TIMER,XMIT_TIMEOUT);
-                // start lift fan
-                ThisEvent.EventType = ES_LiftFan;
-                ThisEvent.EventParam = 0x01;
-                PostMC(ThisEvent);
-                // Turn on LED to indicate pairing success
-                //LATA1 = 1;
-                // Transmit status message back to PAC (STATUS1)
-                PairAddressMSB = *(recvPointer+1);
-                PairAddressLSB = *(recvPointer+2);
-                LastPairMSB = PairAddressMSB;
-                LastPairLSB = PairAddressLSB;
-                ThisEvent.EventType = ES_STATUS1;
-                ThisEvent.EventParam = ((PairAddressMSB<<8) & 0xff00) + (PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
-                PostCommService(ThisEvent);
+    FR_SetRunning(Pairing.MyPriority);
+    SM_Dispatch(&PairingTable, &NextState, &ThisEvent);
+    FR_RecordState(Pairing.MyPriority, Pairing.CurrentState, NextState);
+    FR_SetRunning(FR_NO_SERVICE);
+    Pairing.CurrentState = NextState;
+    return ReturnEvent;
+}
+
+#ifdef SM_DUMP
+bool DumpPairingSM(void)
+{
+    return SM_Dump(&PairingTable);
+}
+#endif
+
+/***********************************
+          E-brake fast path
+ ***********************************/
+/* FastBrake: the receive interrupt has a complete frame, Length RF bytes,
+ * that CommService has yet to see. Check it against DecryptCounter the way
+ * Resync does, without moving the counter, and stop the craft if it is from
+ * our PAC with the brake on. The counter is this frame's unless the frame
+ * before went missing: CommService's queue holds fewer bytes than any
+ * control frame, so by the time a frame is complete the one before it has
+ * been through PairingSM. A frame right after a lost one brakes through the
+ * usual path. A suspended session has lost track of the counter and is not
+ * driving.
+ * returns true if it stopped the craft
+ */
+bool FastBrake(const BrakeFrame_t *pFrame, uint8_t Length)
+{
+    const uint8_t *pData = &pFrame->Control.Header;
+    uint8_t Special;
+    if ((Pairing.CurrentState != Waiting4Control)
+            || (pFrame->Rx.SourceMSB != Pairing.PairAddressMSB)
+            || (pFrame->Rx.SourceLSB != Pairing.PairAddressLSB)
+            || !IsValidControl(pData, Pairing.DecryptCounter, Length)){
+        return false;
+    }
+    // the special byte follows the header in a batch, the turn byte otherwise
+    if (BatchCount(pData, Pairing.DecryptCounter) > 0){
+        Special = pFrame->Batch.Special
+                  ^ Pairing.EncryptionKey[(Pairing.DecryptCounter + 1) & KEY_INDEX_MASK];
+    } else {
+        Special = pFrame->Control.Special
+                  ^ Pairing.EncryptionKey[(Pairing.DecryptCounter + 3) & KEY_INDEX_MASK];
+    }
+    if ((Special & SPECIAL_EBRAKE) != SPECIAL_EBRAKE){
+        return false;
+    }
+    MC_EmergencyStop();
+    return true;
+}
+
+/*--------------------------------- Guards --------------------------------*/
+static bool IsADCTimeout(const ES_Event *pEvent){
+    return (pEvent->EventParam == ADC_TIMER);
+}
+
+static bool IsXmitTimeout(const ES_Event *pEvent){
+    return (pEvent->EventParam == XMIT_TIMER);
+}
+
+static bool IsPairTimeout(const ES_Event *pEvent){
+    return (pEvent->EventParam == PAIR_TIMER);
+}
+
+static bool IsResumeTimeout(const ES_Event *pEvent){
+    return (pEvent->EventParam == RESUME_TIMER);
+}
+
+// anyone may ask for the flight recorder while we are not paired
+static bool IsDumpRequest(const ES_Event *pEvent){
+    return (pEvent->EventParam >= RF_SIZE(DumpRequestFrame_t))
+            && (Pairing.pFrame->Dump.Header == RECORDER_DUMP_HEADER);
+}
+
+// a pairing request from a new PAC that is trying to pair with my number;
+// only the very PAC we last paired with is new no longer
+static bool IsPairRequest(const ES_Event *pEvent){
+    return (pEvent->EventParam >= RF_SIZE(PairRequestFrame_t))
+            && (Pairing.pFrame->Pair.Header == PAIR_REQUEST_HEADER)
+            && !((Pairing.pFrame->Rx.SourceMSB == Pairing.LastPairMSB)
+                 && (Pairing.pFrame->Rx.SourceLSB == Pairing.LastPairLSB))
+            && ((Pairing.pFrame->Pair.Team&TEAM_NUMBER_MASK) == Pairing.TeamNumber);
+}
+
+static bool IsKeyFromPAC(const ES_Event *pEvent){
+    return (pEvent->EventParam >= RF_SIZE(KeyFrame_t))
+            && (Pairing.pFrame->Key.Header == KEY_HEADER) && IsFromPAC();
+}
+
+static bool IsControlFromPAC(const ES_Event *pEvent){
+    return (pEvent->EventParam >= RF_SIZE(ControlFrame_t))
+            && ((Pairing.pFrame->Control.Header ^ Pairing.EncryptionKey[Pairing.DecryptCounter]) == CONTROL_HEADER)
+            && IsFromPAC();
+}
+
+// a batch: the count that decrypts goes with the frame's length
+static bool IsBatchFromPAC(const ES_Event *pEvent){
+    uint8_t Count;
+    if (pEvent->EventParam < BATCH_RF_SIZE(1)){
+        return false;
+    }
+    Count = BatchCount(RECV_RF, Pairing.DecryptCounter);
+    return (Count > 0) && (pEvent->EventParam == BATCH_RF_SIZE(Count)) && IsFromPAC();
+}
+
+// a config write: only ever from our PAC, encrypted like a batch, so nobody
+// without the session key can change the record
+static bool IsConfigFromPAC(const ES_Event *pEvent){
+    uint8_t Length;
+    if (pEvent->EventParam < CONFIG_RF_SIZE(1)){
+        return false;
+    }
+    Length = ConfigLength(RECV_RF, Pairing.DecryptCounter);
+    return (Length > 0) && (pEvent->EventParam == CONFIG_RF_SIZE(Length)) && IsFromPAC();
+}
+
+static bool CanResume(const ES_Event *pEvent){
+    return (pEvent->EventParam >= RF_SIZE(ControlFrame_t)) && IsFromPAC()
+            && (Resync((uint8_t)pEvent->EventParam) != NO_RESYNC);
+}
+
+/*--------------------------------- Actions -------------------------------*/
+// StopDrive: turn off drive propeller motors
+static void StopDrive(const ES_Event *pEvent){
+    Pairing.DriveByte = 0;
+    Pairing.TurnByte = 0;
+    Pairing.ThatEvent.EventType = ES_DRIVE_COMMAND;
+    Pairing.ThatEvent.EventParam = 0x01; // FORWARD
+    PostMC(Pairing.ThatEvent);
+}
+
+// UpdateTeam: check the team resistor's latest reading, then again later
+static void UpdateTeam(const ES_Event *pEvent){
+    ES_Timer_InitTimer(ADC_TIMER, ADC_TIMER_MS);
+    if (!getADCValid(ADC_CH_TEAM)){
+        return;
+    }
+    Pairing.RawADCValue = getADCValue(ADC_CH_TEAM);
+    // find the team whose threshold band holds this reading; a
+    // reading outside every band keeps the last known team
+    for (uint8_t i=0; i<NUM_TEAMS; i++){
+        if ((Pairing.RawADCValue > getConfigTeamLow(i))&&(Pairing.RawADCValue < getConfigTeamHigh(i))){
+            Pairing.TeamNumber = i;
+            setConfigTeamNumber(Pairing.TeamNumber);
+            break;
+        }
+    }
+}
+
+// SendTelemetry: have CommService send the PAC our battery and current
+static void SendTelemetry(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    ES_Timer_InitTimer(ADC_TIMER, ADC_TIMER_MS);
+    ThisEvent.EventType = ES_TELEMETRY;
+    ThisEvent.EventParam = 0;
+    PostCommService(ThisEvent);
+}
+
+/* ApplyConfig: decrypt a config write from our PAC and hand it to
+ * ConfigStore, which turns it down whole if any field ends up out of range
+ */
+static void ApplyConfig(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    const uint8_t *pData = RECV_RF;
+    uint8_t Plain[CONFIG_RF_SIZE(CONFIG_DATA_MAX)];
+    uint8_t Size = (uint8_t)pEvent->EventParam - 1; // bytes ahead of the checksum
+    uint8_t Sum = 0;
+    // restart xmit timer
+    ES_Timer_InitTimer(XMIT_TIMER,getConfigXmitTimeout());
+    for (uint8_t i=0; i<Size; i++){
+        Plain[i] = pData[i] ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+        Sum += Plain[i];
+        IncrementCounter();
+    }
+    Plain[Size] = pData[Size] ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+    IncrementCounter();
+    if (Sum != Plain[Size]){
+        ThisEvent.EventType = ES_DECRYPT_ERROR;
+        PostPairingSM(ThisEvent);
+        return;
+    }
+    Pairing.isVarLength = true;
+    // header, offset and length, then the record bytes
+    UpdateConfig(Plain[1], &Plain[3], Plain[2]);
+}
+
+// StartDump: freeze the recorder and have CommService send its first frame
+static void StartDump(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    FR_RequestDump(Pairing.pFrame->Rx.SourceMSB, Pairing.pFrame->Rx.SourceLSB,
+                   (Pairing.pFrame->Dump.Flags & DUMP_REARM) == DUMP_REARM);
+    ThisEvent.EventType = ES_DUMP_RECORDER;
+    ThisEvent.EventParam = 0;
+    PostCommService(ThisEvent);
+}
+
+static void AcceptPair(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    // update Small PIC to display pairing status
+    if ((Pairing.pFrame->Pair.Team&BIT7HI) == BIT7HI){
+        Pairing.currTeam = SL_TEAM_BLUE;
+    } else {
+        Pairing.currTeam = SL_TEAM_RED;
+    }
+    SL_SendTeam(Pairing.currTeam);
+    Pairing.isBrakeHeld = false;
+    Pairing.isCelebrateHeld = false;
+    // pull in length of RF data
+    Pairing.DataLength = pEvent->EventParam;
+    // start a 45 s timer
+    ES_Timer_InitTimer(PAIR_TIMER,getConfigPairTimeout());
+    // start a 1 s timer
+    ES_Timer_InitTimer(XMIT_TIMER,getConfigXmitTimeout());
+    // start lift fan
+    ThisEvent.EventType = ES_LiftFan;
+    Pairing.FanBrakes = getMCBrakes();
+    ThisEvent.EventParam = MC_FAN_ON(Pairing.FanBrakes);
+    PostMC(ThisEvent);
+    // Turn on LED to indicate pairing success
+    //LATA1 = 1;
+    // Transmit status message back to PAC (STATUS1)
+    Pairing.PairAddressMSB = Pairing.pFrame->Rx.SourceMSB;
+    Pairing.PairAddressLSB = Pairing.pFrame->Rx.SourceLSB;
+    Pairing.LastPairMSB = Pairing.PairAddressMSB;
+    Pairing.LastPairLSB = Pairing.PairAddressLSB;
+    setConfigLastPair(Pairing.LastPairMSB, Pairing.LastPairLSB);
+    ThisEvent.EventType = ES_STATUS1;
+    ThisEvent.EventParam = ((Pairing.PairAddressMSB<<8) & 0xff00) + (Pairing.PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
+    PostCommService(ThisEvent);
+}
+
+static void SaveKey(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    // set decryption counter to 0
+    Pairing.DecryptCounter = 0;
+    Pairing.isVarLength = false;
+    // save encryption key
+    for(int i=0; i<KEY_LENGTH; i++){
+        Pairing.EncryptionKey[i] = Pairing.pFrame->Key.Key[i];
+    }
+    // restart 1s transmit timer
+    ES_Timer_InitTimer(XMIT_TIMER,getConfigXmitTimeout());
+    // telemetry from now on
+    ES_Timer_InitTimer(ADC_TIMER, ADC_TIMER_MS);
+    // transmit status back to PAC (STATUS1)
+#if DEBUG_SERVICES
+    ThisEvent.EventType = ES_DEBUG1;
+#else
+    ThisEvent.EventType = ES_STATUS1;
+#endif
+    ThisEvent.EventParam = ((Pairing.PairAddressMSB<<8) & 0xff00) + (Pairing.PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
+    PostCommService(ThisEvent);
+}
+
+/* HandleControlPacket: decrypt a control packet from our PAC, acknowledge it
+ * and pass the commands on to MotorControl
+ */
+static void HandleControlPacket(const ES_Event *pEvent){
+    ES_Event ThisEvent = *pEvent;
+    // store encrypted checksum value
+    Pairing.EncryptedCHKSM = Pairing.pFrame->Control.Checksum;
+    // restart xmit timer
+    ES_Timer_InitTimer(XMIT_TIMER,getConfigXmitTimeout());
+    // transmit status back to PAC (STATUS1)
+    ThisEvent.EventType = ES_STATUS1;
+    ThisEvent.EventParam = ((Pairing.PairAddressMSB<<8) & 0xff00) + (Pairing.PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
+    PostCommService(ThisEvent);
+    // decrypt data and compare checksum
+    Pairing.ControlSum = Pairing.pFrame->Control.Header ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+    IncrementCounter();
+    Pairing.DriveByte = Pairing.pFrame->Control.Drive ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+    Pairing.ControlSum += (uint8_t)Pairing.DriveByte;
+    IncrementCounter();
+    Pairing.TurnByte = Pairing.pFrame->Control.Turn ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+    Pairing.ControlSum += (uint8_t)Pairing.TurnByte;
+    IncrementCounter();
+    Pairing.SpecialByte = Pairing.pFrame->Control.Special ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+    Pairing.ControlSum += Pairing.SpecialByte;
+    IncrementCounter();
+    // if checksum is bad, post ES_DECRYPT_ERROR to self
+    if (Pairing.ControlSum != (Pairing.pFrame->Control.Checksum ^ Pairing.EncryptionKey[Pairing.DecryptCounter])){
+        ThisEvent.EventType = ES_DECRYPT_ERROR;
+        PostPairingSM(ThisEvent);
+    }
+    IncrementCounter();
+    // the brake holds the drive at zero, as FastBrake left it
+    if ((Pairing.SpecialByte & SPECIAL_EBRAKE) == SPECIAL_EBRAKE){
+        Pairing.DriveByte = 0;
+        Pairing.TurnByte = 0;
+    }
+    /* execute commands:
+        - motor commands
+        - other special actions
+     */
+    /* motor commands: map received drive and turn bytes to values that 
+     * we can use to generate intuitive PWM duty cycles
+     */
+    Pairing.DriveRight = Pairing.DriveByte;
+    Pairing.DriveLeft = Pairing.DriveByte;
+    if (Pairing.DriveByte>0){
+        if (Pairing.TurnByte < 0){
+            Pairing.DriveRight -= Pairing.TurnByte;
+            if (Pairing.DriveRight < 0){
+                Pairing.DriveRight = 0;
             }
-        break;
-           
-        case Waiting4Encrypt:
-            // if we got a transmit timeout
-            if (ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == XMIT_TIMER){
-                // change states
-                CurrentState = Waiting2Pair;
-                //start ADC timer
-                ES_Timer_InitTimer(ADC_TIMER,500);
-                // update small PIC to display unpaired status
-                UpdateSmallPIC(UNPAIRED);
-                // deactivate lift fan
-                ThisEvent.EventType = ES_LiftFan;
-                ThisEvent.EventParam = 0x00;
-                PostMC(ThisEvent);
-                // turn off pairing LED
-                //LATA1 = 0;
-                // Stop pairing timer
-                ES_Timer_StopTimer(PAIR_TIMER);
-                // Stop xmit timer
-                ES_Timer_StopTimer(XMIT_TIMER);
-                // Transmit status back to PAC (STATUS3)
-                ThisEvent.EventType = ES_STATUS3;
-                ThisEvent.EventParam = ((PairAddressMSB<<8) & 0xff00) + (PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
-                PostCommService(ThisEvent);
-            } 
-            // else if we received an encryption key
-            else if ((ThisEvent.EventType == ES_NEW_PACKET && *(recvPointer + 5) == 0x01)
-                    && PairAddressLSB == getPACAddressLSB()
-                    && PairAddressMSB == getPACAddressMSB() ){
-                // change states
-                CurrentState = Waiting4Control;
-                // set decryption counter to 0
-                DecryptCounter = 0;
-                // save encryption key
-                for(int i=0; i<32; i++){
-                    EncryptionKey[i] = *(recvPointer+(i+6));
-                }
-                // restart 1s transmit timer
-                ES_Timer_InitTimer(XMIT_TIMER,XMIT_TIMEOUT);
-                // transmit status back to PAC (STATUS1)
-                //ThisEvent.EventType = ES_STATUS1;
-                ThisEvent.EventType = ES_DEBUG1;
-                ThisEvent.EventParam = ((PairAddressMSB<<8) & 0xff00) + (PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
-                PostCommService(ThisEvent);
+        } else {
+            Pairing.DriveLeft += Pairing.TurnByte;
+            if (Pairing.DriveLeft < 0){
+                Pairing.DriveLeft = 0;
             }
-        break;
-        
-        case Waiting4Control:
-            // if we received a new command
-            if(((ThisEvent.EventType == ES_NEW_PACKET) && ((*(recvPointer + 5)) ^ EncryptionKey[DecryptCounter]) == 0x02)
-                    && (PairAddressLSB == getPACAddressLSB())
-                    && (PairAddressMSB == getPACAddressMSB()) ){
-
-                // store encrypted checksum value
-                EncryptedCHKSM = *(recvPointer + 9);
-                // restart xmit timer
-                ES_Timer_InitTimer(XMIT_TIMER,XMIT_TIMEOUT);
-                // transmit status back to PAC (STATUS1)
-                ThisEvent.EventType = ES_STATUS1;
-                ThisEvent.EventParam = ((PairAddressMSB<<8) & 0xff00) + (PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
-                PostCommService(ThisEvent);
-                // decrypt data and compare checksum
-                ControlSum = 0;
-                for (int i=5; i<9; i++){
-                    if (i==6){
-                        DriveByte = (*(recvPointer + 6)) ^ EncryptionKey[DecryptCounter];
-                    }
-                    if (i==7){
-                        TurnByte = (*(recvPointer + 7)) ^ EncryptionKey[DecryptCounter];
-                    }
-                    if (i==8){
-                        SpecialByte = (*(recvPointer + 8)) ^ EncryptionKey[DecryptCounter];
-                    }
-                    ControlSum += (*(recvPointer + i)) ^ EncryptionKey[DecryptCounter];
-                    IncrementCounter();
-                }
-                // if checksum is bad, post ES_DECRYPT_ERROR to self
-                if ((ControlSum) != ((*(recvPointer + 9)) ^ EncryptionKey[DecryptCounter])){
-                //if ((0xff - ControlSum) != ((*(recvPointer + 9)) ^ EncryptionKey[DecryptCounter])){
-                    ThisEvent.EventType = ES_DECRYPT_ERROR;
-                    PostPairingSM(ThisEvent);
-                }
-                IncrementCounter();
-                /* execute commands:
-                    - motor commands
-                    - other special actions
-                 */
-                /* motor commands: map received drive and turn bytes to values that 
-				 * we can use to generate intuitive PWM duty cycles
-				 */
-                DriveRight = DriveByte;
-                DriveLeft = DriveByte;
-                if (DriveByte>0){
-                    if (TurnByte < 0){
-                        DriveRight -= TurnByte;
-                        if (DriveRight < 0){
-                            DriveRight = 0;
-                        }
-                    } else {
-                        DriveLeft += TurnByte;
-                        if (DriveLeft < 0){
-                            DriveLeft = 0;
-                        }
-                    }
-                }else{
-                    if (TurnByte > 0){
-                        DriveLeft += TurnByte;
-                        if (DriveLeft > 0){
-                            DriveLeft = 0;
-                        } else {
-                            DriveLeft *= -1;
-                        }
-                        DriveRight *= -1;
-                    } else {
-                        DriveRight -= TurnByte;
-                        if (DriveRight > 0){
-                            DriveRight = 0;
-                        } else {
-                            DriveRight *= -1;
-                        }
-                        DriveLeft *= -1;
-                    }
-                }
-                ThisEvent.EventType = ES_DRIVE_COMMAND;
-                PostMC(ThisEvent);
-                // Special actions: e-brake and unpair  
-                if ((SpecialByte & 0x01) == 0x01){
-                    // deactivate lift fan
-                    ThatEvent.EventType = ES_LiftFan;
-                    ThatEvent.EventParam = 0x00;
-                    PostMC(ThatEvent);
-                    isLiftFanOn = false;
-                    // update small PIC with e-brake state
-                    UpdateSmallPIC(EBRAKE);
-                } else if (!isLiftFanOn){
-                    ThatEvent.EventType = ES_LiftFan;
-                    ThatEvent.EventParam = 0x01;
-                    PostMC(ThatEvent);
-                    isLiftFanOn = true;
-                    // update small PIC with current team color
-                    UpdateSmallPIC(currTeam);
-                }
-                if ((SpecialByte & 0x02) == 0x02){
-                    // unpair
-                    ThisEvent.EventType = ES_MANUAL_UNPAIR;
-                    PostPairingSM(ThisEvent);
-                } 
+        }
+    }else{
+        if (Pairing.TurnByte > 0){
+            Pairing.DriveLeft += Pairing.TurnByte;
+            if (Pairing.DriveLeft > 0){
+                Pairing.DriveLeft = 0;
+            } else {
+                Pairing.DriveLeft *= -1;
             }
-            /* unpair if we got any of the following events: 
-                - pairing timeout
-                - xmit timeout
-                - PAC manual unpair
-                - failed decryption
-             */
-            else if (  (ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == PAIR_TIMER)
-                    || (ThisEvent.EventType == ES_TIMEOUT && ThisEvent.EventParam == XMIT_TIMER)
-                    || (ThisEvent.EventType == ES_MANUAL_UNPAIR)
-                    || (ThisEvent.EventType == ES_DECRYPT_ERROR) ){
-                // change state
-                CurrentState = Waiting2Pair;
-                //start ADC timer
-                ES_Timer_InitTimer(ADC_TIMER,500);
-                // update small PIC to display unpaired status
-                UpdateSmallPIC(UNPAIRED);
-                // deactivate lift fan
-                ThatEvent.EventType = ES_LiftFan;
-                ThatEvent.EventParam = 0x00;
-                PostMC(ThatEvent);
-                // turn off drive propeller motors
-                DriveByte = 0;
-                TurnByte = 0;
-                ThatEvent.EventType = ES_DRIVE_COMMAND;
-                ThatEvent.EventParam = 0x01; // FORWARD
-                PostMC(ThatEvent);
-                // turn off pairing LED
-                //LATA1 = 0;
-                // disable pairing timer
-                ES_Timer_StopTimer(PAIR_TIMER);
-                // disable xmit timer
-                ES_Timer_StopTimer(XMIT_TIMER);
-                // transmit status back to PAC
-                if (ThisEvent.EventType == ES_DECRYPT_ERROR){
-                    //ThisEvent.EventType = ES_STATUS4; // unpaired, decrypt error
-                    ThisEvent.EventType = ES_DEBUG2;
-                    ThisEvent.EventParam = ((PairAddressMSB<<8) & 0xff00) + (PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
-                } else {
-                    ThisEvent.EventType = ES_STATUS3; // unpaired, no decrypt error
-                    ThisEvent.EventParam = ((PairAddressMSB<<8) & 0xff00) + (PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
-                }
-                PostCommService(ThisEvent);
+            Pairing.DriveRight *= -1;
+        } else {
+            Pairing.DriveRight -= Pairing.TurnByte;
+            if (Pairing.DriveRight > 0){
+                Pairing.DriveRight = 0;
+            } else {
+                Pairing.DriveRight *= -1;
             }
-        break;
+            Pairing.DriveLeft *= -1;
+        }
     }
-    return ReturnEvent;
+    // the lift fan first: asking for it is what lets go of a brake
+    ApplySpecial();
+    ThisEvent.EventType = ES_DRIVE_COMMAND;
+    PostMC(ThisEvent);
+}
+
+/* HandleBatchPacket: decrypt a batch in one pass, acknowledge it, and hand
+ * the commands to MotorControl, which carries each out at its time. A batch
+ * that fails its checksum is not carried out.
+ */
+static void HandleBatchPacket(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    const uint8_t *pData = &Pairing.pFrame->Batch.Header;
+    uint8_t *pCommands = (uint8_t *)Pairing.Batch;
+    uint8_t Count = BatchCount(RECV_RF, Pairing.DecryptCounter);
+    uint8_t Size = BATCH_RF_SIZE(Count) - 1; // bytes ahead of the checksum
+    uint8_t Plain;
+    // store encrypted checksum value
+    Pairing.EncryptedCHKSM = pData[Size];
+    // restart xmit timer
+    ES_Timer_InitTimer(XMIT_TIMER,getConfigXmitTimeout());
+    // transmit status back to PAC (STATUS1)
+    ThisEvent.EventType = ES_STATUS1;
+    ThisEvent.EventParam = ((Pairing.PairAddressMSB<<8) & 0xff00) + (Pairing.PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
+    PostCommService(ThisEvent);
+    // header, special and count, then the commands straight into Batch
+    Pairing.ControlSum = 0;
+    for (uint8_t i=0; i<Size; i++){
+        Plain = pData[i] ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+        Pairing.ControlSum += Plain;
+        if (i == 1){
+            Pairing.SpecialByte = Plain;
+        } else if (i >= 3){
+            pCommands[i - 3] = Plain;
+        }
+        IncrementCounter();
+    }
+    Plain = pData[Size] ^ Pairing.EncryptionKey[Pairing.DecryptCounter];
+    IncrementCounter();
+    if (Pairing.ControlSum != Plain){
+        ThisEvent.EventType = ES_DECRYPT_ERROR;
+        PostPairingSM(ThisEvent);
+        return;
+    }
+    Pairing.isVarLength = true;
+    if ((Pairing.SpecialByte & SPECIAL_EBRAKE) == SPECIAL_EBRAKE){
+        // nothing of a braking batch is carried out, as FastBrake left it
+        Pairing.DriveByte = 0;
+        Pairing.TurnByte = 0;
+        ThisEvent.EventType = ES_DRIVE_COMMAND;
+    } else {
+        Pairing.DriveByte = (int8_t)Pairing.Batch[0].Drive;
+        Pairing.TurnByte = (int8_t)Pairing.Batch[0].Turn;
+        ThisEvent.EventType = ES_DRIVE_BATCH;
+        ThisEvent.EventParam = Count;
+    }
+    ApplySpecial();
+    PostMC(ThisEvent);
+}
+
+/* Suspend: the PAC went quiet. Stop driving but keep the key, counter, team
+ * and lift fan for the grace window so a short dropout does not cost a full
+ * pairing cycle.
+ */
+static void Suspend(const ES_Event *pEvent){
+    StopDrive(pEvent);
+    // the pairing timer keeps running, the session still ends on time
+    ES_Timer_InitTimer(RESUME_TIMER, (uint16_t)getConfigResumeWindow()*10);
+}
+
+// Resume: pick the session back up where the PAC's key counter got to
+static void Resume(const ES_Event *pEvent){
+    ES_Timer_StopTimer(RESUME_TIMER);
+    ES_Timer_InitTimer(ADC_TIMER, ADC_TIMER_MS);
+    CatchUp(pEvent);
+}
+
+/* CatchUp: move DecryptCounter on to where CanResume found the packet
+ * decrypts, then handle it
+ */
+static void CatchUp(const ES_Event *pEvent){
+    Pairing.DecryptCounter = Resync((uint8_t)pEvent->EventParam);
+    if (BatchCount(RECV_RF, Pairing.DecryptCounter) > 0){
+        HandleBatchPacket(pEvent);
+    } else {
+        HandleControlPacket(pEvent);
+    }
+}
+
+/* Unpair: tear down the session and tell the PAC why */
+static void Unpair(const ES_Event *pEvent){
+    ES_Event ThisEvent;
+    // keep the events that led up to this for a dump
+    FR_Freeze(FR_UNPAIR);
+    // back to reading the team
+    ES_Timer_InitTimer(ADC_TIMER, ADC_TIMER_MS);
+    // have the small PIC lower the flag
+    SL_SendTeam(SL_TEAM_NONE);
+    // deactivate lift fan
+    Pairing.ThatEvent.EventType = ES_LiftFan;
+    Pairing.ThatEvent.EventParam = MC_FAN_OFF;
+    PostMC(Pairing.ThatEvent);
+    Pairing.isLiftFanOn = false;
+    StopDrive(pEvent);
+    // turn off pairing LED
+    //LATA1 = 0;
+    // disable pairing, xmit and resume timers
+    ES_Timer_StopTimer(PAIR_TIMER);
+    ES_Timer_StopTimer(XMIT_TIMER);
+    ES_Timer_StopTimer(RESUME_TIMER);
+    // transmit status back to PAC
+    if (pEvent->EventType == ES_DECRYPT_ERROR){
+#if DEBUG_SERVICES
+        ThisEvent.EventType = ES_DEBUG2;
+#else
+        ThisEvent.EventType = ES_STATUS4; // unpaired, decrypt error
+#endif
+    } else {
+        ThisEvent.EventType = ES_STATUS3; // unpaired, no decrypt error
+    }
+    ThisEvent.EventParam = ((Pairing.PairAddressMSB<<8) & 0xff00) + (Pairing.PairAddressLSB & 0xff); // pass address of paired PAC as event parameter
+    PostCommService(ThisEvent);
 }
 
 /*---------------------------- Helper Functions ---------------------------*/
-static void IncrementCounter(void){
-    if (DecryptCounter == 31){
-        DecryptCounter = 0;
+static bool IsFromPAC(void){
+    return (Pairing.PairAddressLSB == getPACAddressLSB())
+            && (Pairing.PairAddressMSB == getPACAddressMSB());
+}
+
+/* ApplySpecial: e-brake, celebrate, telemetry and unpair, from the special
+ * byte of the control packet or batch just received
+ */
+static void ApplySpecial(void){
+    ES_Event ThisEvent;
+    if ((Pairing.SpecialByte & SPECIAL_EBRAKE) == SPECIAL_EBRAKE){
+        // blink the team LED while the brake is held
+        if (!Pairing.isBrakeHeld){
+            SL_SendLeds(SL_LED_BLINK | ((Pairing.currTeam == SL_TEAM_BLUE) ? SL_LED_BLUE : SL_LED_RED));
+        }
+        Pairing.isBrakeHeld = true;
+        // deactivate lift fan
+        Pairing.ThatEvent.EventType = ES_LiftFan;
+        Pairing.ThatEvent.EventParam = MC_FAN_OFF;
+        PostMC(Pairing.ThatEvent);
+        Pairing.isLiftFanOn = false;
+    } else if (!Pairing.isLiftFanOn || (Pairing.FanBrakes != getMCBrakes())){
+        // off, or braked from the interrupt since it was last turned on
+        Pairing.ThatEvent.EventType = ES_LiftFan;
+        Pairing.FanBrakes = getMCBrakes();
+        Pairing.ThatEvent.EventParam = MC_FAN_ON(Pairing.FanBrakes);
+        PostMC(Pairing.ThatEvent);
+        Pairing.isLiftFanOn = true;
+    }
+    if (Pairing.isBrakeHeld && ((Pairing.SpecialByte & SPECIAL_EBRAKE) == 0)){
+        // back to the steady team colour
+        SL_SendTeam(Pairing.currTeam);
+        Pairing.isBrakeHeld = false;
+    }
+    // the PAC holds the bit for a while, wave the flag once per press
+    if ((Pairing.SpecialByte & SPECIAL_CELEBRATE) == SPECIAL_CELEBRATE){
+        if (!Pairing.isCelebrateHeld){
+            SL_SendCelebrate();
+        }
+        Pairing.isCelebrateHeld = true;
     } else {
-        DecryptCounter ++;
+        Pairing.isCelebrateHeld = false;
+    }
+    // telemetry now, on top of the regular ADC_TIMER ones
+    if ((Pairing.SpecialByte & SPECIAL_TELEMETRY) == SPECIAL_TELEMETRY){
+        ThisEvent.EventType = ES_TELEMETRY;
+        ThisEvent.EventParam = 0;
+        PostCommService(ThisEvent);
+    }
+    if ((Pairing.SpecialByte & SPECIAL_UNPAIR) == SPECIAL_UNPAIR){
+        // unpair
+        ThisEvent.EventType = ES_MANUAL_UNPAIR;
+        PostPairingSM(ThisEvent);
     }
 }
 
-static void UpdateSmallPIC(uint8_t PairStatus){
-    if (PairStatus == UNPAIRED){
-        LATA6 = 0;
-        LATA7 = 0;
-    } else if (PairStatus == RED_TEAM){
-        LATA6 = 1;
-        LATA7 = 0;
-    } else if (PairStatus == BLUE_TEAM){
-        LATA6 = 0;
-        LATA7 = 1;
-    } else if (PairStatus == EBRAKE){
-        LATA6 = 1;
-        LATA7 = 1;
+/* Resync: the PAC kept advancing its key counter while we were not hearing
+ * it, one control packet per CTRL_PACKET_SIZE key bytes. Look for the first
+ * counter, at most MaxResumeSkip packets' worth of key bytes ahead, at which
+ * the packet in the receive array (Length RF bytes) decrypts to a valid
+ * control packet or batch. Batches and config writes use a varying number
+ * of key bytes, so once the PAC has sent one every byte in that span is a
+ * candidate. The span
+ * stays short of the key length (see MAX_RESUME_SKIP), so a packet played
+ * back from just behind DecryptCounter is never taken for one ahead of it.
+ * returns the key counter, NO_RESYNC if there is none
+ */
+static uint8_t Resync(uint8_t Length){
+    uint8_t Step = Pairing.isVarLength ? 1 : CTRL_PACKET_SIZE;
+    uint8_t Span = getConfigMaxResumeSkip()*CTRL_PACKET_SIZE;
+    for (uint8_t Ahead=0; Ahead<=Span; Ahead+=Step){
+        uint8_t Candidate = (Pairing.DecryptCounter + Ahead) & KEY_INDEX_MASK;
+        if (IsValidControl(RECV_RF, Candidate, Length)){
+            return Candidate;
+        }
     }
+    return NO_RESYNC;
 }
 
-static void InitADC(void){
-    //Port configuration
-    ANSB3  = 1;   //Set pin B3 to analog
-    TRISB3 = 1;   //Set pin B3 to input
-    WPUB3 = 0;     //Disable weak pull-up on B3
-    //Channel Selection
-    CHS0 = 1;
-    CHS1 = 0;
-    CHS2 = 0;
-    CHS3 = 1;
-    CHS4 = 0;     //Select AN9 (pin B3) (the CSH<4:0> bits of the ADCON0 register determine which positive channel is selected))
-    CHSN0 = 1;
-    CHSN1 = 1;
-    CHSN2 = 1;
-    CHSN3 = 1;    //Use a single ended ADC converter by setting all of CHSN<3:0> bits in ADCON2 register
-    //ADC Voltage Reference Selection
-    ADPREF0 = 0;
-    ADPREF1 = 0;  // we want to choose VDD for positive reference by using the ADPREF bits of the ADCON1 register
-    ADNREF = 0;   // choose VSS for negative reference by using the ADNREF bits of the ADCON1 register
-    //ADC Conversion Clock Source
-    ADCS2 = 0;
-    ADCS1 = 0;
-    ADCS0 = 1;  // use FOSC/8, 16, or 32  (these are in ADCON1; we are going to choose FOSC/8, so that we can get the fastest possible conversion)
-    //Interrupt Control
-    ADIF = 0;   //Clear the ADC interrupt flag
-    ADIE = 1;   //Enable interrupt upon the completion of a conversion (This is in the PIE1 register))
-    PEIE = 1;   //Enable peripheral interrupts
-    GIE = 1;   //Enable global interrupts
-    //Result Formatting
-    ADFM = 0; //Format the results as sign and magnitude so that we can just read the high byte and still get 8-bit resolution
-    ADRMD = 1; //Choose 10 bit mode for a faster conversion
-    //Enable the ADC
-    ADON = 1;
-}
-
-static void GetADC(void){
-    GO_nDONE = 1; //Set the bit in ADCON0 to start a conversion
+// IsValidControl: check header and checksum of a packet's RF data (pData,
+// Length bytes) as if it had been encrypted starting at key index Counter
+static bool IsValidControl(const uint8_t *pData, uint8_t Counter, uint8_t Length){
+    // everything up to the checksum follows the header
+    uint8_t Count = BatchCount(pData, Counter);
+    uint8_t Size = CTRL_PACKET_SIZE;
+    uint8_t Sum = 0;
+    if (Count > 0){
+        Size = BATCH_RF_SIZE(Count);
+        if (Length != Size){
+            return false;
+        }
+    } else if ((Length < Size) || ((pData[0] ^ Pairing.EncryptionKey[Counter]) != CONTROL_HEADER)){
+        return false;
+    }
+    for (uint8_t i=0; i<Size-1; i++){
+        Sum += pData[i] ^ Pairing.EncryptionKey[Counter];
+        Counter = (Counter + 1) & KEY_INDEX_MASK;
+    }
+    return (Sum == (pData[Size-1] ^ Pairing.EncryptionKey[Counter]));
 }
 
-// public getter functions to allow other modules to see this module's private variables
-// this functionality was mainly for debugging
-uint8_t* getEncryptionKey(void){
-    return EncryptionKey;
+// BatchCount: commands in a batch's RF data (pData) if encrypted from key
+// index Counter, 0 if it is not a batch or the count is out of range
+static uint8_t BatchCount(const uint8_t *pData, uint8_t Counter){
+    uint8_t Count;
+    if ((pData[0] ^ Pairing.EncryptionKey[Counter]) != CONTROL_BATCH_HEADER){
+        return 0;
+    }
+    Count = pData[2] ^ Pairing.EncryptionKey[(Counter + 2) & KEY_INDEX_MASK];
+    return (Count <= CTRL_BATCH_MAX) ? Count : 0;
+}
+
+// ConfigLength: record bytes in a config write's RF data (pData) if
+// encrypted from key index Counter, 0 if it is not one or the length is
+// out of range
+static uint8_t ConfigLength(const uint8_t *pData, uint8_t Counter){
+    uint8_t Length;
+    if ((pData[0] ^ Pairing.EncryptionKey[Counter]) != CONFIG_WRITE_HEADER){
+        return 0;
+    }
+    Length = pData[2] ^ Pairing.EncryptionKey[(Counter + 2) & KEY_INDEX_MASK];
+    return (Length <= CONFIG_DATA_MAX) ? Length : 0;
+}
+
+static void IncrementCounter(void){
+    if (Pairing.DecryptCounter == 31){
+        Pairing.DecryptCounter = 0;
+    } else {
+        Pairing.DecryptCounter ++;
+    }
 }
 
+// public getter functions to allow other modules to see this module's private variables
 uint8_t getEncryptedCHKSM(void){
-    return EncryptedCHKSM;
+    return Pairing.EncryptedCHKSM;
 }
 
+#if DEBUG_SERVICES
+// for the debug frames only: the key does not leave a production build
+uint8_t* getEncryptionKey(void){
+    return Pairing.EncryptionKey;
+}
 
 uint8_t getCtrlCheckSum(void){
-    return (ControlSum);
+    return (Pairing.ControlSum);
 }
 
 uint8_t getCtrlCheckSum2(void){
-    return (*(recvPointer + 9)) ^ EncryptionKey[DecryptCounter-1];
+    return Pairing.pFrame->Control.Checksum ^ Pairing.EncryptionKey[Pairing.DecryptCounter-1];
 }
+#endif
 
 int8_t getTurnByte(void){
-    return TurnByte;
+    return Pairing.TurnByte;
 }
 
 int8_t getDriveByte(void){
-    return DriveByte;
+    return Pairing.DriveByte;
 }
 
 uint8_t getPairAddressLSB(void){
-    return PairAddressLSB;
+    return Pairing.PairAddressLSB;
 }
 
 uint8_t getPairAddressMSB(void){
-    return PairAddressMSB;
+    return Pairing.PairAddressMSB;
 }
 
 uint8_t getDecryptCounter(void){
-    return DecryptCounter;
+    return Pairing.DecryptCounter;
 }
 
 uint8_t getSpecialByte(void){
-    return SpecialByte;
+    return Pairing.SpecialByte;
+}
+
+const BatchCommand_t *getDriveBatch(void){
+    return Pairing.Batch;
 }
 
 uint8_t getTeamNumber(void){
-    return TeamNumber;
+    return Pairing.TeamNumber;
+}
+
+PairingState_t getPairingState(void){
+    return Pairing.CurrentState;
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+/****************************************************************************
+ Module
+   PowerManager.c
+
+ Description
+   Idle sleep for the unpaired craft, and the awake and asleep time
+   counters that give its duty cycle.
+
+ Notes
+   The 16F1788 has no IDLE mode (peripherals running, core stopped), only
+   SLEEP, which stops Fosc and with it Timer2 (the PWM), the framework tick
+   and the EUSART baud clock. So the craft only sleeps when none of that
+   matters: PairingSM in Waiting2Pair, CommService between frames, no
+   EEPROM write or ADC conversion under way.
+
+   The watchdog has to be under software control, i.e. the WDTE config bits
+   set to SWDTEN in the project's configuration word, or it either never
+   wakes us or resets the chip while awake.
+
+   Awake time is exact, it is what the framework tick counted. Sleep time
+   is not measured (nothing runs to measure it): a watchdog wake counts a
+   whole PM_WDT_PERIOD_MS, a radio wake half of one, on average. The WDT
+   runs off the LFINTOSC, so treat getPMSleepMs as +/-15%.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <xc.h>
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "ES_Timers.h"
+#include "PIC16F1788.h"
+#include "PowerManager.h"
+#include "PairingSM.h"
+#include "CommService.h"
+#include "ConfigStore.h"
+#include "AdcSequencer.h"
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static bool CanSleep(void);
+static void Sleep(void);
+
+/*---------------------------- Module Variables ---------------------------*/
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL PowerManagerContext_t *pPowerManagerContext;
+#define PM (*pPowerManagerContext)
+#else
+static PowerManagerContext_t PM;
+#endif
+
+/*------------------------------ Module Code ------------------------------*/
+/***********************************
+           Event checker
+ ***********************************/
+/* CheckPowerState: runs once the queues are empty. The first call after a
+ * sleep accounts for the wake-up, and after a watchdog wake the calls that
+ * follow wait on the ADC; otherwise, if nothing needs the clock, the chip
+ * goes to sleep until the radio or the watchdog wakes it.
+ */
+bool CheckPowerState(void)
+{
+    uint16_t Now = ES_Timer_GetTime();
+    PM.AwakeMs += (uint16_t)(Now - PM.LastTime);
+    PM.LastTime = Now;
+
+    if (PM.isAsleep){
+        PM.isAsleep = false;
+        SWDTEN = 0;
+        // the watchdog clears nTO when it wakes us, SLEEP sets it
+        if (nTO == 0){
+            PM.WatchdogWakes++;
+            PM.isScanPending = true;
+            PM.WakeScans = getADCScans();
+            return true;
+        }
+        PM.RadioWakes++;
+        PM.HoldStart = Now;
+        return false;
+    }
+
+    if (PM.isScanPending){
+        ES_Event ThisEvent;
+        // keep the loop going, and the chip awake, until fresh readings are in
+        if ((uint16_t)(getADCScans() - PM.WakeScans) < PM_WAKE_SCANS){
+            return true;
+        }
+        PM.isScanPending = false;
+        // the tick stood still, so ADC_TIMER did too; stand in for it
+        ThisEvent.EventType = ES_TIMEOUT;
+        ThisEvent.EventParam = ADC_TIMER;
+        PostPairingSM(ThisEvent);
+        return true;
+    }
+
+    if (((uint16_t)(Now - PM.HoldStart) >= PM_WAKE_HOLD_MS) && CanSleep()){
+        Sleep();
+    }
+    return false;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static bool CanSleep(void){
+    return (getPairingState() == Waiting2Pair) && getCommIdle()
+           && !getConfigWritePending() && (GO_nDONE == 0);
+}
+
+/* Sleep: with interrupts held off, check again that no byte came in since
+ * the framework found the queues empty, then sleep. An interrupt that is
+ * already pending turns SLEEP into a NOP, and once GIE is back on the
+ * interrupt that woke us is serviced as usual.
+ */
+static void Sleep(void){
+    GIE = 0;
+    if (!getCommIdle()){
+        GIE = 1;
+        return;
+    }
+    PM.isAsleep = true;
+    WUE = 1;                           // the receive line wakes us
+    WDTCON = (uint8_t)(PM_WDTPS << 1); // WDTPS, still off
+    SWDTEN = 1;
+    CLRWDT();
+    SLEEP();
+    NOP();
+    GIE = 1;
+}
+
+// public getter functions, for whoever reports the duty cycle
+uint32_t getPMAwakeMs(void){
+    return PM.AwakeMs;
+}
+
+uint32_t getPMSleepMs(void){
+    return (uint32_t)PM.WatchdogWakes*PM_WDT_PERIOD_MS
+         + (uint32_t)PM.RadioWakes*(PM_WDT_PERIOD_MS/2);
+}
+
+uint16_t getPMWatchdogWakes(void){
+    return PM.WatchdogWakes;
+}
+
+uint16_t getPMRadioWakes(void){
+    return PM.RadioWakes;
+}
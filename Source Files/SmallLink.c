@@ -0,0 +1,248 @@
+/****************************************************************************
+ Module
+   SmallLink.c
+
+ Description
+   Clocked two-wire command link to the PIC12F752 (flag servo and team
+   LEDs), sent from a queue by an event checker so no caller ever waits.
+
+ Notes
+   The line protocol is described in SmallLink.h, the receiving end in
+   DMC_PIC12F752/Small_PIC.asm.
+
+   Timer4 paces the line changes. Nothing interrupts on it: the checker
+   makes the next change whenever it finds TMR4IF set, so a change can come
+   late (the checkers only run once the queues are empty) but never early,
+   and a clocked link does not mind late. A frame with two payload bytes
+   takes 71 changes, a little over 14 ms.
+
+   While a frame is on the wire CheckSmallLink returns true, which keeps
+   the checkers after it, PowerManager's among them, from running: the
+   craft does not go to sleep with a frame half sent.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include <stddef.h>       /* gets NULL */
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "PIC16F1788.h"
+#include "SmallLink.h"
+
+/*----------------------------- Module Defines ----------------------------*/
+#define SL_DATA LATA6
+#define SL_CLOCK LATA7
+#define SL_DATA_TRIS TRISA6
+#define SL_DATA_IN RA6
+
+// Timer4 at Fosc/4 with a 1:4 prescaler, 2 us a count
+#define FOSC 8000000
+#define SL_PR4 ((FOSC/(4*4)) / (1000000/SL_STEP_US) - 1)
+
+#define SL_LENGTH_MASK 0x0F
+#define SL_CMD_SHIFT 4
+
+typedef char SL_AssertPR4[(SL_PR4 <= 255) ? 1 : -1];
+
+// line changes of a frame, in order
+typedef enum { SL_START = 0,    // data low, clock high
+               SL_BIT_SETUP,    // clock low, data = next bit
+               SL_BIT_CLOCK,    // clock high, the small PIC samples
+               SL_ACK_RELEASE,  // clock low, let go of data
+               SL_ACK_CLOCK,    // clock high, the small PIC drives data
+               SL_ACK_SAMPLE,   // read the ack, clock low
+               SL_ACK_END,      // take data back, low
+               SL_STOP_CLOCK,   // clock high
+               SL_STOP          // data high: done
+             } SL_Step_t;
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static bool Queue(uint8_t Command, const uint8_t *pPayload, uint8_t Length);
+static void FrameDone(void);
+
+/*---------------------------- Module Variables ---------------------------*/
+#ifdef MULTI_CRAFT
+CRAFT_LOCAL SmallLinkContext_t *pSmallLinkContext;
+#define Link (*pSmallLinkContext)
+#else
+static SmallLinkContext_t Link;
+#endif
+
+/*------------------------------ Module Code ------------------------------*/
+/***********************************
+            Init function
+ ***********************************/
+// Called from InitPairingSM, before its first command
+void InitSmallLink(void)
+{
+    // both lines idle high
+    SL_DATA = 1;
+    SL_CLOCK = 1;
+    SL_DATA_TRIS = 0;
+    TRISA7 = 0;
+    // Timer4 free running, one period per line change
+    PR4 = SL_PR4;
+    T4CKPS0 = 1;
+    T4CKPS1 = 0;
+    TMR4IF = 0;
+    TMR4ON = 1;
+    Link.Step = SL_START;
+}
+
+/***********************************
+           Send functions
+ ***********************************/
+// each returns false if the queue is full and the command was dropped
+bool SL_SendTeam(uint8_t Team)
+{
+    return Queue(SL_CMD_TEAM, &Team, 1);
+}
+
+bool SL_SendServo(uint8_t PulseWidth, uint8_t StepPeriods)
+{
+    uint8_t Payload[2];
+    Payload[0] = PulseWidth;
+    Payload[1] = StepPeriods;
+    return Queue(SL_CMD_SERVO, Payload, 2);
+}
+
+bool SL_SendLeds(uint8_t Pattern)
+{
+    return Queue(SL_CMD_LEDS, &Pattern, 1);
+}
+
+bool SL_SendCelebrate(void)
+{
+    return Queue(SL_CMD_CELEBRATE, NULL, 0);
+}
+
+/***********************************
+         Event checker
+ ***********************************/
+/* CheckSmallLink: makes the next line change of the frame at the head of
+ * the queue, if Timer4 says it is time. Never posts an event; returns true
+ * while a frame is going out (see Notes).
+ */
+bool CheckSmallLink(void)
+{
+    const SL_Frame_t *pFrame;
+    if (Link.Count == 0){
+        return false;
+    }
+    if (TMR4IF == 0){
+        return true;
+    }
+    TMR4IF = 0;
+    pFrame = &Link.Queue[Link.Head];
+    switch (Link.Step){
+        case SL_START:
+            SL_DATA = 0;
+            Link.ByteIndex = 0;
+            Link.BitMask = 0x80;
+            Link.Step = SL_BIT_SETUP;
+            break;
+        case SL_BIT_SETUP:
+            SL_CLOCK = 0;
+            SL_DATA = (pFrame->Bytes[Link.ByteIndex] & Link.BitMask) ? 1 : 0;
+            Link.Step = SL_BIT_CLOCK;
+            break;
+        case SL_BIT_CLOCK:
+            SL_CLOCK = 1;
+            Link.BitMask >>= 1;
+            Link.Step = SL_BIT_SETUP;
+            if (Link.BitMask == 0){
+                Link.BitMask = 0x80;
+                if (++Link.ByteIndex == pFrame->Length){
+                    Link.Step = SL_ACK_RELEASE;
+                }
+            }
+            break;
+        case SL_ACK_RELEASE:
+            SL_CLOCK = 0;
+            SL_DATA_TRIS = 1;
+            Link.Step = SL_ACK_CLOCK;
+            break;
+        case SL_ACK_CLOCK:
+            SL_CLOCK = 1;
+            Link.Step = SL_ACK_SAMPLE;
+            break;
+        case SL_ACK_SAMPLE:
+            // with nobody driving the line it is as likely to read high
+            Link.isAcked = (SL_DATA_IN == 0);
+            SL_CLOCK = 0;
+            Link.Step = SL_ACK_END;
+            break;
+        case SL_ACK_END:
+            // a step after the clock fell, so the small PIC has let go
+            SL_DATA = 0;
+            SL_DATA_TRIS = 0;
+            Link.Step = SL_STOP_CLOCK;
+            break;
+        case SL_STOP_CLOCK:
+            SL_CLOCK = 1;
+            Link.Step = SL_STOP;
+            break;
+        case SL_STOP:
+            SL_DATA = 1;
+            FrameDone();
+            break;
+        default:
+            Link.Step = SL_START;
+            break;
+    }
+    return true;
+}
+
+/*---------------------------- Helper Functions ---------------------------*/
+static bool Queue(uint8_t Command, const uint8_t *pPayload, uint8_t Length){
+    SL_Frame_t *pFrame;
+    uint8_t Sum;
+    if (Link.Count == SL_QUEUE_SIZE){
+        Link.Dropped++;
+        return false;
+    }
+    pFrame = &Link.Queue[(Link.Head + Link.Count) % SL_QUEUE_SIZE];
+    pFrame->Bytes[0] = (uint8_t)((Command << SL_CMD_SHIFT) | (Length & SL_LENGTH_MASK));
+    Sum = pFrame->Bytes[0];
+    for (uint8_t i=0; i<Length; i++){
+        pFrame->Bytes[1 + i] = pPayload[i];
+        Sum += pPayload[i];
+    }
+    pFrame->Bytes[1 + Length] = 0xFF - Sum;
+    pFrame->Length = Length + 2;
+    Link.Count++;
+    return true;
+}
+
+// FrameDone: the stop is out; move on, or try the same frame again
+static void FrameDone(void){
+    Link.Step = SL_START;
+    if (Link.isAcked){
+        Link.Frames++;
+    } else {
+        Link.Nacks++;
+        if (++Link.Tries < SL_MAX_TRIES){
+            return;
+        }
+        Link.Dropped++;
+    }
+    Link.Tries = 0;
+    Link.Head = (Link.Head + 1) % SL_QUEUE_SIZE;
+    Link.Count--;
+}
+
+// public getter functions
+bool getSLIdle(void){
+    return (Link.Count == 0);
+}
+
+uint16_t getSLFrames(void){
+    return Link.Frames;
+}
+
+uint16_t getSLNacks(void){
+    return Link.Nacks;
+}
+
+uint16_t getSLDropped(void){
+    return Link.Dropped;
+}
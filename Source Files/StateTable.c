@@ -0,0 +1,112 @@
+/****************************************************************************
+ Module
+   StateTable.c
+
+ Description
+   Small engine that runs the flat state machines in this project from
+   const transition tables instead of nested if/else chains.
+
+ Notes
+   Define SM_COVERAGE to count how often each transition is taken and
+   SM_DUMP to get SM_Dump, which prints a table (and its counters) as CSV
+   for coverage analysis on the host.
+
+****************************************************************************/
+/*----------------------------- Include Files -----------------------------*/
+#include "ES_Configure.h"
+#include "ES_Framework.h"
+#include "StateTable.h"
+#ifdef SM_DUMP
+#include <stdio.h>
+#endif
+
+/*---------------------------- Module Prototypes ---------------------------*/
+static bool TryRows(const SM_Table_t *pTable, uint8_t Block, uint8_t *pState,
+                    const ES_Event *pEvent);
+
+/*------------------------------ Module Code ------------------------------*/
+/* SM_Dispatch: run one event through a state machine
+ * returns true if a transition was taken
+ */
+bool SM_Dispatch(const SM_Table_t *pTable, uint8_t *pState, const ES_Event *pEvent)
+{
+    if (pEvent->EventType >= ES_NUM_EVENTS){
+        return false;
+    }
+    if (TryRows(pTable, *pState, pState, pEvent)){
+        return true;
+    }
+    return TryRows(pTable, SM_ANY_STATE(pTable->NumStates), pState, pEvent);
+}
+
+#ifdef SM_DUMP
+/* SM_Dump: print every transition of a table as
+ *   table,row,state,event,guarded,action,next,hits
+ * and check that the index points at the first row of each (state, event)
+ * pair. returns false if the index and the rows disagree.
+ */
+bool SM_Dump(const SM_Table_t *pTable)
+{
+    bool isConsistent = true;
+    for (uint8_t i=0; i<pTable->NumRows; i++){
+        const SM_Transition_t *pRow = &pTable->Rows[i];
+        uint8_t First = pTable->Index[SM_INDEX(pRow->State, pRow->Event)];
+        bool isFirst = (i == 0) || (pTable->Rows[i-1].State != pRow->State)
+                || (pTable->Rows[i-1].Event != pRow->Event);
+        if ((isFirst && (First != i+1)) || (!isFirst && (First == i+1))
+                || (First == SM_NO_ROW) || (First > i+1)){
+            printf("%s,%u,index mismatch\n", pTable->Name, i);
+            isConsistent = false;
+        }
+        printf("%s,%u,%u,%u,%u,%u,%u,", pTable->Name, i, pRow->State,
+               pRow->Event, pRow->Guard != NULL, pRow->Action != NULL,
+               pRow->NextState);
+#ifdef SM_COVERAGE
+        printf("%u\n", pTable->Hits[i]);
+#else
+        printf("-\n");
+#endif
+    }
+    // and that every index slot in use points at a row for that slot
+    for (uint16_t j=0; j<SM_INDEX_SIZE(pTable->NumStates); j++){
+        uint8_t Row = pTable->Index[j];
+        if ((Row != SM_NO_ROW) && ((Row > pTable->NumRows)
+                || (SM_INDEX(pTable->Rows[Row-1].State, pTable->Rows[Row-1].Event) != j))){
+            printf("%s,slot %u,index mismatch\n", pTable->Name, j);
+            isConsistent = false;
+        }
+    }
+    return isConsistent;
+}
+#endif
+
+/*---------------------------- Helper Functions ---------------------------*/
+// TryRows: take the first transition of (Block, event) whose guard passes
+static bool TryRows(const SM_Table_t *pTable, uint8_t Block, uint8_t *pState,
+                    const ES_Event *pEvent)
+{
+    uint8_t Row = pTable->Index[SM_INDEX(Block, pEvent->EventType)];
+    if (Row == SM_NO_ROW){
+        return false;
+    }
+    // index holds row number + 1
+    for (Row--; Row < pTable->NumRows; Row++){
+        const SM_Transition_t *pRow = &pTable->Rows[Row];
+        if ((pRow->State != Block) || (pRow->Event != pEvent->EventType)){
+            break;
+        }
+        if ((pRow->Guard == NULL) || pRow->Guard(pEvent)){
+            if (pRow->Action != NULL){
+                pRow->Action(pEvent);
+            }
+            if (pRow->NextState != SM_SAME_STATE){
+                *pState = pRow->NextState;
+            }
+#ifdef SM_COVERAGE
+            pTable->Hits[Row]++;
+#endif
+            return true;
+        }
+    }
+    return false;
+}